@@ -0,0 +1,65 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "base/async_timer.h"
+
+#include "base/message_loop/message_loop.h"
+#include "base/message_loop/message_pump_asio.h"
+
+namespace base {
+
+AsyncTimer::AsyncTimer()
+    : timer_(MessageLoop::current()->pumpAsio()->ioContext()),
+      waiter_(MessageLoop::current()->pumpAsio()->ioContext())
+{
+    // Nothing
+}
+
+AsyncTimer::~AsyncTimer() = default;
+
+AsyncTimer::SleepAwaiter AsyncTimer::sleep(const std::chrono::milliseconds& delay)
+{
+    cancelled_ = false;
+    return SleepAwaiter(this, delay);
+}
+
+void AsyncTimer::cancel()
+{
+    if (!waiter_.isWaiting())
+        return;
+
+    cancelled_ = true;
+    timer_.cancel();
+}
+
+void AsyncTimer::SleepAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+    timer_->waiter_.suspend(handle);
+
+    // The handler is called from the io_context, so the coroutine is resumed directly. If the
+    // timer is destroyed, the handler is called with an error and does nothing.
+    timer_->timer_.expires_after(delay_);
+    timer_->timer_.async_wait(timer_->waiter_.resumer());
+}
+
+bool AsyncTimer::SleepAwaiter::await_resume() const
+{
+    return !timer_->cancelled_;
+}
+
+} // namespace base
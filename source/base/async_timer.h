@@ -0,0 +1,81 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BASE__ASYNC_TIMER_H
+#define BASE__ASYNC_TIMER_H
+
+#include "base/coroutine.h"
+
+#include <asio/steady_timer.hpp>
+
+#include <chrono>
+
+namespace base {
+
+//
+// Timer for coroutines. Works on the io_context of the current message loop.
+// Example:
+//
+// base::AsyncTimer timer;
+// if (!co_await timer.sleep(std::chrono::seconds(5)))
+//     co_return; // The timer was cancelled.
+//
+class AsyncTimer
+{
+public:
+    AsyncTimer();
+    ~AsyncTimer();
+
+    class SleepAwaiter
+    {
+    public:
+        bool await_ready() const { return false; }
+        void await_suspend(std::coroutine_handle<> handle);
+        bool await_resume() const;
+
+    private:
+        friend class AsyncTimer;
+        SleepAwaiter(AsyncTimer* timer, const std::chrono::milliseconds& delay)
+            : timer_(timer),
+              delay_(delay)
+        {
+            // Nothing
+        }
+
+        AsyncTimer* timer_;
+        std::chrono::milliseconds delay_;
+    };
+
+    // Suspends the coroutine for |delay|. The result of co_await is false if the timer was
+    // cancelled.
+    SleepAwaiter sleep(const std::chrono::milliseconds& delay);
+
+    // Wakes up the sleeping coroutine.
+    void cancel();
+
+private:
+    asio::steady_timer timer_;
+    internal::CoroutineWaiter waiter_;
+    bool cancelled_ = false;
+
+    DISALLOW_COPY_AND_ASSIGN(AsyncTimer);
+};
+
+} // namespace base
+
+#endif // BASE__ASYNC_TIMER_H
@@ -19,6 +19,7 @@
 #ifndef BASE__CONVERTER_H
 #define BASE__CONVERTER_H
 
+#include "base/files/file_util.h"
 #include "base/memory/byte_array.h"
 #include "base/strings/string_number_conversions.h"
 #include "base/strings/string_util.h"
@@ -86,13 +87,13 @@ struct ConverterImpl<std::filesystem::path>
 {
     static bool fromString(std::string_view str, std::filesystem::path* value)
     {
-        *value = std::filesystem::u8path(str);
+        *value = filePathFromUtf8(str);
         return true;
     }
 
     static std::string toString(const std::filesystem::path& value)
     {
-        return value.u8string();
+        return utf8FromFilePath(value);
     }
 };
 
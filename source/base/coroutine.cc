@@ -0,0 +1,170 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "base/coroutine.h"
+
+#include "base/logging.h"
+
+#include <array>
+#include <new>
+
+namespace base {
+
+namespace {
+
+const size_t kMinSizeClass = 256;
+const size_t kSizeClassCount = 5; // 256, 512, 1024, 2048, 4096 bytes.
+const size_t kMaxFreeBlocks = 64;
+
+class FramePool
+{
+public:
+    FramePool() = default;
+
+    ~FramePool()
+    {
+        for (auto& list : lists_)
+        {
+            while (list.head)
+            {
+                FreeBlock* next = list.head->next;
+                ::operator delete(list.head);
+                list.head = next;
+            }
+        }
+    }
+
+    void* allocate(size_t size_class)
+    {
+        List& list = lists_[size_class];
+
+        if (!list.head)
+            return ::operator new(kMinSizeClass << size_class);
+
+        FreeBlock* block = list.head;
+        list.head = block->next;
+        --list.count;
+        return block;
+    }
+
+    void deallocate(void* ptr, size_t size_class)
+    {
+        List& list = lists_[size_class];
+
+        if (list.count >= kMaxFreeBlocks)
+        {
+            ::operator delete(ptr);
+            return;
+        }
+
+        FreeBlock* block = new (ptr) FreeBlock();
+        block->next = list.head;
+        list.head = block;
+        ++list.count;
+    }
+
+private:
+    struct FreeBlock
+    {
+        FreeBlock* next = nullptr;
+    };
+
+    struct List
+    {
+        FreeBlock* head = nullptr;
+        size_t count = 0;
+    };
+
+    std::array<List, kSizeClassCount> lists_;
+
+    DISALLOW_COPY_AND_ASSIGN(FramePool);
+};
+
+thread_local FramePool frame_pool;
+
+// Returns the size class for |size| or kSizeClassCount if the size is too large.
+size_t sizeClass(size_t size)
+{
+    size_t size_class = 0;
+
+    while (size_class < kSizeClassCount && (kMinSizeClass << size_class) < size)
+        ++size_class;
+
+    return size_class;
+}
+
+} // namespace
+
+// static
+void* CoroutineFrameAllocator::allocate(size_t size)
+{
+    const size_t size_class = sizeClass(size);
+    if (size_class == kSizeClassCount)
+        return ::operator new(size);
+
+    return frame_pool.allocate(size_class);
+}
+
+// static
+void CoroutineFrameAllocator::deallocate(void* ptr, size_t size)
+{
+    const size_t size_class = sizeClass(size);
+    if (size_class == kSizeClassCount)
+    {
+        ::operator delete(ptr);
+        return;
+    }
+
+    // A frame can be destroyed on a thread other than the one on which it was created. The block
+    // simply moves to the list of the current thread.
+    frame_pool.deallocate(ptr, size_class);
+}
+
+namespace internal {
+
+CoroutineWaiter::CoroutineWaiter(asio::io_context& io_context)
+    : io_context_(io_context),
+      state_(std::make_shared<State>())
+{
+    // Nothing
+}
+
+CoroutineWaiter::~CoroutineWaiter()
+{
+    std::coroutine_handle<> handle = std::exchange(state_->handle, nullptr);
+    if (handle)
+        handle.destroy();
+}
+
+void CoroutineWaiter::suspend(std::coroutine_handle<> handle)
+{
+    DCHECK(!state_->handle);
+    state_->handle = handle;
+}
+
+void CoroutineWaiter::resumeLater()
+{
+    if (!state_->handle)
+        return;
+
+    asio::post(io_context_, resumer());
+}
+
+} // namespace internal
+
+} // namespace base
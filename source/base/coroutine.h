@@ -0,0 +1,135 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BASE__COROUTINE_H
+#define BASE__COROUTINE_H
+
+#include "base/macros_magic.h"
+
+#include <asio/io_context.hpp>
+#include <asio/post.hpp>
+
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <utility>
+
+namespace base {
+
+//
+// Allocator for coroutine frames.
+// Frames are taken from thread-local lists of free blocks grouped by size, so that a coroutine
+// started for each connection or request does not go to the system allocator. Blocks that are
+// larger than the maximum size class are allocated with the global operator new.
+//
+class CoroutineFrameAllocator
+{
+public:
+    static void* allocate(size_t size);
+    static void deallocate(void* ptr, size_t size);
+
+private:
+    DISALLOW_COPY_AND_ASSIGN(CoroutineFrameAllocator);
+};
+
+//
+// Return type of a coroutine that is started immediately and is not awaited by anyone (like a
+// function posted to a task runner). The frame is destroyed when the coroutine completes.
+// Example:
+//
+// base::Job Handshake::run()
+// {
+//     std::optional<base::ByteArray> message = co_await channel_.read();
+//     if (!message)
+//         co_return;
+//     ...
+//     if (!co_await channel_.write(std::move(reply)))
+//         co_return;
+// }
+//
+class Job
+{
+public:
+    struct promise_type
+    {
+        Job get_return_object() { return Job(); }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() { /* Nothing */ }
+        void unhandled_exception() { std::terminate(); }
+
+        static void* operator new(size_t size)
+        {
+            return CoroutineFrameAllocator::allocate(size);
+        }
+
+        static void operator delete(void* ptr, size_t size)
+        {
+            CoroutineFrameAllocator::deallocate(ptr, size);
+        }
+    };
+};
+
+namespace internal {
+
+//
+// Keeps the coroutine suspended on an awaitable object. The coroutine is resumed through the
+// io_context, so it never runs inside a listener callback of a channel or timer.
+// If the waiter is destroyed while the coroutine is suspended, the coroutine frame is destroyed.
+//
+class CoroutineWaiter
+{
+public:
+    explicit CoroutineWaiter(asio::io_context& io_context);
+    ~CoroutineWaiter();
+
+    void suspend(std::coroutine_handle<> handle);
+    bool isWaiting() const { return state_->handle != nullptr; }
+
+    // Schedules resumption of the suspended coroutine.
+    void resumeLater();
+
+    // Returns a function object that resumes the suspended coroutine when called. The object may
+    // outlive the waiter; in that case the call does nothing.
+    auto resumer()
+    {
+        return [state = state_](auto&&...)
+        {
+            std::coroutine_handle<> handle = std::exchange(state->handle, nullptr);
+            if (handle)
+                handle.resume();
+        };
+    }
+
+private:
+    struct State
+    {
+        std::coroutine_handle<> handle;
+    };
+
+    asio::io_context& io_context_;
+    std::shared_ptr<State> state_;
+
+    DISALLOW_COPY_AND_ASSIGN(CoroutineWaiter);
+};
+
+} // namespace internal
+
+} // namespace base
+
+#endif // BASE__COROUTINE_H
@@ -0,0 +1,139 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "base/coroutine.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+namespace base {
+
+namespace {
+
+class TestEvent
+{
+public:
+    explicit TestEvent(asio::io_context& io_context)
+        : waiter_(io_context)
+    {
+        // Nothing
+    }
+
+    class Awaiter
+    {
+    public:
+        explicit Awaiter(TestEvent* event) : event_(event) {}
+
+        bool await_ready() const { return event_->signaled_; }
+        void await_suspend(std::coroutine_handle<> handle) { event_->waiter_.suspend(handle); }
+        void await_resume() const { /* Nothing */ }
+
+    private:
+        TestEvent* event_;
+    };
+
+    Awaiter wait() { return Awaiter(this); }
+
+    void signal()
+    {
+        signaled_ = true;
+        waiter_.resumeLater();
+    }
+
+    bool isWaiting() const { return waiter_.isWaiting(); }
+
+private:
+    internal::CoroutineWaiter waiter_;
+    bool signaled_ = false;
+};
+
+class Guard
+{
+public:
+    explicit Guard(bool* destroyed) : destroyed_(destroyed) {}
+    ~Guard() { *destroyed_ = true; }
+
+private:
+    bool* destroyed_;
+};
+
+Job waitForEvent(TestEvent* event, std::vector<int>* log, bool* destroyed)
+{
+    Guard guard(destroyed);
+
+    log->push_back(1);
+    co_await event->wait();
+    log->push_back(2);
+}
+
+} // namespace
+
+TEST(CoroutineTest, ResumedThroughIoContext)
+{
+    asio::io_context io_context;
+    TestEvent event(io_context);
+    std::vector<int> log;
+    bool destroyed = false;
+
+    waitForEvent(&event, &log, &destroyed);
+    EXPECT_EQ(log, std::vector<int>({ 1 }));
+    EXPECT_TRUE(event.isWaiting());
+
+    event.signal();
+
+    // The coroutine is not resumed inside signal().
+    EXPECT_EQ(log, std::vector<int>({ 1 }));
+
+    io_context.run();
+    EXPECT_EQ(log, std::vector<int>({ 1, 2 }));
+    EXPECT_TRUE(destroyed);
+}
+
+TEST(CoroutineTest, DestroyedWithWaiter)
+{
+    asio::io_context io_context;
+    std::vector<int> log;
+    bool destroyed = false;
+
+    {
+        TestEvent event(io_context);
+        waitForEvent(&event, &log, &destroyed);
+        EXPECT_FALSE(destroyed);
+    }
+
+    EXPECT_TRUE(destroyed);
+    EXPECT_EQ(log, std::vector<int>({ 1 }));
+}
+
+TEST(CoroutineTest, FrameAllocator)
+{
+    void* block = CoroutineFrameAllocator::allocate(300);
+    CoroutineFrameAllocator::deallocate(block, 300);
+
+    // A freed block of the same size class is reused.
+    void* other_block = CoroutineFrameAllocator::allocate(500);
+    EXPECT_EQ(block, other_block);
+    CoroutineFrameAllocator::deallocate(other_block, 500);
+
+    void* large_block = CoroutineFrameAllocator::allocate(1024 * 1024);
+    EXPECT_NE(large_block, nullptr);
+    CoroutineFrameAllocator::deallocate(large_block, 1024 * 1024);
+}
+
+} // namespace base
@@ -0,0 +1,373 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "base/files/file.h"
+
+#include "base/logging.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+#if defined(OS_POSIX)
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif // defined(OS_POSIX)
+
+namespace base {
+
+#if defined(OS_WIN)
+
+namespace {
+
+// ReadFile and WriteFile take the size as DWORD.
+const size_t kMaxChunkSize = 1024 * 1024 * 1024;
+
+OVERLAPPED overlappedForOffset(uint64_t offset)
+{
+    OVERLAPPED overlapped;
+    memset(&overlapped, 0, sizeof(overlapped));
+
+    overlapped.Offset = static_cast<DWORD>(offset & 0xFFFFFFFF);
+    overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+    return overlapped;
+}
+
+} // namespace
+
+File::File(win::ScopedHandle&& handle)
+    : handle_(std::move(handle))
+{
+    // Nothing
+}
+
+File::~File() = default;
+
+// static
+std::unique_ptr<File> File::openForReading(const std::filesystem::path& file_path)
+{
+    win::ScopedHandle handle(CreateFileW(file_path.c_str(),
+                                         GENERIC_READ,
+                                         FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                         nullptr,
+                                         OPEN_EXISTING,
+                                         FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+                                         nullptr));
+    if (!handle.isValid())
+        return nullptr;
+
+    return std::unique_ptr<File>(new File(std::move(handle)));
+}
+
+// static
+std::unique_ptr<File> File::createForWriting(const std::filesystem::path& file_path,
+                                             bool overwrite)
+{
+    win::ScopedHandle handle(CreateFileW(file_path.c_str(),
+                                         GENERIC_WRITE,
+                                         FILE_SHARE_READ,
+                                         nullptr,
+                                         overwrite ? CREATE_ALWAYS : CREATE_NEW,
+                                         FILE_ATTRIBUTE_NORMAL,
+                                         nullptr));
+    if (!handle.isValid())
+        return nullptr;
+
+    return std::unique_ptr<File>(new File(std::move(handle)));
+}
+
+// static
+std::unique_ptr<File> File::openForWriting(const std::filesystem::path& file_path)
+{
+    win::ScopedHandle handle(CreateFileW(file_path.c_str(),
+                                         GENERIC_WRITE,
+                                         FILE_SHARE_READ,
+                                         nullptr,
+                                         OPEN_EXISTING,
+                                         FILE_ATTRIBUTE_NORMAL,
+                                         nullptr));
+    if (!handle.isValid())
+        return nullptr;
+
+    return std::unique_ptr<File>(new File(std::move(handle)));
+}
+
+int64_t File::size() const
+{
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(handle_.get(), &size))
+    {
+        PLOG(LS_WARNING) << "GetFileSizeEx failed";
+        return -1;
+    }
+
+    return size.QuadPart;
+}
+
+bool File::read(uint64_t offset, void* buffer, size_t size)
+{
+    uint8_t* current = reinterpret_cast<uint8_t*>(buffer);
+
+    while (size)
+    {
+        OVERLAPPED overlapped = overlappedForOffset(offset);
+        DWORD read_bytes = 0;
+
+        if (!ReadFile(handle_.get(), current, static_cast<DWORD>(std::min(size, kMaxChunkSize)),
+                      &read_bytes, &overlapped))
+        {
+            // Reading at the end of the file with an offset fails with ERROR_HANDLE_EOF.
+            if (GetLastError() == ERROR_HANDLE_EOF)
+            {
+                LOG(LS_WARNING) << "Unexpected end of file";
+                return false;
+            }
+
+            PLOG(LS_WARNING) << "ReadFile failed";
+            return false;
+        }
+
+        if (!read_bytes)
+        {
+            LOG(LS_WARNING) << "Unexpected end of file";
+            return false;
+        }
+
+        current += read_bytes;
+        offset += read_bytes;
+        size -= read_bytes;
+    }
+
+    return true;
+}
+
+bool File::write(uint64_t offset, const void* data, size_t size)
+{
+    const uint8_t* current = reinterpret_cast<const uint8_t*>(data);
+
+    while (size)
+    {
+        OVERLAPPED overlapped = overlappedForOffset(offset);
+        DWORD written_bytes = 0;
+
+        if (!WriteFile(handle_.get(), current, static_cast<DWORD>(std::min(size, kMaxChunkSize)),
+                       &written_bytes, &overlapped))
+        {
+            PLOG(LS_WARNING) << "WriteFile failed";
+            return false;
+        }
+
+        current += written_bytes;
+        offset += written_bytes;
+        size -= written_bytes;
+    }
+
+    return true;
+}
+
+void File::readAhead(uint64_t /* offset */, uint64_t /* size */)
+{
+    // The file is opened with FILE_FLAG_SEQUENTIAL_SCAN and the cache manager reads it ahead.
+}
+
+bool File::preallocate(uint64_t size)
+{
+    FILE_ALLOCATION_INFO info;
+    info.AllocationSize.QuadPart = static_cast<LONGLONG>(size);
+
+    if (!SetFileInformationByHandle(handle_.get(), FileAllocationInfo, &info, sizeof(info)))
+    {
+        PLOG(LS_WARNING) << "SetFileInformationByHandle failed";
+        return false;
+    }
+
+    return true;
+}
+
+#elif defined(OS_POSIX)
+
+File::File(int fd)
+    : fd_(fd)
+{
+    // Nothing
+}
+
+File::~File()
+{
+    if (fd_ != -1)
+        ::close(fd_);
+}
+
+// static
+std::unique_ptr<File> File::openForReading(const std::filesystem::path& file_path)
+{
+    int fd = ::open(file_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return nullptr;
+
+#if defined(OS_LINUX)
+    // Doubles the read-ahead window of the kernel for this file.
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif // defined(OS_LINUX)
+
+    return std::unique_ptr<File>(new File(fd));
+}
+
+// static
+std::unique_ptr<File> File::createForWriting(const std::filesystem::path& file_path,
+                                             bool overwrite)
+{
+    int flags = O_WRONLY | O_CREAT | O_CLOEXEC;
+
+    if (overwrite)
+        flags |= O_TRUNC;
+    else
+        flags |= O_EXCL;
+
+    int fd = ::open(file_path.c_str(), flags, 0666);
+    if (fd == -1)
+        return nullptr;
+
+    return std::unique_ptr<File>(new File(fd));
+}
+
+// static
+std::unique_ptr<File> File::openForWriting(const std::filesystem::path& file_path)
+{
+    int fd = ::open(file_path.c_str(), O_WRONLY | O_CLOEXEC);
+    if (fd == -1)
+        return nullptr;
+
+    return std::unique_ptr<File>(new File(fd));
+}
+
+int64_t File::size() const
+{
+    struct stat info;
+    if (fstat(fd_, &info) == -1)
+    {
+        PLOG(LS_WARNING) << "fstat failed";
+        return -1;
+    }
+
+    return info.st_size;
+}
+
+bool File::read(uint64_t offset, void* buffer, size_t size)
+{
+    uint8_t* current = reinterpret_cast<uint8_t*>(buffer);
+
+    while (size)
+    {
+        ssize_t read_bytes = pread(fd_, current, size, static_cast<off_t>(offset));
+        if (read_bytes == -1)
+        {
+            if (errno == EINTR)
+                continue;
+
+            PLOG(LS_WARNING) << "pread failed";
+            return false;
+        }
+
+        if (!read_bytes)
+        {
+            LOG(LS_WARNING) << "Unexpected end of file";
+            return false;
+        }
+
+        current += read_bytes;
+        offset += static_cast<uint64_t>(read_bytes);
+        size -= static_cast<size_t>(read_bytes);
+    }
+
+    return true;
+}
+
+bool File::write(uint64_t offset, const void* data, size_t size)
+{
+    const uint8_t* current = reinterpret_cast<const uint8_t*>(data);
+
+    while (size)
+    {
+        ssize_t written_bytes = pwrite(fd_, current, size, static_cast<off_t>(offset));
+        if (written_bytes == -1)
+        {
+            if (errno == EINTR)
+                continue;
+
+            PLOG(LS_WARNING) << "pwrite failed";
+            return false;
+        }
+
+        current += written_bytes;
+        offset += static_cast<uint64_t>(written_bytes);
+        size -= static_cast<size_t>(written_bytes);
+    }
+
+    return true;
+}
+
+void File::readAhead(uint64_t offset, uint64_t size)
+{
+#if defined(OS_LINUX)
+    posix_fadvise(fd_, static_cast<off_t>(offset), static_cast<off_t>(size), POSIX_FADV_WILLNEED);
+#elif defined(OS_MACOSX)
+    struct radvisory advisory;
+    advisory.ra_offset = static_cast<off_t>(offset);
+    advisory.ra_count = static_cast<int>(std::min<uint64_t>(size, INT_MAX));
+    fcntl(fd_, F_RDADVISE, &advisory);
+#endif
+}
+
+bool File::preallocate(uint64_t size)
+{
+#if defined(OS_LINUX)
+    // Unlike posix_fallocate, it does not fall back to writing zeros on file systems without
+    // the support of preallocation.
+    if (fallocate(fd_, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(size)) == -1)
+    {
+        PLOG(LS_WARNING) << "fallocate failed";
+        return false;
+    }
+
+    return true;
+#elif defined(OS_MACOSX)
+    fstore_t store;
+    memset(&store, 0, sizeof(store));
+
+    store.fst_flags = F_ALLOCATEALL;
+    store.fst_posmode = F_PEOFPOSMODE;
+    store.fst_length = static_cast<off_t>(size);
+
+    if (fcntl(fd_, F_PREALLOCATE, &store) == -1)
+    {
+        PLOG(LS_WARNING) << "fcntl(F_PREALLOCATE) failed";
+        return false;
+    }
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+#endif // defined(OS_POSIX)
+
+} // namespace base
@@ -0,0 +1,91 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BASE__FILES__FILE_H
+#define BASE__FILES__FILE_H
+
+#include "base/macros_magic.h"
+#include "build/build_config.h"
+
+#if defined(OS_WIN)
+#include "base/win/scoped_object.h"
+#endif // defined(OS_WIN)
+
+#include <filesystem>
+#include <memory>
+
+namespace base {
+
+//
+// File with positional reads and writes.
+// Unlike std::fstream the class has no own buffer: the data is read directly into the buffer of
+// the caller and written directly from it, and the position is passed with each call, so no seek
+// is needed. The hints below let the system read the file ahead and reserve disk space for it.
+//
+class File
+{
+public:
+    ~File();
+
+    // Opens an existing file for reading. The system is told that the file will be read
+    // sequentially. Returns nullptr if the file can not be opened.
+    static std::unique_ptr<File> openForReading(const std::filesystem::path& file_path);
+
+    // Creates a file for writing. If |overwrite| is true, an existing file is truncated, otherwise
+    // the call fails if the file already exists. Returns nullptr if the file can not be created.
+    static std::unique_ptr<File> createForWriting(const std::filesystem::path& file_path,
+                                                  bool overwrite);
+
+    // Opens an existing file for writing. Unlike createForWriting, the file is not truncated, so
+    // the writing can be continued. Returns nullptr if the file can not be opened.
+    static std::unique_ptr<File> openForWriting(const std::filesystem::path& file_path);
+
+    // Returns the current size of the file or -1 on error.
+    int64_t size() const;
+
+    // Reads exactly |size| bytes at |offset|. Returns false if an error occurred or the end of
+    // the file was reached earlier.
+    bool read(uint64_t offset, void* buffer, size_t size);
+
+    // Writes |size| bytes at |offset|.
+    bool write(uint64_t offset, const void* data, size_t size);
+
+    // Asks the system to start reading |size| bytes at |offset| into the cache in the background.
+    // The call does not wait for the data and does nothing where it is not supported.
+    void readAhead(uint64_t offset, uint64_t size);
+
+    // Reserves disk space for a file of |size| bytes without changing the file size. It reduces
+    // fragmentation of large files. Returns false if the space was not reserved; the file can
+    // still be written in this case.
+    bool preallocate(uint64_t size);
+
+private:
+#if defined(OS_WIN)
+    explicit File(win::ScopedHandle&& handle);
+    win::ScopedHandle handle_;
+#elif defined(OS_POSIX)
+    explicit File(int fd);
+    int fd_ = -1;
+#endif
+
+    DISALLOW_COPY_AND_ASSIGN(File);
+};
+
+} // namespace base
+
+#endif // BASE__FILES__FILE_H
@@ -0,0 +1,151 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "base/files/file.h"
+
+#include "base/files/scoped_temp_directory.h"
+
+#include <gtest/gtest.h>
+
+#include <numeric>
+#include <string>
+
+namespace base {
+
+namespace {
+
+std::string testData(size_t size)
+{
+    std::string data(size, 0);
+    std::iota(data.begin(), data.end(), 0);
+    return data;
+}
+
+} // namespace
+
+TEST(FileTest, WriteAndRead)
+{
+    ScopedTempDirectory temp_directory("aspia_file_test");
+    ASSERT_TRUE(temp_directory.isValid());
+    const std::filesystem::path file_path = temp_directory.filePath("write_and_read");
+    const std::string data = testData(256 * 1024);
+
+    {
+        std::unique_ptr<File> file = File::createForWriting(file_path, false);
+        ASSERT_TRUE(file);
+
+        // Write the second half first, the position is passed with each call.
+        EXPECT_TRUE(file->write(data.size() / 2, data.data() + data.size() / 2, data.size() / 2));
+        EXPECT_TRUE(file->write(0, data.data(), data.size() / 2));
+        EXPECT_EQ(file->size(), static_cast<int64_t>(data.size()));
+    }
+
+    std::unique_ptr<File> file = File::openForReading(file_path);
+    ASSERT_TRUE(file);
+    EXPECT_EQ(file->size(), static_cast<int64_t>(data.size()));
+
+    file->readAhead(0, data.size());
+
+    std::string buffer(data.size(), 0);
+    EXPECT_TRUE(file->read(0, buffer.data(), buffer.size()));
+    EXPECT_EQ(buffer, data);
+
+    std::string part(100, 0);
+    EXPECT_TRUE(file->read(1000, part.data(), part.size()));
+    EXPECT_EQ(part, data.substr(1000, 100));
+
+    // Reading past the end of the file fails.
+    EXPECT_FALSE(file->read(data.size() - 10, part.data(), part.size()));
+}
+
+TEST(FileTest, Overwrite)
+{
+    ScopedTempDirectory temp_directory("aspia_file_test");
+    ASSERT_TRUE(temp_directory.isValid());
+    const std::filesystem::path file_path = temp_directory.filePath("overwrite");
+
+    {
+        std::unique_ptr<File> file = File::createForWriting(file_path, false);
+        ASSERT_TRUE(file);
+        EXPECT_TRUE(file->write(0, "0123456789", 10));
+    }
+
+    // The file already exists.
+    EXPECT_FALSE(File::createForWriting(file_path, false));
+
+    std::unique_ptr<File> file = File::createForWriting(file_path, true);
+    ASSERT_TRUE(file);
+    EXPECT_EQ(file->size(), 0);
+}
+
+TEST(FileTest, ContinueWriting)
+{
+    ScopedTempDirectory temp_directory("aspia_file_test");
+    ASSERT_TRUE(temp_directory.isValid());
+    const std::filesystem::path file_path = temp_directory.filePath("continue_writing");
+
+    // The file does not exist.
+    EXPECT_FALSE(File::openForWriting(file_path));
+
+    {
+        std::unique_ptr<File> file = File::createForWriting(file_path, false);
+        ASSERT_TRUE(file);
+        EXPECT_TRUE(file->write(0, "01234", 5));
+    }
+
+    {
+        std::unique_ptr<File> file = File::openForWriting(file_path);
+        ASSERT_TRUE(file);
+        EXPECT_EQ(file->size(), 5);
+        EXPECT_TRUE(file->write(5, "56789", 5));
+    }
+
+    std::unique_ptr<File> file = File::openForReading(file_path);
+    ASSERT_TRUE(file);
+
+    std::string buffer(10, 0);
+    EXPECT_TRUE(file->read(0, buffer.data(), buffer.size()));
+    EXPECT_EQ(buffer, "0123456789");
+}
+
+TEST(FileTest, PreallocateKeepsSize)
+{
+    ScopedTempDirectory temp_directory("aspia_file_test");
+    ASSERT_TRUE(temp_directory.isValid());
+    const std::filesystem::path file_path = temp_directory.filePath("preallocate");
+
+    std::unique_ptr<File> file = File::createForWriting(file_path, false);
+    ASSERT_TRUE(file);
+
+    // The space may not be reserved on some file systems, but the size never changes.
+    file->preallocate(1024 * 1024);
+    EXPECT_EQ(file->size(), 0);
+
+    EXPECT_TRUE(file->write(0, "data", 4));
+    EXPECT_EQ(file->size(), 4);
+}
+
+TEST(FileTest, OpenMissing)
+{
+    ScopedTempDirectory temp_directory("aspia_file_test");
+    ASSERT_TRUE(temp_directory.isValid());
+    const std::filesystem::path file_path = temp_directory.filePath("missing");
+    EXPECT_FALSE(File::openForReading(file_path));
+}
+
+} // namespace base
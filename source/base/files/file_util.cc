@@ -82,4 +82,15 @@ bool readFile(const std::filesystem::path& filename, std::string* buffer)
     return readFileT(filename, buffer);
 }
 
+std::string utf8FromFilePath(const std::filesystem::path& path)
+{
+    std::u8string utf8 = path.u8string();
+    return std::string(utf8.begin(), utf8.end());
+}
+
+std::filesystem::path filePathFromUtf8(std::string_view utf8)
+{
+    return std::filesystem::path(std::u8string(utf8.begin(), utf8.end()));
+}
+
 } // namespace base
@@ -32,6 +32,11 @@ bool writeFile(const std::filesystem::path& filename, std::string_view buffer);
 bool readFile(const std::filesystem::path& filename, ByteArray* buffer);
 bool readFile(const std::filesystem::path& filename, std::string* buffer);
 
+// Converts a path to UTF-8 and back. Since C++20 std::filesystem::path::u8string returns
+// std::u8string and std::filesystem::u8path is deprecated.
+std::string utf8FromFilePath(const std::filesystem::path& path);
+std::filesystem::path filePathFromUtf8(std::string_view utf8);
+
 } // namespace base
 
 #endif // BASE__FILES__FILE_UTIL_H
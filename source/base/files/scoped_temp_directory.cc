@@ -0,0 +1,72 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "base/files/scoped_temp_directory.h"
+
+#include <random>
+#include <string>
+
+namespace base {
+
+namespace {
+
+const int kMaxAttempts = 16;
+
+} // namespace
+
+ScopedTempDirectory::ScopedTempDirectory(std::string_view prefix)
+{
+    std::error_code error_code;
+
+    std::filesystem::path temp_path = std::filesystem::temp_directory_path(error_code);
+    if (error_code)
+        return;
+
+    std::random_device random_device;
+    std::mt19937_64 generator((static_cast<uint64_t>(random_device()) << 32) | random_device());
+
+    for (int i = 0; i < kMaxAttempts; ++i)
+    {
+        std::filesystem::path path = temp_path;
+        path /= std::string(prefix) + '_' + std::to_string(generator());
+
+        // The directory is created only if it does not exist yet, so the name is not shared with
+        // another process.
+        if (std::filesystem::create_directory(path, error_code))
+        {
+            path_ = std::move(path);
+            return;
+        }
+    }
+}
+
+ScopedTempDirectory::~ScopedTempDirectory()
+{
+    if (path_.empty())
+        return;
+
+    std::error_code ignored_code;
+    std::filesystem::remove_all(path_, ignored_code);
+}
+
+std::filesystem::path ScopedTempDirectory::filePath(std::string_view name) const
+{
+    return path_ / std::filesystem::path(name);
+}
+
+} // namespace base
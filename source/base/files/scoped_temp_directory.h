@@ -0,0 +1,53 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BASE__FILES__SCOPED_TEMP_DIRECTORY_H
+#define BASE__FILES__SCOPED_TEMP_DIRECTORY_H
+
+#include "base/macros_magic.h"
+
+#include <filesystem>
+#include <string_view>
+
+namespace base {
+
+// Creates a directory with a unique name in the temporary directory of the system and deletes it
+// with all its contents when destroyed. Tests that run at the same time do not share the files.
+class ScopedTempDirectory
+{
+public:
+    explicit ScopedTempDirectory(std::string_view prefix);
+    ~ScopedTempDirectory();
+
+    // Returns false if the directory could not be created.
+    bool isValid() const { return !path_.empty(); }
+
+    const std::filesystem::path& path() const { return path_; }
+
+    // Returns the path of the file |name| in the directory.
+    std::filesystem::path filePath(std::string_view name) const;
+
+private:
+    std::filesystem::path path_;
+
+    DISALLOW_COPY_AND_ASSIGN(ScopedTempDirectory);
+};
+
+} // namespace base
+
+#endif // BASE__FILES__SCOPED_TEMP_DIRECTORY_H
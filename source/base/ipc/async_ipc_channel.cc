@@ -0,0 +1,114 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "base/ipc/async_ipc_channel.h"
+
+#include "base/logging.h"
+#include "base/message_loop/message_loop.h"
+#include "base/message_loop/message_pump_asio.h"
+
+namespace base {
+
+AsyncIpcChannel::AsyncIpcChannel(std::unique_ptr<IpcChannel> channel)
+    : channel_(std::move(channel)),
+      waiter_(MessageLoop::current()->pumpAsio()->ioContext())
+{
+    DCHECK(channel_);
+
+    disconnected_ = !channel_->isConnected();
+    channel_->setListener(this);
+}
+
+AsyncIpcChannel::~AsyncIpcChannel()
+{
+    if (channel_)
+        channel_->setListener(nullptr);
+}
+
+AsyncIpcChannel::ReadAwaiter AsyncIpcChannel::read()
+{
+    return ReadAwaiter(this);
+}
+
+bool AsyncIpcChannel::send(ByteArray&& buffer)
+{
+    DCHECK(channel_);
+
+    if (disconnected_)
+        return false;
+
+    channel_->send(std::move(buffer));
+    return true;
+}
+
+std::unique_ptr<IpcChannel> AsyncIpcChannel::release()
+{
+    DCHECK(!waiter_.isWaiting());
+
+    if (channel_)
+    {
+        channel_->pause();
+        channel_->setListener(nullptr);
+    }
+
+    read_queue_ = std::queue<ByteArray>();
+    return std::move(channel_);
+}
+
+void AsyncIpcChannel::onDisconnected()
+{
+    disconnected_ = true;
+    waiter_.resumeLater();
+}
+
+void AsyncIpcChannel::onMessageReceived(const ByteArray& buffer)
+{
+    read_queue_.emplace(buffer);
+
+    // New messages are not read until the coroutine takes this one.
+    channel_->pause();
+    waiter_.resumeLater();
+}
+
+bool AsyncIpcChannel::ReadAwaiter::await_ready() const
+{
+    if (!channel_->read_queue_.empty() || channel_->disconnected_)
+        return true;
+
+    // If the channel already has a received message, it is delivered inside resume().
+    channel_->channel_->resume();
+    return !channel_->read_queue_.empty() || channel_->disconnected_;
+}
+
+void AsyncIpcChannel::ReadAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+    channel_->waiter_.suspend(handle);
+}
+
+std::optional<ByteArray> AsyncIpcChannel::ReadAwaiter::await_resume()
+{
+    std::queue<ByteArray>& queue = channel_->read_queue_;
+    if (queue.empty())
+        return std::nullopt;
+
+    ByteArray buffer = std::move(queue.front());
+    queue.pop();
+    return buffer;
+}
+
+} // namespace base
@@ -0,0 +1,83 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BASE__IPC__ASYNC_IPC_CHANNEL_H
+#define BASE__IPC__ASYNC_IPC_CHANNEL_H
+
+#include "base/coroutine.h"
+#include "base/ipc/ipc_channel.h"
+
+#include <optional>
+
+namespace base {
+
+//
+// Adapter that allows to work with IpcChannel from a coroutine.
+// The adapter takes ownership of the channel and becomes its listener. Received messages are
+// returned by read(), the channel is paused while there is an unread message.
+// IpcChannel does not report the completion of writes, so send() does not suspend.
+//
+class AsyncIpcChannel : public IpcChannel::Listener
+{
+public:
+    explicit AsyncIpcChannel(std::unique_ptr<IpcChannel> channel);
+    ~AsyncIpcChannel() override;
+
+    class ReadAwaiter
+    {
+    public:
+        bool await_ready() const;
+        void await_suspend(std::coroutine_handle<> handle);
+        std::optional<ByteArray> await_resume();
+
+    private:
+        friend class AsyncIpcChannel;
+        explicit ReadAwaiter(AsyncIpcChannel* channel) : channel_(channel) {}
+        AsyncIpcChannel* channel_;
+    };
+
+    // Reads the next message. The result of co_await is empty if the channel is disconnected.
+    ReadAwaiter read();
+
+    // Adds a message to the send queue. Returns false if the channel is disconnected.
+    bool send(ByteArray&& buffer);
+
+    IpcChannel* channel() const { return channel_.get(); }
+
+    // Returns the channel to the caller. The channel is returned paused. Messages received by the
+    // channel, but not yet read are lost.
+    std::unique_ptr<IpcChannel> release();
+
+protected:
+    // IpcChannel::Listener implementation.
+    void onDisconnected() override;
+    void onMessageReceived(const ByteArray& buffer) override;
+
+private:
+    std::unique_ptr<IpcChannel> channel_;
+    internal::CoroutineWaiter waiter_;
+
+    bool disconnected_ = false;
+    std::queue<ByteArray> read_queue_;
+
+    DISALLOW_COPY_AND_ASSIGN(AsyncIpcChannel);
+};
+
+} // namespace base
+
+#endif // BASE__IPC__ASYNC_IPC_CHANNEL_H
@@ -116,7 +116,7 @@ void MessageLoop::quit()
 
 PendingTask::Callback MessageLoop::quitClosure()
 {
-    return std::bind(&MessageLoop::quit, this);
+    return [this]() { quit(); };
 }
 
 void MessageLoop::postTask(PendingTask::Callback callback)
@@ -144,6 +144,26 @@ void MessageLoop::postNonNestableDelayedTask(
     addToIncomingQueue(std::move(callback), delay, false);
 }
 
+MessageLoop::DelayedTaskId MessageLoop::postCancelableDelayedTask(
+    PendingTask::Callback callback, const Milliseconds& delay)
+{
+    DCHECK(callback != nullptr);
+    return addToIncomingQueue(std::move(callback), delay, true, true);
+}
+
+void MessageLoop::cancelDelayedTask(DelayedTaskId id)
+{
+    DCHECK_EQ(this, current());
+
+    if (delayed_work_queue_.cancel(id))
+        return;
+
+    // The task has not yet been taken from the incoming queue. Tasks with smaller identifiers have
+    // already been run or cancelled.
+    if (id > last_taken_task_id_)
+        cancelled_task_ids_.emplace(id);
+}
+
 #if defined(OS_WIN)
 MessagePumpForWin* MessageLoop::pumpWin() const
 {
@@ -161,7 +181,7 @@ std::shared_ptr<TaskRunner> MessageLoop::taskRunner() const
     return proxy_;
 }
 
-void MessageLoop::runTask(const PendingTask& pending_task)
+void MessageLoop::runTask(PendingTask& pending_task)
 {
     DCHECK(nestable_tasks_allowed_);
 
@@ -173,7 +193,7 @@ void MessageLoop::runTask(const PendingTask& pending_task)
     nestable_tasks_allowed_ = true;
 }
 
-bool MessageLoop::deferOrRunPendingTask(const PendingTask& pending_task)
+bool MessageLoop::deferOrRunPendingTask(PendingTask&& pending_task)
 {
     if (pending_task.nestable)
     {
@@ -185,24 +205,38 @@ bool MessageLoop::deferOrRunPendingTask(const PendingTask& pending_task)
 
     // We couldn't run the task now because we're in a nested message loop
     // and the task isn't nestable.
-    deferred_non_nestable_work_queue_.emplace(pending_task);
+    deferred_non_nestable_work_queue_.emplace(std::move(pending_task));
     return false;
 }
 
+bool MessageLoop::takeCancelableTask(PendingTask* pending_task)
+{
+    if (!pending_task->id)
+        return true;
+
+    last_taken_task_id_ = pending_task->id;
+
+    // The task was cancelled while it was in the incoming queue.
+    if (!cancelled_task_ids_.empty() && cancelled_task_ids_.erase(pending_task->id))
+    {
+        pending_task->callback = nullptr;
+        return false;
+    }
+
+    return true;
+}
+
 void MessageLoop::addToDelayedWorkQueue(PendingTask* pending_task)
 {
-    // Move to the delayed work queue.  Initialize the sequence number before inserting into the
-    // delayed_work_queue_. The sequence number is used to faciliate FIFO sorting when two tasks
-    // have the same delayed_run_time value.
-    delayed_work_queue_.emplace(std::move(pending_task->callback),
-                                pending_task->delayed_run_time,
-                                pending_task->nestable,
-                                next_sequence_num_++);
+    // Move to the delayed work queue. Tasks with the same delayed_run_time value are run in the
+    // order in which they were added.
+    delayed_work_queue_.add(std::move(*pending_task));
 }
 
-void MessageLoop::addToIncomingQueue(
-    PendingTask::Callback&& callback, const Milliseconds& delay, bool nestable)
+MessageLoop::DelayedTaskId MessageLoop::addToIncomingQueue(
+    PendingTask::Callback&& callback, const Milliseconds& delay, bool nestable, bool cancelable)
 {
+    DelayedTaskId id = 0;
     bool empty;
 
     {
@@ -210,16 +244,22 @@ void MessageLoop::addToIncomingQueue(
 
         empty = incoming_queue_.empty();
 
+        if (cancelable)
+            id = next_delayed_task_id_++;
+
         incoming_queue_.emplace(std::move(callback),
                                 calculateDelayedRuntime(delay),
-                                nestable);
+                                nestable,
+                                id);
     }
 
-    if (!empty)
-        return;
+    if (empty)
+    {
+        std::shared_ptr<MessagePump> pump(pump_);
+        pump->scheduleWork();
+    }
 
-    std::shared_ptr<MessagePump> pump(pump_);
-    pump->scheduleWork();
+    return id;
 }
 
 void MessageLoop::reloadWorkQueue()
@@ -242,9 +282,12 @@ bool MessageLoop::deletePendingTasks()
 
     while (!work_queue_.empty())
     {
-        PendingTask pending_task = work_queue_.front();
+        PendingTask pending_task = std::move(work_queue_.front());
         work_queue_.pop();
 
+        if (!takeCancelableTask(&pending_task))
+            continue;
+
         if (pending_task.delayed_run_time != TimePoint())
         {
             // We want to delete delayed tasks in the same order in which they would normally be
@@ -259,9 +302,7 @@ bool MessageLoop::deletePendingTasks()
         deferred_non_nestable_work_queue_.pop();
 
     did_work |= !delayed_work_queue_.empty();
-
-    while (!delayed_work_queue_.empty())
-        delayed_work_queue_.pop();
+    delayed_work_queue_.clear();
 
     return did_work;
 }
@@ -295,9 +336,12 @@ bool MessageLoop::doWork()
         // Execute oldest task.
         do
         {
-            PendingTask pending_task = work_queue_.front();
+            PendingTask pending_task = std::move(work_queue_.front());
             work_queue_.pop();
 
+            if (!takeCancelableTask(&pending_task))
+                continue;
+
             if (pending_task.delayed_run_time != TimePoint())
             {
                 const bool reschedule = delayed_work_queue_.empty();
@@ -305,12 +349,12 @@ bool MessageLoop::doWork()
                 addToDelayedWorkQueue(&pending_task);
 
                 // If we changed the topmost task, then it is time to reschedule.
-                if (reschedule)
-                    pump_->scheduleDelayedWork(pending_task.delayed_run_time);
+                if (reschedule && !delayed_work_queue_.empty())
+                    pump_->scheduleDelayedWork(delayed_work_queue_.nextRunTime());
             }
             else
             {
-                if (deferOrRunPendingTask(pending_task))
+                if (deferOrRunPendingTask(std::move(pending_task)))
                     return true;
             }
         }
@@ -335,25 +379,34 @@ bool MessageLoop::doDelayedWork(TimePoint* next_delayed_work_time)
     // As a result, the more we fall behind (and have a lot of ready-to-run delayed tasks), the more
     // efficient we'll be at handling the tasks.
 
-    TimePoint next_run_time = delayed_work_queue_.top().delayed_run_time;
-
-    if (next_run_time > recent_time_)
+    if (!delayed_work_queue_.hasExpired())
     {
-        recent_time_ = Clock::now();
+        TimePoint next_run_time = delayed_work_queue_.nextRunTime();
+
         if (next_run_time > recent_time_)
         {
-            *next_delayed_work_time = next_run_time;
+            recent_time_ = Clock::now();
+            if (next_run_time > recent_time_)
+            {
+                *next_delayed_work_time = next_run_time;
+                return false;
+            }
+        }
+
+        delayed_work_queue_.advance(recent_time_);
+
+        // The wheel may only redistribute tasks between its levels without expiring any of them.
+        if (!delayed_work_queue_.hasExpired())
+        {
+            *next_delayed_work_time = delayed_work_queue_.nextRunTime();
             return false;
         }
     }
 
-    PendingTask pending_task = delayed_work_queue_.top();
-    delayed_work_queue_.pop();
-
-    if (!delayed_work_queue_.empty())
-        *next_delayed_work_time = delayed_work_queue_.top().delayed_run_time;
+    PendingTask pending_task = delayed_work_queue_.takeExpired();
+    *next_delayed_work_time = delayed_work_queue_.nextRunTime();
 
-    return deferOrRunPendingTask(pending_task);
+    return deferOrRunPendingTask(std::move(pending_task));
 }
 
 bool MessageLoop::doIdleWork()
@@ -361,7 +414,7 @@ bool MessageLoop::doIdleWork()
     if (deferred_non_nestable_work_queue_.empty())
         return false;
 
-    PendingTask pending_task = deferred_non_nestable_work_queue_.front();
+    PendingTask pending_task = std::move(deferred_non_nestable_work_queue_.front());
     deferred_non_nestable_work_queue_.pop();
 
     runTask(pending_task);
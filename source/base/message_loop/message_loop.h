@@ -24,10 +24,12 @@
 #include "base/message_loop/message_pump.h"
 #include "base/message_loop/message_pump_dispatcher.h"
 #include "base/message_loop/pending_task.h"
+#include "base/message_loop/timer_wheel.h"
 #include "build/build_config.h"
 
 #include <memory>
 #include <mutex>
+#include <unordered_set>
 
 namespace base {
 
@@ -74,20 +76,30 @@ protected:
     using Clock = MessagePump::Clock;
     using TimePoint = MessagePump::TimePoint;
     using Milliseconds = MessagePump::Milliseconds;
+    using DelayedTaskId = PendingTask::DelayedTaskId;
 
     void postTask(PendingTask::Callback callback);
     void postDelayedTask(PendingTask::Callback callback, const Milliseconds& delay);
     void postNonNestableTask(PendingTask::Callback callback);
     void postNonNestableDelayedTask(PendingTask::Callback callback, const Milliseconds& delay);
+    DelayedTaskId postCancelableDelayedTask(PendingTask::Callback callback, const Milliseconds& delay);
+
+    // Must be called on the thread of the message loop.
+    void cancelDelayedTask(DelayedTaskId id);
 
     PendingTask::Callback quitClosure();
 
     // Runs the specified PendingTask.
-    void runTask(const PendingTask& pending_task);
+    void runTask(PendingTask& pending_task);
 
     // Calls RunTask or queues the pending_task on the deferred task list if it cannot be run right
     // now. Returns true if the task was run.
-    bool deferOrRunPendingTask(const PendingTask& pending_task);
+    bool deferOrRunPendingTask(PendingTask&& pending_task);
+
+    // Must be called for each task taken from the incoming queue. Returns false if the task is a
+    // cancelable task that was cancelled while it was in the incoming queue. The callback of such
+    // a task is destroyed.
+    bool takeCancelableTask(PendingTask* pending_task);
 
     // Adds the pending task to delayed_work_queue_.
     void addToDelayedWorkQueue(PendingTask* pending_task);
@@ -97,7 +109,11 @@ protected:
     // Caller retains ownership of |pending_task|, but this function will reset the value of
     // pending_task->task. This is needed to ensure that the posting call stack does not retain
     // pending_task->task beyond this function call.
-    void addToIncomingQueue(PendingTask::Callback&& callback, const Milliseconds& delay, bool nestable);
+    // If |cancelable| is true, returns the identifier assigned to the task, otherwise returns 0.
+    DelayedTaskId addToIncomingQueue(PendingTask::Callback&& callback,
+                                     const Milliseconds& delay,
+                                     bool nestable,
+                                     bool cancelable = false);
 
     // Load tasks from the incoming_queue_ into work_queue_ if the latter is empty. The former
     // requires a lock to access, while the latter is directly accessible on this thread.
@@ -118,8 +134,17 @@ protected:
     // A recent snapshot of Clock::now(), used to check delayed_work_queue_.
     TimePoint recent_time_;
 
-    // Contains delayed tasks, sorted by their 'delayed_run_time' property.
-    DelayedTaskQueue delayed_work_queue_;
+    // Contains delayed tasks, ordered by their 'delayed_run_time' property.
+    TimerWheel delayed_work_queue_;
+
+    // Cancelable tasks are taken from the incoming queue in the order of their identifiers. The
+    // identifier of the last taken task allows to distinguish the tasks that are still in the
+    // incoming queue from the tasks that have already been run or cancelled.
+    DelayedTaskId last_taken_task_id_ = 0;
+
+    // Identifiers of the tasks that were cancelled while they were in the incoming queue. Each
+    // identifier is removed when its task is taken from the queue.
+    std::unordered_set<DelayedTaskId> cancelled_task_ids_;
 
     // A list of tasks that need to be processed by this instance.  Note that this queue is only
     // accessed (push/pop) by our current thread.
@@ -138,8 +163,8 @@ protected:
     TaskQueue incoming_queue_;
     std::mutex incoming_queue_lock_;
 
-    // The next sequence number to use for delayed tasks.
-    int next_sequence_num_ = 0;
+    // The next identifier to use for cancelable delayed tasks. Protected by incoming_queue_lock_.
+    DelayedTaskId next_delayed_task_id_ = 1;
 
     std::shared_ptr<MessageLoopTaskRunner> proxy_;
 
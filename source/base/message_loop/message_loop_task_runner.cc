@@ -76,6 +76,36 @@ void MessageLoopTaskRunner::postQuit()
         loop_->postTask(loop_->quitClosure());
 }
 
+MessageLoopTaskRunner::DelayedTaskId MessageLoopTaskRunner::postCancelableDelayedTask(
+    Callback callback, const Milliseconds& delay)
+{
+    std::shared_lock lock(loop_lock_);
+
+    if (!loop_)
+        return 0;
+
+    return loop_->postCancelableDelayedTask(std::move(callback), delay);
+}
+
+void MessageLoopTaskRunner::cancelDelayedTask(DelayedTaskId id)
+{
+    std::shared_lock lock(loop_lock_);
+
+    if (!loop_ || !id)
+        return;
+
+    if (belongsToCurrentThread())
+    {
+        loop_->cancelDelayedTask(id);
+        return;
+    }
+
+    // The wheel of delayed tasks is accessed only from the thread of the message loop. If the loop
+    // is destroyed before the task is run, the task is destroyed with it.
+    MessageLoop* loop = loop_;
+    loop_->postTask([loop, id]() { loop->cancelDelayedTask(id); });
+}
+
 MessageLoopTaskRunner::MessageLoopTaskRunner(MessageLoop* loop)
     : loop_(loop),
       thread_id_(std::this_thread::get_id())
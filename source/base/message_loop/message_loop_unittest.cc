@@ -0,0 +1,82 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "base/message_loop/message_loop.h"
+#include "base/task_runner.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+namespace base {
+
+namespace {
+
+using Milliseconds = std::chrono::milliseconds;
+
+} // namespace
+
+TEST(MessageLoopTest, CancelQueuedTasks)
+{
+    MessageLoop message_loop;
+    std::shared_ptr<TaskRunner> task_runner = message_loop.taskRunner();
+    std::vector<int> log;
+
+    task_runner->postTask([task_runner, &log]()
+    {
+        TaskRunner::DelayedTaskId id1 = task_runner->postCancelableDelayedTask(
+            [&log]() { log.push_back(1); }, Milliseconds(0));
+        TaskRunner::DelayedTaskId id2 = task_runner->postCancelableDelayedTask(
+            [&log]() { log.push_back(2); }, Milliseconds(10));
+        task_runner->postCancelableDelayedTask([&log]() { log.push_back(3); }, Milliseconds(0));
+        task_runner->postCancelableDelayedTask([&log]() { log.push_back(4); }, Milliseconds(20));
+
+        // Both tasks are still in the incoming queue.
+        task_runner->cancelDelayedTask(id1);
+        task_runner->cancelDelayedTask(id2);
+    });
+
+    task_runner->postDelayedTask([task_runner]() { task_runner->postQuit(); }, Milliseconds(50));
+    message_loop.run();
+
+    EXPECT_EQ(log, std::vector<int>({ 3, 4 }));
+}
+
+TEST(MessageLoopTest, CancelAfterRun)
+{
+    MessageLoop message_loop;
+    std::shared_ptr<TaskRunner> task_runner = message_loop.taskRunner();
+    std::vector<int> log;
+
+    TaskRunner::DelayedTaskId id = task_runner->postCancelableDelayedTask(
+        [&log]() { log.push_back(1); }, Milliseconds(0));
+
+    task_runner->postDelayedTask([task_runner, id, &log]()
+    {
+        // Cancelling a task that has already been run has no effect on later tasks.
+        task_runner->cancelDelayedTask(id);
+        task_runner->postCancelableDelayedTask([&log]() { log.push_back(2); }, Milliseconds(0));
+        task_runner->postDelayedTask([task_runner]() { task_runner->postQuit(); }, Milliseconds(10));
+    }, Milliseconds(10));
+
+    message_loop.run();
+
+    EXPECT_EQ(log, std::vector<int>({ 1, 2 }));
+}
+
+} // namespace base
@@ -19,38 +19,40 @@
 #ifndef BASE__MESSAGE_LOOP__PENDING_TASK_H
 #define BASE__MESSAGE_LOOP__PENDING_TASK_H
 
+#include "base/task_runner.h"
+
 #include <chrono>
-#include <functional>
 #include <queue>
 
 namespace base {
 
-// Contains data about a pending task. Stored in TaskQueue and DelayedTaskQueue for use by classes
-// that queue and execute tasks.
+// Contains data about a pending task. Stored in TaskQueue and TimerWheel for use by classes that
+// queue and execute tasks.
 class PendingTask
 {
 public:
-    using Callback = std::function<void()>;
+    using Callback = TaskRunner::Callback;
+    using DelayedTaskId = TaskRunner::DelayedTaskId;
     using Clock = std::chrono::high_resolution_clock;
     using TimePoint = std::chrono::time_point<Clock>;
 
     PendingTask(Callback&& callback,
                 TimePoint delayed_run_time,
                 bool nestable,
-                int sequence_num = 0);
+                DelayedTaskId id = 0);
     ~PendingTask() = default;
 
-    // Used to support sorting.
-    bool operator<(const PendingTask& other) const;
+    PendingTask(PendingTask&& other) = default;
+    PendingTask& operator=(PendingTask&& other) = default;
 
     // The task to run.
     Callback callback;
 
-    // Secondary sort key for run time.
-    int sequence_num;
-
     TimePoint delayed_run_time;
 
+    // Identifier of a cancelable delayed task or 0 if the task can not be cancelled.
+    DelayedTaskId id;
+
     // OK to dispatch from a nested loop.
     bool nestable;
 };
@@ -65,9 +67,6 @@ public:
     }
 };
 
-// PendingTasks are sorted by their |delayed_run_time| property.
-using DelayedTaskQueue = std::priority_queue<PendingTask>;
-
 } // namespace base
 
 #endif // BASE__MESSAGE_LOOP__PENDING_TASK_H
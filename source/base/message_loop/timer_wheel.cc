@@ -0,0 +1,366 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "base/message_loop/timer_wheel.h"
+
+#include "base/logging.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace base {
+
+namespace {
+
+const uint64_t kNoTick = std::numeric_limits<uint64_t>::max();
+
+} // namespace
+
+TimerWheel::TimerWheel(const TimePoint& origin)
+    : origin_(origin),
+      next_tick_(kNoTick)
+{
+    // Nothing
+}
+
+TimerWheel::~TimerWheel()
+{
+    clear();
+}
+
+void TimerWheel::add(PendingTask&& pending_task)
+{
+    uint32_t index = allocateNode();
+    Node& node = nodes_[index];
+
+    node.callback = std::move(pending_task.callback);
+    node.run_time = pending_task.delayed_run_time;
+    node.expire_tick = tickFromTime(pending_task.delayed_run_time);
+    node.id = pending_task.id;
+    node.nestable = pending_task.nestable;
+
+    if (node.id)
+        index_.emplace(node.id, index);
+
+    ++count_;
+    schedule(index);
+}
+
+bool TimerWheel::cancel(DelayedTaskId id)
+{
+    auto it = index_.find(id);
+    if (it == index_.end())
+        return false;
+
+    uint32_t index = it->second;
+    index_.erase(it);
+
+    unlink(index);
+
+    // The callback is destroyed after the node is released. Destruction of the objects bound to
+    // the callback may lead to a call of the wheel methods.
+    Task callback = std::move(nodes_[index].callback);
+    releaseNode(index);
+    --count_;
+
+    next_tick_valid_ = false;
+    return true;
+}
+
+void TimerWheel::advance(const TimePoint& now)
+{
+    const Tick now_tick = (now > origin_) ?
+        static_cast<Tick>(std::chrono::duration_cast<Milliseconds>(now - origin_).count()) : 0;
+
+    while (current_tick_ < now_tick)
+    {
+        size_t level = 0;
+        while (level < kLevels && !level_count_[level])
+            ++level;
+
+        if (level == kLevels)
+        {
+            // There are no tasks in the slots.
+            current_tick_ = now_tick;
+            break;
+        }
+
+        if (level > 0)
+        {
+            // The lower levels are empty. Nothing happens until the slot of |level| changes, so all
+            // ticks before it can be skipped.
+            const Tick turn_size = Tick(1) << (level * kSlotBits);
+            const Tick next_turn = (current_tick_ | (turn_size - 1)) + 1;
+            if (next_turn > now_tick)
+            {
+                current_tick_ = now_tick;
+                break;
+            }
+
+            current_tick_ = next_turn - 1;
+        }
+
+        ++current_tick_;
+        processTick();
+    }
+
+    next_tick_valid_ = false;
+}
+
+PendingTask TimerWheel::takeExpired()
+{
+    DCHECK(hasExpired());
+
+    uint32_t index = expired_.head;
+    unlink(index);
+
+    Node& node = nodes_[index];
+    if (node.id)
+        index_.erase(node.id);
+
+    PendingTask pending_task(std::move(node.callback), node.run_time, node.nestable, node.id);
+
+    releaseNode(index);
+    --count_;
+
+    return pending_task;
+}
+
+TimerWheel::TimePoint TimerWheel::nextRunTime()
+{
+    if (hasExpired())
+        return nodes_[expired_.head].run_time;
+
+    if (!next_tick_valid_)
+    {
+        next_tick_ = kNoTick;
+
+        for (size_t level = 0; level < kLevels; ++level)
+        {
+            if (!level_count_[level])
+                continue;
+
+            const size_t shift = level * kSlotBits;
+            const Tick position = current_tick_ >> shift;
+
+            // The slot of the current position was already processed, so the search starts from
+            // the next one. An offset of kSlots means the same slot on the next turn.
+            for (Tick offset = 1; offset <= kSlots; ++offset)
+            {
+                const size_t slot = level * kSlots + ((position + offset) & (kSlots - 1));
+
+                if (slots_[slot].head != kInvalidIndex)
+                {
+                    next_tick_ = std::min(next_tick_, (position + offset) << shift);
+                    break;
+                }
+            }
+        }
+
+        next_tick_valid_ = true;
+    }
+
+    if (next_tick_ == kNoTick)
+        return TimePoint();
+
+    return timeFromTick(next_tick_);
+}
+
+void TimerWheel::clear()
+{
+    // Callbacks are moved out before destruction, so that the wheel is in a consistent state if
+    // the destruction of a callback calls the wheel methods.
+    std::vector<Task> callbacks;
+    callbacks.reserve(count_);
+
+    for (auto& node : nodes_)
+    {
+        if (node.callback)
+            callbacks.emplace_back(std::move(node.callback));
+    }
+
+    nodes_.clear();
+    free_head_ = kInvalidIndex;
+    slots_.fill(List());
+    level_count_.fill(0);
+    expired_ = List();
+    count_ = 0;
+    index_.clear();
+    next_tick_ = kNoTick;
+    next_tick_valid_ = true;
+}
+
+TimerWheel::Tick TimerWheel::tickFromTime(const TimePoint& time) const
+{
+    if (time <= origin_)
+        return 0;
+
+    Tick tick = static_cast<Tick>(std::chrono::duration_cast<Milliseconds>(time - origin_).count());
+
+    // Round up, so the task is never run before its time.
+    if (timeFromTick(tick) < time)
+        ++tick;
+
+    return tick;
+}
+
+TimerWheel::TimePoint TimerWheel::timeFromTick(Tick tick) const
+{
+    return origin_ + Milliseconds(tick);
+}
+
+uint32_t TimerWheel::allocateNode()
+{
+    if (free_head_ != kInvalidIndex)
+    {
+        uint32_t index = free_head_;
+        free_head_ = nodes_[index].next;
+        nodes_[index].next = kInvalidIndex;
+        return index;
+    }
+
+    nodes_.emplace_back();
+    return static_cast<uint32_t>(nodes_.size() - 1);
+}
+
+void TimerWheel::releaseNode(uint32_t index)
+{
+    Node& node = nodes_[index];
+
+    node.callback = nullptr;
+    node.id = 0;
+    node.slot = kExpiredSlot;
+    node.prev = kInvalidIndex;
+    node.next = free_head_;
+
+    free_head_ = index;
+}
+
+void TimerWheel::schedule(uint32_t index)
+{
+    Node& node = nodes_[index];
+
+    if (node.expire_tick <= current_tick_)
+    {
+        pushBack(expired_, kExpiredSlot, index);
+        return;
+    }
+
+    // Tasks that do not fit into the wheel are placed to the last level and are moved again when
+    // the wheel reaches them.
+    const Tick max_delta = (Tick(1) << (kLevels * kSlotBits)) - 1;
+    const Tick delta = std::min(node.expire_tick - current_tick_, max_delta);
+    const Tick tick = current_tick_ + delta;
+
+    size_t level = 0;
+    while (level < kLevels - 1 && delta >= (Tick(1) << ((level + 1) * kSlotBits)))
+        ++level;
+
+    const size_t shift = level * kSlotBits;
+    const uint32_t slot = static_cast<uint32_t>(level * kSlots + ((tick >> shift) & (kSlots - 1)));
+
+    pushBack(slots_[slot], slot, index);
+    ++level_count_[level];
+
+    if (next_tick_valid_)
+        next_tick_ = std::min(next_tick_, (tick >> shift) << shift);
+}
+
+void TimerWheel::cascade(size_t level)
+{
+    const size_t shift = level * kSlotBits;
+    const uint32_t slot =
+        static_cast<uint32_t>(level * kSlots + ((current_tick_ >> shift) & (kSlots - 1)));
+
+    List list = slots_[slot];
+    slots_[slot] = List();
+
+    uint32_t index = list.head;
+    while (index != kInvalidIndex)
+    {
+        uint32_t next = nodes_[index].next;
+
+        --level_count_[level];
+        nodes_[index].prev = kInvalidIndex;
+        nodes_[index].next = kInvalidIndex;
+        schedule(index);
+
+        index = next;
+    }
+}
+
+void TimerWheel::processTick()
+{
+    // At the beginning of each turn of a level the current slot of the next level is redistributed.
+    for (size_t level = 1; level < kLevels; ++level)
+    {
+        if (current_tick_ & ((Tick(1) << (level * kSlotBits)) - 1))
+            break;
+
+        if (level_count_[level])
+            cascade(level);
+    }
+
+    if (level_count_[0])
+        cascade(0);
+}
+
+TimerWheel::List& TimerWheel::listFor(uint32_t slot)
+{
+    return (slot == kExpiredSlot) ? expired_ : slots_[slot];
+}
+
+void TimerWheel::pushBack(List& list, uint32_t slot, uint32_t index)
+{
+    Node& node = nodes_[index];
+
+    node.slot = slot;
+    node.prev = list.tail;
+    node.next = kInvalidIndex;
+
+    if (list.tail != kInvalidIndex)
+        nodes_[list.tail].next = index;
+    else
+        list.head = index;
+
+    list.tail = index;
+}
+
+void TimerWheel::unlink(uint32_t index)
+{
+    Node& node = nodes_[index];
+    List& list = listFor(node.slot);
+
+    if (node.prev != kInvalidIndex)
+        nodes_[node.prev].next = node.next;
+    else
+        list.head = node.next;
+
+    if (node.next != kInvalidIndex)
+        nodes_[node.next].prev = node.prev;
+    else
+        list.tail = node.prev;
+
+    if (node.slot != kExpiredSlot)
+        --level_count_[node.slot / kSlots];
+
+    node.prev = kInvalidIndex;
+    node.next = kInvalidIndex;
+}
+
+} // namespace base
@@ -0,0 +1,147 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BASE__MESSAGE_LOOP__TIMER_WHEEL_H
+#define BASE__MESSAGE_LOOP__TIMER_WHEEL_H
+
+#include "base/macros_magic.h"
+#include "base/message_loop/pending_task.h"
+
+#include <array>
+#include <unordered_map>
+#include <vector>
+
+namespace base {
+
+//
+// Hierarchical timer wheel used to store delayed tasks of MessageLoop.
+// Time is divided into ticks of one millisecond. The wheel consists of kLevels levels with kSlots
+// slots each; a slot of level N covers kSlots^N ticks. Adding and cancelling a task is O(1). When
+// the current time passes the beginning of a slot on a higher level, its tasks are redistributed
+// (cascaded) to the lower levels. Tasks that expire at the same tick are returned in the order in
+// which they were added.
+// Nodes are kept in a single vector and reused, so the memory does not grow beyond the peak
+// number of outstanding tasks.
+// The class is not thread-safe.
+//
+class TimerWheel
+{
+public:
+    using Clock = PendingTask::Clock;
+    using TimePoint = PendingTask::TimePoint;
+    using DelayedTaskId = PendingTask::DelayedTaskId;
+
+    explicit TimerWheel(const TimePoint& origin = Clock::now());
+    ~TimerWheel();
+
+    // Adds a task. The task is considered expired when the time passed to advance() is not less
+    // than its |delayed_run_time|.
+    void add(PendingTask&& pending_task);
+
+    // Removes the task with the specified identifier. The callback of the task is destroyed.
+    // Returns false if there is no such task.
+    bool cancel(DelayedTaskId id);
+
+    // Moves all tasks that expire before or at |now| to the queue of expired tasks.
+    void advance(const TimePoint& now);
+
+    // Returns true if the queue of expired tasks is not empty.
+    bool hasExpired() const { return expired_.head != kInvalidIndex; }
+
+    // Takes the oldest task from the queue of expired tasks. hasExpired() must return true.
+    PendingTask takeExpired();
+
+    // Returns the time at which advance() should be called next or a null TimePoint if the wheel
+    // is empty. For tasks located on the higher levels this is the time when they are cascaded,
+    // so the returned time can be earlier than the run time of any task.
+    TimePoint nextRunTime();
+
+    // Destroys all the tasks.
+    void clear();
+
+    bool empty() const { return count_ == 0; }
+    size_t size() const { return count_; }
+
+    static const size_t kLevels = 4;
+    static const size_t kSlotBits = 8;
+    static const size_t kSlots = 1 << kSlotBits;
+
+private:
+    using Milliseconds = std::chrono::milliseconds;
+    using Tick = uint64_t;
+
+    static const uint32_t kInvalidIndex = static_cast<uint32_t>(-1);
+    static const uint32_t kExpiredSlot = static_cast<uint32_t>(-1);
+
+    struct Node
+    {
+        Task callback;
+        TimePoint run_time;
+        Tick expire_tick = 0;
+        DelayedTaskId id = 0;
+        uint32_t slot = kExpiredSlot;
+        uint32_t prev = kInvalidIndex;
+        uint32_t next = kInvalidIndex;
+        bool nestable = true;
+    };
+
+    struct List
+    {
+        uint32_t head = kInvalidIndex;
+        uint32_t tail = kInvalidIndex;
+    };
+
+    Tick tickFromTime(const TimePoint& time) const;
+    TimePoint timeFromTick(Tick tick) const;
+
+    uint32_t allocateNode();
+    void releaseNode(uint32_t index);
+
+    // Puts the node to the slot that corresponds to its |expire_tick| or to the expired queue.
+    void schedule(uint32_t index);
+    void cascade(size_t level);
+    void processTick();
+
+    List& listFor(uint32_t slot);
+    void pushBack(List& list, uint32_t slot, uint32_t index);
+    void unlink(uint32_t index);
+
+    const TimePoint origin_;
+    Tick current_tick_ = 0;
+
+    std::vector<Node> nodes_;
+    uint32_t free_head_ = kInvalidIndex;
+
+    std::array<List, kLevels * kSlots> slots_;
+    std::array<size_t, kLevels> level_count_ = {};
+    List expired_;
+    size_t count_ = 0;
+
+    // Only cancelable tasks (with a non-zero id) are indexed.
+    std::unordered_map<DelayedTaskId, uint32_t> index_;
+
+    // Cached result of nextRunTime(). It is recalculated when |next_tick_valid_| is false.
+    Tick next_tick_ = 0;
+    bool next_tick_valid_ = true;
+
+    DISALLOW_COPY_AND_ASSIGN(TimerWheel);
+};
+
+} // namespace base
+
+#endif // BASE__MESSAGE_LOOP__TIMER_WHEEL_H
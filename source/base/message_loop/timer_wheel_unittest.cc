@@ -0,0 +1,144 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "base/message_loop/timer_wheel.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+namespace base {
+
+namespace {
+
+using Milliseconds = std::chrono::milliseconds;
+using TimePoint = TimerWheel::TimePoint;
+
+const TimePoint kOrigin = TimerWheel::Clock::now();
+
+PendingTask makeTask(std::vector<int>* log, int value, const Milliseconds& delay,
+                     PendingTask::DelayedTaskId id = 0)
+{
+    return PendingTask([log, value]() { log->push_back(value); }, kOrigin + delay, true, id);
+}
+
+void runExpired(TimerWheel* wheel, const TimePoint& now)
+{
+    wheel->advance(now);
+
+    while (wheel->hasExpired())
+        wheel->takeExpired().callback();
+}
+
+} // namespace
+
+TEST(TimerWheelTest, RunsInOrder)
+{
+    TimerWheel wheel(kOrigin);
+    std::vector<int> log;
+
+    wheel.add(makeTask(&log, 3, Milliseconds(300)));
+    wheel.add(makeTask(&log, 1, Milliseconds(10)));
+    wheel.add(makeTask(&log, 2, Milliseconds(10)));
+    wheel.add(makeTask(&log, 4, Milliseconds(70000)));
+    EXPECT_EQ(wheel.size(), 4);
+
+    runExpired(&wheel, kOrigin + Milliseconds(9));
+    EXPECT_TRUE(log.empty());
+
+    runExpired(&wheel, kOrigin + Milliseconds(10));
+    EXPECT_EQ(log, std::vector<int>({ 1, 2 }));
+
+    runExpired(&wheel, kOrigin + Milliseconds(299));
+    EXPECT_EQ(log.size(), 2);
+
+    runExpired(&wheel, kOrigin + Milliseconds(69999));
+    EXPECT_EQ(log, std::vector<int>({ 1, 2, 3 }));
+
+    runExpired(&wheel, kOrigin + Milliseconds(70000));
+    EXPECT_EQ(log, std::vector<int>({ 1, 2, 3, 4 }));
+    EXPECT_TRUE(wheel.empty());
+}
+
+TEST(TimerWheelTest, NextRunTime)
+{
+    TimerWheel wheel(kOrigin);
+    std::vector<int> log;
+
+    EXPECT_EQ(wheel.nextRunTime(), TimePoint());
+
+    wheel.add(makeTask(&log, 1, Milliseconds(100)));
+    EXPECT_EQ(wheel.nextRunTime(), kOrigin + Milliseconds(100));
+
+    wheel.add(makeTask(&log, 2, Milliseconds(50)));
+    EXPECT_EQ(wheel.nextRunTime(), kOrigin + Milliseconds(50));
+
+    // The time of a task on a higher level is never later than its run time.
+    TimerWheel far_wheel(kOrigin);
+    far_wheel.add(makeTask(&log, 3, Milliseconds(30000)));
+    EXPECT_LE(far_wheel.nextRunTime(), kOrigin + Milliseconds(30000));
+    EXPECT_GT(far_wheel.nextRunTime(), kOrigin);
+}
+
+TEST(TimerWheelTest, Cancel)
+{
+    TimerWheel wheel(kOrigin);
+    std::vector<int> log;
+
+    wheel.add(makeTask(&log, 1, Milliseconds(10), 1));
+    wheel.add(makeTask(&log, 2, Milliseconds(20), 2));
+    wheel.add(makeTask(&log, 3, Milliseconds(30000), 3));
+
+    EXPECT_TRUE(wheel.cancel(2));
+    EXPECT_FALSE(wheel.cancel(2));
+    EXPECT_TRUE(wheel.cancel(3));
+    EXPECT_EQ(wheel.size(), 1);
+
+    runExpired(&wheel, kOrigin + Milliseconds(60000));
+    EXPECT_EQ(log, std::vector<int>({ 1 }));
+    EXPECT_TRUE(wheel.empty());
+    EXPECT_FALSE(wheel.cancel(1));
+}
+
+TEST(TimerWheelTest, ReusesNodes)
+{
+    TimerWheel wheel(kOrigin);
+    std::vector<int> log;
+
+    for (int i = 0; i < 100000; ++i)
+        wheel.add(makeTask(&log, i, Milliseconds(30000 + (i % 1000)), i + 1));
+
+    EXPECT_EQ(wheel.size(), 100000);
+
+    for (int i = 0; i < 100000; ++i)
+        EXPECT_TRUE(wheel.cancel(i + 1));
+
+    EXPECT_TRUE(wheel.empty());
+    EXPECT_EQ(wheel.nextRunTime(), TimePoint());
+
+    for (int i = 0; i < 1000; ++i)
+        wheel.add(makeTask(&log, i, Milliseconds(i)));
+
+    runExpired(&wheel, kOrigin + Milliseconds(1000));
+    EXPECT_EQ(log.size(), 1000);
+
+    for (int i = 0; i < 1000; ++i)
+        EXPECT_EQ(log[i], i);
+}
+
+} // namespace base
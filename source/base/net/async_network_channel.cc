@@ -0,0 +1,193 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "base/net/async_network_channel.h"
+
+#include "base/logging.h"
+#include "base/message_loop/message_loop.h"
+#include "base/message_loop/message_pump_asio.h"
+
+namespace base {
+
+AsyncNetworkChannel::AsyncNetworkChannel(std::unique_ptr<NetworkChannel> channel)
+    : channel_(std::move(channel)),
+      waiter_(MessageLoop::current()->pumpAsio()->ioContext())
+{
+    DCHECK(channel_);
+
+    connected_ = channel_->isConnected();
+    channel_->setListener(this);
+}
+
+AsyncNetworkChannel::~AsyncNetworkChannel()
+{
+    if (channel_)
+        channel_->setListener(nullptr);
+}
+
+AsyncNetworkChannel::ConnectAwaiter AsyncNetworkChannel::connect(
+    std::u16string_view address, uint16_t port)
+{
+    DCHECK(channel_);
+
+    if (!connected_ && !disconnected_)
+        channel_->connect(address, port);
+
+    return ConnectAwaiter(this);
+}
+
+AsyncNetworkChannel::ReadAwaiter AsyncNetworkChannel::read()
+{
+    return ReadAwaiter(this);
+}
+
+AsyncNetworkChannel::WriteAwaiter AsyncNetworkChannel::write(ByteArray&& buffer)
+{
+    DCHECK(channel_);
+
+    if (disconnected_)
+        return WriteAwaiter(this, 0);
+
+    channel_->send(std::move(buffer));
+    return WriteAwaiter(this, ++write_number_);
+}
+
+std::unique_ptr<NetworkChannel> AsyncNetworkChannel::release()
+{
+    DCHECK(!waiter_.isWaiting());
+
+    if (channel_)
+    {
+        channel_->pause();
+        channel_->setListener(nullptr);
+    }
+
+    read_queue_ = std::queue<ByteArray>();
+    return std::move(channel_);
+}
+
+void AsyncNetworkChannel::onConnected()
+{
+    connected_ = true;
+
+    if (wait_ == Wait::CONNECT)
+        wakeUp();
+}
+
+void AsyncNetworkChannel::onDisconnected(NetworkChannel::ErrorCode error_code)
+{
+    connected_ = false;
+    disconnected_ = true;
+    error_code_ = error_code;
+
+    // Any waiting operation completes with an error.
+    if (wait_ != Wait::NOTHING)
+        wakeUp();
+}
+
+void AsyncNetworkChannel::onMessageReceived(const ByteArray& buffer)
+{
+    read_queue_.emplace(buffer);
+
+    // New messages are not read until the coroutine takes this one.
+    channel_->pause();
+
+    if (wait_ == Wait::READ)
+        wakeUp();
+}
+
+void AsyncNetworkChannel::onMessageWritten(size_t /* pending */)
+{
+    ++written_count_;
+
+    if (wait_ == Wait::WRITE && written_count_ >= wait_write_number_)
+        wakeUp();
+}
+
+void AsyncNetworkChannel::suspend(Wait wait, std::coroutine_handle<> handle)
+{
+    DCHECK(wait_ == Wait::NOTHING);
+
+    wait_ = wait;
+    waiter_.suspend(handle);
+}
+
+void AsyncNetworkChannel::wakeUp()
+{
+    wait_ = Wait::NOTHING;
+    waiter_.resumeLater();
+}
+
+bool AsyncNetworkChannel::ConnectAwaiter::await_ready() const
+{
+    return channel_->connected_ || channel_->disconnected_;
+}
+
+void AsyncNetworkChannel::ConnectAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+    channel_->suspend(Wait::CONNECT, handle);
+}
+
+bool AsyncNetworkChannel::ConnectAwaiter::await_resume() const
+{
+    return channel_->connected_;
+}
+
+bool AsyncNetworkChannel::ReadAwaiter::await_ready() const
+{
+    if (!channel_->read_queue_.empty() || channel_->disconnected_)
+        return true;
+
+    // If the channel already has a received message, it is delivered inside resume().
+    channel_->channel_->resume();
+    return !channel_->read_queue_.empty() || channel_->disconnected_;
+}
+
+void AsyncNetworkChannel::ReadAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+    channel_->suspend(Wait::READ, handle);
+}
+
+std::optional<ByteArray> AsyncNetworkChannel::ReadAwaiter::await_resume()
+{
+    std::queue<ByteArray>& queue = channel_->read_queue_;
+    if (queue.empty())
+        return std::nullopt;
+
+    ByteArray buffer = std::move(queue.front());
+    queue.pop();
+    return buffer;
+}
+
+bool AsyncNetworkChannel::WriteAwaiter::await_ready() const
+{
+    return channel_->disconnected_ || channel_->written_count_ >= number_;
+}
+
+void AsyncNetworkChannel::WriteAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+    channel_->wait_write_number_ = number_;
+    channel_->suspend(Wait::WRITE, handle);
+}
+
+bool AsyncNetworkChannel::WriteAwaiter::await_resume() const
+{
+    return number_ != 0 && channel_->written_count_ >= number_;
+}
+
+} // namespace base
@@ -0,0 +1,140 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BASE__NET__ASYNC_NETWORK_CHANNEL_H
+#define BASE__NET__ASYNC_NETWORK_CHANNEL_H
+
+#include "base/coroutine.h"
+#include "base/net/network_channel.h"
+
+#include <optional>
+
+namespace base {
+
+//
+// Adapter that allows to work with NetworkChannel from a coroutine.
+// The adapter takes ownership of the channel and becomes its listener. Received messages are
+// returned by read(), the channel is paused while there is an unread message.
+// All messages of the channel must be sent via write(), otherwise the completion of the writes
+// cannot be tracked.
+//
+class AsyncNetworkChannel : public NetworkChannel::Listener
+{
+public:
+    explicit AsyncNetworkChannel(std::unique_ptr<NetworkChannel> channel);
+    ~AsyncNetworkChannel() override;
+
+    class ConnectAwaiter
+    {
+    public:
+        bool await_ready() const;
+        void await_suspend(std::coroutine_handle<> handle);
+        bool await_resume() const;
+
+    private:
+        friend class AsyncNetworkChannel;
+        explicit ConnectAwaiter(AsyncNetworkChannel* channel) : channel_(channel) {}
+        AsyncNetworkChannel* channel_;
+    };
+
+    class ReadAwaiter
+    {
+    public:
+        bool await_ready() const;
+        void await_suspend(std::coroutine_handle<> handle);
+        std::optional<ByteArray> await_resume();
+
+    private:
+        friend class AsyncNetworkChannel;
+        explicit ReadAwaiter(AsyncNetworkChannel* channel) : channel_(channel) {}
+        AsyncNetworkChannel* channel_;
+    };
+
+    class WriteAwaiter
+    {
+    public:
+        bool await_ready() const;
+        void await_suspend(std::coroutine_handle<> handle);
+        bool await_resume() const;
+
+    private:
+        friend class AsyncNetworkChannel;
+        WriteAwaiter(AsyncNetworkChannel* channel, uint64_t number)
+            : channel_(channel),
+              number_(number)
+        {
+            // Nothing
+        }
+
+        AsyncNetworkChannel* channel_;
+        uint64_t number_;
+    };
+
+    // Connects to a host. The result of co_await is true if the connection is established.
+    ConnectAwaiter connect(std::u16string_view address, uint16_t port);
+
+    // Reads the next message. The result of co_await is empty if the channel is disconnected.
+    ReadAwaiter read();
+
+    // Sends a message. The result of co_await is true if the message has been written to the
+    // socket and false if the channel is disconnected.
+    WriteAwaiter write(ByteArray&& buffer);
+
+    // Error code of the disconnection.
+    NetworkChannel::ErrorCode errorCode() const { return error_code_; }
+
+    NetworkChannel* channel() const { return channel_.get(); }
+
+    // Returns the channel to the caller (for example, after the handshake is completed). The
+    // channel is returned paused. Messages returned by the channel, but not yet read are lost.
+    std::unique_ptr<NetworkChannel> release();
+
+protected:
+    // NetworkChannel::Listener implementation.
+    void onConnected() override;
+    void onDisconnected(NetworkChannel::ErrorCode error_code) override;
+    void onMessageReceived(const ByteArray& buffer) override;
+    void onMessageWritten(size_t pending) override;
+
+private:
+    enum class Wait { NOTHING, CONNECT, READ, WRITE };
+
+    void suspend(Wait wait, std::coroutine_handle<> handle);
+    void wakeUp();
+
+    std::unique_ptr<NetworkChannel> channel_;
+    internal::CoroutineWaiter waiter_;
+    Wait wait_ = Wait::NOTHING;
+
+    bool connected_ = false;
+    bool disconnected_ = false;
+    NetworkChannel::ErrorCode error_code_ = NetworkChannel::ErrorCode::SUCCESS;
+
+    std::queue<ByteArray> read_queue_;
+
+    // Number of the last message passed to write() and the number of messages written.
+    uint64_t write_number_ = 0;
+    uint64_t written_count_ = 0;
+    uint64_t wait_write_number_ = 0;
+
+    DISALLOW_COPY_AND_ASSIGN(AsyncNetworkChannel);
+};
+
+} // namespace base
+
+#endif // BASE__NET__ASYNC_NETWORK_CHANNEL_H
@@ -0,0 +1,137 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "base/net/connection_limiter.h"
+
+#include <algorithm>
+
+namespace base {
+
+namespace {
+
+// Full buckets are looked for not more often than this, so a flood from many addresses does not
+// lead to a scan of all buckets on each connection.
+constexpr std::chrono::seconds kCleanupInterval{ 1 };
+
+} // namespace
+
+ConnectionLimiter::ConnectionLimiter(const Limits& limits)
+    : rate_(limits.rate),
+      burst_(limits.burst ? limits.burst : limits.rate),
+      address_rate_(limits.address_rate),
+      address_burst_(limits.address_burst ? limits.address_burst : limits.address_rate),
+      max_addresses_(limits.max_addresses)
+{
+    bucket_.tokens = burst_;
+}
+
+ConnectionLimiter::~ConnectionLimiter() = default;
+
+ConnectionLimiter::Result ConnectionLimiter::admit(std::string_view address, const TimePoint& now)
+{
+    Bucket* address_bucket = nullptr;
+
+    if (address_rate_ > 0)
+    {
+        std::string key(address);
+        auto it = addresses_.find(key);
+
+        if (it == addresses_.end())
+        {
+            if (addresses_.size() >= max_addresses_ && now - cleanup_time_ >= kCleanupInterval)
+            {
+                cleanup_time_ = now;
+                removeFullBuckets(now);
+            }
+
+            if (addresses_.size() < max_addresses_)
+            {
+                Bucket bucket;
+                bucket.tokens = address_burst_;
+                bucket.update_time = now;
+
+                it = addresses_.emplace(std::move(key), bucket).first;
+            }
+        }
+
+        if (it != addresses_.end())
+        {
+            address_bucket = &it->second;
+            refill(address_bucket, address_rate_, address_burst_, now);
+
+            if (address_bucket->tokens < 1)
+            {
+                ++metrics_.rejected_by_address;
+                return Result::ADDRESS_LIMIT;
+            }
+        }
+    }
+
+    if (rate_ > 0)
+    {
+        refill(&bucket_, rate_, burst_, now);
+
+        if (bucket_.tokens < 1)
+        {
+            ++metrics_.rejected_by_rate;
+            return Result::RATE_LIMIT;
+        }
+
+        bucket_.tokens -= 1;
+    }
+
+    if (address_bucket)
+        address_bucket->tokens -= 1;
+
+    ++metrics_.admitted;
+    return Result::ADMITTED;
+}
+
+ConnectionLimiter::Metrics ConnectionLimiter::metrics() const
+{
+    Metrics metrics = metrics_;
+    metrics.addresses = addresses_.size();
+    return metrics;
+}
+
+// static
+void ConnectionLimiter::refill(Bucket* bucket, double rate, double burst, const TimePoint& now)
+{
+    if (now <= bucket->update_time)
+        return;
+
+    std::chrono::duration<double> elapsed = now - bucket->update_time;
+
+    bucket->tokens = std::min(burst, bucket->tokens + elapsed.count() * rate);
+    bucket->update_time = now;
+}
+
+void ConnectionLimiter::removeFullBuckets(const TimePoint& now)
+{
+    for (auto it = addresses_.begin(); it != addresses_.end();)
+    {
+        refill(&it->second, address_rate_, address_burst_, now);
+
+        if (it->second.tokens >= address_burst_)
+            it = addresses_.erase(it);
+        else
+            ++it;
+    }
+}
+
+} // namespace base
@@ -0,0 +1,121 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BASE__NET__CONNECTION_LIMITER_H
+#define BASE__NET__CONNECTION_LIMITER_H
+
+#include "base/macros_magic.h"
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace base {
+
+//
+// Admission control for incoming connections.
+// The rate of connections is limited by token buckets: one for all connections and one for each
+// source address. A bucket holds up to |burst| tokens and is refilled at |rate| tokens per second.
+// A connection is admitted if both buckets have a token; otherwise it should be closed before any
+// work is done for it. A rejected connection does not consume tokens.
+// The number of tracked addresses is bounded. Buckets that are full are forgotten when the limit
+// is reached, since they are equal to new ones. If there is still no room, new addresses are
+// limited only by the global bucket.
+// The class is not thread-safe.
+//
+class ConnectionLimiter
+{
+public:
+    using Clock = std::chrono::steady_clock;
+    using TimePoint = Clock::time_point;
+
+    struct Limits
+    {
+        // Connections per second from all addresses. Zero means no limit.
+        uint32_t rate = 0;
+
+        // Maximum number of connections admitted at once. Zero means equal to |rate|.
+        uint32_t burst = 0;
+
+        // Connections per second from one address. Zero means no limit.
+        uint32_t address_rate = 0;
+
+        // Maximum number of connections from one address admitted at once. Zero means equal to
+        // |address_rate|.
+        uint32_t address_burst = 0;
+
+        // Maximum number of addresses for which buckets are kept.
+        size_t max_addresses = 65536;
+    };
+
+    explicit ConnectionLimiter(const Limits& limits);
+    ~ConnectionLimiter();
+
+    enum class Result
+    {
+        ADMITTED,
+        ADDRESS_LIMIT, // Too many connections from the address.
+        RATE_LIMIT     // Too many connections from all addresses.
+    };
+
+    Result admit(std::string_view address, const TimePoint& now = Clock::now());
+
+    struct Metrics
+    {
+        uint64_t admitted = 0;
+        uint64_t rejected_by_address = 0;
+        uint64_t rejected_by_rate = 0;
+
+        // Number of addresses for which buckets are kept.
+        size_t addresses = 0;
+    };
+
+    Metrics metrics() const;
+
+private:
+    struct Bucket
+    {
+        double tokens = 0;
+        TimePoint update_time;
+    };
+
+    static void refill(Bucket* bucket, double rate, double burst, const TimePoint& now);
+
+    // Removes the buckets of addresses that are full at |now|.
+    void removeFullBuckets(const TimePoint& now);
+
+    const double rate_;
+    const double burst_;
+    const double address_rate_;
+    const double address_burst_;
+    const size_t max_addresses_;
+
+    Bucket bucket_;
+    std::unordered_map<std::string, Bucket> addresses_;
+    TimePoint cleanup_time_;
+
+    Metrics metrics_;
+
+    DISALLOW_COPY_AND_ASSIGN(ConnectionLimiter);
+};
+
+} // namespace base
+
+#endif // BASE__NET__CONNECTION_LIMITER_H
@@ -0,0 +1,157 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "base/net/connection_limiter.h"
+
+#include <gtest/gtest.h>
+
+namespace base {
+
+namespace {
+
+using Milliseconds = std::chrono::milliseconds;
+using Result = ConnectionLimiter::Result;
+
+const ConnectionLimiter::TimePoint kOrigin = ConnectionLimiter::Clock::now();
+
+ConnectionLimiter::Limits addressLimits(uint32_t rate, uint32_t burst)
+{
+    ConnectionLimiter::Limits limits;
+    limits.address_rate = rate;
+    limits.address_burst = burst;
+    return limits;
+}
+
+} // namespace
+
+TEST(ConnectionLimiterTest, NoLimits)
+{
+    ConnectionLimiter limiter((ConnectionLimiter::Limits()));
+
+    for (int i = 0; i < 10000; ++i)
+        EXPECT_EQ(limiter.admit("10.0.0.1", kOrigin), Result::ADMITTED);
+
+    EXPECT_EQ(limiter.metrics().admitted, 10000);
+    EXPECT_EQ(limiter.metrics().addresses, 0);
+}
+
+TEST(ConnectionLimiterTest, AddressBurstAndRefill)
+{
+    ConnectionLimiter limiter(addressLimits(10, 5));
+
+    for (int i = 0; i < 5; ++i)
+        EXPECT_EQ(limiter.admit("10.0.0.1", kOrigin), Result::ADMITTED);
+
+    EXPECT_EQ(limiter.admit("10.0.0.1", kOrigin), Result::ADDRESS_LIMIT);
+
+    // Other addresses have their own buckets.
+    EXPECT_EQ(limiter.admit("10.0.0.2", kOrigin), Result::ADMITTED);
+
+    // One token is added every 100 ms.
+    EXPECT_EQ(limiter.admit("10.0.0.1", kOrigin + Milliseconds(50)), Result::ADDRESS_LIMIT);
+    EXPECT_EQ(limiter.admit("10.0.0.1", kOrigin + Milliseconds(100)), Result::ADMITTED);
+    EXPECT_EQ(limiter.admit("10.0.0.1", kOrigin + Milliseconds(100)), Result::ADDRESS_LIMIT);
+
+    // The bucket is never filled above the burst.
+    for (int i = 0; i < 5; ++i)
+        EXPECT_EQ(limiter.admit("10.0.0.1", kOrigin + Milliseconds(60000)), Result::ADMITTED);
+
+    EXPECT_EQ(limiter.admit("10.0.0.1", kOrigin + Milliseconds(60000)), Result::ADDRESS_LIMIT);
+
+    ConnectionLimiter::Metrics metrics = limiter.metrics();
+    EXPECT_EQ(metrics.admitted, 12);
+    EXPECT_EQ(metrics.rejected_by_address, 4);
+    EXPECT_EQ(metrics.rejected_by_rate, 0);
+    EXPECT_EQ(metrics.addresses, 2);
+}
+
+TEST(ConnectionLimiterTest, GlobalRate)
+{
+    ConnectionLimiter::Limits limits;
+    limits.rate = 100;
+    limits.address_rate = 1000;
+
+    ConnectionLimiter limiter(limits);
+
+    // The burst is equal to the rate by default.
+    for (int i = 0; i < 100; ++i)
+    {
+        std::string address = "10.0.0." + std::to_string(i);
+        EXPECT_EQ(limiter.admit(address, kOrigin), Result::ADMITTED);
+    }
+
+    EXPECT_EQ(limiter.admit("10.0.1.1", kOrigin), Result::RATE_LIMIT);
+    EXPECT_EQ(limiter.admit("10.0.1.1", kOrigin + Milliseconds(10)), Result::ADMITTED);
+
+    EXPECT_EQ(limiter.metrics().rejected_by_rate, 1);
+}
+
+TEST(ConnectionLimiterTest, RejectionDoesNotConsumeTokens)
+{
+    ConnectionLimiter::Limits limits;
+    limits.rate = 2;
+    limits.address_rate = 1;
+
+    ConnectionLimiter limiter(limits);
+
+    EXPECT_EQ(limiter.admit("10.0.0.1", kOrigin), Result::ADMITTED);
+
+    // A flood from one address does not use up the global bucket.
+    for (int i = 0; i < 10; ++i)
+        EXPECT_EQ(limiter.admit("10.0.0.1", kOrigin), Result::ADDRESS_LIMIT);
+
+    EXPECT_EQ(limiter.admit("10.0.0.2", kOrigin), Result::ADMITTED);
+
+    // The address still has a token, but the global bucket is empty.
+    EXPECT_EQ(limiter.admit("10.0.0.3", kOrigin), Result::RATE_LIMIT);
+    EXPECT_EQ(limiter.admit("10.0.0.3", kOrigin), Result::RATE_LIMIT);
+
+    // The global bucket gets a token in 500 ms. The address has kept its token.
+    EXPECT_EQ(limiter.admit("10.0.0.3", kOrigin + Milliseconds(500)), Result::ADMITTED);
+
+    ConnectionLimiter::Metrics metrics = limiter.metrics();
+    EXPECT_EQ(metrics.admitted, 3);
+    EXPECT_EQ(metrics.rejected_by_address, 10);
+    EXPECT_EQ(metrics.rejected_by_rate, 2);
+}
+
+TEST(ConnectionLimiterTest, MaxAddresses)
+{
+    ConnectionLimiter::Limits limits = addressLimits(1, 1);
+    limits.max_addresses = 2;
+
+    ConnectionLimiter limiter(limits);
+
+    EXPECT_EQ(limiter.admit("10.0.0.1", kOrigin), Result::ADMITTED);
+    EXPECT_EQ(limiter.admit("10.0.0.2", kOrigin), Result::ADMITTED);
+
+    // There is no room for the bucket of a new address, so it is not limited.
+    EXPECT_EQ(limiter.admit("10.0.0.3", kOrigin), Result::ADMITTED);
+    EXPECT_EQ(limiter.admit("10.0.0.3", kOrigin), Result::ADMITTED);
+    EXPECT_EQ(limiter.metrics().addresses, 2);
+
+    // The known addresses are still limited.
+    EXPECT_EQ(limiter.admit("10.0.0.1", kOrigin), Result::ADDRESS_LIMIT);
+
+    // The buckets are full again after a second and are replaced with the new ones.
+    EXPECT_EQ(limiter.admit("10.0.0.3", kOrigin + Milliseconds(1000)), Result::ADMITTED);
+    EXPECT_EQ(limiter.admit("10.0.0.3", kOrigin + Milliseconds(1000)), Result::ADDRESS_LIMIT);
+    EXPECT_EQ(limiter.metrics().addresses, 1);
+}
+
+} // namespace base
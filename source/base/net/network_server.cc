@@ -33,18 +33,32 @@ public:
     ~Impl();
 
     void start(uint16_t port, Delegate* delegate);
+    void start(uint16_t port, const std::vector<Worker>& workers);
     void stop();
     uint16_t port() const;
 
+    void setConnectionLimits(const ConnectionLimiter::Limits& limits);
+    ConnectionLimiter::Metrics connectionMetrics() const;
+
 private:
+    void startAcceptor(uint16_t port);
+    bool admit(asio::ip::tcp::socket& socket);
     void doAccept();
     void onAccept(const std::error_code& error_code, asio::ip::tcp::socket socket);
+    void onWorkerAccept(const Worker& worker,
+                        const std::error_code& error_code,
+                        asio::ip::tcp::socket socket);
 
     asio::io_context& io_context_;
     std::unique_ptr<asio::ip::tcp::acceptor> acceptor_;
     Delegate* delegate_ = nullptr;
     uint16_t port_ = 0;
 
+    std::vector<Worker> workers_;
+    size_t next_worker_ = 0;
+
+    std::unique_ptr<ConnectionLimiter> limiter_;
+
     DISALLOW_COPY_AND_ASSIGN(Impl);
 };
 
@@ -62,19 +76,29 @@ NetworkServer::Impl::~Impl()
 void NetworkServer::Impl::start(uint16_t port, Delegate* delegate)
 {
     delegate_ = delegate;
-    port_ = port;
-
     DCHECK(delegate_);
 
-    asio::ip::tcp::endpoint endpoint(asio::ip::tcp::v4(), port);
-    acceptor_ = std::make_unique<asio::ip::tcp::acceptor>(io_context_, endpoint);
+    startAcceptor(port);
+}
 
-    doAccept();
+void NetworkServer::Impl::start(uint16_t port, const std::vector<Worker>& workers)
+{
+    workers_ = workers;
+    DCHECK(!workers_.empty());
+
+    for (const auto& worker : workers_)
+    {
+        DCHECK(worker.message_loop);
+        DCHECK(worker.delegate);
+    }
+
+    startAcceptor(port);
 }
 
 void NetworkServer::Impl::stop()
 {
     delegate_ = nullptr;
+    workers_.clear();
     acceptor_.reset();
 }
 
@@ -83,10 +107,64 @@ uint16_t NetworkServer::Impl::port() const
     return port_;
 }
 
+void NetworkServer::Impl::setConnectionLimits(const ConnectionLimiter::Limits& limits)
+{
+    DCHECK(!acceptor_);
+    limiter_ = std::make_unique<ConnectionLimiter>(limits);
+}
+
+ConnectionLimiter::Metrics NetworkServer::Impl::connectionMetrics() const
+{
+    if (!limiter_)
+        return ConnectionLimiter::Metrics();
+
+    return limiter_->metrics();
+}
+
+void NetworkServer::Impl::startAcceptor(uint16_t port)
+{
+    port_ = port;
+
+    asio::ip::tcp::endpoint endpoint(asio::ip::tcp::v4(), port);
+    acceptor_ = std::make_unique<asio::ip::tcp::acceptor>(io_context_, endpoint);
+
+    doAccept();
+}
+
+bool NetworkServer::Impl::admit(asio::ip::tcp::socket& socket)
+{
+    if (!limiter_)
+        return true;
+
+    asio::error_code error_code;
+    asio::ip::tcp::endpoint endpoint = socket.remote_endpoint(error_code);
+    if (error_code)
+        return false;
+
+    // The connection is closed by the destructor of the socket.
+    return limiter_->admit(endpoint.address().to_string()) ==
+        ConnectionLimiter::Result::ADMITTED;
+}
+
 void NetworkServer::Impl::doAccept()
 {
+    if (workers_.empty())
+    {
+        acceptor_->async_accept(
+            std::bind(&Impl::onAccept, shared_from_this(),
+                      std::placeholders::_1, std::placeholders::_2));
+        return;
+    }
+
+    const Worker& worker = workers_[next_worker_];
+    next_worker_ = (next_worker_ + 1) % workers_.size();
+
+    // The socket is created on the I/O context of the worker, so all its operations are completed
+    // on the worker thread.
     acceptor_->async_accept(
-        std::bind(&Impl::onAccept, shared_from_this(), std::placeholders::_1, std::placeholders::_2));
+        worker.message_loop->pumpAsio()->ioContext(),
+        std::bind(&Impl::onWorkerAccept, shared_from_this(), worker,
+                  std::placeholders::_1, std::placeholders::_2));
 }
 
 void NetworkServer::Impl::onAccept(const std::error_code& error_code, asio::ip::tcp::socket socket)
@@ -99,7 +177,7 @@ void NetworkServer::Impl::onAccept(const std::error_code& error_code, asio::ip::
         LOG(LS_ERROR) << "Error while accepting connection: "
                       << base::utf16FromLocal8Bit(error_code.message());
     }
-    else
+    else if (admit(socket))
     {
         std::unique_ptr<NetworkChannel> channel =
             std::unique_ptr<NetworkChannel>(new NetworkChannel(std::move(socket)));
@@ -112,6 +190,39 @@ void NetworkServer::Impl::onAccept(const std::error_code& error_code, asio::ip::
     doAccept();
 }
 
+void NetworkServer::Impl::onWorkerAccept(const Worker& worker,
+                                         const std::error_code& error_code,
+                                         asio::ip::tcp::socket socket)
+{
+    if (workers_.empty())
+        return;
+
+    if (error_code)
+    {
+        LOG(LS_ERROR) << "Error while accepting connection: "
+                      << base::utf16FromLocal8Bit(error_code.message());
+    }
+    else if (admit(socket))
+    {
+        Delegate* delegate = worker.delegate;
+
+        // The channel uses the message loop of the current thread, so it is created on the worker
+        // thread.
+        worker.message_loop->taskRunner()->postTask(
+            [delegate, socket = std::move(socket)]() mutable
+        {
+            std::unique_ptr<NetworkChannel> channel =
+                std::unique_ptr<NetworkChannel>(new NetworkChannel(std::move(socket)));
+
+            // Connection accepted.
+            delegate->onNewConnection(std::move(channel));
+        });
+    }
+
+    // Accept next connection.
+    doAccept();
+}
+
 NetworkServer::NetworkServer()
     : impl_(std::make_shared<Impl>(MessageLoop::current()->pumpAsio()->ioContext()))
 {
@@ -128,11 +239,26 @@ void NetworkServer::start(uint16_t port, Delegate* delegate)
     impl_->start(port, delegate);
 }
 
+void NetworkServer::start(uint16_t port, const std::vector<Worker>& workers)
+{
+    impl_->start(port, workers);
+}
+
 void NetworkServer::stop()
 {
     impl_->stop();
 }
 
+void NetworkServer::setConnectionLimits(const ConnectionLimiter::Limits& limits)
+{
+    impl_->setConnectionLimits(limits);
+}
+
+ConnectionLimiter::Metrics NetworkServer::connectionMetrics() const
+{
+    return impl_->connectionMetrics();
+}
+
 uint16_t NetworkServer::port() const
 {
     return impl_->port();
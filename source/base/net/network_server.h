@@ -20,12 +20,15 @@
 #define BASE__NET__NETWORK_SERVER_H
 
 #include "base/macros_magic.h"
+#include "base/net/connection_limiter.h"
 
 #include <cstdint>
 #include <memory>
+#include <vector>
 
 namespace base {
 
+class MessageLoop;
 class NetworkChannel;
 
 class NetworkServer
@@ -42,10 +45,27 @@ public:
         virtual void onNewConnection(std::unique_ptr<NetworkChannel> channel) = 0;
     };
 
+    struct Worker
+    {
+        MessageLoop* message_loop = nullptr;
+        Delegate* delegate = nullptr;
+    };
+
     void start(uint16_t port, Delegate* delegate);
+
+    // Accepted connections are distributed in turn between |workers|. The channel of a connection
+    // is bound to the message loop of the worker and is passed to the worker's delegate on the
+    // thread of that loop. The message loops must be of type ASIO. The delegates must remain valid
+    // while their message loops are running.
+    void start(uint16_t port, const std::vector<Worker>& workers);
     void stop();
     uint16_t port() const;
 
+    // Limits the rate of accepted connections. Connections over the limits are closed right after
+    // they are accepted, before a channel is created for them. Must be called before start().
+    void setConnectionLimits(const ConnectionLimiter::Limits& limits);
+    ConnectionLimiter::Metrics connectionMetrics() const;
+
 private:
     class Impl;
     std::shared_ptr<Impl> impl_;
@@ -0,0 +1,122 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "base/peer/fake_verifier_cache.h"
+
+#include "base/logging.h"
+#include "base/crypto/big_num.h"
+#include "base/crypto/generic_hash.h"
+#include "base/crypto/srp_constants.h"
+#include "base/crypto/srp_math.h"
+#include "base/strings/unicode.h"
+
+namespace base {
+
+FakeVerifierCache::FakeVerifierCache(size_t capacity)
+    : capacity_(capacity)
+{
+    DCHECK_GT(capacity_, 0u);
+}
+
+FakeVerifierCache::~FakeVerifierCache() = default;
+
+FakeVerifierCache::Numbers FakeVerifierCache::numbers(
+    std::string_view user_name, const ByteArray& seed_key)
+{
+    Numbers numbers;
+    numbers.salt = calculateSalt(user_name, seed_key);
+
+    std::string key = toStdString(numbers.salt);
+
+    {
+        std::scoped_lock lock(lock_);
+
+        auto it = index_.find(key);
+        if (it != index_.end())
+        {
+            entries_.splice(entries_.begin(), entries_, it->second);
+            numbers.verifier = it->second->verifier;
+            ++hits_;
+            return numbers;
+        }
+
+        ++misses_;
+    }
+
+    numbers.verifier = calculateVerifier(user_name, seed_key, numbers.salt);
+
+    std::scoped_lock lock(lock_);
+
+    // The same name may have been calculated by another thread in the meantime.
+    if (index_.find(key) != index_.end())
+        return numbers;
+
+    entries_.emplace_front(Entry{ std::move(key), numbers.verifier });
+    index_.emplace(entries_.front().key, entries_.begin());
+
+    if (entries_.size() > capacity_)
+    {
+        index_.erase(entries_.back().key);
+        entries_.pop_back();
+    }
+
+    return numbers;
+}
+
+// static
+FakeVerifierCache::Numbers FakeVerifierCache::calculate(
+    std::string_view user_name, const ByteArray& seed_key)
+{
+    Numbers numbers;
+    numbers.salt = calculateSalt(user_name, seed_key);
+    numbers.verifier = calculateVerifier(user_name, seed_key, numbers.salt);
+    return numbers;
+}
+
+FakeVerifierCache::Metrics FakeVerifierCache::metrics() const
+{
+    std::scoped_lock lock(lock_);
+
+    Metrics metrics;
+    metrics.size = entries_.size();
+    metrics.hits = hits_;
+    metrics.misses = misses_;
+    return metrics;
+}
+
+// static
+ByteArray FakeVerifierCache::calculateSalt(std::string_view user_name, const ByteArray& seed_key)
+{
+    GenericHash hash(GenericHash::BLAKE2b512);
+    hash.addData(seed_key);
+    hash.addData(user_name);
+    return hash.result();
+}
+
+// static
+ByteArray FakeVerifierCache::calculateVerifier(
+    std::string_view user_name, const ByteArray& seed_key, const ByteArray& salt)
+{
+    BigNum N = BigNum::fromStdString(kSrpNgPair_8192.first);
+    BigNum g = BigNum::fromStdString(kSrpNgPair_8192.second);
+    BigNum s = BigNum::fromByteArray(salt);
+
+    return SrpMath::calc_v(utf16FromUtf8(user_name), seed_key, s, N, g).toByteArray();
+}
+
+} // namespace base
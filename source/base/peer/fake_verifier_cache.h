@@ -0,0 +1,104 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BASE__PEER__FAKE_VERIFIER_CACHE_H
+#define BASE__PEER__FAKE_VERIFIER_CACHE_H
+
+#include "base/macros_magic.h"
+#include "base/memory/byte_array.h"
+
+#include <list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace base {
+
+//
+// Cache of the SRP numbers that the server sends for unknown user names.
+// So that a client cannot find out whether a user exists, the server answers for an unknown user
+// with a salt and a verifier derived from the user name and the secret seed key of the user list.
+// The verifier is calculated in the 8192-bit group, which is one of the most expensive operations
+// of the authentication. The cache keeps the last |capacity| results, so repeated logins with the
+// same name cost a lookup.
+// The cache is keyed by the salt. The salt is a keyed hash of the seed key and the user name, so
+// the keys cannot be chosen by the client and a change of the seed key makes the old entries
+// unreachable (they are pushed out as new entries are added).
+// The class is thread-safe. The calculation is done outside of the lock.
+//
+class FakeVerifierCache
+{
+public:
+    static const size_t kDefaultCapacity = 4096;
+
+    explicit FakeVerifierCache(size_t capacity = kDefaultCapacity);
+    ~FakeVerifierCache();
+
+    struct Numbers
+    {
+        ByteArray salt;
+        ByteArray verifier;
+    };
+
+    // Returns the numbers for |user_name| (in UTF-8). The result is the same as the result of
+    // calculate() with the same arguments.
+    Numbers numbers(std::string_view user_name, const ByteArray& seed_key);
+
+    // Calculates the numbers without the cache. The group is always 8192-bit.
+    static Numbers calculate(std::string_view user_name, const ByteArray& seed_key);
+
+    struct Metrics
+    {
+        size_t size = 0;
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+    };
+
+    Metrics metrics() const;
+
+private:
+    static ByteArray calculateSalt(std::string_view user_name, const ByteArray& seed_key);
+    static ByteArray calculateVerifier(
+        std::string_view user_name, const ByteArray& seed_key, const ByteArray& salt);
+
+    struct Entry
+    {
+        std::string key;
+        ByteArray verifier;
+    };
+
+    using EntryList = std::list<Entry>;
+
+    const size_t capacity_;
+
+    mutable std::mutex lock_;
+
+    // Most recently used entries are at the front.
+    EntryList entries_;
+    std::unordered_map<std::string_view, EntryList::iterator> index_;
+
+    uint64_t hits_ = 0;
+    uint64_t misses_ = 0;
+
+    DISALLOW_COPY_AND_ASSIGN(FakeVerifierCache);
+};
+
+} // namespace base
+
+#endif // BASE__PEER__FAKE_VERIFIER_CACHE_H
@@ -0,0 +1,126 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "base/peer/fake_verifier_cache.h"
+
+#include "base/crypto/random.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+namespace base {
+
+namespace {
+
+const ByteArray kSeedKey = Random::byteArray(64);
+
+} // namespace
+
+TEST(FakeVerifierCacheTest, Deterministic)
+{
+    FakeVerifierCache cache(2);
+
+    FakeVerifierCache::Numbers expected = FakeVerifierCache::calculate("alice", kSeedKey);
+    EXPECT_FALSE(expected.salt.empty());
+    EXPECT_FALSE(expected.verifier.empty());
+
+    // Miss.
+    FakeVerifierCache::Numbers numbers = cache.numbers("alice", kSeedKey);
+    EXPECT_EQ(numbers.salt, expected.salt);
+    EXPECT_EQ(numbers.verifier, expected.verifier);
+
+    // Hit.
+    numbers = cache.numbers("alice", kSeedKey);
+    EXPECT_EQ(numbers.salt, expected.salt);
+    EXPECT_EQ(numbers.verifier, expected.verifier);
+
+    // The entry is evicted and calculated again.
+    cache.numbers("bob", kSeedKey);
+    cache.numbers("carol", kSeedKey);
+    numbers = cache.numbers("alice", kSeedKey);
+    EXPECT_EQ(numbers.salt, expected.salt);
+    EXPECT_EQ(numbers.verifier, expected.verifier);
+
+    FakeVerifierCache::Metrics metrics = cache.metrics();
+    EXPECT_EQ(metrics.size, 2);
+    EXPECT_EQ(metrics.hits, 1);
+    EXPECT_EQ(metrics.misses, 4);
+}
+
+TEST(FakeVerifierCacheTest, DependsOnSeedKey)
+{
+    FakeVerifierCache cache;
+
+    FakeVerifierCache::Numbers first = cache.numbers("alice", kSeedKey);
+    FakeVerifierCache::Numbers second = cache.numbers("alice", Random::byteArray(64));
+    FakeVerifierCache::Numbers third = cache.numbers("bob", kSeedKey);
+
+    EXPECT_NE(first.salt, second.salt);
+    EXPECT_NE(first.verifier, second.verifier);
+    EXPECT_NE(first.salt, third.salt);
+    EXPECT_NE(first.verifier, third.verifier);
+    EXPECT_EQ(cache.metrics().misses, 3);
+}
+
+TEST(FakeVerifierCacheTest, LeastRecentlyUsedIsEvicted)
+{
+    FakeVerifierCache cache(2);
+
+    cache.numbers("alice", kSeedKey);
+    cache.numbers("bob", kSeedKey);
+    cache.numbers("alice", kSeedKey); // "bob" becomes the least recently used.
+    cache.numbers("carol", kSeedKey);
+
+    EXPECT_EQ(cache.metrics().hits, 1);
+
+    cache.numbers("alice", kSeedKey);
+    EXPECT_EQ(cache.metrics().hits, 2);
+
+    cache.numbers("bob", kSeedKey);
+    EXPECT_EQ(cache.metrics().hits, 2);
+    EXPECT_EQ(cache.metrics().misses, 4);
+}
+
+TEST(FakeVerifierCacheTest, SimilarNames)
+{
+    FakeVerifierCache cache;
+
+    // Names of the same length with a common and a different prefix.
+    const std::vector<std::string> names =
+        { "administrator-01", "administrator-02", "zzzzzzzzzzzzzzzz", "0000000000000000" };
+
+    for (const auto& name : names)
+        cache.numbers(name, kSeedKey);
+
+    for (const auto& name : names)
+    {
+        FakeVerifierCache::Numbers expected = FakeVerifierCache::calculate(name, kSeedKey);
+        FakeVerifierCache::Numbers numbers = cache.numbers(name, kSeedKey);
+
+        EXPECT_EQ(numbers.salt, expected.salt);
+        EXPECT_EQ(numbers.verifier, expected.verifier);
+    }
+
+    FakeVerifierCache::Metrics metrics = cache.metrics();
+    EXPECT_EQ(metrics.size, names.size());
+    EXPECT_EQ(metrics.hits, names.size());
+    EXPECT_EQ(metrics.misses, names.size());
+}
+
+} // namespace base
@@ -27,6 +27,7 @@
 #include "base/crypto/random.h"
 #include "base/crypto/srp_constants.h"
 #include "base/crypto/srp_math.h"
+#include "base/peer/fake_verifier_cache.h"
 #include "base/peer/user_list.h"
 #include "base/strings/unicode.h"
 #include "build/version.h"
@@ -39,8 +40,31 @@ constexpr size_t kIvSize = 12;
 
 } // namespace
 
+struct ServerAuthenticator::SrpNumbers
+{
+    // If the flag is set, the salt and the verifier are calculated from |user_name| and |seed_key|
+    // (the user is not found and the client gets fake numbers).
+    bool calc_verifier = false;
+    std::string user_name;
+    ByteArray seed_key;
+
+    // Session types allowed for the user.
+    uint32_t session_types = 0;
+
+    BigNum N;
+    BigNum g;
+    BigNum s;
+    BigNum v;
+    BigNum b;
+    BigNum B;
+    BigNum A;
+
+    ByteArray srp_key;
+};
+
 ServerAuthenticator::ServerAuthenticator(std::shared_ptr<TaskRunner> task_runner)
-    : Authenticator(std::move(task_runner))
+    : Authenticator(task_runner),
+      task_runner_(std::move(task_runner))
 {
     // Nothing
 }
@@ -53,6 +77,16 @@ void ServerAuthenticator::setUserList(std::shared_ptr<UserListBase> user_list)
     DCHECK(user_list_);
 }
 
+void ServerAuthenticator::setFakeVerifierCache(std::shared_ptr<FakeVerifierCache> cache)
+{
+    fake_verifier_cache_ = std::move(cache);
+}
+
+void ServerAuthenticator::setWorkerTaskRunner(std::shared_ptr<TaskRunner> worker_task_runner)
+{
+    worker_task_runner_ = std::move(worker_task_runner);
+}
+
 bool ServerAuthenticator::setPrivateKey(const ByteArray& private_key)
 {
     // The method must be called before calling start().
@@ -65,8 +99,8 @@ bool ServerAuthenticator::setPrivateKey(const ByteArray& private_key)
         return false;
     }
 
-    key_pair_ = KeyPair::fromPrivateKey(private_key);
-    if (!key_pair_.isValid())
+    key_pair_ = std::make_shared<KeyPair>(KeyPair::fromPrivateKey(private_key));
+    if (!key_pair_->isValid())
     {
         LOG(LS_ERROR) << "Failed to load private key. Perhaps the key is incorrect";
         return false;
@@ -91,7 +125,7 @@ bool ServerAuthenticator::setAnonymousAccess(
 
     if (anonymous_access == AnonymousAccess::ENABLE)
     {
-        if (!key_pair_.isValid())
+        if (!hasKeyPair())
         {
             LOG(LS_ERROR) << "When anonymous access is enabled, a private key must be installed";
             return false;
@@ -120,7 +154,7 @@ bool ServerAuthenticator::onStarted()
     internal_state_ = InternalState::READ_CLIENT_HELLO;
 
     // We do not allow anonymous access without a private key.
-    if (anonymous_access_ == AnonymousAccess::ENABLE && !key_pair_.isValid())
+    if (anonymous_access_ == AnonymousAccess::ENABLE && !hasKeyPair())
     {
         finish(FROM_HERE, ErrorCode::UNKNOWN_ERROR);
         return false;
@@ -129,7 +163,7 @@ bool ServerAuthenticator::onStarted()
     if (anonymous_access_ == AnonymousAccess::ENABLE)
     {
         // When anonymous access is enabled, a private key must be installed.
-        if (!key_pair_.isValid())
+        if (!hasKeyPair())
         {
             finish(FROM_HERE, ErrorCode::UNKNOWN_ERROR);
             return false;
@@ -175,6 +209,15 @@ void ServerAuthenticator::onReceived(const ByteArray& buffer)
             onSessionResponse(buffer);
             break;
 
+        case InternalState::CALC_SESSION_KEY:
+        case InternalState::CALC_SERVER_KEY_EXCHANGE:
+        case InternalState::CALC_SRP_KEY:
+        {
+            // The client must wait for a response before sending the next message.
+            finish(FROM_HERE, ErrorCode::PROTOCOL_ERROR);
+        }
+        break;
+
         default:
             NOTREACHED();
             break;
@@ -285,9 +328,9 @@ void ServerAuthenticator::onClientHello(const ByteArray& buffer)
         }
     }
 
-    proto::ServerHello server_hello;
+    const uint32_t encryption = client_hello.encryption();
 
-    if (key_pair_.isValid())
+    if (hasKeyPair())
     {
         ByteArray peer_public_key = fromStdString(client_hello.public_key());
         decrypt_iv_ = fromStdString(client_hello.iv());
@@ -300,26 +343,45 @@ void ServerAuthenticator::onClientHello(const ByteArray& buffer)
 
         if (!peer_public_key.empty() && !decrypt_iv_.empty())
         {
-            ByteArray temp = key_pair_.sessionKey(peer_public_key);
-            if (temp.empty())
-            {
-                finish(FROM_HERE, ErrorCode::UNKNOWN_ERROR);
-                return;
-            }
+            internal_state_ = InternalState::CALC_SESSION_KEY;
 
-            session_key_ = GenericHash::hash(GenericHash::Type::BLAKE2s256, temp);
-            if (session_key_.empty())
+            std::shared_ptr<ByteArray> session_key = std::make_shared<ByteArray>();
+
+            runOnWorker([key_pair = key_pair_, peer_public_key, session_key]()
             {
-                finish(FROM_HERE, ErrorCode::UNKNOWN_ERROR);
-                return;
-            }
+                ByteArray temp = key_pair->sessionKey(peer_public_key);
+                if (!temp.empty())
+                    *session_key = GenericHash::hash(GenericHash::Type::BLAKE2s256, temp);
+            },
+            [this, session_key, encryption]()
+            {
+                if (session_key->empty())
+                {
+                    finish(FROM_HERE, ErrorCode::UNKNOWN_ERROR);
+                    return;
+                }
 
-            DCHECK(!encrypt_iv_.empty());
-            server_hello.set_iv(toStdString(encrypt_iv_));
+                session_key_ = std::move(*session_key);
+                doServerHello(encryption);
+            });
+            return;
         }
     }
 
-    if ((client_hello.encryption() & proto::ENCRYPTION_AES256_GCM) && CpuidUtil::hasAesNi())
+    doServerHello(encryption);
+}
+
+void ServerAuthenticator::doServerHello(uint32_t encryption)
+{
+    proto::ServerHello server_hello;
+
+    if (!session_key_.empty())
+    {
+        DCHECK(!encrypt_iv_.empty());
+        server_hello.set_iv(toStdString(encrypt_iv_));
+    }
+
+    if ((encryption & proto::ENCRYPTION_AES256_GCM) && CpuidUtil::hasAesNi())
     {
         LOG(LS_INFO) << "Both sides have hardware support AES. Using AES256 GCM";
         // If both sides of the connection support AES, then method AES256 GCM is the fastest option.
@@ -361,69 +423,100 @@ void ServerAuthenticator::onIdentify(const ByteArray& buffer)
 
     LOG(LS_INFO) << "Username: " << user_name_;
 
-    do
+    std::shared_ptr<SrpNumbers> numbers = std::make_shared<SrpNumbers>();
+    internal_state_ = InternalState::CALC_SERVER_KEY_EXCHANGE;
+
+    // The user list may be backed by a database, so the lookup is done on the worker together with
+    // the calculations.
+    runOnWorker([numbers, user_list = user_list_, cache = fake_verifier_cache_,
+                 user_name = user_name_]()
     {
-        std::u16string user_name_utf16 = base::utf16FromUtf8(user_name_);
-        ByteArray seed_key;
-        User user;
+        findUser(user_list.get(), user_name, numbers.get());
 
-        if (user_list_)
-        {
-            user = user_list_->find(user_name_utf16);
-            seed_key = user_list_->seedKey();
-        }
-        else
+        if (numbers->calc_verifier)
         {
-            LOG(LS_INFO) << "UserList is nullptr";
+            FakeVerifierCache::Numbers fake_numbers = cache ?
+                cache->numbers(numbers->user_name, numbers->seed_key) :
+                FakeVerifierCache::calculate(numbers->user_name, numbers->seed_key);
+
+            numbers->s = BigNum::fromByteArray(fake_numbers.salt);
+            numbers->v = BigNum::fromByteArray(fake_numbers.verifier);
         }
 
-        if (seed_key.empty())
-            seed_key = base::Random::byteArray(64);
+        numbers->b = BigNum::fromByteArray(Random::byteArray(128)); // 1024 bits.
+        numbers->B = SrpMath::calc_B(numbers->b, numbers->N, numbers->g, numbers->v);
+    },
+    [this, numbers]()
+    {
+        session_types_ = numbers->session_types;
+        doServerKeyExchange(numbers.get());
+    });
+}
 
-        if (user.isValid())
-        {
-            LOG(LS_INFO) << "User '" << user_name_ << "' found (enabled: "
-                         << ((user.flags & User::ENABLED) != 0) << ")";
-        }
-        else
-        {
-            LOG(LS_INFO) << "User '" << user_name_ << "' NOT found";
-        }
+// static
+void ServerAuthenticator::findUser(
+    UserListBase* user_list, const std::string& user_name, SrpNumbers* numbers)
+{
+    std::u16string user_name_utf16 = base::utf16FromUtf8(user_name);
+    ByteArray seed_key;
+    User user;
 
-        if (user.isValid() && (user.flags & User::ENABLED))
-        {
-            session_types_ = user.sessions;
+    if (user_list)
+    {
+        user = user_list->find(user_name_utf16);
+        seed_key = user_list->seedKey();
+    }
+    else
+    {
+        LOG(LS_INFO) << "UserList is nullptr";
+    }
 
-            std::optional<SrpNgPair> Ng_pair = pairByGroup(user.group);
-            if (Ng_pair.has_value())
-            {
-                N_ = BigNum::fromStdString(Ng_pair->first);
-                g_ = BigNum::fromStdString(Ng_pair->second);
-                s_ = BigNum::fromByteArray(user.salt);
-                v_ = BigNum::fromByteArray(user.verifier);
-                break;
-            }
-            else
-            {
-                LOG(LS_ERROR) << "User '" << user.name << "' has an invalid SRP group";
-            }
-        }
+    if (seed_key.empty())
+        seed_key = base::Random::byteArray(64);
 
-        session_types_ = 0;
+    if (user.isValid())
+    {
+        LOG(LS_INFO) << "User '" << user_name << "' found (enabled: "
+                     << ((user.flags & User::ENABLED) != 0) << ")";
+    }
+    else
+    {
+        LOG(LS_INFO) << "User '" << user_name << "' NOT found";
+    }
 
-        GenericHash hash(GenericHash::BLAKE2b512);
-        hash.addData(seed_key);
-        hash.addData(user_name_);
+    if (user.isValid() && (user.flags & User::ENABLED))
+    {
+        std::optional<SrpNgPair> Ng_pair = pairByGroup(user.group);
+        if (Ng_pair.has_value())
+        {
+            numbers->session_types = user.sessions;
+            numbers->N = BigNum::fromStdString(Ng_pair->first);
+            numbers->g = BigNum::fromStdString(Ng_pair->second);
+            numbers->s = BigNum::fromByteArray(user.salt);
+            numbers->v = BigNum::fromByteArray(user.verifier);
+            return;
+        }
 
-        N_ = BigNum::fromStdString(kSrpNgPair_8192.first);
-        g_ = BigNum::fromStdString(kSrpNgPair_8192.second);
-        s_ = BigNum::fromByteArray(hash.result());
-        v_ = SrpMath::calc_v(user_name_utf16, seed_key, s_, N_, g_);
+        LOG(LS_ERROR) << "User '" << user.name << "' has an invalid SRP group";
     }
-    while (false);
 
-    b_ = BigNum::fromByteArray(Random::byteArray(128)); // 1024 bits.
-    B_ = SrpMath::calc_B(b_, N_, g_, v_);
+    // The client gets fake numbers, so that it cannot find out whether the user exists.
+    numbers->session_types = 0;
+    numbers->N = BigNum::fromStdString(kSrpNgPair_8192.first);
+    numbers->g = BigNum::fromStdString(kSrpNgPair_8192.second);
+    numbers->calc_verifier = true;
+    numbers->user_name = user_name;
+    numbers->seed_key = std::move(seed_key);
+}
+
+void ServerAuthenticator::doServerKeyExchange(SrpNumbers* numbers)
+{
+    N_ = std::move(numbers->N);
+    g_ = std::move(numbers->g);
+    s_ = std::move(numbers->s);
+    v_ = std::move(numbers->v);
+    b_ = std::move(numbers->b);
+    B_ = std::move(numbers->B);
 
     if (!N_.isValid() || !g_.isValid() || !s_.isValid() || !B_.isValid())
     {
@@ -466,7 +559,38 @@ void ServerAuthenticator::onClientKeyExchange(const ByteArray& buffer)
         return;
     }
 
-    ByteArray srp_key = createSrpKey();
+    internal_state_ = InternalState::CALC_SRP_KEY;
+
+    // The numbers are not needed after the calculation of the key, so they are moved.
+    std::shared_ptr<SrpNumbers> numbers = std::make_shared<SrpNumbers>();
+    numbers->N = std::move(N_);
+    numbers->v = std::move(v_);
+    numbers->b = std::move(b_);
+    numbers->B = std::move(B_);
+    numbers->A = std::move(A_);
+
+    runOnWorker([numbers]()
+    {
+        if (!SrpMath::verify_A_mod_N(numbers->A, numbers->N))
+        {
+            LOG(LS_ERROR) << "SrpMath::verify_A_mod_N failed";
+            return;
+        }
+
+        BigNum u = SrpMath::calc_u(numbers->A, numbers->B, numbers->N);
+        BigNum server_key =
+            SrpMath::calcServerKey(numbers->A, numbers->v, u, numbers->b, numbers->N);
+
+        numbers->srp_key = server_key.toByteArray();
+    },
+    [this, numbers]()
+    {
+        onSrpKey(numbers->srp_key);
+    });
+}
+
+void ServerAuthenticator::onSrpKey(const ByteArray& srp_key)
+{
     if (srp_key.empty())
     {
         finish(FROM_HERE, ErrorCode::UNKNOWN_ERROR);
@@ -560,18 +684,32 @@ void ServerAuthenticator::onSessionResponse(const ByteArray& buffer)
     finish(FROM_HERE, ErrorCode::SUCCESS);
 }
 
-ByteArray ServerAuthenticator::createSrpKey()
+void ServerAuthenticator::runOnWorker(std::function<void()> work, std::function<void()> reply)
 {
-    if (!SrpMath::verify_A_mod_N(A_, N_))
+    if (!worker_task_runner_)
     {
-        LOG(LS_ERROR) << "SrpMath::verify_A_mod_N failed";
-        return ByteArray();
+        work();
+        reply();
+        return;
     }
 
-    BigNum u = SrpMath::calc_u(A_, B_, N_);
-    BigNum server_key = SrpMath::calcServerKey(A_, v_, u, b_, N_);
+    std::weak_ptr<int> alive_token = alive_token_;
+
+    worker_task_runner_->postTask(
+        [this, task_runner = task_runner_, work = std::move(work), reply = std::move(reply),
+         alive_token]() mutable
+    {
+        work();
+
+        task_runner->postTask([this, reply = std::move(reply), alive_token]()
+        {
+            // The authenticator is destroyed or has already finished (for example, by timeout).
+            if (alive_token.expired() || state() != State::PENDING)
+                return;
 
-    return server_key.toByteArray();
+            reply();
+        });
+    });
 }
 
 } // namespace base
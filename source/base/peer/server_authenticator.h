@@ -26,6 +26,7 @@
 
 namespace base {
 
+class FakeVerifierCache;
 class UserListBase;
 
 class ServerAuthenticator : public Authenticator
@@ -43,6 +44,15 @@ public:
     // Sets the user list.
     void setUserList(std::shared_ptr<UserListBase> user_list);
 
+    // Sets the cache of the SRP numbers for unknown users. The cache can be shared between
+    // authenticators. If the cache is not set, the numbers are calculated for each login.
+    void setFakeVerifierCache(std::shared_ptr<FakeVerifierCache> cache);
+
+    // Sets the task runner for CPU-bound calculations (SRP numbers and key exchange). The results
+    // are returned to the thread of the authenticator. If the task runner is not set, the
+    // calculations are done on the thread of the authenticator.
+    void setWorkerTaskRunner(std::shared_ptr<TaskRunner> worker_task_runner);
+
     // Sets the private key.
     [[nodiscard]] bool setPrivateKey(const ByteArray& private_key);
 
@@ -59,22 +69,44 @@ protected:
     void onWritten() override;
 
 private:
+    struct SrpNumbers;
+
     void onClientHello(const ByteArray& buffer);
+    void doServerHello(uint32_t encryption);
     void onIdentify(const ByteArray& buffer);
+    static void findUser(
+        UserListBase* user_list, const std::string& user_name, SrpNumbers* numbers);
+    void doServerKeyExchange(SrpNumbers* numbers);
     void onClientKeyExchange(const ByteArray& buffer);
+    void onSrpKey(const ByteArray& srp_key);
     void doSessionChallenge();
     void onSessionResponse(const ByteArray& buffer);
-    [[nodiscard]] ByteArray createSrpKey();
+
+    // Calls |work| on the worker task runner, then |reply| on the thread of the authenticator.
+    // |reply| is not called if the authenticator is destroyed or finished by this time.
+    void runOnWorker(std::function<void()> work, std::function<void()> reply);
+
+    bool hasKeyPair() const { return key_pair_ && key_pair_->isValid(); }
+
+    std::shared_ptr<TaskRunner> task_runner_;
+    std::shared_ptr<TaskRunner> worker_task_runner_;
+
+    // Used to detect that the authenticator was destroyed before the reply of the worker.
+    std::shared_ptr<int> alive_token_ = std::make_shared<int>(0);
 
     std::shared_ptr<UserListBase> user_list_;
+    std::shared_ptr<FakeVerifierCache> fake_verifier_cache_;
 
     enum class InternalState
     {
         READ_CLIENT_HELLO,
+        CALC_SESSION_KEY,
         SEND_SERVER_HELLO,
         READ_IDENTIFY,
+        CALC_SERVER_KEY_EXCHANGE,
         SEND_SERVER_KEY_EXCHANGE,
         READ_CLIENT_KEY_EXCHANGE,
+        CALC_SRP_KEY,
         SEND_SESSION_CHALLENGE,
         READ_SESSION_RESPONSE
     };
@@ -85,7 +117,8 @@ private:
     // Bitmask of allowed session types.
     uint32_t session_types_ = 0;
 
-    KeyPair key_pair_;
+    // The key pair is shared with the worker task runner.
+    std::shared_ptr<KeyPair> key_pair_;
     BigNum N_;
     BigNum g_;
     BigNum v_;
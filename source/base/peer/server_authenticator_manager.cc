@@ -20,6 +20,7 @@
 
 #include "base/logging.h"
 #include "base/task_runner.h"
+#include "base/peer/fake_verifier_cache.h"
 #include "base/peer/user_list_base.h"
 
 namespace base {
@@ -27,6 +28,7 @@ namespace base {
 ServerAuthenticatorManager::ServerAuthenticatorManager(
     std::shared_ptr<TaskRunner> task_runner, Delegate* delegate)
     : task_runner_(std::move(task_runner)),
+      fake_verifier_cache_(std::make_shared<FakeVerifierCache>()),
       delegate_(delegate)
 {
     DCHECK(task_runner_ && delegate_);
@@ -52,13 +54,38 @@ void ServerAuthenticatorManager::setAnonymousAccess(
     anonymous_session_types_ = session_types;
 }
 
+void ServerAuthenticatorManager::setWorkerTaskRunner(
+    std::shared_ptr<TaskRunner> worker_task_runner)
+{
+    worker_task_runner_ = std::move(worker_task_runner);
+}
+
+void ServerAuthenticatorManager::setFakeVerifierCache(std::shared_ptr<FakeVerifierCache> cache)
+{
+    fake_verifier_cache_ = std::move(cache);
+}
+
+void ServerAuthenticatorManager::setMaxPendingCount(size_t max_pending_count)
+{
+    max_pending_count_ = max_pending_count;
+}
+
 void ServerAuthenticatorManager::addNewChannel(std::unique_ptr<NetworkChannel> channel)
 {
     DCHECK(channel);
 
+    if (max_pending_count_ && pending_.size() >= max_pending_count_)
+    {
+        // The channel is closed when it is destroyed.
+        ++metrics_.rejected;
+        return;
+    }
+
     std::unique_ptr<ServerAuthenticator> authenticator =
         std::make_unique<ServerAuthenticator>(task_runner_);
     authenticator->setUserList(user_list_);
+    authenticator->setFakeVerifierCache(fake_verifier_cache_);
+    authenticator->setWorkerTaskRunner(worker_task_runner_);
 
     if (!private_key_.empty())
     {
@@ -78,11 +105,20 @@ void ServerAuthenticatorManager::addNewChannel(std::unique_ptr<NetworkChannel> c
     // Create a new authenticator for the connection and put it on the list.
     pending_.emplace_back(std::move(authenticator));
 
+    ++metrics_.started;
+
     // Start the authentication process.
     pending_.back()->start(
         std::move(channel), std::bind(&ServerAuthenticatorManager::onComplete, this));
 }
 
+ServerAuthenticatorManager::Metrics ServerAuthenticatorManager::metrics() const
+{
+    Metrics metrics = metrics_;
+    metrics.pending = pending_.size();
+    return metrics;
+}
+
 void ServerAuthenticatorManager::onComplete()
 {
     for (auto it = pending_.begin(); it != pending_.end();)
@@ -96,6 +132,8 @@ void ServerAuthenticatorManager::onComplete()
             {
                 if (current->state() == Authenticator::State::SUCCESS)
                 {
+                    ++metrics_.succeeded;
+
                     SessionInfo session_info;
 
                     session_info.channel       = current->takeChannel();
@@ -107,6 +145,10 @@ void ServerAuthenticatorManager::onComplete()
 
                     delegate_->onNewSession(std::move(session_info));
                 }
+                else
+                {
+                    ++metrics_.failed;
+                }
 
                 // Authenticator not needed anymore.
                 task_runner_->deleteSoon(std::move(*it));
@@ -63,17 +63,47 @@ public:
     void setAnonymousAccess(
         ServerAuthenticator::AnonymousAccess anonymous_access, uint32_t session_types);
 
+    // Sets the task runner for CPU-bound calculations of the authenticators.
+    // See ServerAuthenticator::setWorkerTaskRunner.
+    void setWorkerTaskRunner(std::shared_ptr<TaskRunner> worker_task_runner);
+
+    // Sets the cache of the SRP numbers for unknown users. By default, each manager has its own
+    // cache. Managers that use the same user list can share one.
+    void setFakeVerifierCache(std::shared_ptr<FakeVerifierCache> cache);
+
+    // Limits the number of authentications in progress. When the limit is reached, new channels
+    // are rejected (closed) without starting an authenticator, so a flood of connections does not
+    // delay the authentications that are already in progress. Zero means no limit.
+    void setMaxPendingCount(size_t max_pending_count);
+
     // Adds a channel to the authentication queue. After success completion, a session will be
     // created (in a stopped state) and method Delegate::onNewSession will be called.
     // If authentication fails, the channel will be automatically deleted.
     void addNewChannel(std::unique_ptr<NetworkChannel> channel);
 
+    struct Metrics
+    {
+        // Number of authentications in progress.
+        size_t pending = 0;
+
+        uint64_t started = 0;
+        uint64_t rejected = 0;
+        uint64_t succeeded = 0;
+        uint64_t failed = 0;
+    };
+
+    Metrics metrics() const;
+
 private:
     void onComplete();
 
     std::shared_ptr<TaskRunner> task_runner_;
+    std::shared_ptr<TaskRunner> worker_task_runner_;
     std::shared_ptr<UserListBase> user_list_;
+    std::shared_ptr<FakeVerifierCache> fake_verifier_cache_;
     std::vector<std::unique_ptr<ServerAuthenticator>> pending_;
+    size_t max_pending_count_ = 0;
+    Metrics metrics_;
 
     ByteArray private_key_;
 
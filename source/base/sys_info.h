@@ -21,6 +21,7 @@
 
 #include "base/macros_magic.h"
 
+#include <chrono>
 #include <string>
 
 namespace base {
@@ -45,6 +46,9 @@ public:
     static int processorCores();
     static int processorThreads();
 
+    // Processor time (user and kernel) used by the current process.
+    static std::chrono::microseconds processCpuTime();
+
 private:
     DISALLOW_COPY_AND_ASSIGN(SysInfo);
 };
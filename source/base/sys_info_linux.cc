@@ -20,6 +20,8 @@
 
 #include "base/logging.h"
 
+#include <sys/resource.h>
+
 namespace base {
 
 //static
@@ -99,4 +101,22 @@ int SysInfo::processorThreads()
     return 0;
 }
 
+// static
+std::chrono::microseconds SysInfo::processCpuTime()
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+    {
+        PLOG(LS_WARNING) << "getrusage failed";
+        return std::chrono::microseconds();
+    }
+
+    auto toMicroseconds = [](const struct timeval& time)
+    {
+        return std::chrono::seconds(time.tv_sec) + std::chrono::microseconds(time.tv_usec);
+    };
+
+    return toMicroseconds(usage.ru_utime) + toMicroseconds(usage.ru_stime);
+}
+
 } // namespace base
@@ -20,6 +20,7 @@
 
 #include "base/logging.h"
 #include "base/files/base_paths.h"
+#include "base/files/file_util.h"
 #include "base/strings/string_printf.h"
 #include "base/strings/unicode.h"
 #include "base/win/registry.h"
@@ -144,7 +145,7 @@ std::string SysInfo::operatingSystemDir()
     if (!BasePaths::windowsDir(&dir))
         return std::string();
 
-    return dir.u8string();
+    return utf8FromFilePath(dir);
 }
 
 // static
@@ -249,4 +250,31 @@ int SysInfo::processorThreads()
     return system_info.dwNumberOfProcessors;
 }
 
+// static
+std::chrono::microseconds SysInfo::processCpuTime()
+{
+    FILETIME creation_time;
+    FILETIME exit_time;
+    FILETIME kernel_time;
+    FILETIME user_time;
+
+    if (!GetProcessTimes(GetCurrentProcess(), &creation_time, &exit_time, &kernel_time, &user_time))
+    {
+        PLOG(LS_WARNING) << "GetProcessTimes failed";
+        return std::chrono::microseconds();
+    }
+
+    auto toMicroseconds = [](const FILETIME& time)
+    {
+        ULARGE_INTEGER value;
+        value.LowPart = time.dwLowDateTime;
+        value.HighPart = time.dwHighDateTime;
+
+        // FILETIME is measured in 100-nanosecond intervals.
+        return std::chrono::microseconds(value.QuadPart / 10);
+    };
+
+    return toMicroseconds(kernel_time) + toMicroseconds(user_time);
+}
+
 } // namespace base
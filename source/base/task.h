@@ -0,0 +1,232 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BASE__TASK_H
+#define BASE__TASK_H
+
+#include "base/macros_magic.h"
+
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace base {
+
+namespace internal {
+
+template <typename T>
+struct IsStdFunction : std::false_type {};
+
+template <typename Signature>
+struct IsStdFunction<std::function<Signature>> : std::true_type {};
+
+} // namespace internal
+
+//
+// Move-only replacement for std::function<void()> used for posted tasks.
+// Callables whose size does not exceed kInlineSize (for example std::bind with a member function,
+// a shared_ptr and a couple of arguments, or a lambda with several captures) are stored inside the
+// object itself, so posting and running such a task does not touch the heap. Larger callables are
+// allocated on the heap as before.
+// Unlike std::function, the stored callable is not required to be copyable, so the tasks can own
+// std::unique_ptr and similar objects.
+//
+class Task
+{
+public:
+    static const size_t kInlineSize = 64;
+
+    Task() = default;
+
+    Task(std::nullptr_t)
+    {
+        // Nothing
+    }
+
+    template <typename Callable,
+              typename = std::enable_if_t<!std::is_same_v<std::decay_t<Callable>, Task> &&
+                                          std::is_invocable_v<std::decay_t<Callable>&>>>
+    Task(Callable&& callable)
+    {
+        using Stored = std::decay_t<Callable>;
+
+        if constexpr (std::is_pointer_v<Stored> || internal::IsStdFunction<Stored>::value)
+        {
+            // Null function pointers and empty std::function objects give an empty task.
+            if (!callable)
+                return;
+        }
+
+        if constexpr (fitsInline<Stored>())
+        {
+            new (&storage_) Stored(std::forward<Callable>(callable));
+            ops_ = &InlineOps<Stored>::kOps;
+        }
+        else
+        {
+            *reinterpret_cast<Stored**>(&storage_) = new Stored(std::forward<Callable>(callable));
+            ops_ = &HeapOps<Stored>::kOps;
+        }
+    }
+
+    Task(Task&& other) noexcept
+    {
+        moveFrom(other);
+    }
+
+    ~Task()
+    {
+        reset();
+    }
+
+    Task& operator=(Task&& other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+            moveFrom(other);
+        }
+
+        return *this;
+    }
+
+    Task& operator=(std::nullptr_t)
+    {
+        reset();
+        return *this;
+    }
+
+    void operator()()
+    {
+        ops_->invoke(&storage_);
+    }
+
+    explicit operator bool() const { return ops_ != nullptr; }
+
+    bool operator==(std::nullptr_t) const { return ops_ == nullptr; }
+    bool operator!=(std::nullptr_t) const { return ops_ != nullptr; }
+
+    // Returns true if the callable is stored inside the object without heap allocation.
+    bool isInline() const { return ops_ && ops_->is_inline; }
+
+    template <typename Callable>
+    static constexpr bool fitsInline()
+    {
+        return sizeof(Callable) <= kInlineSize &&
+               alignof(std::max_align_t) % alignof(Callable) == 0 &&
+               std::is_nothrow_move_constructible_v<Callable>;
+    }
+
+private:
+    using Storage = std::aligned_storage_t<kInlineSize, alignof(std::max_align_t)>;
+
+    struct Ops
+    {
+        void(*invoke)(Storage* storage);
+        // Moves the callable from |from| to uninitialized |to| and destroys the source.
+        void(*relocate)(Storage* from, Storage* to);
+        void(*destroy)(Storage* storage);
+        bool is_inline;
+    };
+
+    template <typename Stored>
+    struct InlineOps
+    {
+        static Stored* get(Storage* storage)
+        {
+            return std::launder(reinterpret_cast<Stored*>(storage));
+        }
+
+        static void invoke(Storage* storage)
+        {
+            (*get(storage))();
+        }
+
+        static void relocate(Storage* from, Storage* to)
+        {
+            new (to) Stored(std::move(*get(from)));
+            get(from)->~Stored();
+        }
+
+        static void destroy(Storage* storage)
+        {
+            get(storage)->~Stored();
+        }
+
+        static constexpr Ops kOps = { &invoke, &relocate, &destroy, true };
+    };
+
+    template <typename Stored>
+    struct HeapOps
+    {
+        static Stored*& get(Storage* storage)
+        {
+            return *reinterpret_cast<Stored**>(storage);
+        }
+
+        static void invoke(Storage* storage)
+        {
+            (*get(storage))();
+        }
+
+        static void relocate(Storage* from, Storage* to)
+        {
+            *reinterpret_cast<Stored**>(to) = get(from);
+        }
+
+        static void destroy(Storage* storage)
+        {
+            delete get(storage);
+        }
+
+        static constexpr Ops kOps = { &invoke, &relocate, &destroy, false };
+    };
+
+    void moveFrom(Task& other) noexcept
+    {
+        if (!other.ops_)
+            return;
+
+        other.ops_->relocate(&other.storage_, &storage_);
+        ops_ = other.ops_;
+        other.ops_ = nullptr;
+    }
+
+    void reset()
+    {
+        if (!ops_)
+            return;
+
+        // Clear |ops_| before destroying the callable, so that the destruction of captured objects
+        // can not observe a half-destroyed task.
+        const Ops* ops = ops_;
+        ops_ = nullptr;
+        ops->destroy(&storage_);
+    }
+
+    Storage storage_;
+    const Ops* ops_ = nullptr;
+
+    DISALLOW_COPY_AND_ASSIGN(Task);
+};
+
+} // namespace base
+
+#endif // BASE__TASK_H
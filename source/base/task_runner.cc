@@ -34,6 +34,14 @@ public:
         // Nothing
     }
 
+    DeleteHelper(DeleteHelper&& other) noexcept
+        : deleter_(other.deleter_),
+          object_(other.object_)
+    {
+        other.deleter_ = nullptr;
+        other.object_ = nullptr;
+    }
+
     ~DeleteHelper()
     {
         doDelete();
@@ -61,8 +69,10 @@ private:
 
 void TaskRunner::deleteSoonInternal(void(*deleter)(const void*), const void* object)
 {
-    postNonNestableTask(
-        std::bind(&DeleteHelper::doDelete, std::make_shared<DeleteHelper>(deleter, object)));
+    postNonNestableTask([helper = DeleteHelper(deleter, object)]() mutable
+    {
+        helper.doDelete();
+    });
 }
 
 } // namespace base
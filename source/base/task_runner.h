@@ -19,8 +19,10 @@
 #ifndef BASE__TASK_RUNNER_H
 #define BASE__TASK_RUNNER_H
 
+#include "base/task.h"
+
 #include <chrono>
-#include <functional>
+#include <cstdint>
 #include <memory>
 
 namespace base {
@@ -30,9 +32,12 @@ class TaskRunner : public std::enable_shared_from_this<TaskRunner>
 public:
     virtual ~TaskRunner() = default;
 
-    using Callback = std::function<void()>;
+    using Callback = Task;
     using Milliseconds = std::chrono::milliseconds;
 
+    // Identifier of a cancelable delayed task. Zero is never used as an identifier.
+    using DelayedTaskId = uint64_t;
+
     virtual bool belongsToCurrentThread() const = 0;
     virtual void postTask(Callback task) = 0;
     virtual void postDelayedTask(Callback callback, const Milliseconds& delay) = 0;
@@ -40,6 +45,15 @@ public:
     virtual void postNonNestableDelayedTask(Callback callback, const Milliseconds& delay) = 0;
     virtual void postQuit() = 0;
 
+    // Posts a delayed task that can be removed from the queue with cancelDelayedTask() before it
+    // is run.
+    virtual DelayedTaskId postCancelableDelayedTask(Callback callback, const Milliseconds& delay) = 0;
+
+    // Removes the delayed task from the queue and destroys its callback without running it. Does
+    // nothing if the task has already been run or cancelled. If called from a thread other than the
+    // thread of the task runner, the task may still be run before the cancellation takes effect.
+    virtual void cancelDelayedTask(DelayedTaskId id) = 0;
+
     template <class T>
     static void doDelete(const void* object)
     {
@@ -0,0 +1,125 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "base/task.h"
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <memory>
+
+namespace base {
+
+namespace {
+
+class Counter
+{
+public:
+    void increment() { ++value_; }
+    int value() const { return value_; }
+
+private:
+    int value_ = 0;
+};
+
+} // namespace
+
+TEST(TaskTest, Empty)
+{
+    Task task;
+    EXPECT_FALSE(task);
+    EXPECT_TRUE(task == nullptr);
+
+    Task null_task(nullptr);
+    EXPECT_FALSE(null_task);
+
+    std::function<void()> empty_function;
+    Task from_empty_function(empty_function);
+    EXPECT_FALSE(from_empty_function);
+}
+
+TEST(TaskTest, InlineStorage)
+{
+    std::shared_ptr<Counter> counter = std::make_shared<Counter>();
+
+    Task bind_task(std::bind(&Counter::increment, counter));
+    EXPECT_TRUE(bind_task.isInline());
+
+    Task lambda_task([counter]() { counter->increment(); });
+    EXPECT_TRUE(lambda_task.isInline());
+
+    bind_task();
+    lambda_task();
+    EXPECT_EQ(counter->value(), 2);
+}
+
+TEST(TaskTest, HeapStorage)
+{
+    std::shared_ptr<Counter> counter = std::make_shared<Counter>();
+    std::array<uint8_t, Task::kInlineSize * 2> payload = {};
+
+    Task task([counter, payload]() { counter->increment(); });
+    EXPECT_FALSE(task.isInline());
+
+    Task moved_task(std::move(task));
+    EXPECT_FALSE(task);
+
+    moved_task();
+    EXPECT_EQ(counter->value(), 1);
+}
+
+TEST(TaskTest, MoveOnlyCapture)
+{
+    std::unique_ptr<Counter> counter = std::make_unique<Counter>();
+    Counter* counter_ptr = counter.get();
+
+    Task task([counter = std::move(counter)]() { counter->increment(); });
+    EXPECT_TRUE(task.isInline());
+
+    Task other;
+    other = std::move(task);
+    EXPECT_FALSE(task);
+    EXPECT_TRUE(other);
+
+    other();
+    EXPECT_EQ(counter_ptr->value(), 1);
+}
+
+TEST(TaskTest, DestroysCallable)
+{
+    std::shared_ptr<Counter> counter = std::make_shared<Counter>();
+
+    {
+        Task inline_task([counter]() {});
+        EXPECT_EQ(counter.use_count(), 2);
+
+        Task moved_task(std::move(inline_task));
+        EXPECT_EQ(counter.use_count(), 2);
+    }
+
+    EXPECT_EQ(counter.use_count(), 1);
+
+    std::array<uint8_t, Task::kInlineSize * 2> payload = {};
+    Task heap_task([counter, payload]() {});
+    EXPECT_EQ(counter.use_count(), 2);
+
+    heap_task = nullptr;
+    EXPECT_EQ(counter.use_count(), 1);
+}
+
+} // namespace base
@@ -0,0 +1,659 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "base/threading/thread_pool.h"
+
+#include "base/logging.h"
+#include "base/message_loop/timer_wheel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace base {
+
+namespace {
+
+// Sequence whose task is running on the current thread.
+thread_local const void* current_sequence = nullptr;
+
+} // namespace
+
+class ThreadPool::Core
+{
+public:
+    explicit Core(size_t thread_count);
+    ~Core();
+
+    void start();
+    void stop();
+
+    size_t threadCount() const { return workers_.size(); }
+    bool belongsToCurrentThread() const;
+
+    void postTask(Task task);
+    TaskRunner::DelayedTaskId postDelayedTask(
+        Task task, const TaskRunner::Milliseconds& delay, bool cancelable);
+    void cancelDelayedTask(TaskRunner::DelayedTaskId id);
+
+    Metrics metrics() const;
+
+private:
+    struct Worker
+    {
+        std::mutex queue_lock;
+        std::deque<Task> queue;
+        std::thread thread;
+    };
+
+    void workerMain(size_t index);
+    void timerMain();
+
+    bool popTask(size_t index, Task* task);
+    bool stealTask(size_t index, Task* task);
+    void runTask(Task& task);
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::atomic<size_t> next_worker_ { 0 };
+
+    std::atomic<bool> started_ { false };
+    std::atomic<bool> stopping_ { false };
+
+    // Number of tasks in the queues of all workers.
+    std::atomic<size_t> queued_tasks_ { 0 };
+
+    std::mutex wake_lock_;
+    std::condition_variable wake_event_;
+    std::atomic<size_t> sleeping_workers_ { 0 };
+
+    // Delayed tasks are kept in the timer wheel until their time comes and then are posted to the
+    // workers by the timer thread.
+    std::thread timer_thread_;
+    mutable std::mutex timer_lock_;
+    std::condition_variable timer_event_;
+    TimerWheel timer_wheel_;
+    TaskRunner::DelayedTaskId next_delayed_task_id_ = 1;
+
+    std::atomic<uint64_t> completed_tasks_ { 0 };
+    std::atomic<uint64_t> steal_count_ { 0 };
+    std::atomic<int64_t> busy_time_us_ { 0 };
+
+    static thread_local Core* current_core_;
+    static thread_local size_t current_worker_;
+
+    DISALLOW_COPY_AND_ASSIGN(Core);
+};
+
+thread_local ThreadPool::Core* ThreadPool::Core::current_core_ = nullptr;
+thread_local size_t ThreadPool::Core::current_worker_ = 0;
+
+ThreadPool::Core::Core(size_t thread_count)
+{
+    if (!thread_count)
+        thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+
+    for (size_t i = 0; i < thread_count; ++i)
+        workers_.emplace_back(std::make_unique<Worker>());
+}
+
+ThreadPool::Core::~Core()
+{
+    DCHECK(!started_ || stopping_);
+}
+
+void ThreadPool::Core::start()
+{
+    if (started_.exchange(true))
+        return;
+
+    for (size_t i = 0; i < workers_.size(); ++i)
+        workers_[i]->thread = std::thread(&Core::workerMain, this, i);
+
+    timer_thread_ = std::thread(&Core::timerMain, this);
+}
+
+void ThreadPool::Core::stop()
+{
+    DCHECK(!belongsToCurrentThread());
+
+    {
+        std::scoped_lock lock(wake_lock_, timer_lock_);
+
+        if (stopping_)
+            return;
+
+        stopping_ = true;
+    }
+
+    wake_event_.notify_all();
+    timer_event_.notify_all();
+
+    for (auto& worker : workers_)
+    {
+        if (worker->thread.joinable())
+            worker->thread.join();
+    }
+
+    if (timer_thread_.joinable())
+        timer_thread_.join();
+
+    // Tasks are destroyed outside the locks, because their destruction may post new tasks.
+    std::vector<Task> tasks;
+
+    for (auto& worker : workers_)
+    {
+        std::scoped_lock lock(worker->queue_lock);
+
+        for (auto& task : worker->queue)
+            tasks.emplace_back(std::move(task));
+
+        worker->queue.clear();
+    }
+
+    queued_tasks_ = 0;
+    tasks.clear();
+
+    std::scoped_lock lock(timer_lock_);
+    timer_wheel_.clear();
+}
+
+bool ThreadPool::Core::belongsToCurrentThread() const
+{
+    return current_core_ == this;
+}
+
+void ThreadPool::Core::postTask(Task task)
+{
+    if (stopping_)
+        return;
+
+    // Tasks posted from a worker thread stay on this worker. It is likely that they use the same
+    // data as the current task.
+    const size_t index = belongsToCurrentThread() ?
+        current_worker_ : next_worker_.fetch_add(1, std::memory_order_relaxed) % workers_.size();
+
+    Worker* worker = workers_[index].get();
+
+    {
+        std::scoped_lock lock(worker->queue_lock);
+        worker->queue.emplace_back(std::move(task));
+    }
+
+    queued_tasks_.fetch_add(1);
+
+    // A worker increments |sleeping_workers_| before it checks |queued_tasks_|, so at least one of
+    // the sides sees the change of the other.
+    if (sleeping_workers_.load())
+    {
+        {
+            std::scoped_lock lock(wake_lock_);
+        }
+
+        wake_event_.notify_one();
+    }
+}
+
+TaskRunner::DelayedTaskId ThreadPool::Core::postDelayedTask(
+    Task task, const TaskRunner::Milliseconds& delay, bool cancelable)
+{
+    if (stopping_)
+        return 0;
+
+    TaskRunner::DelayedTaskId id = 0;
+
+    {
+        std::scoped_lock lock(timer_lock_);
+
+        if (cancelable)
+            id = next_delayed_task_id_++;
+
+        timer_wheel_.add(PendingTask(std::move(task), TimerWheel::Clock::now() + delay, true, id));
+    }
+
+    timer_event_.notify_one();
+    return id;
+}
+
+void ThreadPool::Core::cancelDelayedTask(TaskRunner::DelayedTaskId id)
+{
+    std::scoped_lock lock(timer_lock_);
+    timer_wheel_.cancel(id);
+}
+
+ThreadPool::Metrics ThreadPool::Core::metrics() const
+{
+    Metrics metrics;
+
+    metrics.thread_count = workers_.size();
+    metrics.queued_tasks = queued_tasks_.load();
+    metrics.completed_tasks = completed_tasks_.load();
+    metrics.steal_count = steal_count_.load();
+    metrics.busy_time = std::chrono::microseconds(busy_time_us_.load());
+
+    std::scoped_lock lock(timer_lock_);
+    metrics.delayed_tasks = timer_wheel_.size();
+
+    return metrics;
+}
+
+void ThreadPool::Core::workerMain(size_t index)
+{
+    current_core_ = this;
+    current_worker_ = index;
+
+    for (;;)
+    {
+        Task task;
+
+        if (popTask(index, &task) || stealTask(index, &task))
+        {
+            runTask(task);
+            continue;
+        }
+
+        std::unique_lock lock(wake_lock_);
+
+        ++sleeping_workers_;
+
+        while (!stopping_ && !queued_tasks_.load())
+            wake_event_.wait(lock);
+
+        --sleeping_workers_;
+
+        if (stopping_)
+            break;
+    }
+
+    current_core_ = nullptr;
+}
+
+void ThreadPool::Core::timerMain()
+{
+    std::unique_lock lock(timer_lock_);
+
+    while (!stopping_)
+    {
+        timer_wheel_.advance(TimerWheel::Clock::now());
+
+        if (timer_wheel_.hasExpired())
+        {
+            PendingTask pending_task = timer_wheel_.takeExpired();
+
+            lock.unlock();
+            postTask(std::move(pending_task.callback));
+            lock.lock();
+            continue;
+        }
+
+        TimerWheel::TimePoint next_run_time = timer_wheel_.nextRunTime();
+
+        if (next_run_time == TimerWheel::TimePoint())
+            timer_event_.wait(lock);
+        else
+            timer_event_.wait_until(lock, next_run_time);
+    }
+}
+
+bool ThreadPool::Core::popTask(size_t index, Task* task)
+{
+    Worker* worker = workers_[index].get();
+
+    std::scoped_lock lock(worker->queue_lock);
+
+    if (worker->queue.empty())
+        return false;
+
+    *task = std::move(worker->queue.front());
+    worker->queue.pop_front();
+
+    queued_tasks_.fetch_sub(1);
+    return true;
+}
+
+bool ThreadPool::Core::stealTask(size_t index, Task* task)
+{
+    if (!queued_tasks_.load())
+        return false;
+
+    for (size_t i = 1; i < workers_.size(); ++i)
+    {
+        Worker* victim = workers_[(index + i) % workers_.size()].get();
+
+        std::scoped_lock lock(victim->queue_lock);
+
+        if (victim->queue.empty())
+            continue;
+
+        // The owner takes tasks from the front of its queue, so the thief takes them from the back
+        // to reduce the contention.
+        *task = std::move(victim->queue.back());
+        victim->queue.pop_back();
+
+        queued_tasks_.fetch_sub(1);
+        steal_count_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    return false;
+}
+
+void ThreadPool::Core::runTask(Task& task)
+{
+    const auto start_time = std::chrono::steady_clock::now();
+
+    task();
+    task = nullptr;
+
+    const auto busy_time = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start_time);
+
+    busy_time_us_.fetch_add(busy_time.count(), std::memory_order_relaxed);
+    completed_tasks_.fetch_add(1, std::memory_order_relaxed);
+}
+
+class ThreadPool::PoolTaskRunner : public TaskRunner
+{
+public:
+    explicit PoolTaskRunner(std::shared_ptr<Core> core)
+        : core_(std::move(core))
+    {
+        // Nothing
+    }
+
+    // TaskRunner implementation.
+    bool belongsToCurrentThread() const override
+    {
+        return core_->belongsToCurrentThread();
+    }
+
+    void postTask(Callback callback) override
+    {
+        core_->postTask(std::move(callback));
+    }
+
+    void postDelayedTask(Callback callback, const Milliseconds& delay) override
+    {
+        core_->postDelayedTask(std::move(callback), delay, false);
+    }
+
+    void postNonNestableTask(Callback callback) override
+    {
+        core_->postTask(std::move(callback));
+    }
+
+    void postNonNestableDelayedTask(Callback callback, const Milliseconds& delay) override
+    {
+        core_->postDelayedTask(std::move(callback), delay, false);
+    }
+
+    void postQuit() override
+    {
+        NOTIMPLEMENTED();
+    }
+
+    DelayedTaskId postCancelableDelayedTask(Callback callback, const Milliseconds& delay) override
+    {
+        return core_->postDelayedTask(std::move(callback), delay, true);
+    }
+
+    void cancelDelayedTask(DelayedTaskId id) override
+    {
+        core_->cancelDelayedTask(id);
+    }
+
+private:
+    std::shared_ptr<Core> core_;
+
+    DISALLOW_COPY_AND_ASSIGN(PoolTaskRunner);
+};
+
+class ThreadPool::SequencedTaskRunner : public TaskRunner
+{
+public:
+    explicit SequencedTaskRunner(std::shared_ptr<Core> core)
+        : core_(std::move(core))
+    {
+        // Nothing
+    }
+
+    // TaskRunner implementation.
+    bool belongsToCurrentThread() const override
+    {
+        return current_sequence == this;
+    }
+
+    void postTask(Callback callback) override
+    {
+        {
+            std::scoped_lock lock(queue_lock_);
+
+            queue_.emplace(std::move(callback));
+
+            if (scheduled_)
+                return;
+
+            scheduled_ = true;
+        }
+
+        scheduleNext();
+    }
+
+    void postDelayedTask(Callback callback, const Milliseconds& delay) override
+    {
+        core_->postDelayedTask(wrapDelayed(std::move(callback)), delay, false);
+    }
+
+    void postNonNestableTask(Callback callback) override
+    {
+        postTask(std::move(callback));
+    }
+
+    void postNonNestableDelayedTask(Callback callback, const Milliseconds& delay) override
+    {
+        postDelayedTask(std::move(callback), delay);
+    }
+
+    void postQuit() override
+    {
+        NOTIMPLEMENTED();
+    }
+
+    DelayedTaskId postCancelableDelayedTask(Callback callback, const Milliseconds& delay) override
+    {
+        return core_->postDelayedTask(wrapDelayed(std::move(callback)), delay, true);
+    }
+
+    void cancelDelayedTask(DelayedTaskId id) override
+    {
+        core_->cancelDelayedTask(id);
+    }
+
+private:
+    std::shared_ptr<SequencedTaskRunner> self()
+    {
+        return std::static_pointer_cast<SequencedTaskRunner>(shared_from_this());
+    }
+
+    // When the time of a delayed task comes, it is added to the queue of the sequence.
+    Callback wrapDelayed(Callback callback)
+    {
+        return [self = self(), callback = std::move(callback)]() mutable
+        {
+            self->postTask(std::move(callback));
+        };
+    }
+
+    void scheduleNext()
+    {
+        core_->postTask([self = self()]() { self->runNext(); });
+    }
+
+    // Runs one task of the sequence. The next task is posted to the pool as a separate task, so
+    // that a long sequence does not hold a worker.
+    void runNext()
+    {
+        Callback callback;
+
+        {
+            std::scoped_lock lock(queue_lock_);
+            DCHECK(!queue_.empty());
+
+            callback = std::move(queue_.front());
+            queue_.pop();
+        }
+
+        current_sequence = this;
+        callback();
+        callback = nullptr;
+        current_sequence = nullptr;
+
+        {
+            std::scoped_lock lock(queue_lock_);
+
+            if (queue_.empty())
+            {
+                scheduled_ = false;
+                return;
+            }
+        }
+
+        scheduleNext();
+    }
+
+    std::shared_ptr<Core> core_;
+
+    std::mutex queue_lock_;
+    std::queue<Callback> queue_;
+
+    // True if the sequence has a task posted to the pool.
+    bool scheduled_ = false;
+
+    DISALLOW_COPY_AND_ASSIGN(SequencedTaskRunner);
+};
+
+ThreadPool::ThreadPool(size_t thread_count)
+    : core_(std::make_shared<Core>(thread_count)),
+      task_runner_(std::make_shared<PoolTaskRunner>(core_))
+{
+    // Nothing
+}
+
+ThreadPool::~ThreadPool()
+{
+    stop();
+}
+
+void ThreadPool::start()
+{
+    core_->start();
+}
+
+void ThreadPool::stop()
+{
+    core_->stop();
+}
+
+size_t ThreadPool::threadCount() const
+{
+    return core_->threadCount();
+}
+
+std::shared_ptr<TaskRunner> ThreadPool::taskRunner() const
+{
+    return task_runner_;
+}
+
+std::shared_ptr<TaskRunner> ThreadPool::createSequencedTaskRunner()
+{
+    return std::make_shared<SequencedTaskRunner>(core_);
+}
+
+void ThreadPool::parallelFor(
+    size_t begin, size_t end, size_t grain_size, const RangeCallback& callback)
+{
+    if (begin >= end)
+        return;
+
+    if (!grain_size)
+        grain_size = 1;
+
+    const size_t part_count = (end - begin + grain_size - 1) / grain_size;
+    if (part_count == 1)
+    {
+        callback(begin, end);
+        return;
+    }
+
+    struct State
+    {
+        std::atomic<size_t> next_part { 0 };
+        std::atomic<size_t> finished_parts { 0 };
+        std::mutex finished_lock;
+        std::condition_variable finished_event;
+    };
+
+    std::shared_ptr<State> state = std::make_shared<State>();
+
+    // Each helper takes parts until they run out. A helper that starts after all the parts have
+    // been taken does not touch |callback|, so it is safe to return before all helpers are run.
+    auto process_parts = [=, &callback]()
+    {
+        for (;;)
+        {
+            const size_t part = state->next_part.fetch_add(1);
+            if (part >= part_count)
+                return;
+
+            const size_t part_begin = begin + part * grain_size;
+            callback(part_begin, std::min(part_begin + grain_size, end));
+
+            if (state->finished_parts.fetch_add(1) + 1 == part_count)
+            {
+                {
+                    std::scoped_lock lock(state->finished_lock);
+                }
+
+                state->finished_event.notify_one();
+            }
+        }
+    };
+
+    const size_t helper_count = std::min(threadCount(), part_count - 1);
+    for (size_t i = 0; i < helper_count; ++i)
+        core_->postTask(process_parts);
+
+    // The calling thread processes the parts too. Thus the function can not deadlock even if it is
+    // called from a pool thread and all other workers are busy.
+    process_parts();
+
+    std::unique_lock lock(state->finished_lock);
+    while (state->finished_parts.load() != part_count)
+        state->finished_event.wait(lock);
+}
+
+ThreadPool::Metrics ThreadPool::metrics() const
+{
+    return core_->metrics();
+}
+
+} // namespace base
@@ -0,0 +1,102 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BASE__THREADING__THREAD_POOL_H
+#define BASE__THREADING__THREAD_POOL_H
+
+#include "base/macros_magic.h"
+#include "base/task_runner.h"
+
+#include <chrono>
+#include <functional>
+#include <memory>
+
+namespace base {
+
+//
+// Pool of worker threads for CPU-bound work.
+// Each worker has its own task queue. Tasks posted from a worker thread are added to the queue of
+// this worker, tasks posted from other threads are distributed between the workers in turn. A
+// worker that has run out of tasks takes (steals) tasks from the queues of other workers.
+// Tasks are accessed through the TaskRunner interface. The task runner returned by taskRunner()
+// runs tasks in parallel and in arbitrary order. Task runners created by
+// createSequencedTaskRunner() run their tasks one at a time in the order of posting.
+//
+class ThreadPool
+{
+public:
+    // If |thread_count| is zero, the number of threads is equal to the number of processors.
+    explicit ThreadPool(size_t thread_count = 0);
+    ~ThreadPool();
+
+    // Starts the worker threads. Tasks posted before the start are run after it.
+    void start();
+
+    // Stops the worker threads and waits for them to exit. Tasks that have not yet started are
+    // destroyed without being run. Tasks posted after the stop are ignored.
+    // Must not be called from a pool thread.
+    void stop();
+
+    size_t threadCount() const;
+
+    std::shared_ptr<TaskRunner> taskRunner() const;
+    std::shared_ptr<TaskRunner> createSequencedTaskRunner();
+
+    using RangeCallback = std::function<void(size_t begin, size_t end)>;
+
+    // Splits the range [|begin|, |end|) into parts of at most |grain_size| elements and calls
+    // |callback| for each part on the pool threads. The calling thread also processes the parts.
+    // Returns when all parts are processed. It is intended for processing of image stripes and
+    // similar independent data.
+    void parallelFor(size_t begin, size_t end, size_t grain_size, const RangeCallback& callback);
+
+    struct Metrics
+    {
+        size_t thread_count = 0;
+
+        // Number of tasks that are ready to run but not yet started.
+        size_t queued_tasks = 0;
+
+        // Number of delayed tasks whose time has not yet come.
+        size_t delayed_tasks = 0;
+
+        uint64_t completed_tasks = 0;
+
+        // Number of tasks that were taken by a worker from the queue of another worker.
+        uint64_t steal_count = 0;
+
+        // Total time spent by all workers running tasks.
+        std::chrono::microseconds busy_time { 0 };
+    };
+
+    Metrics metrics() const;
+
+private:
+    class Core;
+    class PoolTaskRunner;
+    class SequencedTaskRunner;
+
+    std::shared_ptr<Core> core_;
+    std::shared_ptr<TaskRunner> task_runner_;
+
+    DISALLOW_COPY_AND_ASSIGN(ThreadPool);
+};
+
+} // namespace base
+
+#endif // BASE__THREADING__THREAD_POOL_H
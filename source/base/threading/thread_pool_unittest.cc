@@ -0,0 +1,153 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "base/threading/thread_pool.h"
+#include "base/waitable_event.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <vector>
+
+namespace base {
+
+TEST(ThreadPoolTest, RunsTasks)
+{
+    ThreadPool pool(4);
+    pool.start();
+
+    const int kTaskCount = 1000;
+    std::atomic<int> counter = 0;
+    WaitableEvent finished;
+
+    std::shared_ptr<TaskRunner> task_runner = pool.taskRunner();
+    for (int i = 0; i < kTaskCount; ++i)
+    {
+        task_runner->postTask([&]()
+        {
+            if (++counter == kTaskCount)
+                finished.signal();
+        });
+    }
+
+    EXPECT_TRUE(finished.wait(std::chrono::seconds(10)));
+    EXPECT_EQ(counter, kTaskCount);
+
+    pool.stop();
+    EXPECT_EQ(pool.metrics().completed_tasks, kTaskCount);
+}
+
+TEST(ThreadPoolTest, SequencedTaskRunner)
+{
+    ThreadPool pool(4);
+    pool.start();
+
+    std::shared_ptr<TaskRunner> task_runner = pool.createSequencedTaskRunner();
+
+    const int kTaskCount = 1000;
+    std::vector<int> order;
+    std::atomic<bool> in_sequence = true;
+    WaitableEvent finished;
+
+    for (int i = 0; i < kTaskCount; ++i)
+    {
+        task_runner->postTask([&, i]()
+        {
+            if (!task_runner->belongsToCurrentThread())
+                in_sequence = false;
+
+            order.push_back(i);
+
+            if (i == kTaskCount - 1)
+                finished.signal();
+        });
+    }
+
+    EXPECT_TRUE(finished.wait(std::chrono::seconds(10)));
+    EXPECT_TRUE(in_sequence);
+    ASSERT_EQ(order.size(), kTaskCount);
+
+    for (int i = 0; i < kTaskCount; ++i)
+        EXPECT_EQ(order[i], i);
+
+    pool.stop();
+}
+
+TEST(ThreadPoolTest, DelayedTasks)
+{
+    ThreadPool pool(2);
+    pool.start();
+
+    std::shared_ptr<TaskRunner> task_runner = pool.taskRunner();
+
+    std::atomic<bool> cancelled_task_run = false;
+    WaitableEvent finished;
+
+    TaskRunner::DelayedTaskId id = task_runner->postCancelableDelayedTask(
+        [&]() { cancelled_task_run = true; }, std::chrono::milliseconds(10));
+    task_runner->cancelDelayedTask(id);
+
+    task_runner->postDelayedTask([&]() { finished.signal(); }, std::chrono::milliseconds(20));
+
+    EXPECT_TRUE(finished.wait(std::chrono::seconds(10)));
+    EXPECT_FALSE(cancelled_task_run);
+
+    pool.stop();
+    EXPECT_EQ(pool.metrics().delayed_tasks, 0);
+}
+
+TEST(ThreadPoolTest, ParallelFor)
+{
+    ThreadPool pool(4);
+    pool.start();
+
+    const size_t kSize = 10007;
+    std::vector<std::atomic<int>> hits(kSize);
+
+    pool.parallelFor(0, kSize, 64, [&](size_t begin, size_t end)
+    {
+        EXPECT_LE(end - begin, 64);
+
+        for (size_t i = begin; i < end; ++i)
+            ++hits[i];
+    });
+
+    for (size_t i = 0; i < kSize; ++i)
+        EXPECT_EQ(hits[i], 1);
+
+    // Nested call from a pool thread must not deadlock.
+    std::atomic<size_t> total = 0;
+    WaitableEvent finished;
+
+    pool.taskRunner()->postTask([&]()
+    {
+        pool.parallelFor(0, kSize, 100, [&](size_t begin, size_t end)
+        {
+            total += end - begin;
+        });
+
+        finished.signal();
+    });
+
+    EXPECT_TRUE(finished.wait(std::chrono::seconds(10)));
+    EXPECT_EQ(total, kSize);
+
+    pool.stop();
+}
+
+} // namespace base
@@ -23,18 +23,16 @@
 
 namespace base {
 
-class WaitableTimer::Impl : public std::enable_shared_from_this<Impl>
+class WaitableTimer::Impl
 {
 public:
     explicit Impl(TimeoutCallback signal_callback);
     ~Impl();
 
-    void start(const std::chrono::milliseconds& time_delta, std::shared_ptr<TaskRunner>& task_runner);
     void dettach();
-
-private:
     void onSignal();
 
+private:
     TimeoutCallback signal_callback_;
 
     DISALLOW_COPY_AND_ASSIGN(Impl);
@@ -51,12 +49,6 @@ WaitableTimer::Impl::~Impl()
     dettach();
 }
 
-void WaitableTimer::Impl::start(
-    const std::chrono::milliseconds& time_delta, std::shared_ptr<TaskRunner>& task_runner)
-{
-    task_runner->postDelayedTask(std::bind(&Impl::onSignal, shared_from_this()), time_delta);
-}
-
 void WaitableTimer::Impl::dettach()
 {
     signal_callback_ = nullptr;
@@ -82,8 +74,11 @@ WaitableTimer::~WaitableTimer()
 void WaitableTimer::start(const std::chrono::milliseconds& time_delta,
                           TimeoutCallback signal_callback)
 {
+    stop();
+
     impl_ = std::make_shared<Impl>(std::move(signal_callback));
-    impl_->start(time_delta, task_runner_);
+    task_id_ = task_runner_->postCancelableDelayedTask(
+        std::bind(&Impl::onSignal, impl_), time_delta);
 }
 
 void WaitableTimer::stop()
@@ -91,6 +86,12 @@ void WaitableTimer::stop()
     if (!impl_)
         return;
 
+    // The task is removed from the queue immediately, so stopped timers do not hold memory until
+    // their time expires. If the task is already running on another thread, dettach() prevents
+    // the callback from being called.
+    task_runner_->cancelDelayedTask(task_id_);
+    task_id_ = 0;
+
     impl_->dettach();
     impl_.reset();
 }
@@ -20,6 +20,7 @@
 #define BASE__WAITABLE_TIMER_H
 
 #include "base/macros_magic.h"
+#include "base/task_runner.h"
 
 #include <chrono>
 #include <functional>
@@ -27,8 +28,6 @@
 
 namespace base {
 
-class TaskRunner;
-
 class WaitableTimer
 {
 public:
@@ -38,10 +37,10 @@ public:
     using TimeoutCallback = std::function<void()>;
 
     // Starts execution |signal_callback| in the time interval |time_delta_in_ms|.
-    // If the timer is already in a running state, then no action is taken.
+    // If the timer is already running, the previous task is cancelled.
     void start(const std::chrono::milliseconds& time_delta, TimeoutCallback signal_callback);
 
-    // Stops the timer and waits for the callback function to complete, if it is running.
+    // Stops the timer and removes its task from the queue of the task runner.
     void stop();
 
     // Checks the state of the timer.
@@ -51,6 +50,7 @@ private:
     class Impl;
     std::shared_ptr<Impl> impl_;
     std::shared_ptr<TaskRunner> task_runner_;
+    TaskRunner::DelayedTaskId task_id_ = 0;
 
     DISALLOW_COPY_AND_ASSIGN(WaitableTimer);
 };
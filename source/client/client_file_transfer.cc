@@ -20,12 +20,16 @@
 
 #include "base/logging.h"
 #include "base/task_runner.h"
+#include "base/threading/thread_pool.h"
 #include "client/file_control_proxy.h"
 #include "client/file_manager_window_proxy.h"
 #include "common/file_task_factory.h"
 #include "common/file_task_consumer_proxy.h"
 #include "common/file_task_producer_proxy.h"
 #include "common/file_worker.h"
+#include "proto/file_transfer.pb.h"
+
+#include <algorithm>
 
 namespace client {
 
@@ -34,9 +38,15 @@ ClientFileTransfer::ClientFileTransfer(std::shared_ptr<base::TaskRunner> io_task
       file_control_proxy_(std::make_shared<FileControlProxy>(io_task_runner, this)),
       task_consumer_proxy_(std::make_shared<common::FileTaskConsumerProxy>(this)),
       task_producer_proxy_(std::make_shared<common::FileTaskProducerProxy>(this)),
-      local_worker_(std::make_unique<common::FileWorker>(io_task_runner))
+      local_io_pool_(std::make_unique<base::ThreadPool>(common::FileWorker::kIoThreadCount))
 {
-    // Nothing
+    // The local files are read and written outside of the network thread.
+    local_io_pool_->start();
+
+    std::vector<std::shared_ptr<base::TaskRunner>> io_task_runners;
+    io_task_runners.emplace_back(local_io_pool_->taskRunner());
+
+    local_worker_ = std::make_unique<common::FileWorker>(io_task_runner, io_task_runners);
 }
 
 ClientFileTransfer::~ClientFileTransfer()
@@ -82,14 +92,32 @@ void ClientFileTransfer::onMessageReceived(const base::ByteArray& buffer)
     }
     else if (!remote_task_queue_.empty())
     {
-        // Move the reply to the request and notify the sender.
-        remote_task_queue_.front()->setReply(std::move(reply));
+        // The host that supports request identifiers replies in the order of completion, the
+        // other hosts reply in the order of the requests.
+        auto task = remote_task_queue_.begin();
+
+        if (reply->request_id())
+        {
+            task = std::find_if(remote_task_queue_.begin(), remote_task_queue_.end(),
+                                [id = reply->request_id()](const auto& task)
+            {
+                return task->request().request_id() == id;
+            });
+
+            if (task == remote_task_queue_.end())
+            {
+                file_manager_window_proxy_->onErrorOccurred(proto::FILE_ERROR_UNKNOWN);
+                return;
+            }
+        }
+
+        std::shared_ptr<common::FileTask> current_task = std::move(*task);
 
         // Remove the request from the queue.
-        remote_task_queue_.pop();
+        remote_task_queue_.erase(task);
 
-        // Execute the next request.
-        doNextRemoteTask();
+        // Move the reply to the request and notify the sender.
+        current_task->setReply(std::move(reply));
     }
     else
     {
@@ -139,26 +167,13 @@ void ClientFileTransfer::doTask(std::shared_ptr<common::FileTask> task)
     }
     else
     {
-        const bool schedule = remote_task_queue_.empty();
-
-        // Add the request to the queue.
-        remote_task_queue_.emplace(std::move(task));
-
-        // If the request queue was empty, then run execution.
-        if (schedule)
-            doNextRemoteTask();
+        // The request is sent at once and the task waits for its reply in the queue. Several
+        // requests can be in flight (see FileTransfer).
+        sendMessage(task->request());
+        remote_task_queue_.emplace_back(std::move(task));
     }
 }
 
-void ClientFileTransfer::doNextRemoteTask()
-{
-    if (remote_task_queue_.empty())
-        return;
-
-    // Send a request to the remote computer.
-    sendMessage(remote_task_queue_.front()->request());
-}
-
 common::FileTaskFactory* ClientFileTransfer::taskFactory(common::FileTask::Target target)
 {
     common::FileTaskFactory* task_factory;
@@ -224,6 +239,7 @@ void ClientFileTransfer::transfer(std::shared_ptr<FileTransferWindowProxy> trans
 
     transfer_ = std::make_unique<FileTransfer>(
         local_worker_->taskRunner(), transfer_window_proxy, task_consumer_proxy_, transfer_type);
+    transfer_->setMaxStreamCount(transfer_stream_count_);
 
     transfer_->start(source_path, target_path, items, [this]()
     {
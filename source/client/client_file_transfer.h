@@ -24,6 +24,12 @@
 #include "common/file_task_consumer.h"
 #include "common/file_task_producer.h"
 
+#include <deque>
+
+namespace base {
+class ThreadPool;
+} // namespace base
+
 namespace common {
 class FileTaskConsumerProxy;
 class FileTaskProducerProxy;
@@ -52,6 +58,9 @@ public:
 
     void setFileManagerWindow(std::shared_ptr<FileManagerWindowProxy> file_manager_window_proxy);
 
+    // Sets the maximum number of files that are transferred at the same time.
+    void setTransferStreamCount(size_t count) { transfer_stream_count_ = count; }
+
     // FileTaskConsumer implementation.
     void doTask(std::shared_ptr<common::FileTask> task) override;
 
@@ -67,8 +76,6 @@ protected:
     void onTaskDone(std::shared_ptr<common::FileTask> task) override;
 
 private:
-    void doNextRemoteTask();
-
     common::FileTaskFactory* taskFactory(common::FileTask::Target target);
 
     // FileControl implementation.
@@ -93,13 +100,17 @@ private:
     std::unique_ptr<common::FileTaskFactory> local_task_factory_;
     std::unique_ptr<common::FileTaskFactory> remote_task_factory_;
 
-    std::queue<std::shared_ptr<common::FileTask>> remote_task_queue_;
+    // Remote requests waiting for the reply in the order of sending.
+    std::deque<std::shared_ptr<common::FileTask>> remote_task_queue_;
+
+    std::unique_ptr<base::ThreadPool> local_io_pool_;
     std::unique_ptr<common::FileWorker> local_worker_;
 
     std::shared_ptr<FileControlProxy> file_control_proxy_;
     std::shared_ptr<FileManagerWindowProxy> file_manager_window_proxy_;
     std::unique_ptr<FileRemover> remover_;
     std::unique_ptr<FileTransfer> transfer_;
+    size_t transfer_stream_count_ = FileTransfer::kDefaultStreamCount;
 
     DISALLOW_COPY_AND_ASSIGN(ClientFileTransfer);
 };
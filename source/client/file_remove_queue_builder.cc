@@ -26,6 +26,13 @@
 
 namespace client {
 
+namespace {
+
+// Number of requests for the next parts of a tree that are sent without waiting for the replies.
+const size_t kTreeRequestsInFlight = 4;
+
+} // namespace
+
 FileRemoveQueueBuilder::FileRemoveQueueBuilder(
     std::shared_ptr<common::FileTaskConsumerProxy> task_consumer_proxy,
     common::FileTask::Target target)
@@ -61,21 +68,73 @@ FileRemover::TaskList FileRemoveQueueBuilder::takeQueue()
 void FileRemoveQueueBuilder::onTaskDone(std::shared_ptr<common::FileTask> task)
 {
     const proto::FileRequest& request = task->request();
-    const proto::FileReply& reply = task->reply();
 
-    if (!request.has_file_list_request())
-    {
+    if (request.has_file_tree_request())
+        onFileTreeReply(*task);
+    else if (request.has_file_list_request())
+        onFileListReply(*task);
+    else
         onAborted(proto::FILE_ERROR_UNKNOWN);
+}
+
+void FileRemoveQueueBuilder::onFileTreeReply(const common::FileTask& task)
+{
+    // The requests sent after the last part of the tree are ignored.
+    if (tree_requests_.empty() || tree_requests_.front().get() != &task)
+        return;
+
+    tree_requests_.pop_front();
+
+    const proto::FileReply& reply = task.reply();
+
+    if (reply.error_code() == proto::FILE_ERROR_INVALID_REQUEST &&
+        !task.request().file_tree_request().path().empty())
+    {
+        // The peer of an older version does not support the request.
+        is_tree_supported_ = false;
+        task_consumer_proxy_->doTask(task_factory_->fileList(directory_));
+        return;
+    }
+
+    if (reply.error_code() != proto::FILE_ERROR_SUCCESS)
+    {
+        onAborted(reply.error_code());
         return;
     }
 
+    const proto::FileTree& file_tree = reply.file_tree();
+
+    // A directory comes before its contents in the tree, so the contents are removed first.
+    for (int i = 0; i < file_tree.item_size(); ++i)
+    {
+        const proto::FileList::Item& item = file_tree.item(i);
+        std::string item_path = directory_ + '/' + item.name();
+
+        tasks_.emplace_front(std::move(item_path), item.is_directory());
+    }
+
+    if (file_tree.last_part())
+    {
+        tree_requests_.clear();
+        doPendingTasks();
+        return;
+    }
+
+    while (tree_requests_.size() < kTreeRequestsInFlight)
+        sendTreeRequest(std::string());
+}
+
+void FileRemoveQueueBuilder::onFileListReply(const common::FileTask& task)
+{
+    const proto::FileReply& reply = task.reply();
+
     if (reply.error_code() != proto::FILE_ERROR_SUCCESS)
     {
         onAborted(reply.error_code());
         return;
     }
 
-    const std::string& path = request.file_list_request().path();
+    const std::string& path = task.request().file_list_request().path();
 
     for (int i = 0; i < reply.file_list().item_size(); ++i)
     {
@@ -88,6 +147,14 @@ void FileRemoveQueueBuilder::onTaskDone(std::shared_ptr<common::FileTask> task)
     doPendingTasks();
 }
 
+void FileRemoveQueueBuilder::sendTreeRequest(const std::string& path)
+{
+    std::shared_ptr<common::FileTask> task = task_factory_->fileTree(path);
+
+    tree_requests_.emplace_back(task);
+    task_consumer_proxy_->doTask(std::move(task));
+}
+
 void FileRemoveQueueBuilder::doPendingTasks()
 {
     while (!pending_tasks_.empty())
@@ -97,7 +164,12 @@ void FileRemoveQueueBuilder::doPendingTasks()
 
         if (tasks_.front().isDirectory())
         {
-            task_consumer_proxy_->doTask(task_factory_->fileList(tasks_.front().path()));
+            directory_ = tasks_.front().path();
+
+            if (is_tree_supported_)
+                sendTreeRequest(directory_);
+            else
+                task_consumer_proxy_->doTask(task_factory_->fileList(directory_));
             return;
         }
     }
@@ -109,6 +181,7 @@ void FileRemoveQueueBuilder::onAborted(proto::FileError error_code)
 {
     pending_tasks_.clear();
     tasks_.clear();
+    tree_requests_.clear();
 
     callback_(error_code);
 }
@@ -25,6 +25,9 @@
 namespace client {
 
 // The class prepares the task queue to perform the deletion.
+// The class prepares the task queue to perform the removal. The contents of a directory come
+// before the directory itself. The tree of each directory is enumerated by the peer and comes in
+// parts. A peer of an older version lists one directory per request.
 class FileRemoveQueueBuilder : public common::FileTaskProducer
 {
 public:
@@ -45,6 +48,11 @@ protected:
     void onTaskDone(std::shared_ptr<common::FileTask> task) override;
 
 private:
+    using FileTaskQueue = std::deque<std::shared_ptr<common::FileTask>>;
+
+    void onFileTreeReply(const common::FileTask& task);
+    void onFileListReply(const common::FileTask& task);
+    void sendTreeRequest(const std::string& path);
     void doPendingTasks();
     void onAborted(proto::FileError error_code);
 
@@ -57,6 +65,13 @@ private:
     FileRemover::TaskList pending_tasks_;
     FileRemover::TaskList tasks_;
 
+    // Directory being enumerated.
+    std::string directory_;
+
+    // Tree requests that have not been answered yet.
+    FileTaskQueue tree_requests_;
+    bool is_tree_supported_ = true;
+
     DISALLOW_COPY_AND_ASSIGN(FileRemoveQueueBuilder);
 };
 
@@ -27,6 +27,9 @@
 #include "common/file_task_producer_proxy.h"
 #include "common/file_packet.h"
 
+#include <algorithm>
+#include <iterator>
+
 namespace client {
 
 namespace {
@@ -105,6 +108,12 @@ FileTransfer::~FileTransfer()
     transfer_proxy_->dettach();
 }
 
+void FileTransfer::setMaxStreamCount(size_t count)
+{
+    DCHECK(streams_.empty());
+    max_stream_count_ = std::clamp<size_t>(count, 1, common::kMaxFileStreamCount);
+}
+
 void FileTransfer::start(const std::string& source_path,
                          const std::string& target_path,
                          const std::vector<Item>& items,
@@ -112,6 +121,9 @@ void FileTransfer::start(const std::string& source_path,
 {
     finish_callback_ = finish_callback;
 
+    for (size_t i = 0; i < max_stream_count_; ++i)
+        streams_.emplace_back(std::make_unique<Stream>(static_cast<uint32_t>(i)));
+
     std::unique_ptr<common::FileTaskFactory> task_factory_local =
         std::make_unique<common::FileTaskFactory>(
             task_producer_proxy_, common::FileTask::Target::LOCAL);
@@ -139,29 +151,33 @@ void FileTransfer::start(const std::string& source_path,
     queue_builder_ = std::make_unique<FileTransferQueueBuilder>(
         task_consumer_proxy_, task_factory_source_->target());
 
-    // Start building a list of objects for transfer.
-    queue_builder_->start(source_path, target_path, items, [this](proto::FileError error_code)
+    // Start building a list of objects for transfer. The transfer starts with the first tasks
+    // while the rest of the tree is being enumerated.
+    queue_builder_->start(source_path, target_path, items, [this]()
+    {
+        takeQueue();
+        startStreams();
+    },
+    [this](proto::FileError error_code)
     {
         if (error_code == proto::FILE_ERROR_SUCCESS)
-        {
-            tasks_ = queue_builder_->takeQueue();
-            total_size_ = queue_builder_->totalSize();
+            takeQueue();
 
-            if (tasks_.empty())
-            {
-                onFinished();
-            }
-            else
-            {
-                doFrontTask(false);
-            }
+        // The builder is calling this function.
+        io_task_runner_->deleteSoon(std::move(queue_builder_));
+
+        if (error_code != proto::FILE_ERROR_SUCCESS)
+        {
+            onError(nullptr, Error::Type::QUEUE, proto::FILE_ERROR_UNKNOWN);
+        }
+        else if (tasks_.empty() && !hasActiveStreams())
+        {
+            onFinished();
         }
         else
         {
-            onError(Error::Type::QUEUE, proto::FILE_ERROR_UNKNOWN);
+            startStreams();
         }
-
-        queue_builder_.reset();
     });
 }
 
@@ -170,13 +186,16 @@ void FileTransfer::stop()
     if (queue_builder_)
     {
         queue_builder_.reset();
-        onFinished();
-    }
-    else
-    {
-        is_canceled_ = true;
-        cancel_timer_.start(std::chrono::seconds(5), std::bind(&FileTransfer::onFinished, this));
+
+        if (!hasActiveStreams())
+        {
+            onFinished();
+            return;
+        }
     }
+
+    is_canceled_ = true;
+    cancel_timer_.start(std::chrono::seconds(5), std::bind(&FileTransfer::onFinished, this));
 }
 
 void FileTransfer::setActionForErrorType(Error::Type error_type, Error::Action action)
@@ -186,17 +205,21 @@ void FileTransfer::setActionForErrorType(Error::Type error_type, Error::Action a
 
 void FileTransfer::onTaskDone(std::shared_ptr<common::FileTask> task)
 {
+    Stream* stream = streamByTask(*task);
+    if (!stream)
+        return;
+
     if (type_ == Type::DOWNLOADER)
     {
         if (task->target() == common::FileTask::Target::LOCAL)
         {
-            targetReply(task->request(), task->reply());
+            targetReply(stream, *task);
         }
         else
         {
             DCHECK_EQ(task->target(), common::FileTask::Target::REMOTE);
 
-            sourceReply(task->request(), task->reply());
+            sourceReply(stream, *task);
         }
     }
     else
@@ -205,40 +228,60 @@ void FileTransfer::onTaskDone(std::shared_ptr<common::FileTask> task)
 
         if (task->target() == common::FileTask::Target::LOCAL)
         {
-            sourceReply(task->request(), task->reply());
+            sourceReply(stream, *task);
         }
         else
         {
             DCHECK_EQ(task->target(), common::FileTask::Target::REMOTE);
 
-            targetReply(task->request(), task->reply());
+            targetReply(stream, *task);
         }
     }
 }
 
-FileTransfer::Task& FileTransfer::frontTask()
+FileTransfer::Stream* FileTransfer::streamByTask(const common::FileTask& task)
 {
-    return tasks_.front();
+    for (const auto& stream : streams_)
+    {
+        if (!stream->task)
+            continue;
+
+        if (stream->open_request.get() == &task)
+            return stream.get();
+
+        if (!stream->source_packets.empty() && stream->source_packets.front().get() == &task)
+            return stream.get();
+
+        if (!stream->target_packets.empty() && stream->target_packets.front().get() == &task)
+            return stream.get();
+    }
+
+    return nullptr;
 }
 
-void FileTransfer::targetReply(const proto::FileRequest& request, const proto::FileReply& reply)
+void FileTransfer::targetReply(Stream* stream, const common::FileTask& task)
 {
-    if (tasks_.empty())
-        return;
+    const proto::FileRequest& request = task.request();
+    const proto::FileReply& reply = task.reply();
 
     if (request.has_create_directory_request())
     {
+        stream->open_request.reset();
+
         if (reply.error_code() == proto::FILE_ERROR_SUCCESS ||
             reply.error_code() == proto::FILE_ERROR_PATH_ALREADY_EXISTS)
         {
-            doNextTask();
+            doNextTask(stream);
             return;
         }
 
-        onError(Error::Type::CREATE_DIRECTORY, reply.error_code(), frontTask().targetPath());
+        onError(stream, Error::Type::CREATE_DIRECTORY, reply.error_code(),
+                stream->task->targetPath());
     }
     else if (request.has_upload_request())
     {
+        stream->open_request.reset();
+
         if (reply.error_code() != proto::FILE_ERROR_SUCCESS)
         {
             Error::Type error_type = Error::Type::CREATE_FILE;
@@ -246,103 +289,252 @@ void FileTransfer::targetReply(const proto::FileRequest& request, const proto::F
             if (reply.error_code() == proto::FILE_ERROR_PATH_ALREADY_EXISTS)
                 error_type = Error::Type::ALREADY_EXISTS;
 
-            onError(error_type, reply.error_code(), frontTask().targetPath());
+            onError(stream, error_type, reply.error_code(), stream->task->targetPath());
             return;
         }
 
-        task_consumer_proxy_->doTask(
-            task_factory_source_->packetRequest(proto::FilePacketRequest::NO_FLAGS));
+        stream->window_size = std::min(stream->source_window_size, reply.window_size());
+        stream->compression = reply.compression();
+        target_stream_count_ = reply.stream_count();
+        target_packing_ = reply.packing();
+
+        if (stream->delta && reply.has_signature())
+        {
+            // The source sends the difference from the data that the target already has.
+            stream->open_request = task_factory_source_->delta(reply.signature(), stream->id);
+            task_consumer_proxy_->doTask(stream->open_request);
+        }
+        else
+        {
+            requestPackets(stream);
+        }
+
+        // The first opened file tells whether the peers can transfer several files at once.
+        startStreams();
     }
     else if (request.has_packet())
     {
+        stream->target_packets.pop_front();
+
         if (reply.error_code() != proto::FILE_ERROR_SUCCESS)
         {
-            onError(Error::Type::WRITE_FILE, reply.error_code(), frontTask().targetPath());
+            resetPackets(stream);
+            onError(stream, Error::Type::WRITE_FILE, reply.error_code(),
+                    stream->task->targetPath());
             return;
         }
 
-        const int64_t full_task_size = frontTask().size();
-        if (full_task_size && total_size_)
+        const proto::FilePacket& packet = request.packet();
+
+        // The window and the progress count the data of the file rather than the data sent.
+        const uint32_t packet_size = static_cast<uint32_t>(packetFileSize(packet));
+        if (packet.compression() != proto::FILE_COMPRESSION_NONE)
         {
-            int64_t packet_size = common::kMaxFilePacketSize;
+            addCompressionStatistics(
+                packet.original_size(), packet.data().size(), packet.compress_time());
+        }
 
-            task_transfered_size_ += packet_size;
+        stream->written_size += packet_size;
 
-            if (task_transfered_size_ > full_task_size)
-            {
-                packet_size = task_transfered_size_ - full_task_size;
-                task_transfered_size_ = full_task_size;
-            }
+        if (stream->window_size)
+            onPacketWritten(stream, packet_size);
 
-            total_transfered_size_ += packet_size;
+        addProgress(stream, packet_size);
 
-            const int task_percentage =
-                static_cast<int>(task_transfered_size_ * 100 / full_task_size);
-            const int total_percentage =
-                static_cast<int>(total_transfered_size_ * 100 / total_size_);
+        if (packet.flags() & proto::FilePacket::LAST_PACKET)
+        {
+            doNextTask(stream);
+            return;
+        }
 
-            if (task_percentage != task_percentage_ || total_percentage != total_percentage_)
-            {
-                task_percentage_ = task_percentage;
-                total_percentage_ = total_percentage;
+        requestPackets(stream);
+    }
+    else if (request.has_pack())
+    {
+        stream->open_request.reset();
 
-                transfer_window_proxy_->setCurrentProgress(total_percentage_, task_percentage_);
-            }
-        }
+        const proto::FilePack& pack = request.pack();
+        const proto::FilePack& result = reply.pack();
 
-        if (request.packet().flags() & proto::FilePacket::LAST_PACKET)
+        if (reply.error_code() != proto::FILE_ERROR_SUCCESS ||
+            result.files_size() != pack.files_size())
         {
-            doNextTask();
-            return;
+            for (auto& pack_task : stream->pack)
+            {
+                stream->unpacked.emplace_back(
+                    UnpackedTask{ std::move(pack_task), reply.error_code() });
+            }
         }
+        else
+        {
+            int64_t written_size = 0;
 
-        uint32_t flags = proto::FilePacketRequest::NO_FLAGS;
-        if (is_canceled_)
-            flags = proto::FilePacketRequest::CANCEL;
+            for (int i = 0; i < result.files_size(); ++i)
+            {
+                const proto::FileError error_code = result.files(i).error_code();
+
+                if (error_code == proto::FILE_ERROR_SUCCESS)
+                {
+                    written_size += static_cast<int64_t>(pack.files(i).size());
+                }
+                else
+                {
+                    stream->unpacked.emplace_back(
+                        UnpackedTask{ std::move(stream->pack[i]), error_code });
+                }
+            }
 
-        task_consumer_proxy_->doTask(task_factory_source_->packetRequest(flags));
+            if (pack.compression() != proto::FILE_COMPRESSION_NONE)
+            {
+                addCompressionStatistics(
+                    pack.original_size(), pack.data().size(), pack.compress_time());
+            }
+
+            addProgress(stream, written_size);
+        }
+
+        doNextTask(stream);
     }
     else
     {
-        onError(Error::Type::OTHER, proto::FILE_ERROR_UNKNOWN);
+        onError(stream, Error::Type::OTHER, proto::FILE_ERROR_UNKNOWN);
     }
 }
 
-void FileTransfer::sourceReply(const proto::FileRequest& request, const proto::FileReply& reply)
+void FileTransfer::sourceReply(Stream* stream, const common::FileTask& task)
 {
-    if (tasks_.empty())
-        return;
+    const proto::FileRequest& request = task.request();
+    const proto::FileReply& reply = task.reply();
 
     if (request.has_download_request())
     {
-        Task& front_task = frontTask();
+        stream->open_request.reset();
+
+        const Task& stream_task = *stream->task;
 
         if (reply.error_code() != proto::FILE_ERROR_SUCCESS)
         {
-            onError(Error::Type::OPEN_FILE, reply.error_code(), front_task.sourcePath());
+            onError(stream, Error::Type::OPEN_FILE, reply.error_code(), stream_task.sourcePath());
             return;
         }
 
-        task_consumer_proxy_->doTask(
-            task_factory_target_->upload(front_task.targetPath(), front_task.overwrite()));
+        stream->source_window_size = reply.window_size();
+        stream->file_size = reply.file_size();
+        stream->delta = reply.delta() && stream->file_size >= common::kMinDeltaFileSize;
+        source_stream_count_ = reply.stream_count();
+        source_packing_ = reply.packing();
+
+        stream->open_request = task_factory_target_->upload(
+            stream_task.targetPath(), stream_task.overwrite(), stream->delta,
+            common::kMaxFileWindowSize, stream->id);
+        task_consumer_proxy_->doTask(stream->open_request);
+    }
+    else if (request.has_delta_request())
+    {
+        stream->open_request.reset();
+
+        if (reply.error_code() != proto::FILE_ERROR_SUCCESS)
+        {
+            onError(stream, Error::Type::READ_FILE, reply.error_code(),
+                    stream->task->sourcePath());
+            return;
+        }
+
+        // The data of the interrupted transfer is already written by the target.
+        const uint64_t resume_size = std::min(reply.resume_size(), stream->file_size);
+
+        stream->requested_size = resume_size;
+        stream->written_size = resume_size;
+
+        addProgress(stream, static_cast<int64_t>(resume_size));
+        requestPackets(stream);
     }
     else if (request.has_packet_request())
     {
+        stream->source_packets.pop_front();
+
         if (reply.error_code() != proto::FILE_ERROR_SUCCESS)
         {
-            onError(Error::Type::READ_FILE, reply.error_code(), frontTask().sourcePath());
+            resetPackets(stream);
+            onError(stream, Error::Type::READ_FILE, reply.error_code(),
+                    stream->task->sourcePath());
+            return;
+        }
+
+        if (reply.packet().flags() & proto::FilePacket::LAST_PACKET)
+            stream->last_packet_requested = true;
+
+        std::shared_ptr<common::FileTask> packet_task =
+            task_factory_target_->packet(reply.packet(), stream->id);
+
+        stream->target_packets.emplace_back(packet_task);
+        task_consumer_proxy_->doTask(std::move(packet_task));
+    }
+    else if (request.has_pack_request())
+    {
+        stream->open_request.reset();
+
+        const proto::FilePack& source_pack = reply.pack();
+
+        if (reply.error_code() != proto::FILE_ERROR_SUCCESS ||
+            static_cast<size_t>(source_pack.files_size()) != stream->pack.size())
+        {
+            // The files are transferred one at a time.
+            for (auto& pack_task : stream->pack)
+            {
+                stream->unpacked.emplace_back(
+                    UnpackedTask{ std::move(pack_task), reply.error_code() });
+            }
+
+            doNextTask(stream);
+            return;
+        }
+
+        if (is_canceled_)
+        {
+            doNextTask(stream);
             return;
         }
 
-        task_consumer_proxy_->doTask(task_factory_target_->packet(reply.packet()));
+        std::unique_ptr<proto::FilePack> pack = std::make_unique<proto::FilePack>(source_pack);
+
+        for (int i = 0; i < pack->files_size(); ++i)
+        {
+            proto::FilePack::File* file = pack->mutable_files(i);
+            file->set_path(stream->pack[i].targetPath());
+            file->set_overwrite(stream->pack[i].overwrite());
+        }
+
+        stream->open_request = task_factory_target_->pack(std::move(pack), stream->id);
+        task_consumer_proxy_->doTask(stream->open_request);
     }
     else
     {
-        onError(Error::Type::OTHER, proto::FILE_ERROR_UNKNOWN);
+        onError(stream, Error::Type::OTHER, proto::FILE_ERROR_UNKNOWN);
     }
 }
 
 void FileTransfer::setAction(Error::Type error_type, Error::Action action)
+{
+    if (action == Error::ACTION_REPLACE_ALL || action == Error::ACTION_SKIP_ALL)
+        setActionForErrorType(error_type, action);
+
+    if (errors_.empty())
+        return;
+
+    Stream* stream = errors_.front().stream;
+    errors_.pop_front();
+
+    // While other errors wait for the user, their streams keep the transfer from finishing.
+    const bool has_errors = !errors_.empty();
+
+    doAction(stream, action);
+
+    if (has_errors && action != Error::ACTION_ABORT)
+        showNextError();
+}
+
+void FileTransfer::doAction(Stream* stream, Error::Action action)
 {
     switch (action)
     {
@@ -352,23 +544,15 @@ void FileTransfer::setAction(Error::Type error_type, Error::Action action)
 
         case Error::ACTION_REPLACE:
         case Error::ACTION_REPLACE_ALL:
-        {
-            if (action == Error::ACTION_REPLACE_ALL)
-                setActionForErrorType(error_type, action);
-
-            doFrontTask(true);
-        }
-        break;
+            DCHECK(stream);
+            doStreamTask(stream, true);
+            break;
 
         case Error::ACTION_SKIP:
         case Error::ACTION_SKIP_ALL:
-        {
-            if (action == Error::ACTION_SKIP_ALL)
-                setActionForErrorType(error_type, action);
-
-            doNextTask();
-        }
-        break;
+            DCHECK(stream);
+            doNextTask(stream);
+            break;
 
         default:
             NOTREACHED();
@@ -376,64 +560,470 @@ void FileTransfer::setAction(Error::Type error_type, Error::Action action)
     }
 }
 
-void FileTransfer::doFrontTask(bool overwrite)
+void FileTransfer::showNextError()
+{
+    while (!errors_.empty())
+    {
+        auto default_action = actions_.find(errors_.front().error.type());
+        if (default_action == actions_.end())
+        {
+            transfer_window_proxy_->errorOccurred(errors_.front().error);
+            return;
+        }
+
+        const Error::Action action = default_action->second;
+
+        Stream* stream = errors_.front().stream;
+        errors_.pop_front();
+
+        const bool has_errors = !errors_.empty();
+
+        doAction(stream, action);
+
+        if (!has_errors || action == Error::ACTION_ABORT)
+            return;
+    }
+}
+
+void FileTransfer::requestPackets(Stream* stream)
+{
+    if (stream->last_packet_requested)
+        return;
+
+    if (!stream->window_size &&
+        (!stream->source_packets.empty() || !stream->target_packets.empty()))
+    {
+        return;
+    }
+
+    if (is_canceled_)
+    {
+        // The source closes the file and replies with an empty last packet. The target deletes
+        // the incomplete file when it receives it.
+        stream->last_packet_requested = true;
+        sendPacketRequest(stream, proto::FilePacketRequest::CANCEL, 0);
+        return;
+    }
+
+    if (!stream->window_size)
+    {
+        // The peer of an older version does not know the packet size and uses the default one.
+        sendPacketRequest(stream, proto::FilePacketRequest::NO_FLAGS, 0);
+        return;
+    }
+
+    // The source sends packets of the requested size until the end of the file, so the request
+    // that gets the last packet is known in advance. A file of zero size has one empty packet.
+    do
+    {
+        stream->requested_size +=
+            std::min<uint64_t>(stream->packet_size, stream->file_size - stream->requested_size);
+
+        if (stream->requested_size >= stream->file_size)
+            stream->last_packet_requested = true;
+
+        stream->request_times.emplace_back(Clock::now());
+        sendPacketRequest(stream, proto::FilePacketRequest::NO_FLAGS, stream->packet_size);
+    }
+    while (!stream->last_packet_requested &&
+           stream->requested_size - stream->written_size < stream->window_size);
+}
+
+void FileTransfer::sendPacketRequest(Stream* stream, uint32_t flags, uint32_t packet_size)
+{
+    std::shared_ptr<common::FileTask> task =
+        task_factory_source_->packetRequest(flags, packet_size, stream->compression, stream->id);
+
+    stream->source_packets.emplace_back(task);
+    task_consumer_proxy_->doTask(std::move(task));
+}
+
+// static
+void FileTransfer::onPacketWritten(Stream* stream, uint32_t size)
+{
+    // The packet should take about this time at the speed of the transfer. Smaller packets spend
+    // more time on the framing, the encryption and the task switches than on the data.
+    static const Clock::duration kPacketDuration = std::chrono::milliseconds(10);
+
+    // The speed is measured over at least this time and at least two round trips.
+    static const Clock::duration kMinMeasureTime = std::chrono::milliseconds(20);
+
+    // The bytes in flight should make up at least this number of packets, so that the source
+    // always has a requested packet to send.
+    static const uint64_t kMinPacketsInFlight = 4;
+
+    const Clock::time_point now = Clock::now();
+
+    if (!stream->request_times.empty())
+    {
+        const Clock::duration rtt = now - stream->request_times.front();
+        stream->request_times.pop_front();
+
+        if (stream->rate_min_rtt == Clock::duration::zero() || rtt < stream->rate_min_rtt)
+            stream->rate_min_rtt = rtt;
+    }
+
+    if (stream->rate_start_time == Clock::time_point())
+    {
+        // The first packet of the file includes the time of opening the file.
+        stream->rate_start_time = now;
+        return;
+    }
+
+    stream->rate_bytes += size;
+
+    const Clock::duration elapsed = now - stream->rate_start_time;
+    if (elapsed < std::max(kMinMeasureTime, stream->rate_min_rtt * 2))
+        return;
+
+    const double bytes_per_second =
+        static_cast<double>(stream->rate_bytes) / std::chrono::duration<double>(elapsed).count();
+
+    uint64_t target_size = static_cast<uint64_t>(
+        bytes_per_second * std::chrono::duration<double>(kPacketDuration).count());
+
+    // The bandwidth-delay product is limited by the window.
+    uint64_t bytes_in_flight = stream->window_size;
+    if (stream->rate_min_rtt != Clock::duration::zero())
+    {
+        bytes_in_flight = std::min(bytes_in_flight, static_cast<uint64_t>(
+            bytes_per_second * std::chrono::duration<double>(stream->rate_min_rtt).count()));
+    }
+
+    target_size = std::min(target_size, bytes_in_flight / kMinPacketsInFlight);
+
+    // The size grows to the target at once, so that a fast transfer reaches large packets in a
+    // few measurements, and shrinks by half per measurement, so that a single slow measurement
+    // does not throw it back. Sizes are powers of two and the gap between the thresholds keeps
+    // the size from oscillating between two neighbors.
+    while (target_size >= static_cast<uint64_t>(stream->packet_size) * 2 &&
+           stream->packet_size < common::kMaxFilePacketSize)
+    {
+        stream->packet_size *= 2;
+    }
+
+    if (target_size < stream->packet_size / 2)
+        stream->packet_size = std::max(stream->packet_size / 2, common::kMinFilePacketSize);
+
+    stream->rate_start_time = now;
+    stream->rate_bytes = 0;
+    stream->rate_min_rtt = Clock::duration::zero();
+}
+
+void FileTransfer::addProgress(Stream* stream, int64_t size)
+{
+    const int64_t full_task_size = taskSize(*stream);
+    if (!full_task_size || !total_size_)
+        return;
+
+    stream->transfered_size += size;
+
+    if (stream->transfered_size > full_task_size)
+    {
+        // The file has grown since the queue was built.
+        size -= stream->transfered_size - full_task_size;
+        stream->transfered_size = full_task_size;
+    }
+
+    total_transfered_size_ += size;
+
+    const int total_percentage = static_cast<int>(total_transfered_size_ * 100 / total_size_);
+    int task_percentage = task_percentage_;
+
+    if (stream == current_stream_)
+        task_percentage = static_cast<int>(stream->transfered_size * 100 / full_task_size);
+
+    if (task_percentage != task_percentage_ || total_percentage != total_percentage_)
+    {
+        task_percentage_ = task_percentage;
+        total_percentage_ = total_percentage;
+
+        transfer_window_proxy_->setCurrentProgress(total_percentage_, task_percentage_);
+
+        if (compression_statistics_.original_size)
+            transfer_window_proxy_->setCompressionStatistics(compression_statistics_);
+    }
+}
+
+// static
+uint64_t FileTransfer::packetFileSize(const proto::FilePacket& packet)
+{
+    uint64_t size = packet.data().size();
+    if (packet.compression() != proto::FILE_COMPRESSION_NONE)
+        size = packet.original_size();
+
+    for (const auto& operation : packet.operations())
+        size += operation.copy_size();
+
+    return size;
+}
+
+// static
+int64_t FileTransfer::taskSize(const Stream& stream)
 {
+    if (stream.pack.empty())
+        return stream.task->size();
+
+    int64_t size = 0;
+
+    for (const auto& task : stream.pack)
+        size += task.size();
+
+    return size;
+}
+
+void FileTransfer::addCompressionStatistics(uint32_t original_size, size_t compressed_size,
+                                            uint32_t compress_time)
+{
+    compression_statistics_.original_size += original_size;
+    compression_statistics_.compressed_size += compressed_size;
+    compression_statistics_.compress_time += std::chrono::microseconds(compress_time);
+}
+
+void FileTransfer::updateCurrentItem()
+{
+    Stream* oldest_stream = nullptr;
+
+    for (const auto& stream : streams_)
+    {
+        if (stream->task && (!oldest_stream || stream->sequence < oldest_stream->sequence))
+            oldest_stream = stream.get();
+    }
+
+    if (oldest_stream == current_stream_)
+        return;
+
+    current_stream_ = oldest_stream;
+    if (!current_stream_)
+        return;
+
+    const Task& task = *current_stream_->task;
+    transfer_window_proxy_->setCurrentItem(task.sourcePath(), task.targetPath());
+
+    // Other files are transferred at the same time, so the new current file may be partially
+    // transferred.
+    const int64_t task_size = taskSize(*current_stream_);
+
     task_percentage_ = 0;
-    task_transfered_size_ = 0;
+    if (task_size)
+        task_percentage_ = static_cast<int>(current_stream_->transfered_size * 100 / task_size);
 
-    Task& front_task = frontTask();
-    front_task.setOverwrite(overwrite);
+    transfer_window_proxy_->setCurrentProgress(total_percentage_, task_percentage_);
+}
 
-    transfer_window_proxy_->setCurrentItem(front_task.sourcePath(), front_task.targetPath());
+// static
+void FileTransfer::resetPackets(Stream* stream)
+{
+    stream->source_packets.clear();
+    stream->target_packets.clear();
+
+    stream->source_window_size = 0;
+    stream->window_size = 0;
+    stream->compression = proto::FILE_COMPRESSION_NONE;
+    stream->delta = false;
+    stream->file_size = 0;
+    stream->requested_size = 0;
+    stream->written_size = 0;
+    stream->last_packet_requested = false;
+
+    stream->request_times.clear();
+    stream->rate_start_time = Clock::time_point();
+    stream->rate_bytes = 0;
+    stream->rate_min_rtt = Clock::duration::zero();
+}
+
+void FileTransfer::takeQueue()
+{
+    TaskList tasks = queue_builder_->takeQueue();
 
-    if (front_task.isDirectory())
+    for (auto& task : tasks)
+        tasks_.emplace_back(std::move(task));
+
+    total_size_ = queue_builder_->totalSize();
+}
+
+bool FileTransfer::hasActiveStreams() const
+{
+    for (const auto& stream : streams_)
     {
-        task_consumer_proxy_->doTask(
-            task_factory_target_->createDirectory(front_task.targetPath()));
+        if (stream->task)
+            return true;
     }
-    else
+
+    return false;
+}
+
+size_t FileTransfer::streamLimit() const
+{
+    size_t limit = max_stream_count_;
+
+    limit = std::min<size_t>(limit, std::max<uint32_t>(source_stream_count_, 1));
+    limit = std::min<size_t>(limit, std::max<uint32_t>(target_stream_count_, 1));
+
+    return limit;
+}
+
+void FileTransfer::startStreams()
+{
+    const size_t limit = std::min(streamLimit(), streams_.size());
+
+    // The limit only grows, so the streams beyond it are always idle.
+    for (size_t i = 0; i < limit && !tasks_.empty() && !is_canceled_; ++i)
     {
-        task_consumer_proxy_->doTask(
-            task_factory_source_->download(front_task.sourcePath()));
+        Stream* stream = streams_[i].get();
+        if (stream->task)
+            continue;
+
+        stream->task.emplace(std::move(tasks_.front()));
+        stream->sequence = next_sequence_++;
+        tasks_.pop_front();
+
+        if (isPackable(*stream->task))
+            doPackTask(stream);
+        else
+            doStreamTask(stream, false);
     }
+
+    updateCurrentItem();
 }
 
-void FileTransfer::doNextTask()
+bool FileTransfer::isPackable(const Task& task) const
 {
-    if (is_canceled_)
+    if (!source_packing_ || !target_packing_ || task.isDirectory())
+        return false;
+
+    return task.size() >= 0 && static_cast<uint64_t>(task.size()) <= common::kMaxPackedFileSize;
+}
+
+void FileTransfer::doStreamTask(Stream* stream, bool overwrite)
+{
+    resetPackets(stream);
+    stream->transfered_size = 0;
+
+    Task& task = *stream->task;
+    task.setOverwrite(overwrite);
+
+    if (task.isDirectory())
+    {
+        // The target executes the requests in order, so the files of the directory can be
+        // opened before the reply comes.
+        stream->open_request = task_factory_target_->createDirectory(task.targetPath());
+    }
+    else
     {
-        while (!tasks_.empty())
-            tasks_.pop_front();
+        stream->open_request = task_factory_source_->download(
+            task.sourcePath(), common::kMaxFileWindowSize, stream->id);
     }
 
-    if (!tasks_.empty())
+    task_consumer_proxy_->doTask(stream->open_request);
+}
+
+void FileTransfer::doPackTask(Stream* stream)
+{
+    resetPackets(stream);
+    stream->transfered_size = 0;
+
+    stream->pack.emplace_back(*stream->task);
+    uint64_t pack_size = static_cast<uint64_t>(stream->task->size());
+
+    // The directories stop the pack, so that the files are created after their directories.
+    while (!tasks_.empty() && stream->pack.size() < common::kMaxFilePackCount &&
+           isPackable(tasks_.front()) &&
+           pack_size + static_cast<uint64_t>(tasks_.front().size()) <= common::kMaxFilePackSize)
     {
-        // Delete the task only after confirmation of its successful execution.
+        pack_size += static_cast<uint64_t>(tasks_.front().size());
+
+        stream->pack.emplace_back(std::move(tasks_.front()));
         tasks_.pop_front();
     }
 
-    if (tasks_.empty())
+    std::vector<std::string> paths;
+    paths.reserve(stream->pack.size());
+
+    for (const auto& task : stream->pack)
+        paths.emplace_back(task.sourcePath());
+
+    // The peers that support the packs also support the compression.
+    stream->open_request = task_factory_source_->packRequest(
+        paths, proto::FILE_COMPRESSION_ZSTD, stream->id);
+    task_consumer_proxy_->doTask(stream->open_request);
+}
+
+void FileTransfer::doNextTask(Stream* stream)
+{
+    // Delete the task only after confirmation of its successful execution.
+    resetPackets(stream);
+    stream->open_request.reset();
+    stream->task.reset();
+    stream->pack.clear();
+
+    if (is_canceled_)
     {
-        if (cancel_timer_.isActive())
-            cancel_timer_.stop();
+        tasks_.clear();
+        stream->unpacked.clear();
+    }
 
-        onFinished();
-        return;
+    TaskList repacked;
+
+    while (!stream->unpacked.empty())
+    {
+        UnpackedTask unpacked = std::move(stream->unpacked.front());
+        stream->unpacked.pop_front();
+
+        // The action chosen for all existing files applies to the rest of the pack at once.
+        if (unpacked.error_code == proto::FILE_ERROR_PATH_ALREADY_EXISTS)
+        {
+            auto action = actions_.find(Error::Type::ALREADY_EXISTS);
+            if (action != actions_.end())
+            {
+                if (action->second == Error::ACTION_SKIP_ALL)
+                    continue;
+
+                if (action->second == Error::ACTION_REPLACE_ALL)
+                {
+                    unpacked.task.setOverwrite(true);
+                    repacked.emplace_back(std::move(unpacked.task));
+                    continue;
+                }
+            }
+        }
+
+        stream->task.emplace(std::move(unpacked.task));
+        break;
     }
 
-    doFrontTask(false);
+    tasks_.insert(tasks_.begin(), std::make_move_iterator(repacked.begin()),
+                  std::make_move_iterator(repacked.end()));
+
+    if (stream->task)
+        doStreamTask(stream, false);
+
+    startStreams();
+
+    if (!tasks_.empty() || queue_builder_ || hasActiveStreams())
+        return;
+
+    if (cancel_timer_.isActive())
+        cancel_timer_.stop();
+
+    onFinished();
 }
 
-void FileTransfer::onError(Error::Type type, proto::FileError code, const std::string& path)
+void FileTransfer::onError(Stream* stream, Error::Type type, proto::FileError code,
+                           const std::string& path)
 {
     auto default_action = actions_.find(type);
     if (default_action != actions_.end())
     {
-        setAction(type, default_action->second);
+        doAction(stream, default_action->second);
         return;
     }
 
-    transfer_window_proxy_->errorOccurred(Error(type, code, path));
+    errors_.push_back(PendingError{ stream, Error(type, code, path) });
+
+    // The errors are shown one at a time.
+    if (errors_.size() == 1)
+        transfer_window_proxy_->errorOccurred(errors_.front().error);
 }
 
 void FileTransfer::onFinished()
@@ -443,6 +1033,10 @@ void FileTransfer::onFinished()
 
     if (callback)
     {
+        // The last packets may not have changed the percentage of the progress.
+        if (compression_statistics_.original_size)
+            transfer_window_proxy_->setCompressionStatistics(compression_statistics_);
+
         transfer_window_proxy_->stop();
         callback();
     }
@@ -484,6 +1078,7 @@ FileTransfer::Task::Task(Task&& other) noexcept
     : source_path_(std::move(other.source_path_)),
       target_path_(std::move(other.target_path_)),
       is_directory_(other.is_directory_),
+      overwrite_(other.overwrite_),
       size_(other.size_)
 {
     // Nothing
@@ -494,6 +1089,7 @@ FileTransfer::Task& FileTransfer::Task::operator=(Task&& other) noexcept
     source_path_ = std::move(other.source_path_);
     target_path_ = std::move(other.target_path_);
     is_directory_ = other.is_directory_;
+    overwrite_ = other.overwrite_;
     size_ = other.size_;
     return *this;
 }
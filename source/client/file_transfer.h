@@ -20,11 +20,14 @@
 #define CLIENT__FILE_TRANSFER_H
 
 #include "base/waitable_timer.h"
+#include "common/file_packet.h"
 #include "common/file_task.h"
 #include "common/file_task_producer.h"
 #include "proto/file_transfer.pb.h"
 
+#include <chrono>
 #include <deque>
+#include <optional>
 
 namespace base {
 class TaskRunner;
@@ -152,15 +155,34 @@ public:
         int64_t size_;
     };
 
+    // Statistics of the packets that the source has compressed.
+    struct CompressionStatistics
+    {
+        // Size of the data before and after the compression.
+        uint64_t original_size = 0;
+        uint64_t compressed_size = 0;
+
+        // Time that the source has spent on the compression.
+        std::chrono::microseconds compress_time = std::chrono::microseconds::zero();
+    };
+
     using TaskList = std::deque<Task>;
     using FinishCallback = std::function<void()>;
 
+    // Number of files transferred at the same time by default.
+    static const size_t kDefaultStreamCount = 4;
+
     FileTransfer(std::shared_ptr<base::TaskRunner> io_task_runner,
                  std::shared_ptr<FileTransferWindowProxy> transfer_window_proxy,
                  std::shared_ptr<common::FileTaskConsumerProxy> task_consumer_proxy,
                  Type type);
     ~FileTransfer();
 
+    // Sets the maximum number of files that are transferred at the same time. The number is also
+    // limited by the peers: a peer of an older version transfers one file at a time. Must be
+    // called before start().
+    void setMaxStreamCount(size_t count);
+
     void start(const std::string& source_path,
                const std::string& target_path,
                const std::vector<Item>& items,
@@ -174,13 +196,156 @@ protected:
     void onTaskDone(std::shared_ptr<common::FileTask> task) override;
 
 private:
-    Task& frontTask();
-    void targetReply(const proto::FileRequest& request, const proto::FileReply& reply);
-    void sourceReply(const proto::FileRequest& request, const proto::FileReply& reply);
-    void doFrontTask(bool overwrite);
-    void doNextTask();
-    void onError(Error::Type type, proto::FileError code, const std::string& path = std::string());
+    using FileTaskQueue = std::deque<std::shared_ptr<common::FileTask>>;
+    using Clock = std::chrono::steady_clock;
+
+    // File of a pack that was not transferred and the error of the source or the target.
+    struct UnpackedTask
+    {
+        Task task;
+        proto::FileError error_code;
+    };
+
+    // A task of the queue that is being executed. Each stream has its own open file on the
+    // source and on the target, so several files are transferred at the same time.
+    struct Stream
+    {
+        explicit Stream(uint32_t id)
+            : id(id)
+        {
+            // Nothing
+        }
+
+        const uint32_t id;
+
+        // The task being executed. Empty if the stream is idle.
+        std::optional<Task> task;
+
+        // Small files transferred in one pack (see proto::FilePackRequest). The first of them is
+        // the task of the stream.
+        TaskList pack;
+
+        // Files of the pack that were not transferred. The stream transfers them one at a time
+        // after the pack, so that their errors are handled as usual.
+        std::deque<UnpackedTask> unpacked;
+
+        // Order of the task in the queue.
+        uint64_t sequence = 0;
+
+        // Request to create the directory or to open the file that has not been answered yet.
+        std::shared_ptr<common::FileTask> open_request;
+
+        // Packet requests sent to the source and packets sent to the target that have not been
+        // answered yet. Each side answers in the order of the requests.
+        FileTaskQueue source_packets;
+        FileTaskQueue target_packets;
+
+        // Window accepted by the source for the current file. The window of the transfer is the
+        // smaller of the windows of the source and the target.
+        uint32_t source_window_size = 0;
+        uint32_t window_size = 0;
+
+        // Compression of the packets accepted by the target for the current file.
+        proto::FileCompression compression = proto::FILE_COMPRESSION_NONE;
+
+        // The current file is sent by the delta transfer if the target has a part of it.
+        bool delta = false;
+
+        uint64_t file_size = 0;
+        uint64_t requested_size = 0;
+        uint64_t written_size = 0;
+        bool last_packet_requested = false;
+
+        // Size of the packets requested in the windowed transfer. It is kept between files,
+        // because it depends on the connection rather than on the file.
+        uint32_t packet_size = common::kMinFilePacketSize;
+
+        // Times of the packet requests that have not been written by the target yet.
+        std::deque<Clock::time_point> request_times;
+
+        // Current measurement of the speed of the transfer.
+        Clock::time_point rate_start_time;
+        uint64_t rate_bytes = 0;
+        Clock::duration rate_min_rtt = Clock::duration::zero();
+
+        int64_t transfered_size = 0;
+    };
+
+    // Error waiting for the action of the user. |stream| is null for errors that do not belong
+    // to a task.
+    struct PendingError
+    {
+        Stream* stream;
+        Error error;
+    };
+
+    // Returns the stream that is waiting for the reply to |task| or null if the reply is not
+    // expected (the task of the stream was interrupted).
+    Stream* streamByTask(const common::FileTask& task);
+
+    void targetReply(Stream* stream, const common::FileTask& task);
+    void sourceReply(Stream* stream, const common::FileTask& task);
+
+    // Requests the next packets of the current file from the source. If both peers support the
+    // windowed transfer, packets are requested until |window_size| bytes are in flight.
+    // Otherwise, the next packet is requested after the target has written the previous one.
+    void requestPackets(Stream* stream);
+    void sendPacketRequest(Stream* stream, uint32_t flags, uint32_t packet_size);
+
+    // Called when the target has written a packet of |size| bytes in the windowed transfer.
+    // Measures the speed of the transfer and adapts the packet size of the stream to it.
+    static void onPacketWritten(Stream* stream, uint32_t size);
+
+    // Adds the written packet to the progress of the stream and of the whole transfer.
+    void addProgress(Stream* stream, int64_t size);
+
+    // Returns the size of the file data in the packet. Compressed data and copies of the blocks
+    // of the delta transfer are counted by their size in the file.
+    static uint64_t packetFileSize(const proto::FilePacket& packet);
+
+    // Returns the size of the files of the task or the pack of the stream.
+    static int64_t taskSize(const Stream& stream);
+
+    // Adds the compressed data to the statistics of the compression.
+    void addCompressionStatistics(uint32_t original_size, size_t compressed_size,
+                                  uint32_t compress_time);
+
+    // Shows the oldest task in progress as the current item.
+    void updateCurrentItem();
+
+    // Forgets the packets of the current file. Replies to them are ignored.
+    static void resetPackets(Stream* stream);
+
+    // Moves the tasks built so far from the queue builder to |tasks_|.
+    void takeQueue();
+
+    bool hasActiveStreams() const;
+
+    // Number of files that the source and the target can transfer at the same time.
+    size_t streamLimit() const;
+
+    // Starts the next tasks of the queue on idle streams up to the stream limit.
+    void startStreams();
+
+    // Returns true if the file of |task| can be transferred in a pack.
+    bool isPackable(const Task& task) const;
+
+    void doStreamTask(Stream* stream, bool overwrite);
+
+    // Transfers the task of the stream in a pack together with the next small files of the queue.
+    void doPackTask(Stream* stream);
+    void doNextTask(Stream* stream);
+    void onError(Stream* stream, Error::Type type, proto::FileError code,
+                 const std::string& path = std::string());
     void setActionForErrorType(Error::Type error_type, Error::Action action);
+
+    // Applies |action| to the error of |stream|.
+    void doAction(Stream* stream, Error::Action action);
+
+    // Shows the first error of the queue to the user or applies the action chosen earlier for
+    // its type.
+    void showNextError();
+
     void onFinished();
 
     std::shared_ptr<base::TaskRunner> io_task_runner_;
@@ -195,19 +360,38 @@ private:
 
     // The map contains available actions for the error and the current action.
     std::map<Error::Type, Error::Action> actions_;
+    std::deque<PendingError> errors_;
     std::unique_ptr<FileTransferQueueBuilder> queue_builder_;
     TaskList tasks_;
     const Type type_;
 
     FinishCallback finish_callback_;
 
+    size_t max_stream_count_ = kDefaultStreamCount;
+    std::vector<std::unique_ptr<Stream>> streams_;
+    uint64_t next_sequence_ = 0;
+
+    // Number of streams supported by the source and by the target. They become known from the
+    // replies to the first opened file. Zero means one stream.
+    uint32_t source_stream_count_ = 0;
+    uint32_t target_stream_count_ = 0;
+
+    // The source and the target support the packs of small files. They become known from the
+    // replies to the first opened file.
+    bool source_packing_ = false;
+    bool target_packing_ = false;
+
+    // Stream whose task is shown as the current item.
+    Stream* current_stream_ = nullptr;
+
     int64_t total_size_ = 0;
     int64_t total_transfered_size_ = 0;
-    int64_t task_transfered_size_ = 0;
 
     int total_percentage_ = 0;
     int task_percentage_ = 0;
 
+    CompressionStatistics compression_statistics_;
+
     bool is_canceled_ = false;
 
     DISALLOW_COPY_AND_ASSIGN(FileTransfer);
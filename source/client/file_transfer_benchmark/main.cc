@@ -0,0 +1,1085 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "base/command_line.h"
+#include "base/logging.h"
+#include "base/sys_info.h"
+#include "base/task_runner.h"
+#include "base/crypto/message_decryptor_openssl.h"
+#include "base/crypto/message_encryptor_openssl.h"
+#include "base/crypto/random.h"
+#include "base/files/file_util.h"
+#include "base/message_loop/message_loop.h"
+#include "base/net/network_channel.h"
+#include "base/net/network_server.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/threading/thread_pool.h"
+#include "build/build_config.h"
+#include "client/file_transfer.h"
+#include "client/file_transfer_proxy.h"
+#include "client/file_transfer_window.h"
+#include "client/file_transfer_window_proxy.h"
+#include "common/file_task.h"
+#include "common/file_task_consumer.h"
+#include "common/file_task_consumer_proxy.h"
+#include "common/file_task_producer.h"
+#include "common/file_task_producer_proxy.h"
+#include "common/file_worker.h"
+#include "proto/file_transfer.pb.h"
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+#if defined(OS_WIN)
+#include <Windows.h>
+#include <psapi.h>
+#endif // defined(OS_WIN)
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using TimePoint = Clock::time_point;
+using Seconds = std::chrono::duration<double>;
+
+const double kMegabyte = 1024.0 * 1024.0;
+const double kGigabyte = 1024.0 * 1024.0 * 1024.0;
+
+// Size of the buffer in which the files are generated and compared.
+const size_t kChunkSize = 1024 * 1024;
+
+// Both peers use the same random session key, so the channels are encrypted like the channels of
+// an authenticated session without the key exchange.
+const base::ByteArray kSessionKey = base::Random::byteArray(32);
+const base::ByteArray kClientIv = base::Random::byteArray(12);
+const base::ByteArray kHostIv = base::Random::byteArray(12);
+
+enum class Encryption
+{
+    NONE,
+    AES256_GCM,
+    CHACHA20_POLY1305
+};
+
+struct Options
+{
+    uint16_t port = 18050;
+    std::filesystem::path work_dir;
+    bool upload = false;
+    int stream_count = static_cast<int>(client::FileTransfer::kDefaultStreamCount);
+    Encryption encryption = Encryption::AES256_GCM;
+
+    // Link between the client and the host (see Shaper).
+    std::chrono::milliseconds rtt{ 0 };
+    int64_t bandwidth = 0; // Bits per second, zero if the bandwidth is not limited.
+
+    bool huge = true;
+    bool tiny = true;
+    bool tree = true;
+
+    int huge_size = 1024; // MB
+    int tiny_count = 100000;
+    int tiny_size = 1024;
+    int tree_depth = 32;
+    int tree_files = 16;
+    bool compressible = false;
+};
+
+// Returns the peak resident memory of the process in bytes or zero if it is unknown.
+int64_t peakMemory()
+{
+#if defined(OS_WIN)
+    PROCESS_MEMORY_COUNTERS counters;
+    memset(&counters, 0, sizeof(counters));
+
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+
+    return static_cast<int64_t>(counters.PeakWorkingSetSize);
+#elif defined(OS_LINUX)
+    std::ifstream status("/proc/self/status");
+    std::string line;
+
+    while (std::getline(status, line))
+    {
+        if (line.rfind("VmHWM:", 0) != 0)
+            continue;
+
+        std::istringstream stream(line.substr(6));
+        int64_t kilobytes = 0;
+        if (!(stream >> kilobytes))
+            return 0;
+
+        return kilobytes * 1024;
+    }
+
+    return 0;
+#else
+    return 0;
+#endif
+}
+
+// Starts a new measurement of the peak memory. On other platforms than Linux the peak memory of
+// a scenario includes the previous scenarios.
+void resetPeakMemory()
+{
+#if defined(OS_LINUX)
+    std::ofstream("/proc/self/clear_refs") << "5";
+#endif // defined(OS_LINUX)
+}
+
+// Fills |buffer| with random data or with text that compresses about as well as source code.
+void fillBuffer(bool compressible, std::mt19937_64* random, std::string* buffer)
+{
+    if (!compressible)
+    {
+        base::Random::fillBuffer(buffer->data(), buffer->size());
+        return;
+    }
+
+    static const char* const kWords[] =
+    {
+        "file", "transfer", "const", "std::string", "return", "if", "else", "while", "for",
+        "void", "int64_t", "uint32_t", "stream", "packet", "request", "reply", "->", "=", "(",
+        ")", ";", "{", "}", "\n", "\n    ", "\n        "
+    };
+
+    std::uniform_int_distribution<size_t> distribution(0, std::size(kWords) - 1);
+    size_t offset = 0;
+
+    while (offset < buffer->size())
+    {
+        const char* word = kWords[distribution(*random)];
+
+        for (; *word && offset < buffer->size(); ++word, ++offset)
+            (*buffer)[offset] = *word;
+
+        if (offset < buffer->size())
+            (*buffer)[offset++] = ' ';
+    }
+}
+
+bool writeFile(const std::filesystem::path& path, int64_t size, bool compressible,
+               std::mt19937_64* random)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    std::string buffer;
+
+    while (file && size > 0)
+    {
+        buffer.resize(static_cast<size_t>(std::min<int64_t>(size, kChunkSize)));
+        fillBuffer(compressible, random, &buffer);
+
+        file.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        size -= static_cast<int64_t>(buffer.size());
+    }
+
+    return static_cast<bool>(file);
+}
+
+bool isSameFile(const std::filesystem::path& first_path, const std::filesystem::path& second_path)
+{
+    std::ifstream first(first_path, std::ios::binary);
+    std::ifstream second(second_path, std::ios::binary);
+
+    if (!first || !second)
+        return false;
+
+    std::string first_buffer(kChunkSize, 0);
+    std::string second_buffer(kChunkSize, 0);
+
+    while (first && second)
+    {
+        first.read(first_buffer.data(), static_cast<std::streamsize>(first_buffer.size()));
+        second.read(second_buffer.data(), static_cast<std::streamsize>(second_buffer.size()));
+
+        if (first.gcount() != second.gcount() ||
+            memcmp(first_buffer.data(), second_buffer.data(),
+                   static_cast<size_t>(first.gcount())) != 0)
+        {
+            return false;
+        }
+    }
+
+    return first.eof() && second.eof();
+}
+
+double megabytes(int64_t bytes)
+{
+    return static_cast<double>(bytes) / kMegabyte;
+}
+
+void setEncryption(base::NetworkChannel* channel, Encryption encryption, bool is_host)
+{
+    const base::ByteArray& encrypt_iv = is_host ? kHostIv : kClientIv;
+    const base::ByteArray& decrypt_iv = is_host ? kClientIv : kHostIv;
+
+    switch (encryption)
+    {
+        case Encryption::AES256_GCM:
+        {
+            channel->setEncryptor(
+                base::MessageEncryptorOpenssl::createForAes256Gcm(kSessionKey, encrypt_iv));
+            channel->setDecryptor(
+                base::MessageDecryptorOpenssl::createForAes256Gcm(kSessionKey, decrypt_iv));
+        }
+        break;
+
+        case Encryption::CHACHA20_POLY1305:
+        {
+            channel->setEncryptor(
+                base::MessageEncryptorOpenssl::createForChaCha20Poly1305(kSessionKey, encrypt_iv));
+            channel->setDecryptor(
+                base::MessageDecryptorOpenssl::createForChaCha20Poly1305(kSessionKey, decrypt_iv));
+        }
+        break;
+
+        default:
+            break;
+    }
+}
+
+//
+// Delays the outgoing messages of a channel as a link with the specified round trip time and
+// bandwidth would. A message leaves when the link has passed the previous messages and all bytes
+// of the message, and arrives half of the round trip time later. The order of the messages is
+// kept.
+//
+class Shaper
+{
+public:
+    Shaper(std::shared_ptr<base::TaskRunner> task_runner,
+           base::NetworkChannel* channel,
+           const Options& options)
+        : task_runner_(std::move(task_runner)),
+          channel_(channel),
+          delay_(std::chrono::duration_cast<Clock::duration>(options.rtt) / 2),
+          bandwidth_(options.bandwidth)
+    {
+        // Nothing
+    }
+
+    ~Shaper()
+    {
+        if (timer_id_)
+            task_runner_->cancelDelayedTask(timer_id_);
+    }
+
+    void send(base::ByteArray&& buffer)
+    {
+        if (delay_ == Clock::duration::zero() && !bandwidth_)
+        {
+            channel_->send(std::move(buffer));
+            return;
+        }
+
+        TimePoint departure = std::max(Clock::now(), last_departure_);
+
+        if (bandwidth_)
+        {
+            departure += std::chrono::microseconds(
+                static_cast<int64_t>(buffer.size()) * 8 * 1000000 / bandwidth_);
+        }
+
+        last_departure_ = departure;
+        queue_.emplace_back(Message{ departure + delay_, std::move(buffer) });
+
+        if (queue_.size() == 1)
+            schedule();
+    }
+
+private:
+    struct Message
+    {
+        TimePoint arrival;
+        base::ByteArray buffer;
+    };
+
+    void schedule()
+    {
+        auto delay = std::chrono::ceil<std::chrono::milliseconds>(
+            queue_.front().arrival - Clock::now());
+
+        // The timer is cancelled in the destructor, so it never runs for a destroyed shaper.
+        timer_id_ = task_runner_->postCancelableDelayedTask(
+            std::bind(&Shaper::onTimer, this), std::max(delay, std::chrono::milliseconds::zero()));
+    }
+
+    void onTimer()
+    {
+        timer_id_ = 0;
+
+        TimePoint now = Clock::now();
+
+        while (!queue_.empty() && queue_.front().arrival <= now)
+        {
+            channel_->send(std::move(queue_.front().buffer));
+            queue_.pop_front();
+        }
+
+        if (!queue_.empty())
+            schedule();
+    }
+
+    std::shared_ptr<base::TaskRunner> task_runner_;
+    base::NetworkChannel* const channel_;
+    const Clock::duration delay_;
+    const int64_t bandwidth_;
+
+    std::deque<Message> queue_;
+    TimePoint last_departure_;
+    base::TaskRunner::DelayedTaskId timer_id_ = 0;
+
+    DISALLOW_COPY_AND_ASSIGN(Shaper);
+};
+
+//
+// Host side of the file transfer. Executes the requests of the client with its own FileWorker
+// like the file transfer session of the host does.
+//
+class Host
+    : public base::NetworkServer::Delegate,
+      public base::NetworkChannel::Listener,
+      public common::FileTaskProducer
+{
+public:
+    Host(std::shared_ptr<base::TaskRunner> task_runner, const Options& options)
+        : task_runner_(task_runner),
+          options_(options),
+          producer_proxy_(std::make_shared<common::FileTaskProducerProxy>(this)),
+          io_pool_(std::make_unique<base::ThreadPool>(common::FileWorker::kIoThreadCount))
+    {
+        io_pool_->start();
+
+        std::vector<std::shared_ptr<base::TaskRunner>> io_task_runners;
+        io_task_runners.emplace_back(io_pool_->taskRunner());
+
+        worker_ = std::make_unique<common::FileWorker>(task_runner, io_task_runners);
+    }
+
+    ~Host() override
+    {
+        producer_proxy_->dettach();
+    }
+
+    void start()
+    {
+        server_.start(options_.port, this);
+    }
+
+protected:
+    // base::NetworkServer::Delegate implementation.
+    void onNewConnection(std::unique_ptr<base::NetworkChannel> channel) override
+    {
+        // The benchmark has only one client.
+        if (channel_)
+            return;
+
+        channel_ = std::move(channel);
+        channel_->setListener(this);
+        channel_->setNoDelay(true);
+        setEncryption(channel_.get(), options_.encryption, true);
+        channel_->resume();
+
+        shaper_ = std::make_unique<Shaper>(task_runner_, channel_.get(), options_);
+    }
+
+    // base::NetworkChannel::Listener implementation.
+    void onConnected() override
+    {
+        NOTREACHED();
+    }
+
+    void onDisconnected(base::NetworkChannel::ErrorCode /* error_code */) override
+    {
+        // The client reports the error.
+    }
+
+    void onMessageReceived(const base::ByteArray& buffer) override
+    {
+        std::unique_ptr<proto::FileRequest> request = std::make_unique<proto::FileRequest>();
+
+        if (!base::parse(buffer, request.get()))
+        {
+            LOG(LS_ERROR) << "Invalid message from client";
+            return;
+        }
+
+        worker_->doTask(std::make_shared<common::FileTask>(
+            producer_proxy_, std::move(request), common::FileTask::Target::LOCAL));
+    }
+
+    void onMessageWritten(size_t /* pending */) override
+    {
+        // Nothing
+    }
+
+    // common::FileTaskProducer implementation.
+    void onTaskDone(std::shared_ptr<common::FileTask> task) override
+    {
+        if (shaper_)
+            shaper_->send(base::serialize(task->reply()));
+    }
+
+private:
+    std::shared_ptr<base::TaskRunner> task_runner_;
+    const Options& options_;
+    std::shared_ptr<common::FileTaskProducerProxy> producer_proxy_;
+    std::unique_ptr<base::ThreadPool> io_pool_;
+    std::unique_ptr<common::FileWorker> worker_;
+    base::NetworkServer server_;
+    std::unique_ptr<base::NetworkChannel> channel_;
+    std::unique_ptr<Shaper> shaper_;
+
+    DISALLOW_COPY_AND_ASSIGN(Host);
+};
+
+class Benchmark;
+
+//
+// Client side of the file transfer. Executes the local tasks of FileTransfer and sends the remote
+// tasks to the host like ClientFileTransfer does.
+//
+class Client
+    : public base::NetworkChannel::Listener,
+      public common::FileTaskConsumer
+{
+public:
+    Client(std::shared_ptr<base::TaskRunner> task_runner,
+           const Options& options,
+           Benchmark* benchmark);
+    ~Client() override;
+
+    void connect();
+
+    std::shared_ptr<common::FileTaskConsumerProxy> taskConsumerProxy() const
+    {
+        return consumer_proxy_;
+    }
+
+    int64_t totalRx() const { return channel_ ? channel_->totalRx() : 0; }
+    int64_t totalTx() const { return channel_ ? channel_->totalTx() : 0; }
+
+protected:
+    // base::NetworkChannel::Listener implementation.
+    void onConnected() override;
+    void onDisconnected(base::NetworkChannel::ErrorCode error_code) override;
+    void onMessageReceived(const base::ByteArray& buffer) override;
+    void onMessageWritten(size_t pending) override;
+
+    // common::FileTaskConsumer implementation.
+    void doTask(std::shared_ptr<common::FileTask> task) override;
+
+private:
+    std::shared_ptr<base::TaskRunner> task_runner_;
+    const Options& options_;
+    Benchmark* const benchmark_;
+    std::shared_ptr<common::FileTaskConsumerProxy> consumer_proxy_;
+    std::unique_ptr<base::ThreadPool> io_pool_;
+    std::unique_ptr<common::FileWorker> worker_;
+    std::unique_ptr<base::NetworkChannel> channel_;
+    std::unique_ptr<Shaper> shaper_;
+    std::deque<std::shared_ptr<common::FileTask>> remote_task_queue_;
+
+    DISALLOW_COPY_AND_ASSIGN(Client);
+};
+
+//
+// Benchmark of the file transfer. The client and the host run in the same process and are
+// connected with real channels over the loopback interface. The messages of both peers pass
+// through a Shaper, so the transfer behaves like a transfer over a slower link.
+// The scenarios are run one after another:
+// 1. "huge": one file of |huge_size| MB.
+// 2. "tiny": |tiny_count| files of |tiny_size| bytes in directories of 1000 files.
+// 3. "tree": a chain of |tree_depth| nested directories with |tree_files| files of different
+//    sizes at each level.
+// The source files are generated before each scenario and are not included in the measurement.
+// After each scenario the copies are compared with the source files and the throughput, the CPU
+// time of the process (both peers) per GB and the peak memory are reported.
+//
+class Benchmark : public client::FileTransferWindow
+{
+public:
+    Benchmark(std::shared_ptr<base::TaskRunner> task_runner, const Options& options)
+        : task_runner_(task_runner),
+          options_(options),
+          window_proxy_(std::make_shared<client::FileTransferWindowProxy>(task_runner, this)),
+          host_(task_runner, options),
+          client_(task_runner, options, this),
+          random_(std::random_device()())
+    {
+        if (options_.huge)
+            scenarios_.emplace_back("huge");
+        if (options_.tiny)
+            scenarios_.emplace_back("tiny");
+        if (options_.tree)
+            scenarios_.emplace_back("tree");
+    }
+
+    ~Benchmark() override
+    {
+        window_proxy_->dettach();
+    }
+
+    void run()
+    {
+        std::cout << "Link: RTT " << options_.rtt.count() << " ms, bandwidth ";
+        if (options_.bandwidth)
+            std::cout << options_.bandwidth / 1000000 << " Mbit/s";
+        else
+            std::cout << "unlimited";
+        std::cout << ", " << (options_.upload ? "upload" : "download") << ", "
+                  << options_.stream_count << " streams" << std::endl;
+
+        host_.start();
+        client_.connect();
+    }
+
+    bool isSucceeded() const { return succeeded_; }
+
+    void onConnected()
+    {
+        runNextScenario();
+    }
+
+    void onDisconnected(base::NetworkChannel::ErrorCode error_code)
+    {
+        std::cout << "Connection error: " << base::NetworkChannel::errorToString(error_code)
+                  << std::endl;
+
+        succeeded_ = false;
+        task_runner_->postQuit();
+    }
+
+protected:
+    // client::FileTransferWindow implementation.
+    void start(std::shared_ptr<client::FileTransferProxy> transfer_proxy) override
+    {
+        transfer_proxy_ = std::move(transfer_proxy);
+    }
+
+    void stop() override
+    {
+        // Nothing
+    }
+
+    void setCurrentItem(const std::string& /* source_path */,
+                        const std::string& /* target_path */) override
+    {
+        // Nothing
+    }
+
+    void setCurrentProgress(int /* total */, int /* current */) override
+    {
+        // Nothing
+    }
+
+    void setCompressionStatistics(
+        const client::FileTransfer::CompressionStatistics& statistics) override
+    {
+        compression_ = statistics;
+    }
+
+    void errorOccurred(const client::FileTransfer::Error& error) override
+    {
+        std::cout << "Transfer error " << error.code() << ": " << error.path() << std::endl;
+
+        scenario_failed_ = true;
+        transfer_proxy_->setAction(error.type(), client::FileTransfer::Error::ACTION_ABORT);
+    }
+
+private:
+    struct Measurement
+    {
+        TimePoint time;
+        std::chrono::microseconds cpu_time = std::chrono::microseconds::zero();
+        int64_t tx = 0;
+        int64_t rx = 0;
+    };
+
+    std::filesystem::path sourcePath() const { return options_.work_dir / "source"; }
+    std::filesystem::path targetPath() const { return options_.work_dir / "target"; }
+
+    Measurement measure() const
+    {
+        return Measurement{ Clock::now(), base::SysInfo::processCpuTime(),
+                            client_.totalTx(), client_.totalRx() };
+    }
+
+    bool createFile(const std::filesystem::path& path, int64_t size)
+    {
+        if (!writeFile(path, size, options_.compressible, &random_))
+        {
+            std::cout << "Unable to create " << path << std::endl;
+            return false;
+        }
+
+        ++file_count_;
+        total_size_ += size;
+        return true;
+    }
+
+    bool createDirectory(const std::filesystem::path& path)
+    {
+        std::error_code error_code;
+        std::filesystem::create_directories(path, error_code);
+
+        if (error_code)
+        {
+            std::cout << "Unable to create " << path << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+
+    // Generates the source files of the scenario and returns the items to transfer.
+    bool prepare(const std::string& scenario, std::vector<client::FileTransfer::Item>* items)
+    {
+        std::error_code ignored_code;
+        std::filesystem::remove_all(options_.work_dir, ignored_code);
+
+        if (!createDirectory(sourcePath()) || !createDirectory(targetPath()))
+            return false;
+
+        file_count_ = 0;
+        total_size_ = 0;
+
+        if (scenario == "huge")
+        {
+            const int64_t size = static_cast<int64_t>(options_.huge_size) * 1024 * 1024;
+
+            if (!createFile(sourcePath() / "huge.bin", size))
+                return false;
+
+            items->emplace_back("huge.bin", size, false);
+        }
+        else if (scenario == "tiny")
+        {
+            static const int kFilesPerDirectory = 1000;
+
+            std::filesystem::path directory;
+
+            for (int i = 0; i < options_.tiny_count; ++i)
+            {
+                if (i % kFilesPerDirectory == 0)
+                {
+                    directory = sourcePath() / "tiny" / ("d" + std::to_string(i));
+                    if (!createDirectory(directory))
+                        return false;
+                }
+
+                if (!createFile(directory / ("f" + std::to_string(i)), options_.tiny_size))
+                    return false;
+            }
+
+            items->emplace_back("tiny", 0, true);
+        }
+        else
+        {
+            DCHECK_EQ(scenario, "tree");
+
+            // Most files are packed, some of them are transferred in packets.
+            std::uniform_int_distribution<int64_t> small_size(0, 64 * 1024);
+            std::uniform_int_distribution<int64_t> large_size(64 * 1024, 1024 * 1024);
+
+            std::filesystem::path directory = sourcePath() / "tree";
+
+            for (int level = 0; level < options_.tree_depth; ++level)
+            {
+                directory /= "d" + std::to_string(level);
+                if (!createDirectory(directory))
+                    return false;
+
+                for (int i = 0; i < options_.tree_files; ++i)
+                {
+                    int64_t size = (i % 4) ? small_size(random_) : large_size(random_);
+                    if (!createFile(directory / ("f" + std::to_string(i)), size))
+                        return false;
+                }
+            }
+
+            items->emplace_back("tree", 0, true);
+        }
+
+        return true;
+    }
+
+    // Compares the copies with the source files.
+    bool verify() const
+    {
+        std::error_code error_code;
+        int64_t file_count = 0;
+
+        for (const auto& entry :
+                 std::filesystem::recursive_directory_iterator(sourcePath(), error_code))
+        {
+            if (!entry.is_regular_file())
+                continue;
+
+            std::filesystem::path target_path =
+                targetPath() / std::filesystem::relative(entry.path(), sourcePath());
+
+            if (!isSameFile(entry.path(), target_path))
+            {
+                std::cout << "Copy differs from the source: " << target_path << std::endl;
+                return false;
+            }
+
+            ++file_count;
+        }
+
+        return !error_code && file_count == file_count_;
+    }
+
+    void runNextScenario()
+    {
+        if (scenarios_.empty())
+        {
+            std::error_code ignored_code;
+            std::filesystem::remove_all(options_.work_dir, ignored_code);
+
+            task_runner_->postQuit();
+            return;
+        }
+
+        std::string scenario = std::move(scenarios_.front());
+        scenarios_.pop_front();
+
+        std::vector<client::FileTransfer::Item> items;
+        if (!prepare(scenario, &items))
+        {
+            succeeded_ = false;
+            task_runner_->postQuit();
+            return;
+        }
+
+        std::cout << std::endl << "Scenario: " << scenario << " (" << file_count_ << " files, "
+                  << std::fixed << std::setprecision(1) << megabytes(total_size_) << " MB)"
+                  << std::endl;
+
+        scenario_failed_ = false;
+        compression_ = client::FileTransfer::CompressionStatistics();
+
+        resetPeakMemory();
+        start_ = measure();
+
+        transfer_ = std::make_unique<client::FileTransfer>(
+            task_runner_, window_proxy_, client_.taskConsumerProxy(),
+            options_.upload ? client::FileTransfer::Type::UPLOADER :
+                              client::FileTransfer::Type::DOWNLOADER);
+        transfer_->setMaxStreamCount(static_cast<size_t>(options_.stream_count));
+
+        transfer_->start(base::utf8FromFilePath(sourcePath()),
+                         base::utf8FromFilePath(targetPath()),
+                         items,
+                         std::bind(&Benchmark::onScenarioFinished, this));
+    }
+
+    void onScenarioFinished()
+    {
+        Measurement finish = measure();
+        int64_t peak_memory = peakMemory();
+
+        // The transfer is calling this function.
+        task_runner_->deleteSoon(std::move(transfer_));
+
+        double seconds = std::chrono::duration_cast<Seconds>(finish.time - start_.time).count();
+        double cpu_seconds =
+            std::chrono::duration_cast<Seconds>(finish.cpu_time - start_.cpu_time).count();
+
+        if (!scenario_failed_ && !verify())
+            scenario_failed_ = true;
+
+        std::cout << std::fixed << std::setprecision(2)
+                  << "  Time: " << seconds << " s" << std::endl
+                  << "  Throughput: " << megabytes(total_size_) / seconds << " MB/s, "
+                  << static_cast<double>(file_count_) / seconds << " files/s" << std::endl
+                  << "  CPU: " << cpu_seconds << " s ("
+                  << cpu_seconds * kGigabyte / std::max<double>(1, total_size_) << " s/GB)"
+                  << std::endl
+                  << "  Peak memory: " << megabytes(peak_memory) << " MB" << std::endl
+                  << "  Network: " << megabytes(finish.tx - start_.tx) << " MB sent, "
+                  << megabytes(finish.rx - start_.rx) << " MB received" << std::endl;
+
+        if (compression_.original_size)
+        {
+            std::cout << "  Compression: " << megabytes(compression_.original_size) << " MB -> "
+                      << megabytes(compression_.compressed_size) << " MB in "
+                      << std::chrono::duration_cast<Seconds>(compression_.compress_time).count()
+                      << " s" << std::endl;
+        }
+
+        std::cout << "  Result: " << (scenario_failed_ ? "FAILED" : "OK") << std::endl;
+
+        if (scenario_failed_)
+            succeeded_ = false;
+
+        task_runner_->postTask(std::bind(&Benchmark::runNextScenario, this));
+    }
+
+    std::shared_ptr<base::TaskRunner> task_runner_;
+    const Options& options_;
+    std::shared_ptr<client::FileTransferWindowProxy> window_proxy_;
+    std::shared_ptr<client::FileTransferProxy> transfer_proxy_;
+    Host host_;
+    Client client_;
+    std::unique_ptr<client::FileTransfer> transfer_;
+    std::mt19937_64 random_;
+
+    std::deque<std::string> scenarios_;
+    int64_t file_count_ = 0;
+    int64_t total_size_ = 0;
+    Measurement start_;
+    client::FileTransfer::CompressionStatistics compression_;
+    bool scenario_failed_ = false;
+    bool succeeded_ = true;
+
+    DISALLOW_COPY_AND_ASSIGN(Benchmark);
+};
+
+Client::Client(std::shared_ptr<base::TaskRunner> task_runner,
+               const Options& options,
+               Benchmark* benchmark)
+    : task_runner_(task_runner),
+      options_(options),
+      benchmark_(benchmark),
+      consumer_proxy_(std::make_shared<common::FileTaskConsumerProxy>(this)),
+      io_pool_(std::make_unique<base::ThreadPool>(common::FileWorker::kIoThreadCount))
+{
+    io_pool_->start();
+
+    std::vector<std::shared_ptr<base::TaskRunner>> io_task_runners;
+    io_task_runners.emplace_back(io_pool_->taskRunner());
+
+    worker_ = std::make_unique<common::FileWorker>(task_runner, io_task_runners);
+}
+
+Client::~Client()
+{
+    consumer_proxy_->dettach();
+}
+
+void Client::connect()
+{
+    channel_ = std::make_unique<base::NetworkChannel>();
+    channel_->setListener(this);
+    channel_->connect(u"127.0.0.1", options_.port);
+}
+
+void Client::onConnected()
+{
+    channel_->setNoDelay(true);
+    setEncryption(channel_.get(), options_.encryption, false);
+    channel_->resume();
+
+    shaper_ = std::make_unique<Shaper>(task_runner_, channel_.get(), options_);
+    benchmark_->onConnected();
+}
+
+void Client::onDisconnected(base::NetworkChannel::ErrorCode error_code)
+{
+    benchmark_->onDisconnected(error_code);
+}
+
+void Client::onMessageReceived(const base::ByteArray& buffer)
+{
+    std::unique_ptr<proto::FileReply> reply = std::make_unique<proto::FileReply>();
+
+    if (!base::parse(buffer, reply.get()))
+    {
+        LOG(LS_ERROR) << "Invalid message from host";
+        return;
+    }
+
+    auto task = std::find_if(remote_task_queue_.begin(), remote_task_queue_.end(),
+                             [id = reply->request_id()](const auto& task)
+    {
+        return task->request().request_id() == id;
+    });
+
+    if (task == remote_task_queue_.end())
+    {
+        LOG(LS_ERROR) << "Reply to an unknown request";
+        return;
+    }
+
+    std::shared_ptr<common::FileTask> current_task = std::move(*task);
+    remote_task_queue_.erase(task);
+
+    current_task->setReply(std::move(reply));
+}
+
+void Client::onMessageWritten(size_t /* pending */)
+{
+    // Nothing
+}
+
+void Client::doTask(std::shared_ptr<common::FileTask> task)
+{
+    if (task->target() == common::FileTask::Target::LOCAL)
+    {
+        worker_->doTask(std::move(task));
+    }
+    else
+    {
+        shaper_->send(base::serialize(task->request()));
+        remote_task_queue_.emplace_back(std::move(task));
+    }
+}
+
+void showHelp()
+{
+    std::cout << "aspia_client_file_transfer_benchmark [switches]" << std::endl
+        << "Available switches:" << std::endl
+        << '\t' << "--port" << '\t' << "Loopback port of the host (default 18050)" << std::endl
+        << '\t' << "--dir" << '\t' << "Directory for the generated files (default temporary)"
+        << std::endl
+        << '\t' << "--scenario" << '\t' << "huge, tiny, tree or all (default all)" << std::endl
+        << '\t' << "--upload" << '\t' << "Upload the files to the host instead of downloading"
+        << std::endl
+        << '\t' << "--streams" << '\t' << "Files transferred at the same time (default 4)"
+        << std::endl
+        << '\t' << "--rtt" << '\t' << "Round trip time of the link in ms (default 0)" << std::endl
+        << '\t' << "--bandwidth" << '\t' << "Bandwidth of the link in Mbit/s (default unlimited)"
+        << std::endl
+        << '\t' << "--encryption" << '\t' << "aes256gcm, chacha20poly1305 or none "
+        << "(default aes256gcm)" << std::endl
+        << '\t' << "--compressible" << '\t' << "Generate text files instead of random data"
+        << std::endl
+        << '\t' << "--huge-size" << '\t' << "Size of the huge file in MB (default 1024)"
+        << std::endl
+        << '\t' << "--tiny-count" << '\t' << "Number of tiny files (default 100000)" << std::endl
+        << '\t' << "--tiny-size" << '\t' << "Size of a tiny file in bytes (default 1024)"
+        << std::endl
+        << '\t' << "--tree-depth" << '\t' << "Depth of the directory tree (default 32)"
+        << std::endl
+        << '\t' << "--tree-files" << '\t' << "Files at each level of the tree (default 16)"
+        << std::endl;
+}
+
+bool parseNumber(const base::CommandLine& command_line, std::u16string_view name, int min_value,
+                 int* value)
+{
+    if (!command_line.hasSwitch(name))
+        return true;
+
+    return base::stringToInt(command_line.switchValue(name), value) && *value >= min_value;
+}
+
+bool parseOptions(const base::CommandLine& command_line, Options* options)
+{
+    if (command_line.hasSwitch(u"port"))
+    {
+        int port = 0;
+        if (!base::stringToInt(command_line.switchValue(u"port"), &port) ||
+            port <= 0 || port > 65535)
+        {
+            return false;
+        }
+
+        options->port = static_cast<uint16_t>(port);
+    }
+
+    // The work directory is removed after the benchmark, so it is always created inside of the
+    // specified directory.
+    std::filesystem::path parent_dir(command_line.switchValue(u"dir"));
+    if (parent_dir.empty())
+        parent_dir = std::filesystem::temp_directory_path();
+
+    options->work_dir = parent_dir / "aspia_file_transfer_benchmark";
+
+    if (command_line.hasSwitch(u"scenario"))
+    {
+        const std::u16string& scenario = command_line.switchValue(u"scenario");
+
+        if (scenario != u"all")
+        {
+            options->huge = scenario == u"huge";
+            options->tiny = scenario == u"tiny";
+            options->tree = scenario == u"tree";
+
+            if (!options->huge && !options->tiny && !options->tree)
+                return false;
+        }
+    }
+
+    if (command_line.hasSwitch(u"encryption"))
+    {
+        const std::u16string& encryption = command_line.switchValue(u"encryption");
+
+        if (encryption == u"aes256gcm")
+            options->encryption = Encryption::AES256_GCM;
+        else if (encryption == u"chacha20poly1305")
+            options->encryption = Encryption::CHACHA20_POLY1305;
+        else if (encryption == u"none")
+            options->encryption = Encryption::NONE;
+        else
+            return false;
+    }
+
+    options->upload = command_line.hasSwitch(u"upload");
+    options->compressible = command_line.hasSwitch(u"compressible");
+
+    int rtt = 0;
+    int bandwidth = 0;
+
+    if (!parseNumber(command_line, u"streams", 1, &options->stream_count) ||
+        !parseNumber(command_line, u"rtt", 0, &rtt) ||
+        !parseNumber(command_line, u"bandwidth", 0, &bandwidth) ||
+        !parseNumber(command_line, u"huge-size", 0, &options->huge_size) ||
+        !parseNumber(command_line, u"tiny-count", 1, &options->tiny_count) ||
+        !parseNumber(command_line, u"tiny-size", 0, &options->tiny_size) ||
+        !parseNumber(command_line, u"tree-depth", 1, &options->tree_depth) ||
+        !parseNumber(command_line, u"tree-files", 0, &options->tree_files))
+    {
+        return false;
+    }
+
+    options->rtt = std::chrono::milliseconds(rtt);
+    options->bandwidth = static_cast<int64_t>(bandwidth) * 1000000;
+    return true;
+}
+
+} // namespace
+
+int main(int argc, const char* const* argv)
+{
+    base::CommandLine command_line(argc, argv);
+    Options options;
+
+    if (command_line.hasSwitch(u"help") || !parseOptions(command_line, &options))
+    {
+        showHelp();
+        return 1;
+    }
+
+    base::MessageLoop message_loop(base::MessageLoop::Type::ASIO);
+
+    Benchmark benchmark(message_loop.taskRunner(), options);
+    message_loop.taskRunner()->postTask(std::bind(&Benchmark::run, &benchmark));
+    message_loop.run();
+
+    return benchmark.isSucceeded() ? 0 : 1;
+}
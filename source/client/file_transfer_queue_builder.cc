@@ -25,6 +25,13 @@
 
 namespace client {
 
+namespace {
+
+// Number of requests for the next parts of a tree that are sent without waiting for the replies.
+const size_t kTreeRequestsInFlight = 4;
+
+} // namespace
+
 FileTransferQueueBuilder::FileTransferQueueBuilder(
     std::shared_ptr<common::FileTaskConsumerProxy> task_consumer_proxy,
     common::FileTask::Target target)
@@ -44,10 +51,12 @@ FileTransferQueueBuilder::~FileTransferQueueBuilder()
 void FileTransferQueueBuilder::start(const std::string& source_path,
                                      const std::string& target_path,
                                      const std::vector<FileTransfer::Item>& items,
-                                     const FinishCallback& callback)
+                                     const QueueCallback& queue_callback,
+                                     const FinishCallback& finish_callback)
 {
-    callback_ = callback;
-    DCHECK(callback_);
+    queue_callback_ = queue_callback;
+    finish_callback_ = finish_callback;
+    DCHECK(queue_callback_ && finish_callback_);
 
     for (const auto& item : items)
         addPendingTask(source_path, target_path, item.name, item.is_directory, item.size);
@@ -57,7 +66,9 @@ void FileTransferQueueBuilder::start(const std::string& source_path,
 
 FileTransfer::TaskList FileTransferQueueBuilder::takeQueue()
 {
-    return std::move(tasks_);
+    FileTransfer::TaskList tasks;
+    tasks.swap(tasks_);
+    return tasks;
 }
 
 int64_t FileTransferQueueBuilder::totalSize() const
@@ -67,14 +78,32 @@ int64_t FileTransferQueueBuilder::totalSize() const
 
 void FileTransferQueueBuilder::onTaskDone(std::shared_ptr<common::FileTask> task)
 {
-    DCHECK(!tasks_.empty());
-
     const proto::FileRequest& request = task->request();
-    const proto::FileReply& reply = task->reply();
 
-    if (!request.has_file_list_request())
-    {
+    if (request.has_file_tree_request())
+        onFileTreeReply(*task);
+    else if (request.has_file_list_request())
+        onFileListReply(*task);
+    else
         onAborted(proto::FILE_ERROR_UNKNOWN);
+}
+
+void FileTransferQueueBuilder::onFileTreeReply(const common::FileTask& task)
+{
+    // The requests sent after the last part of the tree are ignored.
+    if (tree_requests_.empty() || tree_requests_.front().get() != &task)
+        return;
+
+    tree_requests_.pop_front();
+
+    const proto::FileReply& reply = task.reply();
+
+    if (reply.error_code() == proto::FILE_ERROR_INVALID_REQUEST &&
+        !task.request().file_tree_request().path().empty())
+    {
+        // The source of an older version does not support the request.
+        is_tree_supported_ = false;
+        task_consumer_proxy_->doTask(task_factory_->fileList(source_dir_));
         return;
     }
 
@@ -84,19 +113,43 @@ void FileTransferQueueBuilder::onTaskDone(std::shared_ptr<common::FileTask> task
         return;
     }
 
-    // If we get a list of files, then the last task is a directory.
-    const FileTransfer::Task& last_task = tasks_.back();
-    DCHECK(last_task.isDirectory());
+    const proto::FileTree& file_tree = reply.file_tree();
+
+    for (int i = 0; i < file_tree.item_size(); ++i)
+    {
+        const proto::FileList::Item& item = file_tree.item(i);
+
+        addTask(source_dir_, target_dir_, item.name(), item.is_directory(), item.size());
+    }
+
+    if (file_tree.last_part())
+    {
+        tree_requests_.clear();
+        doPendingTasks();
+        return;
+    }
+
+    while (tree_requests_.size() < kTreeRequestsInFlight)
+        sendTreeRequest(std::string());
+
+    queue_callback_();
+}
+
+void FileTransferQueueBuilder::onFileListReply(const common::FileTask& task)
+{
+    const proto::FileReply& reply = task.reply();
+
+    if (reply.error_code() != proto::FILE_ERROR_SUCCESS)
+    {
+        onAborted(reply.error_code());
+        return;
+    }
 
     for (int i = 0; i < reply.file_list().item_size(); ++i)
     {
         const proto::FileList::Item& item = reply.file_list().item(i);
 
-        addPendingTask(last_task.sourcePath(),
-                       last_task.targetPath(),
-                       item.name(),
-                       item.is_directory(),
-                       item.size());
+        addPendingTask(source_dir_, target_dir_, item.name(), item.is_directory(), item.size());
     }
 
     doPendingTasks();
@@ -116,6 +169,28 @@ void FileTransferQueueBuilder::addPendingTask(const std::string& source_dir,
     pending_tasks_.emplace_back(std::move(source_path), std::move(target_path), is_directory, size);
 }
 
+void FileTransferQueueBuilder::addTask(const std::string& source_dir,
+                                       const std::string& target_dir,
+                                       const std::string& item_name,
+                                       bool is_directory,
+                                       int64_t size)
+{
+    total_size_ += size;
+
+    std::string source_path = source_dir + '/' + item_name;
+    std::string target_path = target_dir + '/' + item_name;
+
+    tasks_.emplace_back(std::move(source_path), std::move(target_path), is_directory, size);
+}
+
+void FileTransferQueueBuilder::sendTreeRequest(const std::string& path)
+{
+    std::shared_ptr<common::FileTask> task = task_factory_->fileTree(path);
+
+    tree_requests_.emplace_back(task);
+    task_consumer_proxy_->doTask(std::move(task));
+}
+
 void FileTransferQueueBuilder::doPendingTasks()
 {
     while (!pending_tasks_.empty())
@@ -123,23 +198,33 @@ void FileTransferQueueBuilder::doPendingTasks()
         tasks_.emplace_back(std::move(pending_tasks_.front()));
         pending_tasks_.pop_front();
 
-        if (tasks_.back().isDirectory())
+        const FileTransfer::Task& task = tasks_.back();
+        if (task.isDirectory())
         {
-            task_consumer_proxy_->doTask(task_factory_->fileList(tasks_.back().sourcePath()));
+            source_dir_ = task.sourcePath();
+            target_dir_ = task.targetPath();
+
+            if (is_tree_supported_)
+                sendTreeRequest(source_dir_);
+            else
+                task_consumer_proxy_->doTask(task_factory_->fileList(source_dir_));
+
+            queue_callback_();
             return;
         }
     }
 
-    callback_(proto::FILE_ERROR_SUCCESS);
+    finish_callback_(proto::FILE_ERROR_SUCCESS);
 }
 
 void FileTransferQueueBuilder::onAborted(proto::FileError error_code)
 {
     pending_tasks_.clear();
     tasks_.clear();
+    tree_requests_.clear();
     total_size_ = 0;
 
-    callback_(error_code);
+    finish_callback_(error_code);
 }
 
 } // namespace client
@@ -24,6 +24,9 @@
 namespace client {
 
 // The class prepares the task queue to perform the downloading/uploading.
+// The tree of each directory is enumerated by the source and comes in parts. The tasks of each
+// part can be taken from the queue while the building goes on, so the transfer starts before the
+// whole tree is known. A source of an older version lists one directory per request.
 class FileTransferQueueBuilder : public common::FileTaskProducer
 {
 public:
@@ -32,15 +35,21 @@ public:
         common::FileTask::Target target);
     ~FileTransferQueueBuilder();
 
+    using QueueCallback = std::function<void()>;
     using FinishCallback = std::function<void(proto::FileError)>;
 
-    // Starts building of the task queue.
+    // Starts building of the task queue. |queue_callback| is called when tasks are added to the
+    // queue. |finish_callback| is called when the building is finished or failed.
     void start(const std::string& source_path,
                const std::string& target_path,
                const std::vector<FileTransfer::Item>& items,
-               const FinishCallback& callback);
+               const QueueCallback& queue_callback,
+               const FinishCallback& finish_callback);
 
+    // Takes the tasks added to the queue since the previous call.
     FileTransfer::TaskList takeQueue();
+
+    // Total size of the tasks added to the queue so far.
     int64_t totalSize() const;
 
 protected:
@@ -48,11 +57,21 @@ protected:
     void onTaskDone(std::shared_ptr<common::FileTask> task) override;
 
 private:
+    using FileTaskQueue = std::deque<std::shared_ptr<common::FileTask>>;
+
+    void onFileTreeReply(const common::FileTask& task);
+    void onFileListReply(const common::FileTask& task);
     void addPendingTask(const std::string& source_dir,
                         const std::string& target_dir,
                         const std::string& item_name,
                         bool is_directory,
                         int64_t size);
+    void addTask(const std::string& source_dir,
+                 const std::string& target_dir,
+                 const std::string& item_name,
+                 bool is_directory,
+                 int64_t size);
+    void sendTreeRequest(const std::string& path);
     void doPendingTasks();
     void onAborted(proto::FileError error_code);
 
@@ -60,12 +79,21 @@ private:
     std::shared_ptr<common::FileTaskProducerProxy> task_producer_proxy_;
     std::unique_ptr<common::FileTaskFactory> task_factory_;
 
-    FinishCallback callback_;
+    QueueCallback queue_callback_;
+    FinishCallback finish_callback_;
 
     FileTransfer::TaskList pending_tasks_;
     FileTransfer::TaskList tasks_;
     int64_t total_size_ = 0;
 
+    // Directory being enumerated.
+    std::string source_dir_;
+    std::string target_dir_;
+
+    // Tree requests that have not been answered yet.
+    FileTaskQueue tree_requests_;
+    bool is_tree_supported_ = true;
+
     DISALLOW_COPY_AND_ASSIGN(FileTransferQueueBuilder);
 };
 
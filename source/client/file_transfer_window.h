@@ -33,6 +33,8 @@ public:
 
     virtual void setCurrentItem(const std::string& source_path, const std::string& target_path) = 0;
     virtual void setCurrentProgress(int total, int current) = 0;
+    virtual void setCompressionStatistics(
+        const FileTransfer::CompressionStatistics& statistics) = 0;
     virtual void errorOccurred(const FileTransfer::Error& error) = 0;
 };
 
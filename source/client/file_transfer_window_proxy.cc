@@ -97,6 +97,20 @@ void FileTransferWindowProxy::setCurrentProgress(int total, int current)
         file_transfer_window_->setCurrentProgress(total, current);
 }
 
+void FileTransferWindowProxy::setCompressionStatistics(
+    const FileTransfer::CompressionStatistics& statistics)
+{
+    if (!ui_task_runner_->belongsToCurrentThread())
+    {
+        ui_task_runner_->postTask(std::bind(
+            &FileTransferWindowProxy::setCompressionStatistics, shared_from_this(), statistics));
+        return;
+    }
+
+    if (file_transfer_window_)
+        file_transfer_window_->setCompressionStatistics(statistics);
+}
+
 void FileTransferWindowProxy::errorOccurred(const FileTransfer::Error& error)
 {
     if (!ui_task_runner_->belongsToCurrentThread())
@@ -18,6 +18,8 @@
 
 #include "client/ui/file_manager_settings.h"
 
+#include "client/file_transfer.h"
+
 namespace client {
 
 FileManagerSettings::FileManagerSettings()
@@ -49,4 +51,15 @@ void FileManagerSettings::setWindowState(const QByteArray& state)
     settings_.setValue(QLatin1String("FileManager/WindowState"), state);
 }
 
+int FileManagerSettings::transferStreamCount() const
+{
+    return settings_.value(QLatin1String("FileManager/TransferStreamCount"),
+                           static_cast<int>(FileTransfer::kDefaultStreamCount)).toInt();
+}
+
+void FileManagerSettings::setTransferStreamCount(int count)
+{
+    settings_.setValue(QLatin1String("FileManager/TransferStreamCount"), count);
+}
+
 } // namespace client
@@ -37,6 +37,10 @@ public:
     QByteArray windowState() const;
     void setWindowState(const QByteArray& state);
 
+    // Maximum number of files that are transferred at the same time.
+    int transferStreamCount() const;
+    void setTransferStreamCount(int count);
+
 private:
     QSettings settings_;
 
@@ -131,6 +131,22 @@ void FileTransferDialog::setCurrentProgress(int total, int current)
 #endif
 }
 
+void FileTransferDialog::setCompressionStatistics(
+    const FileTransfer::CompressionStatistics& statistics)
+{
+    if (!statistics.original_size)
+        return;
+
+    const int64_t saved_size = static_cast<int64_t>(statistics.original_size) -
+        static_cast<int64_t>(statistics.compressed_size);
+    const double cpu_time = std::chrono::duration<double>(statistics.compress_time).count();
+
+    ui.label_compression->setText(tr("Compression: saved %1 (%2%), CPU time of the source %3 s")
+        .arg(sizeToString(std::max<int64_t>(saved_size, 0)))
+        .arg(std::max<int64_t>(saved_size, 0) * 100 / statistics.original_size)
+        .arg(cpu_time, 0, 'f', 1));
+}
+
 void FileTransferDialog::errorOccurred(const FileTransfer::Error& error)
 {
 #if defined(OS_WIN)
@@ -305,4 +321,46 @@ QString FileTransferDialog::errorToMessage(const FileTransfer::Error& error)
     }
 }
 
+// static
+QString FileTransferDialog::sizeToString(int64_t size)
+{
+    static const int64_t kKB = 1024LL;
+    static const int64_t kMB = kKB * 1024LL;
+    static const int64_t kGB = kMB * 1024LL;
+    static const int64_t kTB = kGB * 1024LL;
+
+    QString units;
+    int64_t divider;
+
+    if (size >= kTB)
+    {
+        units = tr("TB");
+        divider = kTB;
+    }
+    else if (size >= kGB)
+    {
+        units = tr("GB");
+        divider = kGB;
+    }
+    else if (size >= kMB)
+    {
+        units = tr("MB");
+        divider = kMB;
+    }
+    else if (size >= kKB)
+    {
+        units = tr("kB");
+        divider = kKB;
+    }
+    else
+    {
+        units = tr("B");
+        divider = 1;
+    }
+
+    return QString("%1 %2")
+        .arg(static_cast<double>(size) / static_cast<double>(divider), 0, 'g', 4)
+        .arg(units);
+}
+
 } // namespace client
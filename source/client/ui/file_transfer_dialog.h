@@ -47,6 +47,7 @@ public:
     void stop() override;
     void setCurrentItem(const std::string& source_path, const std::string& target_path) override;
     void setCurrentProgress(int total, int current) override;
+    void setCompressionStatistics(const FileTransfer::CompressionStatistics& statistics) override;
     void errorOccurred(const FileTransfer::Error& error) override;
 
 protected:
@@ -56,6 +57,7 @@ protected:
 
 private:
     QString errorToMessage(const FileTransfer::Error& error);
+    static QString sizeToString(int64_t size);
 
     Ui::FileTransferDialog ui;
 
@@ -67,6 +67,11 @@ std::unique_ptr<Client> QtFileManagerWindow::createClient()
 
     client->setFileManagerWindow(file_manager_window_proxy_);
 
+    FileManagerSettings settings;
+    int stream_count = settings.transferStreamCount();
+    if (stream_count > 0)
+        client->setTransferStreamCount(static_cast<size_t>(stream_count));
+
     return client;
 }
 
@@ -0,0 +1,405 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "common/file_delta.h"
+
+#include "base/logging.h"
+#include "base/files/file.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace common {
+
+namespace {
+
+// The block size is about the square root of the file size (as in rsync), but the signature
+// has no more than kMaxBlockCount blocks. The files that need larger blocks are sent whole.
+const size_t kMinBlockSize = 2 * 1024;
+const size_t kMaxBlockSize = 16 * 1024 * 1024;
+const uint64_t kMaxBlockCount = 128 * 1024;
+
+// Size of the strong checksum of a block.
+const size_t kStrongChecksumSize = 16;
+
+// Size of the filter of the rolling checksums in bits.
+const uint32_t kFilterBits = 20;
+
+// Size of the parts in which the files are read.
+const size_t kReadSize = 1024 * 1024;
+
+size_t blockSizeForFile(uint64_t file_size)
+{
+    uint64_t block_size = kMinBlockSize;
+
+    while (block_size * block_size < file_size || file_size / block_size >= kMaxBlockCount)
+        block_size *= 2;
+
+    if (block_size > kMaxBlockSize)
+        return 0;
+
+    return static_cast<size_t>(block_size);
+}
+
+uint64_t blockCount(uint64_t file_size, size_t block_size)
+{
+    return (file_size + block_size - 1) / block_size;
+}
+
+uint32_t filterIndex(uint32_t weak_checksum)
+{
+    return (weak_checksum * 2654435761U) >> (32 - kFilterBits);
+}
+
+void strongChecksum(base::GenericHash* hash, const uint8_t* data, size_t size, uint8_t* checksum)
+{
+    hash->reset();
+    hash->addData(data, size);
+
+    base::ByteArray result = hash->result();
+    DCHECK_GE(result.size(), kStrongChecksumSize);
+
+    memcpy(checksum, result.data(), kStrongChecksumSize);
+}
+
+} // namespace
+
+void RollingChecksum::reset(const uint8_t* data, size_t size)
+{
+    a_ = 0;
+    b_ = 0;
+    size_ = static_cast<uint32_t>(size);
+
+    for (size_t i = 0; i < size; ++i)
+    {
+        a_ += data[i];
+        b_ += a_;
+    }
+}
+
+void RollingChecksum::roll(uint8_t out, uint8_t in)
+{
+    a_ = a_ - out + in;
+    b_ = b_ - size_ * out + a_;
+}
+
+bool makeFileSignature(base::File* file, uint64_t size, proto::FileSignature* signature)
+{
+    signature->set_basis_size(size);
+
+    const size_t block_size = blockSizeForFile(size);
+    if (!block_size)
+        return true;
+
+    const uint64_t block_count = blockCount(size, block_size);
+
+    std::string* weak_checksums = signature->mutable_weak_checksums();
+    std::string* strong_checksums = signature->mutable_strong_checksums();
+
+    weak_checksums->resize(block_count * sizeof(uint32_t));
+    strong_checksums->resize(block_count * kStrongChecksumSize);
+
+    uint8_t* weak_checksum = reinterpret_cast<uint8_t*>(weak_checksums->data());
+    uint8_t* strong_checksum = reinterpret_cast<uint8_t*>(strong_checksums->data());
+
+    base::GenericHash hash(base::GenericHash::BLAKE2b512);
+    std::vector<uint8_t> buffer(std::max(block_size, kReadSize));
+    uint64_t offset = 0;
+
+    while (offset < size)
+    {
+        const size_t read_size =
+            static_cast<size_t>(std::min<uint64_t>(buffer.size(), size - offset));
+
+        if (!file->read(offset, buffer.data(), read_size))
+            return false;
+
+        for (size_t pos = 0; pos < read_size; pos += block_size)
+        {
+            const size_t current_size = std::min(block_size, read_size - pos);
+
+            RollingChecksum checksum;
+            checksum.reset(buffer.data() + pos, current_size);
+
+            const uint32_t value = checksum.value();
+            for (size_t i = 0; i < sizeof(value); ++i)
+                *weak_checksum++ = static_cast<uint8_t>(value >> (i * 8));
+
+            strongChecksum(&hash, buffer.data() + pos, current_size, strong_checksum);
+            strong_checksum += kStrongChecksumSize;
+        }
+
+        offset += read_size;
+    }
+
+    signature->set_block_size(static_cast<uint32_t>(block_size));
+    return true;
+}
+
+bool hashFile(base::File* file, uint64_t size, base::GenericHash* hash,
+              base::GenericHash* file_hash)
+{
+    std::vector<uint8_t> buffer(static_cast<size_t>(std::min<uint64_t>(size, kReadSize)));
+    uint64_t offset = 0;
+
+    while (offset < size)
+    {
+        const size_t read_size =
+            static_cast<size_t>(std::min<uint64_t>(buffer.size(), size - offset));
+
+        if (!file->read(offset, buffer.data(), read_size))
+            return false;
+
+        hash->addData(buffer.data(), read_size);
+        if (file_hash)
+            file_hash->addData(buffer.data(), read_size);
+
+        offset += read_size;
+    }
+
+    return true;
+}
+
+FileDeltaEncoder::FileDeltaEncoder(const proto::FileSignature& signature, size_t block_count)
+    : basis_size_(signature.basis_size()),
+      block_size_(signature.block_size()),
+      block_count_(block_count),
+      strong_checksums_(signature.strong_checksums()),
+      hash_(base::GenericHash::BLAKE2b512)
+{
+    if (!block_count_)
+        return;
+
+    const uint8_t* weak_checksum =
+        reinterpret_cast<const uint8_t*>(signature.weak_checksums().data());
+
+    weak_checksums_.resize(block_count_);
+    next_blocks_.resize(block_count_);
+    filter_.resize((1U << kFilterBits) / 64);
+
+    // The blocks are added from the end, so the chains of the blocks with the same checksum
+    // start with the first block.
+    for (size_t i = block_count_; i-- > 0;)
+    {
+        uint32_t value = 0;
+        for (size_t j = 0; j < sizeof(value); ++j)
+            value |= static_cast<uint32_t>(weak_checksum[i * sizeof(value) + j]) << (j * 8);
+
+        weak_checksums_[i] = value;
+
+        const uint32_t filter_index = filterIndex(value);
+        filter_[filter_index / 64] |= 1ULL << (filter_index % 64);
+
+        auto result = blocks_.try_emplace(value, static_cast<uint32_t>(i));
+        if (result.second)
+        {
+            next_blocks_[i] = static_cast<uint32_t>(block_count_);
+        }
+        else
+        {
+            next_blocks_[i] = result.first->second;
+            result.first->second = static_cast<uint32_t>(i);
+        }
+    }
+}
+
+FileDeltaEncoder::~FileDeltaEncoder() = default;
+
+// static
+std::unique_ptr<FileDeltaEncoder> FileDeltaEncoder::create(const proto::FileSignature& signature)
+{
+    size_t block_count = 0;
+
+    if (signature.block_size())
+    {
+        const size_t block_size = signature.block_size();
+
+        if (block_size < kMinBlockSize || block_size > kMaxBlockSize)
+        {
+            LOG(LS_WARNING) << "Wrong block size: " << block_size;
+            return nullptr;
+        }
+
+        const uint64_t count = blockCount(signature.basis_size(), block_size);
+        if (count > kMaxBlockCount ||
+            signature.weak_checksums().size() != count * sizeof(uint32_t) ||
+            signature.strong_checksums().size() != count * kStrongChecksumSize)
+        {
+            LOG(LS_WARNING) << "Wrong signature size";
+            return nullptr;
+        }
+
+        block_count = static_cast<size_t>(count);
+    }
+    else if (!signature.weak_checksums().empty() || !signature.strong_checksums().empty())
+    {
+        LOG(LS_WARNING) << "Signature without block size";
+        return nullptr;
+    }
+
+    return std::unique_ptr<FileDeltaEncoder>(new FileDeltaEncoder(signature, block_count));
+}
+
+size_t FileDeltaEncoder::lookaheadSize() const
+{
+    return block_count_ ? block_size_ - 1 : 0;
+}
+
+void FileDeltaEncoder::encode(const uint8_t* data, size_t size, size_t available,
+                              bool end_of_file, proto::FilePacket* packet)
+{
+    DCHECK_GE(available, size);
+
+    size_t pos = 0;
+
+    if (pending_size_)
+    {
+        const size_t copy_size = std::min(pending_size_, size);
+
+        addCopy(packet, nullptr, 0, pending_offset_, copy_size);
+
+        pending_offset_ += copy_size;
+        pending_size_ -= copy_size;
+        pos = copy_size;
+    }
+
+    if (!block_count_)
+    {
+        packet->mutable_data()->append(reinterpret_cast<const char*>(data) + pos, size - pos);
+        return;
+    }
+
+    const size_t last_block_size = blockSize(block_count_ - 1);
+    size_t data_start = pos;
+
+    RollingChecksum checksum;
+    bool checksum_valid = false;
+
+    while (pos < size)
+    {
+        const size_t window_size = std::min(block_size_, available - pos);
+
+        // The last block of the basis may be shorter. It can only be at the end of the file.
+        if (window_size == block_size_ || (end_of_file && window_size == last_block_size))
+        {
+            if (!checksum_valid)
+            {
+                checksum.reset(data + pos, window_size);
+                checksum_valid = true;
+            }
+
+            int64_t block = findBlock(checksum.value(), data + pos, window_size);
+            if (block >= 0)
+            {
+                const uint64_t offset = static_cast<uint64_t>(block) * block_size_;
+                const size_t copy_size = std::min(window_size, size - pos);
+
+                addCopy(packet, data + data_start, pos - data_start, offset, copy_size);
+
+                // The block may continue in the next data.
+                pending_offset_ = offset + copy_size;
+                pending_size_ = window_size - copy_size;
+                expected_block_ = static_cast<size_t>(block) + 1;
+
+                pos += copy_size;
+                data_start = pos;
+                checksum_valid = false;
+                continue;
+            }
+        }
+
+        // The byte is sent as data and the window moves to the next byte.
+        if (checksum_valid)
+        {
+            if (window_size == block_size_ && pos + block_size_ < available)
+                checksum.roll(data[pos], data[pos + block_size_]);
+            else
+                checksum_valid = false;
+        }
+
+        ++pos;
+    }
+
+    packet->mutable_data()->append(
+        reinterpret_cast<const char*>(data) + data_start, pos - data_start);
+}
+
+size_t FileDeltaEncoder::blockSize(size_t index) const
+{
+    return static_cast<size_t>(
+        std::min<uint64_t>(block_size_, basis_size_ - static_cast<uint64_t>(index) * block_size_));
+}
+
+int64_t FileDeltaEncoder::findBlock(uint32_t weak_checksum, const uint8_t* data, size_t size)
+{
+    const uint32_t filter_index = filterIndex(weak_checksum);
+    if (!(filter_[filter_index / 64] & (1ULL << (filter_index % 64))))
+        return -1;
+
+    auto result = blocks_.find(weak_checksum);
+    if (result == blocks_.end())
+        return -1;
+
+    uint8_t strong_checksum[kStrongChecksumSize];
+    strongChecksum(&hash_, data, size, strong_checksum);
+
+    auto is_equal = [&](size_t index)
+    {
+        return weak_checksums_[index] == weak_checksum && blockSize(index) == size &&
+            memcmp(strong_checksums_.data() + index * kStrongChecksumSize, strong_checksum,
+                   kStrongChecksumSize) == 0;
+    };
+
+    if (expected_block_ < block_count_ && is_equal(expected_block_))
+        return static_cast<int64_t>(expected_block_);
+
+    for (size_t index = result->second; index < block_count_; index = next_blocks_[index])
+    {
+        if (is_equal(index))
+            return static_cast<int64_t>(index);
+    }
+
+    return -1;
+}
+
+// static
+void FileDeltaEncoder::addCopy(proto::FilePacket* packet, const uint8_t* data, size_t data_size,
+                               uint64_t offset, size_t size)
+{
+    if (data_size)
+        packet->mutable_data()->append(reinterpret_cast<const char*>(data), data_size);
+
+    const int count = packet->operations_size();
+    if (!data_size && count)
+    {
+        // The block follows the previous copy in the basis.
+        proto::FilePacket::DeltaOperation* last = packet->mutable_operations(count - 1);
+        if (last->copy_offset() + last->copy_size() == offset)
+        {
+            last->set_copy_size(last->copy_size() + static_cast<uint32_t>(size));
+            return;
+        }
+    }
+
+    proto::FilePacket::DeltaOperation* operation = packet->add_operations();
+    operation->set_data_size(static_cast<uint32_t>(data_size));
+    operation->set_copy_offset(offset);
+    operation->set_copy_size(static_cast<uint32_t>(size));
+}
+
+} // namespace common
@@ -0,0 +1,132 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef COMMON__FILE_DELTA_H
+#define COMMON__FILE_DELTA_H
+
+#include "base/macros_magic.h"
+#include "base/crypto/generic_hash.h"
+#include "proto/file_transfer.pb.h"
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace base {
+class File;
+} // namespace base
+
+namespace common {
+
+//
+// Delta transfer of files in the manner of rsync.
+// The target splits the file that it already has (the basis) into blocks and sends the rolling
+// and the strong checksums of the blocks to the source (see proto::FileSignature). The source
+// looks for the blocks at each offset of its file. The rolling checksum of the next offset is
+// calculated from the previous one in constant time, and only the offsets with a known rolling
+// checksum are verified by the strong checksum. The blocks that are found are sent as references
+// to the basis, the rest of the file is sent as data.
+//
+
+class RollingChecksum
+{
+public:
+    // Calculates the checksum of |size| bytes of |data|.
+    void reset(const uint8_t* data, size_t size);
+
+    // Moves the window by one byte: |out| leaves the window and |in| enters it.
+    void roll(uint8_t out, uint8_t in);
+
+    uint32_t value() const { return (a_ & 0xFFFF) | (b_ << 16); }
+
+private:
+    uint32_t a_ = 0;
+    uint32_t b_ = 0;
+    uint32_t size_ = 0;
+};
+
+// Makes the signature of the first |size| bytes of |file|. If the file is too large for the
+// delta transfer, the signature has no blocks. Returns false if the file can not be read.
+bool makeFileSignature(base::File* file, uint64_t size, proto::FileSignature* signature);
+
+// Adds the first |size| bytes of |file| to |hash| and, if it is not null, to |file_hash|.
+// Returns false if the file can not be read.
+bool hashFile(base::File* file, uint64_t size, base::GenericHash* hash,
+              base::GenericHash* file_hash);
+
+class FileDeltaEncoder
+{
+public:
+    ~FileDeltaEncoder();
+
+    // Returns nullptr if the signature is not valid.
+    static std::unique_ptr<FileDeltaEncoder> create(const proto::FileSignature& signature);
+
+    // Number of bytes after the encoded data that encode() needs to find the blocks that start
+    // in the encoded data.
+    size_t lookaheadSize() const;
+
+    // Encodes |size| bytes of |data| into the data and the operations of |packet|. |available|
+    // bytes (not less than |size|) can be read at |data|. If |end_of_file| is true, they reach
+    // the end of the file. The calls must follow the order of the data in the file.
+    void encode(const uint8_t* data, size_t size, size_t available, bool end_of_file,
+                proto::FilePacket* packet);
+
+private:
+    FileDeltaEncoder(const proto::FileSignature& signature, size_t block_count);
+
+    size_t blockSize(size_t index) const;
+
+    // Returns the index of the block of the basis that is equal to |size| bytes of |data| or -1.
+    int64_t findBlock(uint32_t weak_checksum, const uint8_t* data, size_t size);
+
+    static void addCopy(proto::FilePacket* packet, const uint8_t* data, size_t data_size,
+                        uint64_t offset, size_t size);
+
+    const uint64_t basis_size_;
+    const size_t block_size_;
+    const size_t block_count_;
+
+    std::vector<uint32_t> weak_checksums_;
+    std::string strong_checksums_;
+
+    // Filter of the rolling checksums that rejects the most offsets without the lookup in
+    // |blocks_|.
+    std::vector<uint64_t> filter_;
+
+    // First block with the rolling checksum and the next blocks with the same checksum.
+    std::unordered_map<uint32_t, uint32_t> blocks_;
+    std::vector<uint32_t> next_blocks_;
+
+    // Block that follows the last found one. It is checked first, so the unchanged parts of the
+    // file are sent as long copies.
+    size_t expected_block_ = 0;
+
+    // Rest of the block found at the end of the previous data.
+    uint64_t pending_offset_ = 0;
+    size_t pending_size_ = 0;
+
+    base::GenericHash hash_;
+
+    DISALLOW_COPY_AND_ASSIGN(FileDeltaEncoder);
+};
+
+} // namespace common
+
+#endif // COMMON__FILE_DELTA_H
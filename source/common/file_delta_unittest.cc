@@ -0,0 +1,245 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "common/file_delta.h"
+
+#include "base/files/file.h"
+#include "base/files/file_util.h"
+#include "base/files/scoped_temp_directory.h"
+#include "common/file_depacketizer.h"
+#include "common/file_packetizer.h"
+
+#include <gtest/gtest.h>
+
+#include <random>
+
+namespace common {
+
+namespace {
+
+// Size of the parts in which the data is encoded, as the packets of the file.
+const size_t kPartSize = 64 * 1024;
+
+std::string randomData(size_t size, uint32_t seed)
+{
+    std::mt19937 generator(seed);
+    std::string data(size, 0);
+
+    for (auto& byte : data)
+        byte = static_cast<char>(generator());
+
+    return data;
+}
+
+proto::FileSignature makeSignature(const std::filesystem::path& basis_path,
+                                   const std::string& basis)
+{
+    EXPECT_TRUE(base::writeFile(basis_path, basis));
+
+    std::unique_ptr<base::File> file = base::File::openForReading(basis_path);
+    EXPECT_TRUE(file);
+
+    proto::FileSignature signature;
+    EXPECT_TRUE(makeFileSignature(file.get(), basis.size(), &signature));
+    return signature;
+}
+
+// Encodes |data| in parts and applies the packets to |basis| in the same way as the target.
+std::string encodeAndApply(const proto::FileSignature& signature, const std::string& basis,
+                           const std::string& data, size_t* copied_size)
+{
+    std::unique_ptr<FileDeltaEncoder> encoder = FileDeltaEncoder::create(signature);
+    EXPECT_TRUE(encoder);
+    if (!encoder)
+        return std::string();
+
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data.data());
+    std::string result;
+    *copied_size = 0;
+
+    for (size_t offset = 0; offset < data.size(); offset += kPartSize)
+    {
+        const size_t size = std::min(kPartSize, data.size() - offset);
+        const size_t available =
+            std::min(size + encoder->lookaheadSize(), data.size() - offset);
+
+        proto::FilePacket packet;
+        encoder->encode(bytes + offset, size, available, offset + available == data.size(),
+                        &packet);
+
+        size_t data_pos = 0;
+        size_t packet_size = packet.data().size();
+
+        for (const auto& operation : packet.operations())
+        {
+            result.append(packet.data(), data_pos, operation.data_size());
+            data_pos += operation.data_size();
+
+            EXPECT_LE(operation.copy_offset() + operation.copy_size(), basis.size());
+            result.append(basis, operation.copy_offset(), operation.copy_size());
+
+            *copied_size += operation.copy_size();
+            packet_size += operation.copy_size();
+        }
+
+        result.append(packet.data(), data_pos, std::string::npos);
+        EXPECT_EQ(packet_size, size);
+    }
+
+    return result;
+}
+
+} // namespace
+
+TEST(RollingChecksumTest, RollMatchesReset)
+{
+    const size_t kWindowSize = 2048;
+    const std::string data = randomData(kWindowSize * 4, 1);
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data.data());
+
+    RollingChecksum rolling;
+    rolling.reset(bytes, kWindowSize);
+
+    for (size_t pos = 0; pos + kWindowSize < data.size(); ++pos)
+    {
+        rolling.roll(bytes[pos], bytes[pos + kWindowSize]);
+
+        RollingChecksum expected;
+        expected.reset(bytes + pos + 1, kWindowSize);
+        ASSERT_EQ(rolling.value(), expected.value()) << "offset " << pos + 1;
+    }
+}
+
+TEST(FileDeltaTest, SameFile)
+{
+    base::ScopedTempDirectory temp_directory("aspia_file_delta_test");
+    ASSERT_TRUE(temp_directory.isValid());
+    const std::string basis = randomData(1024 * 1024 + 123, 2);
+
+    proto::FileSignature signature = makeSignature(temp_directory.filePath("basis"), basis);
+    EXPECT_GT(signature.block_size(), 0);
+
+    size_t copied_size;
+    EXPECT_EQ(encodeAndApply(signature, basis, basis, &copied_size), basis);
+    EXPECT_EQ(copied_size, basis.size());
+}
+
+TEST(FileDeltaTest, InsertedAndDeletedBlocks)
+{
+    base::ScopedTempDirectory temp_directory("aspia_file_delta_test");
+    ASSERT_TRUE(temp_directory.isValid());
+    const std::string basis = randomData(1024 * 1024 + 321, 3);
+
+    proto::FileSignature signature = makeSignature(temp_directory.filePath("basis"), basis);
+    const size_t block_size = signature.block_size();
+    ASSERT_GT(block_size, 0);
+
+    // Data inserted inside a block, a deleted block and a changed tail of the file.
+    std::string data = basis;
+    data.insert(block_size * 3 + 17, randomData(5000, 4));
+    data.erase(block_size * 20, block_size);
+    data.replace(data.size() - 100, 100, randomData(300, 5));
+
+    size_t copied_size;
+    EXPECT_EQ(encodeAndApply(signature, basis, data, &copied_size), data);
+
+    // Only the blocks around the changes are sent as data.
+    EXPECT_GE(copied_size, basis.size() - block_size * 4);
+}
+
+TEST(FileDeltaTest, NoBasis)
+{
+    proto::FileSignature signature;
+    const std::string data = randomData(200 * 1024, 6);
+
+    size_t copied_size;
+    EXPECT_EQ(encodeAndApply(signature, std::string(), data, &copied_size), data);
+    EXPECT_EQ(copied_size, 0);
+}
+
+TEST(FileDeltaTest, WrongSignature)
+{
+    base::ScopedTempDirectory temp_directory("aspia_file_delta_test");
+    ASSERT_TRUE(temp_directory.isValid());
+    proto::FileSignature signature =
+        makeSignature(temp_directory.filePath("basis"), randomData(100 * 1024, 7));
+
+    proto::FileSignature wrong_block_size = signature;
+    wrong_block_size.set_block_size(16);
+    EXPECT_FALSE(FileDeltaEncoder::create(wrong_block_size));
+
+    proto::FileSignature wrong_checksums = signature;
+    wrong_checksums.mutable_weak_checksums()->pop_back();
+    EXPECT_FALSE(FileDeltaEncoder::create(wrong_checksums));
+
+    proto::FileSignature no_block_size = signature;
+    no_block_size.clear_block_size();
+    EXPECT_FALSE(FileDeltaEncoder::create(no_block_size));
+}
+
+TEST(FileDeltaTest, ResumeWithWrongHash)
+{
+    base::ScopedTempDirectory temp_directory("aspia_file_delta_test");
+    ASSERT_TRUE(temp_directory.isValid());
+
+    const std::filesystem::path source_path = temp_directory.filePath("source");
+    const std::filesystem::path target_path = temp_directory.filePath("target");
+    const std::filesystem::path partial_path = temp_directory.filePath("target.aspia-part");
+
+    const std::string data = randomData(300 * 1024, 8);
+    ASSERT_TRUE(base::writeFile(source_path, data));
+
+    // The part of the interrupted transfer of another version of the file.
+    ASSERT_TRUE(base::writeFile(partial_path, randomData(100 * 1024, 9)));
+
+    proto::FileSignature signature;
+    std::unique_ptr<FileDepacketizer> depacketizer =
+        FileDepacketizer::createForDelta(target_path, true, &signature);
+    ASSERT_TRUE(depacketizer);
+    EXPECT_EQ(signature.resume_size(), 100 * 1024);
+
+    std::unique_ptr<FilePacketizer> packetizer = FilePacketizer::create(source_path);
+    ASSERT_TRUE(packetizer);
+
+    // The source does not start with the data of the part, so the file is sent from the start.
+    uint64_t resume_size = 1;
+    ASSERT_TRUE(packetizer->startDelta(signature, &resume_size));
+    EXPECT_EQ(resume_size, 0);
+
+    proto::FilePacketRequest request;
+    request.set_packet_size(64 * 1024);
+
+    while (true)
+    {
+        std::unique_ptr<proto::FilePacket> packet = packetizer->readNextPacket(request);
+        ASSERT_TRUE(packet);
+        ASSERT_TRUE(depacketizer->writeNextPacket(*packet));
+
+        if (packet->flags() & proto::FilePacket::LAST_PACKET)
+            break;
+    }
+
+    depacketizer.reset();
+
+    std::string result;
+    ASSERT_TRUE(base::readFile(target_path, &result));
+    EXPECT_EQ(result, data);
+    EXPECT_FALSE(std::filesystem::exists(partial_path));
+}
+
+} // namespace common
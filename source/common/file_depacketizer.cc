@@ -19,13 +19,60 @@
 #include "common/file_depacketizer.h"
 
 #include "base/logging.h"
+#include "base/strings/unicode.h"
+#include "common/file_delta.h"
+#include "common/file_packet.h"
+
+#include <algorithm>
 
 namespace common {
 
+namespace {
+
+// Suffix of the temporary file of the delta transfer.
+const char kPartialFileSuffix[] = ".aspia-part";
+
+// Size of the parts in which the blocks of the basis file are copied.
+const uint64_t kCopySize = 1024 * 1024;
+
+// Moves the file if there is no file at |new_path|. A hard link fails if the target exists, so
+// an existing file is not replaced even if it appears during the transfer.
+proto::FileError moveFileNoReplace(const std::filesystem::path& old_path,
+                                   const std::filesystem::path& new_path)
+{
+    std::error_code error_code;
+
+    std::filesystem::create_hard_link(old_path, new_path, error_code);
+    if (error_code == std::errc::file_exists)
+        return proto::FILE_ERROR_PATH_ALREADY_EXISTS;
+
+    if (error_code)
+    {
+        // The file system does not support hard links.
+        if (std::filesystem::exists(new_path, error_code))
+            return proto::FILE_ERROR_PATH_ALREADY_EXISTS;
+
+        std::filesystem::rename(old_path, new_path, error_code);
+        if (error_code)
+        {
+            LOG(LS_WARNING) << "Unable to rename file: "
+                            << base::utf16FromLocal8Bit(error_code.message());
+            return proto::FILE_ERROR_FILE_WRITE_ERROR;
+        }
+
+        return proto::FILE_ERROR_SUCCESS;
+    }
+
+    std::filesystem::remove(old_path, error_code);
+    return proto::FILE_ERROR_SUCCESS;
+}
+
+} // namespace
+
 FileDepacketizer::FileDepacketizer(const std::filesystem::path& file_path,
-                                   std::ofstream&& file_stream)
+                                   std::unique_ptr<base::File> file)
     : file_path_(file_path),
-      file_stream_(std::move(file_stream))
+      file_(std::move(file))
 {
     // Nothing
 }
@@ -33,11 +80,16 @@ FileDepacketizer::FileDepacketizer(const std::filesystem::path& file_path,
 FileDepacketizer::~FileDepacketizer()
 {
     // If the file is opened, it was not completely written.
-    if (file_stream_.is_open())
+    if (file_)
     {
-        file_stream_.close();
+        file_.reset();
+
+        // The temporary file of the delta transfer is kept to continue the transfer later. It is
+        // deleted if the transfer was canceled or the peer moved on to another file. Other
+        // incomplete files are always deleted.
+        if (!target_path_.empty() && !discard_)
+            return;
 
-        // The transfer of files was canceled. Delete the file.
         std::error_code ignored_error;
         std::filesystem::remove(file_path_, ignored_error);
     }
@@ -47,58 +99,351 @@ FileDepacketizer::~FileDepacketizer()
 std::unique_ptr<FileDepacketizer> FileDepacketizer::create(
     const std::filesystem::path& file_path, bool overwrite)
 {
-    std::ofstream::openmode mode = std::ofstream::binary;
+    std::unique_ptr<base::File> file = base::File::createForWriting(file_path, overwrite);
+    if (!file)
+        return nullptr;
 
-    if (overwrite)
-        mode |= std::ofstream::trunc;
+    return std::unique_ptr<FileDepacketizer>(new FileDepacketizer(file_path, std::move(file)));
+}
 
-    std::ofstream file_stream;
+// static
+std::unique_ptr<FileDepacketizer> FileDepacketizer::createForDelta(
+    const std::filesystem::path& file_path, bool overwrite, proto::FileSignature* signature)
+{
+    std::filesystem::path partial_path = file_path;
+    partial_path += kPartialFileSuffix;
 
-    file_stream.open(file_path, mode);
-    if (!file_stream.is_open())
-        return nullptr;
+    auto file_hash = std::make_unique<base::GenericHash>(base::GenericHash::BLAKE2b512);
+    std::unique_ptr<base::File> file;
+    uint64_t resume_size = 0;
+
+    // The temporary file of the interrupted transfer is continued if the source file starts
+    // with the same data.
+    std::unique_ptr<base::File> partial_file = base::File::openForReading(partial_path);
+    if (partial_file)
+    {
+        const int64_t partial_size = partial_file->size();
+        base::GenericHash resume_hash(base::GenericHash::BLAKE2b512);
+
+        if (partial_size > 0 &&
+            hashFile(partial_file.get(), static_cast<uint64_t>(partial_size), &resume_hash,
+                     file_hash.get()))
+        {
+            file = base::File::openForWriting(partial_path);
+            if (file)
+            {
+                resume_size = static_cast<uint64_t>(partial_size);
+
+                signature->set_resume_size(resume_size);
+                signature->set_resume_hash(base::toStdString(resume_hash.result()));
+            }
+        }
+
+        partial_file.reset();
+    }
+
+    if (!file)
+    {
+        file_hash->reset();
+
+        file = base::File::createForWriting(partial_path, true);
+        if (!file)
+            return nullptr;
+    }
+
+    std::unique_ptr<FileDepacketizer> depacketizer(
+        new FileDepacketizer(partial_path, std::move(file)));
+
+    depacketizer->target_path_ = file_path;
+    depacketizer->overwrite_ = overwrite;
+    depacketizer->resume_size_ = resume_size;
+    depacketizer->file_hash_ = std::move(file_hash);
 
-    return std::unique_ptr<FileDepacketizer>(
-        new FileDepacketizer(file_path, std::move(file_stream)));
+    // The existing file is the basis of the delta transfer.
+    std::unique_ptr<base::File> basis = base::File::openForReading(file_path);
+    if (basis)
+    {
+        const int64_t basis_size = basis->size();
+        if (basis_size > 0)
+        {
+            if (makeFileSignature(basis.get(), static_cast<uint64_t>(basis_size), signature))
+            {
+                depacketizer->basis_ = std::move(basis);
+                depacketizer->basis_size_ = static_cast<uint64_t>(basis_size);
+            }
+            else
+            {
+                LOG(LS_WARNING) << "Unable to read basis file";
+
+                signature->clear_basis_size();
+                signature->clear_block_size();
+                signature->clear_weak_checksums();
+                signature->clear_strong_checksums();
+            }
+        }
+    }
+
+    return depacketizer;
 }
 
 bool FileDepacketizer::writeNextPacket(const proto::FilePacket& packet)
 {
-    DCHECK(file_stream_.is_open());
+    DCHECK(file_);
+
+    const std::string* data = &packet.data();
+
+    switch (packet.compression())
+    {
+        case proto::FILE_COMPRESSION_NONE:
+            break;
+
+        case proto::FILE_COMPRESSION_ZSTD:
+        {
+            if (!decompressPacket(packet))
+                return false;
+
+            data = &buffer_;
+        }
+        break;
+
+        default:
+        {
+            LOG(LS_WARNING) << "Unknown compression: " << packet.compression();
+            return false;
+        }
+    }
+
+    // Size of the file data in the packet.
+    uint64_t packet_size = data->size();
+    for (const auto& operation : packet.operations())
+        packet_size += operation.copy_size();
+
+    // The first packet must have the full file size.
+    if (packet.flags() & proto::FilePacket::FIRST_PACKET)
+    {
+        file_size_ = packet.file_size();
+
+        if (packet.offset())
+        {
+            // The source continues the interrupted transfer.
+            if (packet.offset() != resume_size_ || packet.offset() > file_size_)
+            {
+                LOG(LS_WARNING) << "Wrong offset: " << packet.offset();
+                return false;
+            }
+        }
+        else if (resume_size_)
+        {
+            // The source file does not start with the data of the interrupted transfer.
+            file_ = base::File::createForWriting(file_path_, true);
+            if (!file_)
+            {
+                LOG(LS_WARNING) << "Unable to create file";
+                return false;
+            }
+
+            file_hash_->reset();
+            resume_size_ = 0;
+        }
+
+        left_size_ = file_size_ - packet.offset();
+
+        // Reserve the space for the whole file if it takes more than one packet.
+        if (left_size_ > packet_size)
+            file_->preallocate(file_size_);
+    }
 
-    const size_t packet_size = packet.data().size();
     if (!packet_size)
     {
-        // If an empty data packet with the last packet flag set is received, the transfer
-        // is canceled.
         if (packet.flags() & proto::FilePacket::LAST_PACKET)
+        {
+            // The first packet is empty if there is no data to write (an empty file).
+            if ((packet.flags() & proto::FilePacket::FIRST_PACKET) && !left_size_)
+                return finishFile(packet);
+
+            // If an empty data packet with the last packet flag set is received, the transfer
+            // is canceled.
+            discard_ = true;
             return true;
+        }
 
         LOG(LS_WARNING) << "Wrong packet size";
         return false;
     }
 
-    // The first packet must have the full file size.
-    if (packet.flags() & proto::FilePacket::FIRST_PACKET)
+    if (packet_size > left_size_)
     {
-        file_size_ = packet.file_size();
-        left_size_ = file_size_;
+        LOG(LS_WARNING) << "Packet exceeds the file size";
+        return false;
     }
 
-    file_stream_.seekp(file_size_ - left_size_);
-    file_stream_.write(packet.data().data(), packet_size);
-    if (file_stream_.fail())
+    size_t data_pos = 0;
+
+    for (const auto& operation : packet.operations())
+    {
+        if (operation.data_size() > data->size() - data_pos)
+        {
+            LOG(LS_WARNING) << "Wrong size of the data of the delta operation";
+            return false;
+        }
+
+        if (!writeData(data->data() + data_pos, operation.data_size()))
+            return false;
+
+        data_pos += operation.data_size();
+
+        if (!copyBasis(operation.copy_offset(), operation.copy_size()))
+            return false;
+    }
+
+    if (!writeData(data->data() + data_pos, data->size() - data_pos))
+        return false;
+
+    if (packet.flags() & proto::FilePacket::LAST_PACKET)
+        return finishFile(packet);
+
+    return true;
+}
+
+const std::filesystem::path& FileDepacketizer::targetPath() const
+{
+    return target_path_.empty() ? file_path_ : target_path_;
+}
+
+bool FileDepacketizer::decompressPacket(const proto::FilePacket& packet)
+{
+    const size_t original_size = packet.original_size();
+    if (!original_size || original_size > kMaxFilePacketSize)
+    {
+        LOG(LS_WARNING) << "Wrong original size: " << original_size;
+        return false;
+    }
+
+    // The stream starts with the first compressed packet of the file.
+    if (!stream_)
+        stream_.reset(ZSTD_createDStream());
+
+    buffer_.resize(original_size);
+
+    ZSTD_inBuffer input = { packet.data().data(), packet.data().size(), 0 };
+    ZSTD_outBuffer output = { buffer_.data(), buffer_.size(), 0 };
+
+    while (input.pos < input.size)
+    {
+        const size_t input_pos = input.pos;
+        const size_t output_pos = output.pos;
+
+        size_t ret = ZSTD_decompressStream(stream_.get(), &output, &input);
+        if (ZSTD_isError(ret))
+        {
+            LOG(LS_WARNING) << "ZSTD_decompressStream failed: " << ZSTD_getErrorName(ret);
+            return false;
+        }
+
+        // The packet contains more data than the original size.
+        if (input.pos == input_pos && output.pos == output_pos)
+        {
+            LOG(LS_WARNING) << "Decompressed data exceeds the original size";
+            return false;
+        }
+    }
+
+    if (output.pos != original_size)
+    {
+        LOG(LS_WARNING) << "Decompressed size mismatch: " << output.pos << " expected: "
+                        << original_size;
+        return false;
+    }
+
+    return true;
+}
+
+bool FileDepacketizer::writeData(const char* data, size_t size)
+{
+    if (!size)
+        return true;
+
+    // The data is written directly from the packet.
+    if (!file_->write(file_size_ - left_size_, data, size))
     {
         LOG(LS_WARNING) << "Unable to write file";
         return false;
     }
 
-    left_size_ -= packet_size;
+    if (file_hash_)
+        file_hash_->addData(data, size);
 
-    if (packet.flags() & proto::FilePacket::LAST_PACKET)
+    left_size_ -= size;
+    return true;
+}
+
+bool FileDepacketizer::copyBasis(uint64_t offset, uint64_t size)
+{
+    if (!basis_ || offset > basis_size_ || size > basis_size_ - offset)
+    {
+        LOG(LS_WARNING) << "Wrong copy of the basis: " << offset << " " << size;
+        return false;
+    }
+
+    while (size)
+    {
+        const size_t copy_size = static_cast<size_t>(std::min<uint64_t>(size, kCopySize));
+        copy_buffer_.resize(copy_size);
+
+        if (!basis_->read(offset, copy_buffer_.data(), copy_size))
+        {
+            LOG(LS_WARNING) << "Unable to read basis file";
+            return false;
+        }
+
+        if (!writeData(copy_buffer_.data(), copy_size))
+            return false;
+
+        offset += copy_size;
+        size -= copy_size;
+    }
+
+    return true;
+}
+
+bool FileDepacketizer::finishFile(const proto::FilePacket& packet)
+{
+    file_size_ = 0;
+    file_.reset();
+    stream_.reset();
+
+    if (target_path_.empty())
+        return true;
+
+    basis_.reset();
+
+    std::error_code error_code;
+
+    if (left_size_ || base::toStdString(file_hash_->result()) != packet.file_hash())
+    {
+        LOG(LS_WARNING) << "File hash mismatch";
+        std::filesystem::remove(file_path_, error_code);
+        return false;
+    }
+
+    if (!overwrite_)
+    {
+        error_code_ = moveFileNoReplace(file_path_, target_path_);
+        if (error_code_ != proto::FILE_ERROR_SUCCESS)
+        {
+            std::filesystem::remove(file_path_, error_code);
+            return false;
+        }
+
+        return true;
+    }
+
+    std::filesystem::rename(file_path_, target_path_, error_code);
+    if (error_code)
     {
-        file_size_ = 0;
-        file_stream_.close();
+        LOG(LS_WARNING) << "Unable to replace file: "
+                        << base::utf16FromLocal8Bit(error_code.message());
+        return false;
     }
 
     return true;
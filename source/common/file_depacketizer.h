@@ -20,10 +20,12 @@
 #define COMMON__FILE_DEPACKETIZER_H
 
 #include "base/macros_magic.h"
+#include "base/codec/scoped_zstd_stream.h"
+#include "base/crypto/generic_hash.h"
+#include "base/files/file.h"
 #include "proto/file_transfer.pb.h"
 
 #include <filesystem>
-#include <fstream>
 #include <memory>
 
 namespace common {
@@ -36,18 +38,59 @@ public:
     static std::unique_ptr<FileDepacketizer> create(const std::filesystem::path& file_path,
                                                     bool overwrite);
 
+    // Creates the depacketizer for the delta transfer. The packets are written to a temporary
+    // file next to |file_path|, which replaces the file when the last packet is written. If
+    // |overwrite| is false and the file appears during the transfer, it is not replaced.
+    // If the connection is lost or writing fails, the temporary file is kept and the next transfer
+    // of the file continues it. If the transfer is canceled or the file is discarded, the temporary
+    // file is deleted. |signature| receives the signature of the existing file and of the
+    // temporary file. It has no blocks and no resume size if there are no such files.
+    static std::unique_ptr<FileDepacketizer> createForDelta(const std::filesystem::path& file_path,
+                                                            bool overwrite,
+                                                            proto::FileSignature* signature);
+
     // Reads the packet and writes its contents to a file.
     bool writeNextPacket(const proto::FilePacket& packet);
 
+    // Error of the last failed call of writeNextPacket.
+    proto::FileError errorCode() const { return error_code_; }
+
+    // Path of the file as requested by the peer.
+    const std::filesystem::path& targetPath() const;
+
+    // The incomplete file is deleted even if it is a temporary file of the delta transfer.
+    void discard() { discard_ = true; }
+
 private:
-    FileDepacketizer(const std::filesystem::path& file_path, std::ofstream&& file_stream);
+    FileDepacketizer(const std::filesystem::path& file_path, std::unique_ptr<base::File> file);
+
+    bool decompressPacket(const proto::FilePacket& packet);
+    bool writeData(const char* data, size_t size);
+    bool copyBasis(uint64_t offset, uint64_t size);
+    bool finishFile(const proto::FilePacket& packet);
 
     std::filesystem::path file_path_;
-    std::ofstream file_stream_;
+    std::unique_ptr<base::File> file_;
 
     uint64_t file_size_ = 0;
     uint64_t left_size_ = 0;
 
+    proto::FileError error_code_ = proto::FILE_ERROR_FILE_WRITE_ERROR;
+    bool discard_ = false;
+
+    // Stream of the compressed packets of the file and the buffer for the decompressed data.
+    base::ScopedZstdDStream stream_;
+    std::string buffer_;
+
+    // Delta transfer. |file_path_| is the temporary file that replaces |target_path_|.
+    std::filesystem::path target_path_;
+    bool overwrite_ = false;
+    std::unique_ptr<base::File> basis_;
+    uint64_t basis_size_ = 0;
+    uint64_t resume_size_ = 0;
+    std::unique_ptr<base::GenericHash> file_hash_;
+    std::string copy_buffer_;
+
     DISALLOW_COPY_AND_ASSIGN(FileDepacketizer);
 };
 
@@ -0,0 +1,259 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "common/file_pack.h"
+
+#include "base/logging.h"
+#include "base/files/file.h"
+#include "base/files/file_util.h"
+#include "common/file_packet.h"
+
+#include <zstd.h>
+
+#include <algorithm>
+#include <chrono>
+
+namespace common {
+
+namespace {
+
+// Same level as for the packets of the large files (see FilePacketizer).
+const int kCompressionLevel = 3;
+
+// The data is sent uncompressed if the compression saves less than 5 percent of it.
+const uint64_t kMaxCompressedPercent = 95;
+
+proto::FileError readFile(const std::filesystem::path& file_path, uint64_t max_size,
+                          std::string* data, uint64_t* size)
+{
+    std::unique_ptr<base::File> file = base::File::openForReading(file_path);
+    if (!file)
+        return proto::FILE_ERROR_FILE_OPEN_ERROR;
+
+    const int64_t file_size = file->size();
+    if (file_size < 0)
+        return proto::FILE_ERROR_FILE_READ_ERROR;
+
+    // The file has grown since the queue was built or the pack is full.
+    if (static_cast<uint64_t>(file_size) > max_size)
+        return proto::FILE_ERROR_FILE_READ_ERROR;
+
+    const size_t offset = data->size();
+    data->resize(offset + static_cast<size_t>(file_size));
+
+    if (!file->read(0, data->data() + offset, static_cast<size_t>(file_size)))
+    {
+        data->resize(offset);
+        return proto::FILE_ERROR_FILE_READ_ERROR;
+    }
+
+    *size = static_cast<uint64_t>(file_size);
+    return proto::FILE_ERROR_SUCCESS;
+}
+
+proto::FileError writeFile(const std::filesystem::path& file_path, bool overwrite,
+                           const char* data, size_t size)
+{
+    if (!overwrite)
+    {
+        std::error_code ignored_code;
+        if (std::filesystem::exists(file_path, ignored_code))
+            return proto::FILE_ERROR_PATH_ALREADY_EXISTS;
+    }
+
+    std::unique_ptr<base::File> file = base::File::createForWriting(file_path, overwrite);
+    if (!file)
+        return proto::FILE_ERROR_FILE_CREATE_ERROR;
+
+    if (!file->write(0, data, size))
+    {
+        file.reset();
+
+        std::error_code ignored_code;
+        std::filesystem::remove(file_path, ignored_code);
+        return proto::FILE_ERROR_FILE_WRITE_ERROR;
+    }
+
+    return proto::FILE_ERROR_SUCCESS;
+}
+
+// Compresses |data| into |pack| and returns true if the compression saves enough of it.
+bool compressData(const std::string& data, proto::FilePack* pack)
+{
+    const std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+
+    std::string compressed_data;
+    compressed_data.resize(ZSTD_compressBound(data.size()));
+
+    size_t ret = ZSTD_compress(compressed_data.data(), compressed_data.size(),
+                               data.data(), data.size(), kCompressionLevel);
+    if (ZSTD_isError(ret))
+    {
+        LOG(LS_WARNING) << "ZSTD_compress failed: " << ZSTD_getErrorName(ret);
+        return false;
+    }
+
+    if (ret * 100 > data.size() * kMaxCompressedPercent)
+        return false;
+
+    compressed_data.resize(ret);
+
+    const std::chrono::microseconds compress_time =
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start_time);
+
+    pack->set_compression(proto::FILE_COMPRESSION_ZSTD);
+    pack->set_original_size(static_cast<uint32_t>(data.size()));
+    pack->set_compress_time(static_cast<uint32_t>(compress_time.count()));
+    pack->set_data(std::move(compressed_data));
+    return true;
+}
+
+bool decompressData(const proto::FilePack& pack, std::string* data)
+{
+    const size_t original_size = pack.original_size();
+    if (!original_size || original_size > kMaxFilePackSize)
+    {
+        LOG(LS_WARNING) << "Wrong original size: " << original_size;
+        return false;
+    }
+
+    data->resize(original_size);
+
+    size_t ret = ZSTD_decompress(data->data(), data->size(),
+                                 pack.data().data(), pack.data().size());
+    if (ZSTD_isError(ret))
+    {
+        LOG(LS_WARNING) << "ZSTD_decompress failed: " << ZSTD_getErrorName(ret);
+        return false;
+    }
+
+    if (ret != original_size)
+    {
+        LOG(LS_WARNING) << "Decompressed size mismatch: " << ret << " expected: "
+                        << original_size;
+        return false;
+    }
+
+    return true;
+}
+
+} // namespace
+
+void readFilePack(const proto::FilePackRequest& request, proto::FilePack* pack)
+{
+    std::string data;
+
+    for (const auto& path : request.paths())
+    {
+        const uint64_t max_size = std::min(kMaxPackedFileSize, kMaxFilePackSize - data.size());
+        uint64_t size = 0;
+
+        proto::FilePack::File* file = pack->add_files();
+        file->set_error_code(readFile(base::filePathFromUtf8(path), max_size, &data, &size));
+        file->set_size(size);
+    }
+
+    if (request.compression() == proto::FILE_COMPRESSION_ZSTD && !data.empty())
+    {
+        if (compressData(data, pack))
+            return;
+    }
+
+    pack->set_data(std::move(data));
+}
+
+bool writeFilePack(const proto::FilePack& pack, proto::FilePack* result)
+{
+    if (static_cast<size_t>(pack.files_size()) > kMaxFilePackCount)
+    {
+        LOG(LS_WARNING) << "Too many files in pack: " << pack.files_size();
+        return false;
+    }
+
+    const std::string* data = &pack.data();
+    std::string buffer;
+
+    switch (pack.compression())
+    {
+        case proto::FILE_COMPRESSION_NONE:
+            break;
+
+        case proto::FILE_COMPRESSION_ZSTD:
+        {
+            if (!decompressData(pack, &buffer))
+                return false;
+
+            data = &buffer;
+        }
+        break;
+
+        default:
+        {
+            LOG(LS_WARNING) << "Unknown compression: " << pack.compression();
+            return false;
+        }
+    }
+
+    // The data must consist of the files that the source has read.
+    uint64_t data_size = 0;
+
+    for (const auto& file : pack.files())
+    {
+        if (file.error_code() != proto::FILE_ERROR_SUCCESS)
+            continue;
+
+        if (file.size() > data->size() - data_size)
+        {
+            LOG(LS_WARNING) << "File exceeds the data of pack";
+            return false;
+        }
+
+        data_size += file.size();
+    }
+
+    if (data_size != data->size())
+    {
+        LOG(LS_WARNING) << "Wrong size of the data of pack";
+        return false;
+    }
+
+    size_t offset = 0;
+
+    for (const auto& file : pack.files())
+    {
+        proto::FilePack::File* file_result = result->add_files();
+
+        // The source could not read the file.
+        if (file.error_code() != proto::FILE_ERROR_SUCCESS)
+        {
+            file_result->set_error_code(file.error_code());
+            continue;
+        }
+
+        const size_t size = static_cast<size_t>(file.size());
+
+        file_result->set_error_code(writeFile(
+            base::filePathFromUtf8(file.path()), file.overwrite(), data->data() + offset, size));
+        offset += size;
+    }
+
+    return true;
+}
+
+} // namespace common
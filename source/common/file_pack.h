@@ -0,0 +1,37 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef COMMON__FILE_PACK_H
+#define COMMON__FILE_PACK_H
+
+#include "proto/file_transfer.pb.h"
+
+namespace common {
+
+// Reads the files of |request| into |pack|. The files that can not be read or do not fit into
+// the pack (see kMaxPackedFileSize and kMaxFilePackSize) get an error code. The client transfers
+// them separately.
+void readFilePack(const proto::FilePackRequest& request, proto::FilePack* pack);
+
+// Writes the files of |pack| and sets the result of each of them in |result|. Returns false if
+// the pack is not valid.
+bool writeFilePack(const proto::FilePack& pack, proto::FilePack* result);
+
+} // namespace common
+
+#endif // COMMON__FILE_PACK_H
@@ -0,0 +1,213 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "common/file_pack.h"
+
+#include "base/files/file_util.h"
+#include "base/files/scoped_temp_directory.h"
+#include "common/file_packet.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+namespace common {
+
+namespace {
+
+std::string testData(size_t size, char first)
+{
+    std::string data(size, 0);
+    for (size_t i = 0; i < size; ++i)
+        data[i] = static_cast<char>(first + i % 7);
+    return data;
+}
+
+std::string readTestFile(const std::filesystem::path& path)
+{
+    std::string data;
+    EXPECT_TRUE(base::readFile(path, &data));
+    return data;
+}
+
+// Returns the pack with the files of |request| and the paths of the target.
+proto::FilePack readPack(const proto::FilePackRequest& request,
+                         const std::vector<std::filesystem::path>& target_paths)
+{
+    proto::FilePack pack;
+    readFilePack(request, &pack);
+    EXPECT_EQ(pack.files_size(), static_cast<int>(target_paths.size()));
+
+    for (int i = 0; i < pack.files_size() && i < static_cast<int>(target_paths.size()); ++i)
+        pack.mutable_files(i)->set_path(base::utf8FromFilePath(target_paths[i]));
+
+    return pack;
+}
+
+} // namespace
+
+TEST(FilePackTest, RoundTrip)
+{
+    for (auto compression : { proto::FILE_COMPRESSION_NONE, proto::FILE_COMPRESSION_ZSTD })
+    {
+        base::ScopedTempDirectory directory("aspia_file_pack_test");
+    ASSERT_TRUE(directory.isValid());
+
+        const std::string first = testData(1000, 'a');
+        const std::string second = testData(20000, 'b');
+
+        ASSERT_TRUE(base::writeFile(directory.filePath("1"), first));
+        ASSERT_TRUE(base::writeFile(directory.filePath("2"), std::string_view()));
+        ASSERT_TRUE(base::writeFile(directory.filePath("3"), second));
+
+        proto::FilePackRequest request;
+        request.set_compression(compression);
+        request.add_paths(base::utf8FromFilePath(directory.filePath("1")));
+        request.add_paths(base::utf8FromFilePath(directory.filePath("2")));
+        request.add_paths(base::utf8FromFilePath(directory.filePath("missing")));
+        request.add_paths(base::utf8FromFilePath(directory.filePath("3")));
+
+        proto::FilePack pack = readPack(request,
+            { directory.filePath("1.out"), directory.filePath("2.out"),
+              directory.filePath("missing.out"), directory.filePath("3.out") });
+        EXPECT_EQ(pack.compression(), compression);
+        EXPECT_EQ(pack.files(2).error_code(), proto::FILE_ERROR_FILE_OPEN_ERROR);
+
+        proto::FilePack result;
+        ASSERT_TRUE(writeFilePack(pack, &result));
+        ASSERT_EQ(result.files_size(), 4);
+
+        EXPECT_EQ(result.files(0).error_code(), proto::FILE_ERROR_SUCCESS);
+        EXPECT_EQ(result.files(1).error_code(), proto::FILE_ERROR_SUCCESS);
+        EXPECT_EQ(result.files(2).error_code(), proto::FILE_ERROR_FILE_OPEN_ERROR);
+        EXPECT_EQ(result.files(3).error_code(), proto::FILE_ERROR_SUCCESS);
+
+        EXPECT_EQ(readTestFile(directory.filePath("1.out")), first);
+        EXPECT_TRUE(readTestFile(directory.filePath("2.out")).empty());
+        EXPECT_FALSE(std::filesystem::exists(directory.filePath("missing.out")));
+        EXPECT_EQ(readTestFile(directory.filePath("3.out")), second);
+    }
+}
+
+TEST(FilePackTest, LargeFileIsNotPacked)
+{
+    base::ScopedTempDirectory directory("aspia_file_pack_test");
+    ASSERT_TRUE(directory.isValid());
+
+    ASSERT_TRUE(base::writeFile(directory.filePath("1"), testData(kMaxPackedFileSize + 1, 'a')));
+
+    proto::FilePackRequest request;
+    request.add_paths(base::utf8FromFilePath(directory.filePath("1")));
+
+    proto::FilePack pack;
+    readFilePack(request, &pack);
+    ASSERT_EQ(pack.files_size(), 1);
+    EXPECT_NE(pack.files(0).error_code(), proto::FILE_ERROR_SUCCESS);
+    EXPECT_TRUE(pack.data().empty());
+}
+
+TEST(FilePackTest, ExistingFileIsNotReplaced)
+{
+    base::ScopedTempDirectory directory("aspia_file_pack_test");
+    ASSERT_TRUE(directory.isValid());
+
+    ASSERT_TRUE(base::writeFile(directory.filePath("1"), std::string_view("old")));
+    ASSERT_TRUE(base::writeFile(directory.filePath("2"), std::string_view("old")));
+
+    proto::FilePack pack;
+    pack.set_data("new1new2");
+
+    proto::FilePack::File* file = pack.add_files();
+    file->set_path(base::utf8FromFilePath(directory.filePath("1")));
+    file->set_error_code(proto::FILE_ERROR_SUCCESS);
+    file->set_size(4);
+
+    file = pack.add_files();
+    file->set_path(base::utf8FromFilePath(directory.filePath("2")));
+    file->set_error_code(proto::FILE_ERROR_SUCCESS);
+    file->set_overwrite(true);
+    file->set_size(4);
+
+    proto::FilePack result;
+    ASSERT_TRUE(writeFilePack(pack, &result));
+    ASSERT_EQ(result.files_size(), 2);
+
+    EXPECT_EQ(result.files(0).error_code(), proto::FILE_ERROR_PATH_ALREADY_EXISTS);
+    EXPECT_EQ(result.files(1).error_code(), proto::FILE_ERROR_SUCCESS);
+    EXPECT_EQ(readTestFile(directory.filePath("1")), "old");
+    EXPECT_EQ(readTestFile(directory.filePath("2")), "new2");
+}
+
+TEST(FilePackTest, WrongSizes)
+{
+    base::ScopedTempDirectory directory("aspia_file_pack_test");
+    ASSERT_TRUE(directory.isValid());
+
+    proto::FilePack pack;
+    pack.set_data("12345678");
+
+    proto::FilePack::File* file = pack.add_files();
+    file->set_path(base::utf8FromFilePath(directory.filePath("1")));
+    file->set_error_code(proto::FILE_ERROR_SUCCESS);
+    file->set_size(4);
+
+    // The data is longer than the files.
+    proto::FilePack result;
+    EXPECT_FALSE(writeFilePack(pack, &result));
+
+    // The file exceeds the data.
+    file->set_size(9);
+    EXPECT_FALSE(writeFilePack(pack, &result));
+    EXPECT_FALSE(std::filesystem::exists(directory.filePath("1")));
+
+    // The size of a file that has not been read does not count.
+    file->set_size(8);
+    file = pack.add_files();
+    file->set_error_code(proto::FILE_ERROR_FILE_OPEN_ERROR);
+    file->set_size(100);
+    EXPECT_TRUE(writeFilePack(pack, &result));
+    EXPECT_EQ(readTestFile(directory.filePath("1")), "12345678");
+
+    // The size after the decompression does not match.
+    proto::FilePack compressed;
+    compressed.set_compression(proto::FILE_COMPRESSION_ZSTD);
+    compressed.set_original_size(8);
+    compressed.set_data("not a zstd frame");
+    file = compressed.add_files();
+    file->set_error_code(proto::FILE_ERROR_SUCCESS);
+    file->set_size(8);
+    EXPECT_FALSE(writeFilePack(compressed, &result));
+
+    compressed.set_original_size(kMaxFilePackSize + 1);
+    EXPECT_FALSE(writeFilePack(compressed, &result));
+}
+
+TEST(FilePackTest, TooManyFiles)
+{
+    proto::FilePack pack;
+
+    for (size_t i = 0; i <= kMaxFilePackCount; ++i)
+        pack.add_files()->set_error_code(proto::FILE_ERROR_FILE_OPEN_ERROR);
+
+    proto::FilePack result;
+    EXPECT_FALSE(writeFilePack(pack, &result));
+    EXPECT_EQ(result.files_size(), 0);
+}
+
+} // namespace common
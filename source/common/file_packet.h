@@ -19,11 +19,40 @@
 #ifndef COMMON__FILE_PACKET_H
 #define COMMON__FILE_PACKET_H
 
+#include <cstddef>
+#include <cstdint>
+
 namespace common {
 
 // When transferring a file is divided into parts and each part is transmitted separately.
-// This parameter specifies the size of the part.
-static const size_t kMaxFilePacketSize = 16 * 1024; // 16 kB
+// The target chooses the size of the part in the packet request within the limits below. The
+// default size is used if the request does not specify the size (peers of older versions).
+static const uint32_t kDefaultFilePacketSize = 16 * 1024; // 16 kB
+static const uint32_t kMinFilePacketSize = 16 * 1024; // 16 kB
+static const uint32_t kMaxFilePacketSize = 4 * 1024 * 1024; // 4 MB
+
+// Maximum number of bytes of a file that can be in flight between the source and the target.
+// Packets are requested ahead until the window is filled, so the transfer speed does not depend
+// on the round trip time of the connection as long as the window covers the bandwidth-delay
+// product.
+static const uint32_t kMaxFileWindowSize = 16 * 1024 * 1024; // 16 MB
+
+// Maximum number of files that can be open for transfer at the same time. Each file has its own
+// stream and its own window.
+static const uint32_t kMaxFileStreamCount = 16;
+
+// Files smaller than this are sent whole. The delta transfer would save less than its
+// additional round trip costs.
+static const uint64_t kMinDeltaFileSize = 1024 * 1024; // 1 MB
+
+// Files up to this size are transferred in packs (see proto::FilePackRequest). Opening a file
+// and transferring its packets separately costs several round trips, which take longer than the
+// transfer of the data of a small file.
+static const uint64_t kMaxPackedFileSize = 64 * 1024; // 64 kB
+
+// Maximum number of files and size of the data of one pack.
+static const size_t kMaxFilePackCount = 1024;
+static const uint64_t kMaxFilePackSize = 1024 * 1024; // 1 MB
 
 } // namespace common
 
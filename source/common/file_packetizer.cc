@@ -19,12 +19,39 @@
 #include "common/file_packetizer.h"
 
 #include "base/logging.h"
+#include "base/strings/string_util.h"
+#include "common/file_delta.h"
 #include "common/file_packet.h"
 
+#include <algorithm>
+#include <chrono>
+
 namespace common {
 
 namespace {
 
+// Size of the part of the file that the system reads ahead of the packets.
+const uint64_t kReadAheadSize = 8 * 1024 * 1024;
+
+// The default level of ZSTD. It compresses several hundred MB/s on one thread, which is faster
+// than the most connections.
+const int kCompressionLevel = 3;
+
+// The compression is stopped if it saves less than 5 percent of this amount of data.
+const uint64_t kCompressionProbeSize = 1024 * 1024;
+const uint64_t kMaxCompressedPercent = 95;
+
+// Extensions of the formats that are already compressed.
+
+const char16_t* kCompressedExtensions[] =
+{
+    u".7z", u".aac", u".apk", u".avi", u".br", u".bz2", u".cab", u".docx", u".flac", u".gif",
+    u".gz", u".heic", u".jar", u".jpeg", u".jpg", u".lz", u".lz4", u".lzma", u".m4a", u".m4v",
+    u".mkv", u".mov", u".mp3", u".mp4", u".msi", u".odp", u".ods", u".odt", u".ogg", u".opus",
+    u".png", u".pptx", u".rar", u".tgz", u".txz", u".webm", u".webp", u".wmv", u".xlsx", u".xz",
+    u".zip", u".zst"
+};
+
 char* outputBuffer(proto::FilePacket* packet, size_t size)
 {
     packet->mutable_data()->resize(size);
@@ -33,71 +60,97 @@ char* outputBuffer(proto::FilePacket* packet, size_t size)
 
 } // namespace
 
-FilePacketizer::FilePacketizer(std::ifstream&& file_stream)
-    : file_stream_(std::move(file_stream))
+FilePacketizer::FilePacketizer(
+    std::unique_ptr<base::File> file, uint64_t file_size, bool compressible)
+    : file_(std::move(file)),
+      file_size_(file_size),
+      left_size_(file_size),
+      compressible_(compressible)
 {
-    file_stream_.seekg(0, file_stream_.end);
-    file_size_ = file_stream_.tellg();
-    file_stream_.seekg(0);
-    left_size_ = file_size_;
+    // Nothing
 }
 
+FilePacketizer::~FilePacketizer() = default;
+
+// static
 std::unique_ptr<FilePacketizer> FilePacketizer::create(const std::filesystem::path& file_path)
 {
-    std::ifstream file_stream;
+    std::unique_ptr<base::File> file = base::File::openForReading(file_path);
+    if (!file)
+        return nullptr;
 
-    file_stream.open(file_path, std::ifstream::binary);
-    if (!file_stream.is_open())
+    int64_t file_size = file->size();
+    if (file_size < 0)
         return nullptr;
 
-    return std::unique_ptr<FilePacketizer>(new FilePacketizer(std::move(file_stream)));
+    return std::unique_ptr<FilePacketizer>(
+        new FilePacketizer(std::move(file), static_cast<uint64_t>(file_size),
+                           isCompressible(file_path)));
 }
 
 std::unique_ptr<proto::FilePacket> FilePacketizer::readNextPacket(
     const proto::FilePacketRequest& request)
 {
-    DCHECK(file_stream_.is_open());
+    DCHECK(file_);
 
-    // Create a new file packet.
-    std::unique_ptr<proto::FilePacket> packet = std::make_unique<proto::FilePacket>();
+    std::unique_ptr<proto::FilePacket> packet;
+    packet.swap(prefetched_packet_);
 
     if (request.flags() & proto::FilePacketRequest::CANCEL)
     {
+        // Create a new file packet.
+        packet = std::make_unique<proto::FilePacket>();
         packet->set_flags(proto::FilePacket::LAST_PACKET);
         return packet;
     }
 
-    size_t packet_buffer_size = kMaxFilePacketSize;
-
-    if (left_size_ < kMaxFilePacketSize)
-        packet_buffer_size = static_cast<size_t>(left_size_);
+    const uint32_t packet_size = packetSize(request.packet_size());
+    const size_t packet_buffer_size =
+        static_cast<size_t>(std::min<uint64_t>(left_size_, packet_size));
 
-    char* packet_buffer = outputBuffer(packet.get(), packet_buffer_size);
+    if (delta_encoder_)
+    {
+        packet = readDelta(packet_buffer_size, packet_size);
+        if (!packet)
+            return nullptr;
+    }
+    else if (!packet || packet->data().size() != packet_buffer_size)
+    {
+        // The prefetched data is used if the packet size has not changed since then.
+        packet = readData(packet_buffer_size, packet_size);
+        if (!packet)
+            return nullptr;
+    }
 
-    // Moving to a new position in file.
-    file_stream_.seekg(file_size_ - left_size_);
+    // The stream can not be resumed after an uncompressed packet.
+    if (request.compression() != proto::FILE_COMPRESSION_ZSTD)
+        compressible_ = false;
 
-    file_stream_.read(packet_buffer, packet_buffer_size);
-    if (file_stream_.fail())
+    if (compressible_ && !packet->data().empty())
     {
-        LOG(LS_WARNING) << "Unable to read file";
-        return nullptr;
+        if (!compressPacket(packet.get(), packet_buffer_size == left_size_))
+            return nullptr;
     }
 
-    if (left_size_ == file_size_)
+    if (left_size_ + resume_size_ == file_size_)
     {
         packet->set_flags(packet->flags() | proto::FilePacket::FIRST_PACKET);
 
         // Set file path and size in first packet.
         packet->set_file_size(file_size_);
+        packet->set_offset(resume_size_);
     }
 
     left_size_ -= packet_buffer_size;
 
     if (!left_size_)
     {
+        if (file_hash_)
+            packet->set_file_hash(base::toStdString(file_hash_->result()));
+
         file_size_ = 0;
-        file_stream_.close();
+        resume_size_ = 0;
+        file_.reset();
 
         packet->set_flags(packet->flags() | proto::FilePacket::LAST_PACKET);
     }
@@ -105,4 +158,206 @@ std::unique_ptr<proto::FilePacket> FilePacketizer::readNextPacket(
     return packet;
 }
 
+bool FilePacketizer::startDelta(const proto::FileSignature& signature, uint64_t* resume_size)
+{
+    DCHECK(file_);
+
+    if (left_size_ != file_size_ || delta_encoder_)
+    {
+        LOG(LS_WARNING) << "Delta transfer after the first packet";
+        return false;
+    }
+
+    delta_encoder_ = FileDeltaEncoder::create(signature);
+    if (!delta_encoder_)
+        return false;
+
+    prefetched_packet_.reset();
+    file_hash_ = std::make_unique<base::GenericHash>(base::GenericHash::BLAKE2b512);
+
+    *resume_size = 0;
+
+    if (!signature.resume_size() || signature.resume_size() > file_size_)
+        return true;
+
+    base::GenericHash resume_hash(base::GenericHash::BLAKE2b512);
+
+    if (!hashFile(file_.get(), signature.resume_size(), &resume_hash, file_hash_.get()))
+    {
+        LOG(LS_WARNING) << "Unable to read file";
+        return false;
+    }
+
+    if (base::toStdString(resume_hash.result()) != signature.resume_hash())
+    {
+        // The file has changed since the interrupted transfer.
+        file_hash_->reset();
+        return true;
+    }
+
+    resume_size_ = signature.resume_size();
+    left_size_ -= resume_size_;
+
+    *resume_size = resume_size_;
+    return true;
+}
+
+void FilePacketizer::prefetchNextPacket(uint32_t packet_size)
+{
+    if (!file_ || !left_size_ || prefetched_packet_ || delta_encoder_)
+        return;
+
+    packet_size = packetSize(packet_size);
+
+    // A read error is reported by the next readNextPacket call.
+    prefetched_packet_ = readData(
+        static_cast<size_t>(std::min<uint64_t>(left_size_, packet_size)), packet_size);
+}
+
+// static
+bool FilePacketizer::isCompressible(const std::filesystem::path& file_path)
+{
+    std::u16string extension = base::toLowerASCII(file_path.extension().u16string());
+
+    for (const char16_t* compressed_extension : kCompressedExtensions)
+    {
+        if (extension == compressed_extension)
+            return false;
+    }
+
+    return true;
+}
+
+// static
+uint32_t FilePacketizer::packetSize(uint32_t requested_size)
+{
+    if (!requested_size)
+        return kDefaultFilePacketSize;
+
+    return std::clamp(requested_size, kMinFilePacketSize, kMaxFilePacketSize);
+}
+
+std::unique_ptr<proto::FilePacket> FilePacketizer::readData(size_t size, uint32_t packet_size)
+{
+    const uint64_t offset = file_size_ - left_size_;
+
+    // Keep the system reading the file ahead of the packets, so that the next packets are read
+    // from the cache while the current ones are sent.
+    if (offset + size + packet_size > read_ahead_offset_ && read_ahead_offset_ < file_size_)
+    {
+        uint64_t read_ahead_begin = std::max(read_ahead_offset_, offset);
+        read_ahead_offset_ =
+            std::min(offset + std::max<uint64_t>(kReadAheadSize, packet_size * 2), file_size_);
+
+        file_->readAhead(read_ahead_begin, read_ahead_offset_ - read_ahead_begin);
+    }
+
+    std::unique_ptr<proto::FilePacket> packet = std::make_unique<proto::FilePacket>();
+
+    // The data is read directly into the packet.
+    char* packet_buffer = outputBuffer(packet.get(), size);
+
+    if (!file_->read(offset, packet_buffer, size))
+    {
+        LOG(LS_WARNING) << "Unable to read file";
+        return nullptr;
+    }
+
+    return packet;
+}
+
+std::unique_ptr<proto::FilePacket> FilePacketizer::readDelta(size_t size, uint32_t packet_size)
+{
+    // The blocks that start at the end of the packet are looked for in the data after it.
+    const size_t available_size = static_cast<size_t>(
+        std::min<uint64_t>(left_size_, size + delta_encoder_->lookaheadSize()));
+
+    std::unique_ptr<proto::FilePacket> data = readData(available_size, packet_size);
+    if (!data)
+        return nullptr;
+
+    const uint8_t* buffer = reinterpret_cast<const uint8_t*>(data->data().data());
+    file_hash_->addData(buffer, size);
+
+    std::unique_ptr<proto::FilePacket> packet = std::make_unique<proto::FilePacket>();
+    delta_encoder_->encode(buffer, size, available_size, available_size == left_size_,
+                           packet.get());
+    return packet;
+}
+
+bool FilePacketizer::compressPacket(proto::FilePacket* packet, bool last_packet)
+{
+    const std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+
+    if (!stream_)
+    {
+        stream_.reset(ZSTD_createCStream());
+
+        ZSTD_CCtx_setParameter(stream_.get(), ZSTD_c_compressionLevel, kCompressionLevel);
+        ZSTD_CCtx_setParameter(stream_.get(), ZSTD_c_checksumFlag, 1);
+
+        // The size of the data of the delta transfer is not known in advance.
+        if (!delta_encoder_)
+            ZSTD_CCtx_setPledgedSrcSize(stream_.get(), file_size_);
+    }
+
+    const std::string& input_data = packet->data();
+
+    std::string output_data;
+    output_data.resize(ZSTD_compressBound(input_data.size()));
+
+    ZSTD_inBuffer input = { input_data.data(), input_data.size(), 0 };
+    ZSTD_outBuffer output = { output_data.data(), output_data.size(), 0 };
+
+    // Each packet is flushed, so that the target can decompress it without the next packets.
+    const ZSTD_EndDirective directive = last_packet ? ZSTD_e_end : ZSTD_e_flush;
+
+    for (;;)
+    {
+        size_t ret = ZSTD_compressStream2(stream_.get(), &output, &input, directive);
+        if (ZSTD_isError(ret))
+        {
+            LOG(LS_WARNING) << "ZSTD_compressStream2 failed: " << ZSTD_getErrorName(ret);
+            return false;
+        }
+
+        if (!ret)
+            break;
+
+        output_data.resize(output_data.size() * 2);
+        output.dst = output_data.data();
+        output.size = output_data.size();
+    }
+
+    output_data.resize(output.pos);
+
+    compress_input_size_ += input_data.size();
+    compress_output_size_ += output_data.size();
+
+    // Stop compressing the data that does not compress. The ratio is checked for each part of
+    // the file, because a file may contain the compressed data after the uncompressed one (for
+    // example, an archive without compression of media files).
+    if (compress_input_size_ >= kCompressionProbeSize)
+    {
+        if (compress_output_size_ * 100 > compress_input_size_ * kMaxCompressedPercent)
+        {
+            compressible_ = false;
+            stream_.reset();
+        }
+
+        compress_input_size_ = 0;
+        compress_output_size_ = 0;
+    }
+
+    const std::chrono::microseconds compress_time =
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start_time);
+
+    packet->set_compression(proto::FILE_COMPRESSION_ZSTD);
+    packet->set_original_size(static_cast<uint32_t>(input_data.size()));
+    packet->set_compress_time(static_cast<uint32_t>(compress_time.count()));
+    packet->mutable_data()->swap(output_data);
+    return true;
+}
+
 } // namespace common
@@ -20,35 +20,81 @@
 #define COMMON__FILE_PACKETIZER_H
 
 #include "base/macros_magic.h"
+#include "base/codec/scoped_zstd_stream.h"
+#include "base/crypto/generic_hash.h"
+#include "base/files/file.h"
 #include "proto/file_transfer.pb.h"
 
 #include <filesystem>
-#include <fstream>
 #include <memory>
 
 namespace common {
 
+class FileDeltaEncoder;
+
 class FilePacketizer
 {
 public:
-    ~FilePacketizer() = default;
+    ~FilePacketizer();
 
     // Creates an instance of the class.
     // Parameter |file_path| contains the full path to the file.
     // If the specified file can not be opened for reading, then returns nullptr.
     static std::unique_ptr<FilePacketizer> create(const std::filesystem::path& file_path);
 
-    // Creates a packet for transferring.
+    // Creates a packet for transferring. If the request allows the compression, the data is
+    // compressed unless the file does not compress (see isCompressible).
     std::unique_ptr<proto::FilePacket> readNextPacket(const proto::FilePacketRequest& request);
 
+    // Starts the delta transfer to the target that has the data described by |signature|. Must be
+    // called before the first packet. If the file starts with the data of the interrupted
+    // transfer, the packets start after it and |resume_size| receives its size. Returns false if
+    // the signature is not valid or the file can not be read.
+    bool startDelta(const proto::FileSignature& signature, uint64_t* resume_size);
+
+    // Reads the data of the next packet in advance, so that it is ready when the request for it
+    // comes. |packet_size| is the size of the last requested packet.
+    void prefetchNextPacket(uint32_t packet_size);
+
+    uint64_t fileSize() const { return file_size_; }
+
 private:
-    explicit FilePacketizer(std::ifstream&& file_stream);
+    FilePacketizer(std::unique_ptr<base::File> file, uint64_t file_size, bool compressible);
+
+    // Returns false for the files of the formats that are already compressed (archives, images,
+    // video, etc.).
+    static bool isCompressible(const std::filesystem::path& file_path);
+
+    static uint32_t packetSize(uint32_t requested_size);
+    std::unique_ptr<proto::FilePacket> readData(size_t size, uint32_t packet_size);
+    std::unique_ptr<proto::FilePacket> readDelta(size_t size, uint32_t packet_size);
+    bool compressPacket(proto::FilePacket* packet, bool last_packet);
 
-    std::ifstream file_stream_;
+    std::unique_ptr<base::File> file_;
 
     uint64_t file_size_ = 0;
     uint64_t left_size_ = 0;
 
+    // Offset up to which the system was asked to read the file ahead.
+    uint64_t read_ahead_offset_ = 0;
+
+    // Data of the next packet read by prefetchNextPacket.
+    std::unique_ptr<proto::FilePacket> prefetched_packet_;
+
+    // All packets of the file are compressed in one stream. Once a packet is sent uncompressed,
+    // the rest of the file is also sent uncompressed.
+    bool compressible_ = false;
+    base::ScopedZstdCStream stream_;
+
+    // Size of the data compressed since the last check of the compression ratio.
+    uint64_t compress_input_size_ = 0;
+    uint64_t compress_output_size_ = 0;
+
+    // Delta transfer (see startDelta). The hash of the whole file is sent in the last packet.
+    std::unique_ptr<FileDeltaEncoder> delta_encoder_;
+    std::unique_ptr<base::GenericHash> file_hash_;
+    uint64_t resume_size_ = 0;
+
     DISALLOW_COPY_AND_ASSIGN(FilePacketizer);
 };
 
@@ -21,6 +21,8 @@
 #include "base/logging.h"
 #include "proto/file_transfer.pb.h"
 
+#include <atomic>
+
 namespace common {
 
 FileTaskFactory::FileTaskFactory(
@@ -48,6 +50,13 @@ std::shared_ptr<FileTask> FileTaskFactory::fileList(const std::string& path)
     return makeTask(std::move(request));
 }
 
+std::shared_ptr<FileTask> FileTaskFactory::fileTree(const std::string& path)
+{
+    auto request = std::make_unique<proto::FileRequest>();
+    request->mutable_file_tree_request()->set_path(path);
+    return makeTask(std::move(request));
+}
+
 std::shared_ptr<FileTask> FileTaskFactory::createDirectory(const std::string& path)
 {
     auto request = std::make_unique<proto::FileRequest>();
@@ -74,47 +83,114 @@ std::shared_ptr<FileTask> FileTaskFactory::remove(const std::string& path)
     return makeTask(std::move(request));
 }
 
-std::shared_ptr<FileTask> FileTaskFactory::download(const std::string& file_path)
+std::shared_ptr<FileTask> FileTaskFactory::download(
+    const std::string& file_path, uint32_t window_size, uint32_t stream_id)
 {
     auto request = std::make_unique<proto::FileRequest>();
-    request->mutable_download_request()->set_path(file_path);
+    request->set_stream_id(stream_id);
+
+    proto::DownloadRequest* download_request = request->mutable_download_request();
+    download_request->set_path(file_path);
+    download_request->set_window_size(window_size);
+
     return makeTask(std::move(request));
 }
 
-std::shared_ptr<FileTask> FileTaskFactory::upload(const std::string& file_path, bool overwrite)
+std::shared_ptr<FileTask> FileTaskFactory::upload(const std::string& file_path,
+                                                  bool overwrite,
+                                                  bool delta,
+                                                  uint32_t window_size,
+                                                  uint32_t stream_id)
 {
     auto request = std::make_unique<proto::FileRequest>();
+    request->set_stream_id(stream_id);
 
     proto::UploadRequest* upload_request = request->mutable_upload_request();
     upload_request->set_path(file_path);
     upload_request->set_overwrite(overwrite);
+    upload_request->set_window_size(window_size);
+    upload_request->set_delta(delta);
 
     return makeTask(std::move(request));
 }
 
-std::shared_ptr<FileTask> FileTaskFactory::packetRequest(uint32_t flags)
+std::shared_ptr<FileTask> FileTaskFactory::delta(
+    const proto::FileSignature& signature, uint32_t stream_id)
 {
     auto request = std::make_unique<proto::FileRequest>();
+    request->set_stream_id(stream_id);
+    request->mutable_delta_request()->mutable_signature()->CopyFrom(signature);
+    return makeTask(std::move(request));
+}
+
+std::shared_ptr<FileTask> FileTaskFactory::packetRequest(uint32_t flags,
+                                                         uint32_t packet_size,
+                                                         proto::FileCompression compression,
+                                                         uint32_t stream_id)
+{
+    auto request = std::make_unique<proto::FileRequest>();
+    request->set_stream_id(stream_id);
     request->mutable_packet_request()->set_flags(flags);
+    request->mutable_packet_request()->set_packet_size(packet_size);
+    request->mutable_packet_request()->set_compression(compression);
     return makeTask(std::move(request));
 }
 
-std::shared_ptr<FileTask> FileTaskFactory::packet(const proto::FilePacket& packet)
+std::shared_ptr<FileTask> FileTaskFactory::packet(
+    const proto::FilePacket& packet, uint32_t stream_id)
 {
     auto request = std::make_unique<proto::FileRequest>();
+    request->set_stream_id(stream_id);
     request->mutable_packet()->CopyFrom(packet);
     return makeTask(std::move(request));
 }
 
-std::shared_ptr<FileTask> FileTaskFactory::packet(std::unique_ptr<proto::FilePacket> packet)
+std::shared_ptr<FileTask> FileTaskFactory::packet(
+    std::unique_ptr<proto::FilePacket> packet, uint32_t stream_id)
 {
     auto request = std::make_unique<proto::FileRequest>();
+    request->set_stream_id(stream_id);
     request->set_allocated_packet(packet.release());
     return makeTask(std::move(request));
 }
 
+std::shared_ptr<FileTask> FileTaskFactory::packRequest(const std::vector<std::string>& paths,
+                                                       proto::FileCompression compression,
+                                                       uint32_t stream_id)
+{
+    auto request = std::make_unique<proto::FileRequest>();
+    request->set_stream_id(stream_id);
+
+    proto::FilePackRequest* pack_request = request->mutable_pack_request();
+    for (const auto& path : paths)
+        pack_request->add_paths(path);
+    pack_request->set_compression(compression);
+
+    return makeTask(std::move(request));
+}
+
+std::shared_ptr<FileTask> FileTaskFactory::pack(
+    std::unique_ptr<proto::FilePack> pack, uint32_t stream_id)
+{
+    auto request = std::make_unique<proto::FileRequest>();
+    request->set_stream_id(stream_id);
+    request->set_allocated_pack(pack.release());
+    return makeTask(std::move(request));
+}
+
 std::shared_ptr<FileTask> FileTaskFactory::makeTask(std::unique_ptr<proto::FileRequest> request)
 {
+    // The requests of all factories share one numbering because the remote tasks of different
+    // factories (for example, of the transfer and its queue builder) wait in the same queue.
+    static std::atomic_uint32_t last_request_id = 0;
+
+    uint32_t request_id = ++last_request_id;
+
+    // Zero means a request without identifier.
+    if (!request_id)
+        request_id = ++last_request_id;
+
+    request->set_request_id(request_id);
     return std::make_shared<FileTask>(producer_proxy_, std::move(request), target_);
 }
 
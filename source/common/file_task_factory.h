@@ -20,12 +20,10 @@
 #define CLIENT__FILE_TASK_FACTORY_H
 
 #include "common/file_task.h"
+#include "proto/file_transfer.pb.h"
 
 #include <string>
-
-namespace proto {
-class FilePacket;
-} // namespace proto
+#include <vector>
 
 namespace common {
 
@@ -39,14 +37,29 @@ public:
 
     std::shared_ptr<FileTask> driveList();
     std::shared_ptr<FileTask> fileList(const std::string& path);
+    std::shared_ptr<FileTask> fileTree(const std::string& path);
     std::shared_ptr<FileTask> createDirectory(const std::string& path);
     std::shared_ptr<FileTask> rename(const std::string& old_name, const std::string& new_name);
     std::shared_ptr<FileTask> remove(const std::string& path);
-    std::shared_ptr<FileTask> download(const std::string& file_path);
-    std::shared_ptr<FileTask> upload(const std::string& file_path, bool overwrite);
-    std::shared_ptr<FileTask> packetRequest(uint32_t flags);
-    std::shared_ptr<FileTask> packet(const proto::FilePacket& packet);
-    std::shared_ptr<FileTask> packet(std::unique_ptr<proto::FilePacket> packet);
+    std::shared_ptr<FileTask> download(
+        const std::string& file_path, uint32_t window_size, uint32_t stream_id);
+    std::shared_ptr<FileTask> upload(const std::string& file_path,
+                                     bool overwrite,
+                                     bool delta,
+                                     uint32_t window_size,
+                                     uint32_t stream_id);
+    std::shared_ptr<FileTask> delta(const proto::FileSignature& signature, uint32_t stream_id);
+    std::shared_ptr<FileTask> packetRequest(uint32_t flags,
+                                            uint32_t packet_size,
+                                            proto::FileCompression compression,
+                                            uint32_t stream_id);
+    std::shared_ptr<FileTask> packet(const proto::FilePacket& packet, uint32_t stream_id);
+    std::shared_ptr<FileTask> packet(
+        std::unique_ptr<proto::FilePacket> packet, uint32_t stream_id);
+    std::shared_ptr<FileTask> packRequest(const std::vector<std::string>& paths,
+                                          proto::FileCompression compression,
+                                          uint32_t stream_id);
+    std::shared_ptr<FileTask> pack(std::unique_ptr<proto::FilePack> pack, uint32_t stream_id);
 
 private:
     std::shared_ptr<FileTask> makeTask(std::unique_ptr<proto::FileRequest> request);
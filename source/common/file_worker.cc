@@ -21,8 +21,11 @@
 #include "base/logging.h"
 #include "base/task_runner.h"
 #include "base/files/base_paths.h"
+#include "base/files/file_util.h"
 #include "build/build_config.h"
 #include "common/file_depacketizer.h"
+#include "common/file_pack.h"
+#include "common/file_packet.h"
 #include "common/file_packetizer.h"
 #include "common/file_platform_util.h"
 #include "common/file_task.h"
@@ -32,12 +35,63 @@
 #include "common/win/file_enumerator.h"
 #endif // defined(OS_WIN)
 
+#include <algorithm>
+#include <array>
+#include <deque>
+#include <functional>
+
 namespace common {
 
+namespace {
+
+// Maximum number of items in one part of a file tree.
+const int kMaxFileTreePartSize = 2048;
+
+// Each open file (stream) has its own order of execution (lane). The other lanes follow them.
+const size_t kListLane = kMaxFileStreamCount;
+const size_t kTreeLane = kListLane + 1;
+const size_t kChangeLane = kTreeLane + 1;
+const size_t kLaneCount = kChangeLane + 1;
+
+size_t laneIndex(const proto::FileRequest& request)
+{
+    if (request.has_file_tree_request())
+        return kTreeLane;
+
+    if (request.has_create_directory_request() || request.has_rename_request() ||
+        request.has_remove_request())
+    {
+        return kChangeLane;
+    }
+
+    if (request.has_download_request() || request.has_upload_request() ||
+        request.has_delta_request() || request.has_packet_request() || request.has_packet() ||
+        request.has_pack_request() || request.has_pack())
+    {
+        // The requests with an invalid stream are rejected in the list lane.
+        if (request.stream_id() < kMaxFileStreamCount)
+            return request.stream_id();
+    }
+
+    return kListLane;
+}
+
+// Returns true if the request reads or opens a path, so it must see the changes of the file
+// system requested before it.
+bool dependsOnChanges(const proto::FileRequest& request)
+{
+    return request.has_file_list_request() || request.has_file_tree_request() ||
+           request.has_download_request() || request.has_upload_request() ||
+           request.has_pack_request() || request.has_pack();
+}
+
+} // namespace
+
 class FileWorker::Impl : public std::enable_shared_from_this<Impl>
 {
 public:
-    explicit Impl(std::shared_ptr<base::TaskRunner> task_runner);
+    Impl(std::shared_ptr<base::TaskRunner> task_runner,
+         std::vector<std::shared_ptr<base::TaskRunner>> io_task_runners);
     ~Impl();
 
     void doTask(std::shared_ptr<FileTask> task);
@@ -45,28 +99,103 @@ public:
     std::shared_ptr<base::TaskRunner> taskRunner() { return task_runner_; }
 
 private:
+    struct Job
+    {
+        // The task is null for reading of the next packet in advance.
+        std::shared_ptr<FileTask> task;
+        std::unique_ptr<proto::FileReply> reply;
+
+        // Number of changes of the file system that must be done before the job starts.
+        uint64_t changes_before = 0;
+
+        // Size of the packet to read in advance.
+        uint32_t prefetch_size = 0;
+
+        // Set on |task_runner_| when the job is finished. Unlike |reply|, it is never written on
+        // the I/O task runners.
+        bool done = false;
+    };
+
+    struct Lane
+    {
+        std::deque<std::shared_ptr<Job>> jobs;
+
+        // I/O task runner of the running first job or -1 if the lane is idle.
+        int io_index = -1;
+    };
+
+    // The methods below are called on |task_runner_|.
+    void addJob(std::shared_ptr<FileTask> task);
+    void runJob(size_t lane_index);
+    void onJobDone(size_t lane_index);
+    void setReplies(Job* job);
+
+    // Called on one of |io_task_runners_|.
+    void doJob(Job* job, size_t lane_index);
+
     std::unique_ptr<proto::FileReply> doRequest(const proto::FileRequest& request);
     std::unique_ptr<proto::FileReply> doDriveListRequest();
     std::unique_ptr<proto::FileReply> doFileListRequest(const proto::FileListRequest& request);
+    std::unique_ptr<proto::FileReply> doFileTreeRequest(const proto::FileTreeRequest& request);
     std::unique_ptr<proto::FileReply> doCreateDirectoryRequest(const proto::CreateDirectoryRequest& request);
     std::unique_ptr<proto::FileReply> doRenameRequest(const proto::RenameRequest& request);
     std::unique_ptr<proto::FileReply> doRemoveRequest(const proto::RemoveRequest& request);
-    std::unique_ptr<proto::FileReply> doDownloadRequest(const proto::DownloadRequest& request);
-    std::unique_ptr<proto::FileReply> doUploadRequest(const proto::UploadRequest& request);
-    std::unique_ptr<proto::FileReply> doPacketRequest(const proto::FilePacketRequest& request);
-    std::unique_ptr<proto::FileReply> doPacket(const proto::FilePacket& packet);
+    std::unique_ptr<proto::FileReply> doDownloadRequest(
+        const proto::DownloadRequest& request, uint32_t stream_id);
+    std::unique_ptr<proto::FileReply> doUploadRequest(
+        const proto::UploadRequest& request, uint32_t stream_id);
+    std::unique_ptr<proto::FileReply> doDeltaRequest(
+        const proto::FileDeltaRequest& request, uint32_t stream_id);
+    std::unique_ptr<proto::FileReply> doPacketRequest(
+        const proto::FilePacketRequest& request, uint32_t stream_id);
+    std::unique_ptr<proto::FileReply> doPacket(const proto::FilePacket& packet, uint32_t stream_id);
+    std::unique_ptr<proto::FileReply> doPackRequest(
+        const proto::FilePackRequest& request, uint32_t stream_id);
+    std::unique_ptr<proto::FileReply> doPack(const proto::FilePack& pack, uint32_t stream_id);
 
     std::shared_ptr<base::TaskRunner> task_runner_;
-    std::unique_ptr<FileDepacketizer> depacketizer_;
-    std::unique_ptr<FilePacketizer> packetizer_;
+    std::vector<std::shared_ptr<base::TaskRunner>> io_task_runners_;
+
+    // Number of running jobs on each I/O task runner.
+    std::vector<size_t> io_load_;
+
+    std::array<Lane, kLaneCount> lanes_;
+
+    // Jobs of the requests without identifier in the order of the requests.
+    std::deque<std::shared_ptr<Job>> ordered_jobs_;
+
+    uint64_t changes_requested_ = 0;
+    uint64_t changes_done_ = 0;
+
+    // Open files by stream. Each stream has at most one file open for reading or writing. The
+    // files of a stream are used only by the jobs of its lane.
+    std::array<std::unique_ptr<FileDepacketizer>, kMaxFileStreamCount> depacketizers_;
+    std::array<std::unique_ptr<FilePacketizer>, kMaxFileStreamCount> packetizers_;
+
+    // Directories of the file tree being enumerated. The last one is the deepest.
+    struct TreeLevel
+    {
+        std::filesystem::path path;
+        std::string relative_path;
+        std::unique_ptr<FileEnumerator> enumerator;
+    };
+
+    std::vector<TreeLevel> tree_;
 
     DISALLOW_COPY_AND_ASSIGN(Impl);
 };
 
-FileWorker::Impl::Impl(std::shared_ptr<base::TaskRunner> task_runner)
-    : task_runner_(std::move(task_runner))
+FileWorker::Impl::Impl(std::shared_ptr<base::TaskRunner> task_runner,
+                       std::vector<std::shared_ptr<base::TaskRunner>> io_task_runners)
+    : task_runner_(std::move(task_runner)),
+      io_task_runners_(std::move(io_task_runners))
 {
     DCHECK(task_runner_);
+
+    if (io_task_runners_.empty())
+        io_task_runners_.emplace_back(task_runner_);
+
+    io_load_.resize(io_task_runners_.size());
 }
 
 FileWorker::Impl::~Impl() = default;
@@ -76,10 +205,127 @@ void FileWorker::Impl::doTask(std::shared_ptr<FileTask> task)
     auto self = shared_from_this();
     task_runner_->postTask([self, task]()
     {
-        task->setReply(self->doRequest(task->request()));
+        self->addJob(task);
     });
 }
 
+void FileWorker::Impl::addJob(std::shared_ptr<FileTask> task)
+{
+    const proto::FileRequest& request = task->request();
+    const size_t lane_index = laneIndex(request);
+
+    std::shared_ptr<Job> job = std::make_shared<Job>();
+    job->task = std::move(task);
+
+    if (lane_index == kChangeLane)
+        ++changes_requested_;
+    else if (dependsOnChanges(request))
+        job->changes_before = changes_requested_;
+
+    if (!request.request_id())
+        ordered_jobs_.emplace_back(job);
+
+    lanes_[lane_index].jobs.emplace_back(std::move(job));
+    runJob(lane_index);
+}
+
+void FileWorker::Impl::runJob(size_t lane_index)
+{
+    Lane& lane = lanes_[lane_index];
+
+    if (lane.io_index != -1 || lane.jobs.empty())
+        return;
+
+    std::shared_ptr<Job> job = lane.jobs.front();
+    if (job->changes_before > changes_done_)
+        return;
+
+    // The job goes to the least loaded I/O task runner.
+    lane.io_index = static_cast<int>(
+        std::min_element(io_load_.begin(), io_load_.end()) - io_load_.begin());
+    ++io_load_[lane.io_index];
+
+    auto self = shared_from_this();
+    io_task_runners_[lane.io_index]->postTask([self, job, lane_index]()
+    {
+        self->doJob(job.get(), lane_index);
+        self->task_runner_->postTask(std::bind(&Impl::onJobDone, self, lane_index));
+    });
+}
+
+void FileWorker::Impl::doJob(Job* job, size_t lane_index)
+{
+    if (!job->task)
+    {
+        if (packetizers_[lane_index])
+            packetizers_[lane_index]->prefetchNextPacket(job->prefetch_size);
+        return;
+    }
+
+    const proto::FileRequest& request = job->task->request();
+
+    job->reply = doRequest(request);
+    job->reply->set_request_id(request.request_id());
+}
+
+void FileWorker::Impl::onJobDone(size_t lane_index)
+{
+    Lane& lane = lanes_[lane_index];
+
+    --io_load_[lane.io_index];
+    lane.io_index = -1;
+
+    std::shared_ptr<Job> job = std::move(lane.jobs.front());
+    lane.jobs.pop_front();
+
+    if (lane_index == kChangeLane)
+    {
+        ++changes_done_;
+
+        // The jobs waiting for the change can start.
+        for (size_t i = 0; i < kLaneCount; ++i)
+            runJob(i);
+    }
+    else
+    {
+        // While the packet is sent and the next request is on the way, the next packet is read.
+        if (lane_index < kMaxFileStreamCount && lane.jobs.empty() && packetizers_[lane_index] &&
+            job->task && job->task->request().has_packet_request())
+        {
+            std::shared_ptr<Job> prefetch_job = std::make_shared<Job>();
+            prefetch_job->prefetch_size = job->task->request().packet_request().packet_size();
+
+            lane.jobs.emplace_back(std::move(prefetch_job));
+        }
+
+        runJob(lane_index);
+    }
+
+    if (job->task)
+    {
+        job->done = true;
+        setReplies(job.get());
+    }
+}
+
+void FileWorker::Impl::setReplies(Job* job)
+{
+    if (job->task->request().request_id())
+    {
+        job->task->setReply(std::move(job->reply));
+        return;
+    }
+
+    // The replies to the requests without identifier are set in the order of the requests.
+    while (!ordered_jobs_.empty() && ordered_jobs_.front()->done)
+    {
+        std::shared_ptr<Job> front = std::move(ordered_jobs_.front());
+        ordered_jobs_.pop_front();
+
+        front->task->setReply(std::move(front->reply));
+    }
+}
+
 std::unique_ptr<proto::FileReply> FileWorker::Impl::doRequest(const proto::FileRequest& request)
 {
 #if defined(OS_WIN)
@@ -96,6 +342,10 @@ std::unique_ptr<proto::FileReply> FileWorker::Impl::doRequest(const proto::FileR
     {
         return doFileListRequest(request.file_list_request());
     }
+    else if (request.has_file_tree_request())
+    {
+        return doFileTreeRequest(request.file_tree_request());
+    }
     else if (request.has_create_directory_request())
     {
         return doCreateDirectoryRequest(request.create_directory_request());
@@ -108,21 +358,41 @@ std::unique_ptr<proto::FileReply> FileWorker::Impl::doRequest(const proto::FileR
     {
         return doRemoveRequest(request.remove_request());
     }
+    else if (request.stream_id() >= kMaxFileStreamCount)
+    {
+        LOG(LS_WARNING) << "Invalid stream: " << request.stream_id();
+
+        std::unique_ptr<proto::FileReply> reply = std::make_unique<proto::FileReply>();
+        reply->set_error_code(proto::FILE_ERROR_INVALID_REQUEST);
+        return reply;
+    }
     else if (request.has_download_request())
     {
-        return doDownloadRequest(request.download_request());
+        return doDownloadRequest(request.download_request(), request.stream_id());
     }
     else if (request.has_upload_request())
     {
-        return doUploadRequest(request.upload_request());
+        return doUploadRequest(request.upload_request(), request.stream_id());
+    }
+    else if (request.has_delta_request())
+    {
+        return doDeltaRequest(request.delta_request(), request.stream_id());
     }
     else if (request.has_packet_request())
     {
-        return doPacketRequest(request.packet_request());
+        return doPacketRequest(request.packet_request(), request.stream_id());
     }
     else if (request.has_packet())
     {
-        return doPacket(request.packet());
+        return doPacket(request.packet(), request.stream_id());
+    }
+    else if (request.has_pack_request())
+    {
+        return doPackRequest(request.pack_request(), request.stream_id());
+    }
+    else if (request.has_pack())
+    {
+        return doPack(request.pack(), request.stream_id());
     }
     else
     {
@@ -169,7 +439,7 @@ std::unique_ptr<proto::FileReply> FileWorker::Impl::doDriveListRequest()
                 break;
         }
 
-        item->set_path(drive_info.path().u8string());
+        item->set_path(base::utf8FromFilePath(drive_info.path()));
         item->set_name(drive_info.volumeName());
         item->set_total_space(drive_info.totalSpace());
         item->set_free_space(drive_info.freeSpace());
@@ -181,7 +451,7 @@ std::unique_ptr<proto::FileReply> FileWorker::Impl::doDriveListRequest()
         proto::DriveList::Item* item = drive_list->add_item();
 
         item->set_type(proto::DriveList::Item::TYPE_DESKTOP_FOLDER);
-        item->set_path(desktop_path.u8string());
+        item->set_path(base::utf8FromFilePath(desktop_path));
         item->set_total_space(-1);
         item->set_free_space(-1);
     }
@@ -192,7 +462,7 @@ std::unique_ptr<proto::FileReply> FileWorker::Impl::doDriveListRequest()
         proto::DriveList::Item* item = drive_list->add_item();
 
         item->set_type(proto::DriveList::Item::TYPE_HOME_FOLDER);
-        item->set_path(home_path.u8string());
+        item->set_path(base::utf8FromFilePath(home_path));
         item->set_total_space(-1);
         item->set_free_space(-1);
     }
@@ -210,7 +480,7 @@ std::unique_ptr<proto::FileReply> FileWorker::Impl::doFileListRequest(
 {
     std::unique_ptr<proto::FileReply> reply = std::make_unique<proto::FileReply>();
 
-    std::filesystem::path path = std::filesystem::u8path(request.path());
+    std::filesystem::path path = base::filePathFromUtf8(request.path());
 
     std::error_code ignored_code;
     std::filesystem::file_status status = std::filesystem::status(path, ignored_code);
@@ -247,12 +517,90 @@ std::unique_ptr<proto::FileReply> FileWorker::Impl::doFileListRequest(
     return reply;
 }
 
+std::unique_ptr<proto::FileReply> FileWorker::Impl::doFileTreeRequest(
+    const proto::FileTreeRequest& request)
+{
+    std::unique_ptr<proto::FileReply> reply = std::make_unique<proto::FileReply>();
+
+    if (!request.path().empty())
+    {
+        // A new enumeration replaces the previous one.
+        tree_.clear();
+
+        std::filesystem::path path = base::filePathFromUtf8(request.path());
+
+        std::error_code ignored_code;
+        std::filesystem::file_status status = std::filesystem::status(path, ignored_code);
+
+        if (!std::filesystem::exists(status))
+        {
+            reply->set_error_code(proto::FILE_ERROR_PATH_NOT_FOUND);
+            return reply;
+        }
+
+        if (!std::filesystem::is_directory(status))
+        {
+            reply->set_error_code(proto::FILE_ERROR_INVALID_PATH_NAME);
+            return reply;
+        }
+
+        tree_.push_back(TreeLevel{ path, std::string(), std::make_unique<FileEnumerator>(path) });
+    }
+
+    proto::FileTree* file_tree = reply->mutable_file_tree();
+
+    // The tree is walked depth-first, so a directory is added before its contents. The requests
+    // after the end of the tree get an empty last part.
+    while (!tree_.empty() && file_tree->item_size() < kMaxFileTreePartSize)
+    {
+        TreeLevel& level = tree_.back();
+
+        if (level.enumerator->isAtEnd())
+        {
+            proto::FileError error_code = level.enumerator->errorCode();
+            tree_.pop_back();
+
+            if (error_code != proto::FILE_ERROR_SUCCESS)
+            {
+                tree_.clear();
+                reply->clear_file_tree();
+                reply->set_error_code(error_code);
+                return reply;
+            }
+
+            continue;
+        }
+
+        const FileEnumerator::FileInfo& file_info = level.enumerator->fileInfo();
+
+        proto::FileList::Item* item = file_tree->add_item();
+        item->set_name(level.relative_path + file_info.u8name());
+        item->set_size(file_info.size());
+        item->set_modification_time(file_info.lastWriteTime());
+        item->set_is_directory(file_info.isDirectory());
+
+        std::filesystem::path child_path = level.path / file_info.name();
+        level.enumerator->advance();
+
+        if (item->is_directory())
+        {
+            tree_.push_back(TreeLevel{ child_path,
+                                       item->name() + '/',
+                                       std::make_unique<FileEnumerator>(child_path) });
+        }
+    }
+
+    file_tree->set_last_part(tree_.empty());
+    reply->set_error_code(proto::FILE_ERROR_SUCCESS);
+    return reply;
+}
+
 std::unique_ptr<proto::FileReply> FileWorker::Impl::doCreateDirectoryRequest(
     const proto::CreateDirectoryRequest& request)
 {
     std::unique_ptr<proto::FileReply> reply = std::make_unique<proto::FileReply>();
 
-    std::filesystem::path directory_path = std::filesystem::u8path(request.path());
+    std::filesystem::path directory_path = base::filePathFromUtf8(request.path());
 
     std::error_code ignored_code;
     if (std::filesystem::exists(directory_path, ignored_code))
@@ -276,8 +624,8 @@ std::unique_ptr<proto::FileReply> FileWorker::Impl::doRenameRequest(
 {
     std::unique_ptr<proto::FileReply> reply = std::make_unique<proto::FileReply>();
 
-    std::filesystem::path old_name = std::filesystem::u8path(request.old_name());
-    std::filesystem::path new_name = std::filesystem::u8path(request.new_name());
+    std::filesystem::path old_name = base::filePathFromUtf8(request.old_name());
+    std::filesystem::path new_name = base::filePathFromUtf8(request.new_name());
 
     if (old_name == new_name)
     {
@@ -316,7 +664,7 @@ std::unique_ptr<proto::FileReply> FileWorker::Impl::doRemoveRequest(
 {
     std::unique_ptr<proto::FileReply> reply = std::make_unique<proto::FileReply>();
 
-    std::filesystem::path path = std::filesystem::u8path(request.path());
+    std::filesystem::path path = base::filePathFromUtf8(request.path());
 
     std::error_code ignored_code;
     if (!std::filesystem::exists(path, ignored_code))
@@ -342,25 +690,48 @@ std::unique_ptr<proto::FileReply> FileWorker::Impl::doRemoveRequest(
 }
 
 std::unique_ptr<proto::FileReply> FileWorker::Impl::doDownloadRequest(
-    const proto::DownloadRequest& request)
+    const proto::DownloadRequest& request, uint32_t stream_id)
 {
     std::unique_ptr<proto::FileReply> reply = std::make_unique<proto::FileReply>();
 
-    packetizer_ = FilePacketizer::create(std::filesystem::u8path(request.path()));
-    if (!packetizer_)
+    std::unique_ptr<FilePacketizer> packetizer =
+        FilePacketizer::create(base::filePathFromUtf8(request.path()));
+    if (!packetizer)
+    {
+        packetizers_[stream_id].reset();
         reply->set_error_code(proto::FILE_ERROR_FILE_OPEN_ERROR);
+    }
     else
+    {
+        // The packet requests are processed in the order of arrival, so the client can send
+        // them without waiting for the replies. The file size lets the client stop requesting
+        // at the end of the file.
+        reply->set_window_size(std::min(request.window_size(), kMaxFileWindowSize));
+        reply->set_file_size(packetizer->fileSize());
+        reply->set_stream_count(kMaxFileStreamCount);
+        reply->set_delta(true);
+        reply->set_packing(true);
         reply->set_error_code(proto::FILE_ERROR_SUCCESS);
 
+        packetizers_[stream_id] = std::move(packetizer);
+    }
+
     return reply;
 }
 
 std::unique_ptr<proto::FileReply> FileWorker::Impl::doUploadRequest(
-    const proto::UploadRequest& request)
+    const proto::UploadRequest& request, uint32_t stream_id)
 {
     std::unique_ptr<proto::FileReply> reply = std::make_unique<proto::FileReply>();
 
-    std::filesystem::path file_path = std::filesystem::u8path(request.path());
+    std::filesystem::path file_path = base::filePathFromUtf8(request.path());
+
+    // The previous file of the stream is closed (and deleted if it is incomplete). The peer has
+    // skipped it unless the same file is requested again.
+    std::unique_ptr<FileDepacketizer>& previous = depacketizers_[stream_id];
+    if (previous && previous->targetPath() != file_path)
+        previous->discard();
+    previous.reset();
 
     do
     {
@@ -374,13 +745,37 @@ std::unique_ptr<proto::FileReply> FileWorker::Impl::doUploadRequest(
             }
         }
 
-        depacketizer_ = FileDepacketizer::create(file_path, request.overwrite());
-        if (!depacketizer_)
+        std::unique_ptr<FileDepacketizer> depacketizer;
+
+        if (request.delta())
+        {
+            proto::FileSignature signature;
+
+            // The signature is sent even if the target has no data of the file. The source sends
+            // the hash of the file in the delta transfer, so the part of the file can be
+            // continued if the transfer is interrupted.
+            depacketizer = FileDepacketizer::createForDelta(
+                file_path, request.overwrite(), &signature);
+            if (depacketizer)
+                reply->mutable_signature()->Swap(&signature);
+        }
+        else
+        {
+            depacketizer = FileDepacketizer::create(file_path, request.overwrite());
+        }
+
+        if (!depacketizer)
         {
             reply->set_error_code(proto::FILE_ERROR_FILE_CREATE_ERROR);
             break;
         }
 
+        depacketizers_[stream_id] = std::move(depacketizer);
+
+        reply->set_window_size(std::min(request.window_size(), kMaxFileWindowSize));
+        reply->set_stream_count(kMaxFileStreamCount);
+        reply->set_compression(proto::FILE_COMPRESSION_ZSTD);
+        reply->set_packing(true);
         reply->set_error_code(proto::FILE_ERROR_SUCCESS);
     }
     while (false);
@@ -388,12 +783,44 @@ std::unique_ptr<proto::FileReply> FileWorker::Impl::doUploadRequest(
     return reply;
 }
 
+std::unique_ptr<proto::FileReply> FileWorker::Impl::doDeltaRequest(
+    const proto::FileDeltaRequest& request, uint32_t stream_id)
+{
+    std::unique_ptr<proto::FileReply> reply = std::make_unique<proto::FileReply>();
+
+    std::unique_ptr<FilePacketizer>& packetizer = packetizers_[stream_id];
+    if (!packetizer)
+    {
+        // Set the unknown status of the request. The connection will be closed.
+        reply->set_error_code(proto::FILE_ERROR_UNKNOWN);
+        LOG(LS_WARNING) << "Unexpected delta request";
+    }
+    else
+    {
+        uint64_t resume_size = 0;
+
+        if (!packetizer->startDelta(request.signature(), &resume_size))
+        {
+            reply->set_error_code(proto::FILE_ERROR_FILE_READ_ERROR);
+            packetizer.reset();
+        }
+        else
+        {
+            reply->set_resume_size(resume_size);
+            reply->set_error_code(proto::FILE_ERROR_SUCCESS);
+        }
+    }
+
+    return reply;
+}
+
 std::unique_ptr<proto::FileReply> FileWorker::Impl::doPacketRequest(
-    const proto::FilePacketRequest& request)
+    const proto::FilePacketRequest& request, uint32_t stream_id)
 {
     std::unique_ptr<proto::FileReply> reply = std::make_unique<proto::FileReply>();
 
-    if (!packetizer_)
+    std::unique_ptr<FilePacketizer>& packetizer = packetizers_[stream_id];
+    if (!packetizer)
     {
         // Set the unknown status of the request. The connection will be closed.
         reply->set_error_code(proto::FILE_ERROR_UNKNOWN);
@@ -401,16 +828,16 @@ std::unique_ptr<proto::FileReply> FileWorker::Impl::doPacketRequest(
     }
     else
     {
-        std::unique_ptr<proto::FilePacket> packet = packetizer_->readNextPacket(request);
+        std::unique_ptr<proto::FilePacket> packet = packetizer->readNextPacket(request);
         if (!packet)
         {
             reply->set_error_code(proto::FILE_ERROR_FILE_READ_ERROR);
-            packetizer_.reset();
+            packetizer.reset();
         }
         else
         {
             if (packet->flags() & proto::FilePacket::LAST_PACKET)
-                packetizer_.reset();
+                packetizer.reset();
 
             reply->set_error_code(proto::FILE_ERROR_SUCCESS);
             reply->set_allocated_packet(packet.release());
@@ -420,11 +847,13 @@ std::unique_ptr<proto::FileReply> FileWorker::Impl::doPacketRequest(
     return reply;
 }
 
-std::unique_ptr<proto::FileReply> FileWorker::Impl::doPacket(const proto::FilePacket& packet)
+std::unique_ptr<proto::FileReply> FileWorker::Impl::doPacket(
+    const proto::FilePacket& packet, uint32_t stream_id)
 {
     std::unique_ptr<proto::FileReply> reply = std::make_unique<proto::FileReply>();
 
-    if (!depacketizer_)
+    std::unique_ptr<FileDepacketizer>& depacketizer = depacketizers_[stream_id];
+    if (!depacketizer)
     {
         // Set the unknown status of the request. The connection will be closed.
         reply->set_error_code(proto::FILE_ERROR_UNKNOWN);
@@ -432,25 +861,68 @@ std::unique_ptr<proto::FileReply> FileWorker::Impl::doPacket(const proto::FilePa
     }
     else
     {
-        if (!depacketizer_->writeNextPacket(packet))
+        if (!depacketizer->writeNextPacket(packet))
         {
-            reply->set_error_code(proto::FILE_ERROR_FILE_WRITE_ERROR);
-            depacketizer_.reset();
+            reply->set_error_code(depacketizer->errorCode());
+            depacketizer.reset();
         }
         else
         {
             reply->set_error_code(proto::FILE_ERROR_SUCCESS);
+
+            if (packet.flags() & proto::FilePacket::LAST_PACKET)
+                depacketizer.reset();
         }
+    }
+
+    return reply;
+}
+
+std::unique_ptr<proto::FileReply> FileWorker::Impl::doPackRequest(
+    const proto::FilePackRequest& request, uint32_t stream_id)
+{
+    std::unique_ptr<proto::FileReply> reply = std::make_unique<proto::FileReply>();
 
-        if (packet.flags() & proto::FilePacket::LAST_PACKET)
-            depacketizer_.reset();
+    // The previous file of the stream is closed.
+    packetizers_[stream_id].reset();
+
+    if (static_cast<size_t>(request.paths_size()) > kMaxFilePackCount)
+    {
+        LOG(LS_WARNING) << "Too many files in pack request: " << request.paths_size();
+        reply->set_error_code(proto::FILE_ERROR_INVALID_REQUEST);
+        return reply;
     }
 
+    readFilePack(request, reply->mutable_pack());
+    reply->set_error_code(proto::FILE_ERROR_SUCCESS);
+    return reply;
+}
+
+std::unique_ptr<proto::FileReply> FileWorker::Impl::doPack(
+    const proto::FilePack& pack, uint32_t stream_id)
+{
+    std::unique_ptr<proto::FileReply> reply = std::make_unique<proto::FileReply>();
+
+    // The previous file of the stream is closed and deleted if it is incomplete. The peer has
+    // skipped it.
+    if (depacketizers_[stream_id])
+        depacketizers_[stream_id]->discard();
+    depacketizers_[stream_id].reset();
+
+    if (!writeFilePack(pack, reply->mutable_pack()))
+    {
+        reply->clear_pack();
+        reply->set_error_code(proto::FILE_ERROR_INVALID_REQUEST);
+        return reply;
+    }
+
+    reply->set_error_code(proto::FILE_ERROR_SUCCESS);
     return reply;
 }
 
-FileWorker::FileWorker(std::shared_ptr<base::TaskRunner> task_runner)
-    : impl_(std::make_shared<Impl>(std::move(task_runner)))
+FileWorker::FileWorker(std::shared_ptr<base::TaskRunner> task_runner,
+                       std::vector<std::shared_ptr<base::TaskRunner>> io_task_runners)
+    : impl_(std::make_shared<Impl>(std::move(task_runner), std::move(io_task_runners)))
 {
     // Nothing
 }
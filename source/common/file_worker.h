@@ -22,6 +22,7 @@
 #include "base/macros_magic.h"
 
 #include <memory>
+#include <vector>
 
 namespace base {
 class TaskRunner;
@@ -31,12 +32,25 @@ namespace common {
 
 class FileTask;
 
+//
+// Executes file requests.
+// The requests are executed on |io_task_runners| (on |task_runner| if the list is empty). The
+// requests that do not depend on each other run at the same time: each open file, the file lists,
+// the file tree and the changes of the file system (creation, renaming and removal) have their own
+// order of execution, so a slow listing does not stop a transfer. A file is opened and a list is
+// read only after the changes requested before. The replies are set on |task_runner|; the replies
+// to the requests without identifier (see FileRequest.request_id) keep the order of the requests.
+//
 class FileWorker
 {
 public:
-    explicit FileWorker(std::shared_ptr<base::TaskRunner> task_runner);
+    explicit FileWorker(std::shared_ptr<base::TaskRunner> task_runner,
+                        std::vector<std::shared_ptr<base::TaskRunner>> io_task_runners = {});
     ~FileWorker();
 
+    // Recommended number of I/O threads.
+    static const size_t kIoThreadCount = 4;
+
     void doTask(std::shared_ptr<FileTask> task);
 
     std::shared_ptr<base::TaskRunner> taskRunner();
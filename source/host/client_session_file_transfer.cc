@@ -31,6 +31,8 @@
 
 #include <wtsapi32.h>
 
+#include <vector>
+
 namespace host {
 
 namespace {
@@ -90,6 +92,49 @@ bool createLoggedOnUserToken(DWORD session_id, base::win::ScopedHandle* token_ou
     return true;
 }
 
+// Thread that executes file requests on behalf of the logged on user.
+class ImpersonatedThread : public base::Thread::Delegate
+{
+public:
+    ImpersonatedThread() = default;
+    ~ImpersonatedThread() override
+    {
+        thread_.stop();
+    }
+
+    // Starts the thread. Returns false if the thread can not impersonate the user.
+    bool start(HANDLE user_token)
+    {
+        user_token_ = user_token;
+        thread_.start(base::MessageLoop::Type::DEFAULT, this);
+        user_token_ = nullptr;
+
+        return impersonator_ && impersonator_->isImpersonated();
+    }
+
+    std::shared_ptr<base::TaskRunner> taskRunner() const { return thread_.taskRunner(); }
+
+protected:
+    // base::Thread::Delegate implementation.
+    void onBeforeThreadRunning() override
+    {
+        impersonator_ = std::make_unique<base::win::ScopedImpersonator>();
+        impersonator_->loggedOnUser(user_token_);
+    }
+
+    void onAfterThreadRunning() override
+    {
+        impersonator_.reset();
+    }
+
+private:
+    base::Thread thread_;
+    HANDLE user_token_ = nullptr;
+    std::unique_ptr<base::win::ScopedImpersonator> impersonator_;
+
+    DISALLOW_COPY_AND_ASSIGN(ImpersonatedThread);
+};
+
 } // namespace
 
 class ClientSessionFileTransfer::Worker
@@ -117,6 +162,7 @@ private:
     std::unique_ptr<base::win::ScopedImpersonator> impersonator_;
     std::shared_ptr<base::NetworkChannelProxy> channel_proxy_;
     std::shared_ptr<common::FileTaskProducerProxy> producer_proxy_;
+    std::vector<std::unique_ptr<ImpersonatedThread>> io_threads_;
     std::unique_ptr<common::FileWorker> impl_;
 
     DISALLOW_COPY_AND_ASSIGN(Worker);
@@ -167,8 +213,25 @@ void ClientSessionFileTransfer::Worker::onBeforeThreadRunning()
     if (!impersonator_->loggedOnUser(user_token))
         return;
 
+    // The requests are executed on several threads, so a slow operation does not stop the others.
+    // A thread that can not impersonate the user is not used.
+    std::vector<std::shared_ptr<base::TaskRunner>> io_task_runners;
+
+    for (size_t i = 0; i < common::FileWorker::kIoThreadCount; ++i)
+    {
+        std::unique_ptr<ImpersonatedThread> io_thread = std::make_unique<ImpersonatedThread>();
+        if (!io_thread->start(user_token))
+        {
+            LOG(LS_WARNING) << "Unable to start I/O thread";
+            continue;
+        }
+
+        io_task_runners.emplace_back(io_thread->taskRunner());
+        io_threads_.emplace_back(std::move(io_thread));
+    }
+
     producer_proxy_ = std::make_shared<common::FileTaskProducerProxy>(this);
-    impl_ = std::make_unique<common::FileWorker>(thread_.taskRunner());
+    impl_ = std::make_unique<common::FileWorker>(thread_.taskRunner(), io_task_runners);
 }
 
 void ClientSessionFileTransfer::Worker::onAfterThreadRunning()
@@ -179,6 +242,7 @@ void ClientSessionFileTransfer::Worker::onAfterThreadRunning()
         producer_proxy_.reset();
     }
 
+    io_threads_.clear();
     impl_.reset();
     impersonator_.reset();
 }
@@ -21,6 +21,7 @@
 #include "base/smbios_parser.h"
 #include "base/smbios_reader.h"
 #include "base/sys_info.h"
+#include "base/files/file_util.h"
 #include "base/net/adapter_enumerator.h"
 #include "base/win/drive_enumerator.h"
 #include "base/win/printer_enumerator.h"
@@ -113,7 +114,7 @@ void createSystemInfo(proto::SystemInfo* system_info)
         proto::system_info::LogicalDrives::Drive* drive =
             system_info->mutable_logical_drives()->add_drive();
 
-        drive->set_path(drive_info.path().u8string());
+        drive->set_path(base::utf8FromFilePath(drive_info.path()));
         drive->set_file_system(drive_info.fileSystem());
         drive->set_total_size(drive_info.totalSpace());
         drive->set_free_size(drive_info.freeSpace());
@@ -23,6 +23,12 @@
 #include <QApplication>
 #include <QEvent>
 #include <QThread>
+#include <QTimer>
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <mutex>
 
 namespace qt_base {
 
@@ -56,14 +62,24 @@ public:
 
     bool belongsToCurrentThread() const;
     void postTask(Callback&& callback, int priority);
+    DelayedTaskId postDelayedTask(Callback&& callback, const Milliseconds& delay);
+    void cancelDelayedTask(DelayedTaskId id);
 
 protected:
     // QObject implementation.
     void customEvent(QEvent* event) override;
 
 private:
+    void runDelayedTask(DelayedTaskId id);
+
     Qt::HANDLE current_thread_;
 
+    // Delayed tasks that have not yet been run or cancelled. The timer only keeps the identifier,
+    // so a cancelled task is simply removed from the map.
+    std::mutex delayed_tasks_lock_;
+    std::map<DelayedTaskId, Callback> delayed_tasks_;
+    DelayedTaskId next_delayed_task_id_ = 1;
+
     DISALLOW_COPY_AND_ASSIGN(Impl);
 };
 
@@ -85,6 +101,63 @@ void QtTaskRunner::Impl::postTask(Callback&& callback, int priority)
     QApplication::postEvent(this, new TaskEvent(std::move(callback)), priority);
 }
 
+QtTaskRunner::DelayedTaskId QtTaskRunner::Impl::postDelayedTask(
+    Callback&& callback, const Milliseconds& delay)
+{
+    DelayedTaskId id;
+
+    {
+        std::scoped_lock lock(delayed_tasks_lock_);
+        id = next_delayed_task_id_++;
+        delayed_tasks_.emplace(id, std::move(callback));
+    }
+
+    // The timer must be started on the thread of the object.
+    const int msec = static_cast<int>(std::max(delay.count(), Milliseconds::rep(0)));
+    postTask([this, id, msec]()
+    {
+        QTimer::singleShot(msec, this, [this, id]() { runDelayedTask(id); });
+    }, Qt::NormalEventPriority);
+
+    return id;
+}
+
+void QtTaskRunner::Impl::cancelDelayedTask(DelayedTaskId id)
+{
+    Callback callback;
+
+    {
+        std::scoped_lock lock(delayed_tasks_lock_);
+
+        auto it = delayed_tasks_.find(id);
+        if (it == delayed_tasks_.end())
+            return;
+
+        callback = std::move(it->second);
+        delayed_tasks_.erase(it);
+    }
+
+    // The callback is destroyed outside the lock.
+}
+
+void QtTaskRunner::Impl::runDelayedTask(DelayedTaskId id)
+{
+    Callback callback;
+
+    {
+        std::scoped_lock lock(delayed_tasks_lock_);
+
+        auto it = delayed_tasks_.find(id);
+        if (it == delayed_tasks_.end())
+            return; // The task was cancelled.
+
+        callback = std::move(it->second);
+        delayed_tasks_.erase(it);
+    }
+
+    callback();
+}
+
 void QtTaskRunner::Impl::customEvent(QEvent* event)
 {
     if (event->type() == TaskEvent::kType)
@@ -109,9 +182,9 @@ void QtTaskRunner::postTask(Callback callback)
     impl_->postTask(std::move(callback), Qt::NormalEventPriority);
 }
 
-void QtTaskRunner::postDelayedTask(Callback /* callback */, const Milliseconds& /* delay */)
+void QtTaskRunner::postDelayedTask(Callback callback, const Milliseconds& delay)
 {
-    NOTIMPLEMENTED();
+    impl_->postDelayedTask(std::move(callback), delay);
 }
 
 void QtTaskRunner::postNonNestableTask(Callback callback)
@@ -130,4 +203,26 @@ void QtTaskRunner::postQuit()
     NOTIMPLEMENTED();
 }
 
+QtTaskRunner::DelayedTaskId QtTaskRunner::postCancelableDelayedTask(
+    Callback callback, const Milliseconds& delay)
+{
+    return impl_->postDelayedTask(std::move(callback), delay);
+}
+
+void QtTaskRunner::cancelDelayedTask(DelayedTaskId id)
+{
+    if (!id)
+        return;
+
+    if (!belongsToCurrentThread())
+    {
+        // The callback must be destroyed on the thread of the task runner.
+        postTask(std::bind(&QtTaskRunner::cancelDelayedTask,
+                           std::static_pointer_cast<QtTaskRunner>(shared_from_this()), id));
+        return;
+    }
+
+    impl_->cancelDelayedTask(id);
+}
+
 } // namespace qt_base
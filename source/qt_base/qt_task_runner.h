@@ -37,6 +37,8 @@ public:
     void postNonNestableTask(Callback callback) override;
     void postNonNestableDelayedTask(Callback callback, const Milliseconds& delay) override;
     void postQuit() override;
+    DelayedTaskId postCancelableDelayedTask(Callback callback, const Milliseconds& delay) override;
+    void cancelDelayedTask(DelayedTaskId id) override;
 
 private:
     class Impl;
@@ -19,16 +19,28 @@
 #include "relay/controller.h"
 
 #include "base/logging.h"
+#include "base/sys_info.h"
 #include "base/task_runner.h"
 #include "base/peer/client_authenticator.h"
 #include "proto/router_common.pb.h"
 #include "relay/settings.h"
 
+#include <algorithm>
+#include <thread>
+
 namespace relay {
 
 namespace {
 
 const std::chrono::seconds kReconnectTimeout{ 30 };
+const std::chrono::seconds kStatInterval{ 5 };
+
+// Released keys are sent to the router in batches. A batch is sent when it reaches
+// 1/kKeyBatchDivider of the maximum number of peers, when the number of keys in the router pool
+// falls below 1/kLowWatermarkDivider of the maximum or kKeyPoolDelay after the first key.
+const uint32_t kKeyBatchDivider = 10;
+const uint32_t kLowWatermarkDivider = 4;
+const std::chrono::seconds kKeyPoolDelay{ 1 };
 
 #if defined(OS_WIN)
 const wchar_t kFirewallRuleName[] = L"Aspia Relay Service";
@@ -63,6 +75,7 @@ private:
 
 Controller::Controller(std::shared_ptr<base::TaskRunner> task_runner)
     : task_runner_(task_runner),
+      worker_pool_(1),
       reconnect_timer_(task_runner),
       shared_pool_(std::make_unique<SharedPool>(this))
 {
@@ -81,13 +94,24 @@ Controller::Controller(std::shared_ptr<base::TaskRunner> task_runner)
     peer_address_ = settings.peerAddress();
     peer_port_ = settings.peerPort();
     max_peer_count_ = settings.maxPeerCount();
+    max_bandwidth_ = settings.maxBandwidth();
 
     LOG(LS_INFO) << "Peer address: " << peer_address_;
     LOG(LS_INFO) << "Peer port: " << peer_port_;
     LOG(LS_INFO) << "Max peer count: " << max_peer_count_;
+    LOG(LS_INFO) << "Max bandwidth: " << max_bandwidth_;
 }
 
-Controller::~Controller() = default;
+Controller::~Controller()
+{
+    stopStatTimer();
+
+    if (key_pool_task_id_)
+        task_runner_->cancelDelayedTask(key_pool_task_id_);
+
+    key_generator_.reset();
+    worker_pool_.stop();
+}
 
 bool Controller::start()
 {
@@ -126,6 +150,17 @@ bool Controller::start()
     session_manager_ = std::make_unique<SessionManager>(task_runner_, peer_port_);
     session_manager_->start(shared_pool_->share(), this);
 
+    // Keys are generated in advance, so the whole pool is ready by the time the router is
+    // connected.
+    worker_pool_.start();
+    key_generator_ = std::make_unique<KeyGenerator>(
+        worker_pool_.createSequencedTaskRunner(), task_runner_);
+    key_generator_->start(max_peer_count_, [this]()
+    {
+        // Keys that were not sent because of an empty buffer.
+        onKeysReleased(0);
+    });
+
     connectToRouter();
     return true;
 }
@@ -161,7 +196,12 @@ void Controller::onConnected()
             // Now the session will receive incoming messages.
             channel_->resume();
 
-            sendKeyPool(max_peer_count_);
+            is_authenticated_ = true;
+            released_key_count_ = 0;
+            router_key_count_ = 0;
+
+            onKeysReleased(max_peer_count_);
+            startStatTimer();
         }
         else
         {
@@ -180,6 +220,18 @@ void Controller::onDisconnected(base::NetworkChannel::ErrorCode error_code)
     LOG(LS_INFO) << "The connection to the router has been lost: "
                  << base::NetworkChannel::errorToString(error_code);
 
+    stopStatTimer();
+
+    is_authenticated_ = false;
+    released_key_count_ = 0;
+    router_key_count_ = 0;
+
+    if (key_pool_task_id_)
+    {
+        task_runner_->cancelDelayedTask(key_pool_task_id_);
+        key_pool_task_id_ = 0;
+    }
+
     // Clearing the key pool.
     shared_pool_->clear();
 
@@ -198,6 +250,9 @@ void Controller::onMessageReceived(const base::ByteArray& buffer)
 
     if (message.has_key_used())
     {
+        if (router_key_count_)
+            --router_key_count_;
+
         std::shared_ptr<KeyDeleter> key_deleter =
             std::make_shared<KeyDeleter>(shared_pool_->share(), message.key_used().key_id());
 
@@ -221,14 +276,14 @@ void Controller::onSessionFinished()
 {
     // After disconnecting the peer, one key is released.
     // Add a new key to the pool and send it to the router.
-    sendKeyPool(1);
+    onKeysReleased(1);
 }
 
 void Controller::onPoolKeyExpired(uint32_t /* key_id */)
 {
     // The key has expired and has been removed from the pool.
     // Add a new key to the pool and send it to the router.
-    sendKeyPool(1);
+    onKeysReleased(1);
 }
 
 void Controller::connectToRouter()
@@ -249,21 +304,54 @@ void Controller::delayedConnectToRouter()
     reconnect_timer_.start(kReconnectTimeout, std::bind(&Controller::connectToRouter, this));
 }
 
-void Controller::sendKeyPool(uint32_t key_count)
+void Controller::onKeysReleased(uint32_t key_count)
 {
+    released_key_count_ += key_count;
+
+    if (!is_authenticated_ || !released_key_count_)
+        return;
+
+    const uint32_t batch_size = std::max(1u, max_peer_count_ / kKeyBatchDivider);
+    const uint32_t low_watermark = max_peer_count_ / kLowWatermarkDivider;
+
+    if (released_key_count_ >= batch_size || router_key_count_ <= low_watermark)
+    {
+        sendKeyPool();
+        return;
+    }
+
+    if (key_pool_task_id_)
+        return;
+
+    key_pool_task_id_ = task_runner_->postCancelableDelayedTask([this]()
+    {
+        key_pool_task_id_ = 0;
+        sendKeyPool();
+    },
+    kKeyPoolDelay);
+}
+
+void Controller::sendKeyPool()
+{
+    if (key_pool_task_id_)
+    {
+        task_runner_->cancelDelayedTask(key_pool_task_id_);
+        key_pool_task_id_ = 0;
+    }
+
+    // If there are not enough ready keys, the rest is sent when the generator adds new keys.
+    std::vector<SessionKey> session_keys = key_generator_->takeKeys(released_key_count_);
+    if (session_keys.empty())
+        return;
+
     proto::RelayToRouter message;
     proto::RelayKeyPool* relay_key_pool = message.mutable_key_pool();
 
     relay_key_pool->set_peer_host(base::utf8FromUtf16(peer_address_));
     relay_key_pool->set_peer_port(peer_port_);
 
-    // Add the requested number of keys to the pool.
-    for (uint32_t i = 0; i < key_count; ++i)
+    for (auto& session_key : session_keys)
     {
-        SessionKey session_key = SessionKey::create();
-        if (!session_key.isValid())
-            return;
-
         // Add the key to the outgoing message.
         proto::RelayKey* key = relay_key_pool->add_key();
 
@@ -276,8 +364,72 @@ void Controller::sendKeyPool(uint32_t key_count)
         key->set_key_id(shared_pool_->addKey(std::move(session_key)));
     }
 
+    const uint32_t sent_count = static_cast<uint32_t>(session_keys.size());
+    released_key_count_ -= sent_count;
+    router_key_count_ += sent_count;
+
     // Send a message to the router.
     channel_->send(base::serialize(message));
 }
 
+void Controller::startStatTimer()
+{
+    stopStatTimer();
+
+    stat_time_ = std::chrono::steady_clock::now();
+    stat_bytes_transferred_ = session_manager_->bytesTransferred();
+    stat_cpu_time_ = base::SysInfo::processCpuTime();
+
+    stat_task_id_ = task_runner_->postCancelableDelayedTask([this]()
+    {
+        stat_task_id_ = 0;
+        sendRelayStat();
+        startStatTimer();
+    },
+    kStatInterval);
+}
+
+void Controller::stopStatTimer()
+{
+    if (!stat_task_id_)
+        return;
+
+    task_runner_->cancelDelayedTask(stat_task_id_);
+    stat_task_id_ = 0;
+}
+
+void Controller::sendRelayStat()
+{
+    if (!channel_)
+        return;
+
+    const std::chrono::microseconds elapsed_time =
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - stat_time_);
+    if (elapsed_time.count() <= 0)
+        return;
+
+    const int64_t bytes_transferred =
+        session_manager_->bytesTransferred() - stat_bytes_transferred_;
+    const std::chrono::microseconds cpu_time =
+        base::SysInfo::processCpuTime() - stat_cpu_time_;
+
+    const int64_t processor_count = std::max(1u, std::thread::hardware_concurrency());
+    const int64_t cpu_usage =
+        cpu_time.count() * 100 / (elapsed_time.count() * processor_count);
+
+    proto::RelayToRouter message;
+    proto::RelayStat* relay_stat = message.mutable_relay_stat();
+
+    relay_stat->set_active_sessions(static_cast<uint32_t>(session_manager_->sessionCount()));
+    relay_stat->set_max_sessions(max_peer_count_);
+    relay_stat->set_bandwidth(
+        static_cast<uint64_t>(std::max<int64_t>(bytes_transferred, 0) * 1000000 /
+                              elapsed_time.count()));
+    relay_stat->set_max_bandwidth(max_bandwidth_);
+    relay_stat->set_cpu_usage(static_cast<uint32_t>(std::clamp<int64_t>(cpu_usage, 0, 100)));
+
+    channel_->send(base::serialize(message));
+}
+
 } // namespace relay
@@ -21,8 +21,10 @@
 
 #include "base/waitable_timer.h"
 #include "base/net/network_channel.h"
+#include "base/threading/thread_pool.h"
 #include "build/build_config.h"
 #include "proto/router_relay.pb.h"
+#include "relay/key_generator.h"
 #include "relay/session_manager.h"
 #include "relay/shared_pool.h"
 
@@ -59,7 +61,11 @@ protected:
 private:
     void connectToRouter();
     void delayedConnectToRouter();
-    void sendKeyPool(uint32_t key_count);
+    void onKeysReleased(uint32_t key_count);
+    void sendKeyPool();
+    void startStatTimer();
+    void stopStatTimer();
+    void sendRelayStat();
 
     // Router settings.
     std::u16string router_address_;
@@ -70,13 +76,31 @@ private:
     std::u16string peer_address_;
     uint16_t peer_port_ = 0;
     uint32_t max_peer_count_ = 0;
+    uint64_t max_bandwidth_ = 0;
 
     std::shared_ptr<base::TaskRunner> task_runner_;
+    base::ThreadPool worker_pool_;
     base::WaitableTimer reconnect_timer_;
     std::unique_ptr<base::NetworkChannel> channel_;
     std::unique_ptr<base::ClientAuthenticator> authenticator_;
     std::unique_ptr<SharedPool> shared_pool_;
     std::unique_ptr<SessionManager> session_manager_;
+    std::unique_ptr<KeyGenerator> key_generator_;
+
+    // Number of keys that should be sent to the router (one per free session).
+    uint32_t released_key_count_ = 0;
+
+    // Number of keys in the pool of the router.
+    uint32_t router_key_count_ = 0;
+
+    bool is_authenticated_ = false;
+    base::TaskRunner::DelayedTaskId key_pool_task_id_ = 0;
+
+    // Previous values for calculation of the bandwidth and processor usage.
+    base::TaskRunner::DelayedTaskId stat_task_id_ = 0;
+    std::chrono::steady_clock::time_point stat_time_;
+    int64_t stat_bytes_transferred_ = 0;
+    std::chrono::microseconds stat_cpu_time_;
 
     DISALLOW_COPY_AND_ASSIGN(Controller);
 };
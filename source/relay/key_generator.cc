@@ -0,0 +1,130 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "relay/key_generator.h"
+
+#include "base/logging.h"
+
+#include <algorithm>
+
+namespace relay {
+
+namespace {
+
+// Number of keys generated by one task of the worker thread.
+const size_t kChunkSize = 16;
+
+} // namespace
+
+KeyGenerator::KeyGenerator(std::shared_ptr<base::TaskRunner> worker_task_runner,
+                           std::shared_ptr<base::TaskRunner> task_runner)
+    : worker_task_runner_(std::move(worker_task_runner)),
+      task_runner_(std::move(task_runner)),
+      alive_token_(std::make_shared<int>(0))
+{
+    DCHECK(worker_task_runner_ && task_runner_);
+}
+
+KeyGenerator::~KeyGenerator() = default;
+
+void KeyGenerator::start(size_t capacity, ReadyCallback ready_callback)
+{
+    DCHECK(task_runner_->belongsToCurrentThread());
+
+    capacity_ = capacity;
+    ready_callback_ = std::move(ready_callback);
+
+    keys_.reserve(capacity_);
+    generateMore();
+}
+
+std::vector<SessionKey> KeyGenerator::takeKeys(size_t count)
+{
+    DCHECK(task_runner_->belongsToCurrentThread());
+
+    count = std::min(count, keys_.size());
+
+    std::vector<SessionKey> result;
+    result.reserve(count);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        result.emplace_back(std::move(keys_.back()));
+        keys_.pop_back();
+    }
+
+    generateMore();
+    return result;
+}
+
+void KeyGenerator::generateMore()
+{
+    if (generating_ || keys_.size() >= capacity_)
+        return;
+
+    const size_t count = std::min(kChunkSize, capacity_ - keys_.size());
+    generating_ = true;
+
+    worker_task_runner_->postTask(
+        [task_runner = task_runner_, alive_token = std::weak_ptr<int>(alive_token_), this, count]()
+    {
+        std::vector<SessionKey> keys;
+        keys.reserve(count);
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            SessionKey session_key = SessionKey::create();
+            if (!session_key.isValid())
+            {
+                LOG(LS_ERROR) << "Unable to create session key";
+                break;
+            }
+
+            keys.emplace_back(std::move(session_key));
+        }
+
+        task_runner->postTask([alive_token, this, keys = std::move(keys)]() mutable
+        {
+            if (alive_token.expired())
+                return;
+
+            onKeysGenerated(std::move(keys));
+        });
+    });
+}
+
+void KeyGenerator::onKeysGenerated(std::vector<SessionKey> keys)
+{
+    generating_ = false;
+
+    if (keys.empty())
+    {
+        // Key generation failed. The next attempt is made when keys are taken.
+        return;
+    }
+
+    for (auto& key : keys)
+        keys_.emplace_back(std::move(key));
+
+    generateMore();
+
+    if (ready_callback_)
+        ready_callback_();
+}
+
+} // namespace relay
@@ -0,0 +1,73 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef RELAY__KEY_GENERATOR_H
+#define RELAY__KEY_GENERATOR_H
+
+#include "base/task_runner.h"
+#include "relay/session_key.h"
+
+#include <functional>
+#include <vector>
+
+namespace relay {
+
+//
+// Generates session keys on a worker thread and keeps a buffer of ready keys, so the network
+// thread takes keys without generating them. The buffer is refilled in the background each time
+// keys are taken from it.
+//
+class KeyGenerator
+{
+public:
+    using ReadyCallback = std::function<void()>;
+
+    KeyGenerator(std::shared_ptr<base::TaskRunner> worker_task_runner,
+                 std::shared_ptr<base::TaskRunner> task_runner);
+    ~KeyGenerator();
+
+    // Starts filling the buffer up to |capacity| keys. |ready_callback| is called on the thread of
+    // |task_runner| each time new keys are added to the buffer.
+    void start(size_t capacity, ReadyCallback ready_callback);
+
+    // Takes at most |count| ready keys.
+    std::vector<SessionKey> takeKeys(size_t count);
+
+    size_t readyCount() const { return keys_.size(); }
+
+private:
+    void generateMore();
+    void onKeysGenerated(std::vector<SessionKey> keys);
+
+    std::shared_ptr<base::TaskRunner> worker_task_runner_;
+    std::shared_ptr<base::TaskRunner> task_runner_;
+    ReadyCallback ready_callback_;
+
+    std::vector<SessionKey> keys_;
+    size_t capacity_ = 0;
+    bool generating_ = false;
+
+    // Expires when the object is destroyed.
+    std::shared_ptr<int> alive_token_;
+
+    DISALLOW_COPY_AND_ASSIGN(KeyGenerator);
+};
+
+} // namespace relay
+
+#endif // RELAY__KEY_GENERATOR_H
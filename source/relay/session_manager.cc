@@ -123,6 +123,16 @@ void SessionManager::start(std::unique_ptr<SharedPool> shared_pool, Delegate* de
     SessionManager::doAccept(this);
 }
 
+int64_t SessionManager::bytesTransferred() const
+{
+    int64_t result = finished_bytes_transferred_;
+
+    for (const auto& session : active_sessions_)
+        result += session->bytesTransferred();
+
+    return result;
+}
+
 void SessionManager::onPendingSessionReady(
     PendingSession* session, const proto::PeerToRelay& message)
 {
@@ -225,7 +235,11 @@ void SessionManager::removePendingSession(PendingSession* session)
 
 void SessionManager::removeSession(Session* session)
 {
-    task_runner_->deleteSoon(removeSessionT(&active_sessions_, session));
+    std::unique_ptr<Session> removed_session = removeSessionT(&active_sessions_, session);
+    if (removed_session)
+        finished_bytes_transferred_ += removed_session->bytesTransferred();
+
+    task_runner_->deleteSoon(std::move(removed_session));
 
     if (delegate_)
         delegate_->onSessionFinished();
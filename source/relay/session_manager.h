@@ -48,6 +48,11 @@ public:
 
     void start(std::unique_ptr<SharedPool> shared_pool, Delegate* delegate);
 
+    size_t sessionCount() const { return active_sessions_.size(); }
+
+    // Total number of bytes transferred by all sessions (active and finished).
+    int64_t bytesTransferred() const;
+
 protected:
     // PendingSession::Delegate implementation.
     void onPendingSessionReady(
@@ -67,6 +72,7 @@ private:
     asio::ip::tcp::acceptor acceptor_;
     std::vector<std::unique_ptr<PendingSession>> pending_sessions_;
     std::vector<std::unique_ptr<Session>> active_sessions_;
+    int64_t finished_bytes_transferred_ = 0;
 
     std::unique_ptr<SharedPool> shared_pool_;
     Delegate* delegate_ = nullptr;
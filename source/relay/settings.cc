@@ -91,6 +91,16 @@ uint32_t Settings::maxPeerCount() const
     return impl_.get<uint32_t>("MaxPeerCount", 100);
 }
 
+void Settings::setMaxBandwidth(uint64_t bandwidth)
+{
+    impl_.set<uint64_t>("MaxBandwidth", bandwidth);
+}
+
+uint64_t Settings::maxBandwidth() const
+{
+    return impl_.get<uint64_t>("MaxBandwidth", 0);
+}
+
 void Settings::setLogPath(const std::filesystem::path& path)
 {
     impl_.set<std::filesystem::path>("LogPath", path);
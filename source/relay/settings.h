@@ -47,6 +47,10 @@ public:
     void setMaxPeerCount(uint32_t count);
     uint32_t maxPeerCount() const;
 
+    // Bandwidth available to the peers in bytes per second. Zero if not limited.
+    void setMaxBandwidth(uint64_t bandwidth);
+    uint64_t maxBandwidth() const;
+
     void setLogPath(const std::filesystem::path& path);
     std::filesystem::path logPath() const;
 
@@ -0,0 +1,55 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "router/async_database.h"
+
+#include "base/logging.h"
+#include "router/database.h"
+#include "router/database_factory.h"
+
+namespace router {
+
+AsyncDatabase::AsyncDatabase(std::shared_ptr<DatabaseFactory> database_factory,
+                             std::shared_ptr<base::TaskRunner> database_task_runner,
+                             std::shared_ptr<base::TaskRunner> reply_task_runner)
+    : database_factory_(std::move(database_factory)),
+      database_task_runner_(std::move(database_task_runner)),
+      reply_task_runner_(std::move(reply_task_runner)),
+      alive_token_(std::make_shared<int>(0))
+{
+    DCHECK(database_factory_);
+    DCHECK(database_task_runner_);
+    DCHECK(reply_task_runner_);
+}
+
+AsyncDatabase::~AsyncDatabase()
+{
+    DCHECK(reply_task_runner_->belongsToCurrentThread());
+}
+
+// static
+std::unique_ptr<Database> AsyncDatabase::openDatabase(const DatabaseFactory& database_factory)
+{
+    std::unique_ptr<Database> database = database_factory.openDatabase();
+    if (!database)
+        LOG(LS_ERROR) << "Failed to connect to database";
+
+    return database;
+}
+
+} // namespace router
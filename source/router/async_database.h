@@ -0,0 +1,95 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef ROUTER__ASYNC_DATABASE_H
+#define ROUTER__ASYNC_DATABASE_H
+
+#include "base/macros_magic.h"
+#include "base/task_runner.h"
+
+#include <memory>
+#include <type_traits>
+
+namespace router {
+
+class Database;
+class DatabaseFactory;
+
+//
+// Runs database requests on the database thread and returns the results to the thread on which
+// the object was created.
+// A request is a callable that takes Database& and returns the result. The reply is a callable
+// that takes the result. If the database could not be opened, the request is not called and the
+// reply receives a value-initialized result (false, an empty list, an invalid ID and so on).
+// Requests are executed in the order of posting. Replies that arrive after the destruction of the
+// object are dropped, so a reply may safely use the object that owns AsyncDatabase.
+//
+class AsyncDatabase
+{
+public:
+    AsyncDatabase(std::shared_ptr<DatabaseFactory> database_factory,
+                  std::shared_ptr<base::TaskRunner> database_task_runner,
+                  std::shared_ptr<base::TaskRunner> reply_task_runner);
+    ~AsyncDatabase();
+
+    template <typename Request, typename Reply>
+    void execute(Request request, Reply reply)
+    {
+        using Result = std::invoke_result_t<Request&, Database&>;
+
+        database_task_runner_->postTask(
+            [database_factory = database_factory_, reply_task_runner = reply_task_runner_,
+             alive_token = std::weak_ptr<int>(alive_token_), request = std::move(request),
+             reply = std::move(reply)]() mutable
+        {
+            Result result = Result();
+
+            std::unique_ptr<Database> database = openDatabase(*database_factory);
+            if (database)
+                result = request(*database);
+
+            // The connection is returned to the pool before the reply.
+            database.reset();
+
+            reply_task_runner->postTask(
+                [alive_token, reply = std::move(reply), result = std::move(result)]() mutable
+            {
+                if (alive_token.expired())
+                    return;
+
+                reply(std::move(result));
+            });
+        });
+    }
+
+private:
+    static std::unique_ptr<Database> openDatabase(const DatabaseFactory& database_factory);
+
+    std::shared_ptr<DatabaseFactory> database_factory_;
+    std::shared_ptr<base::TaskRunner> database_task_runner_;
+    std::shared_ptr<base::TaskRunner> reply_task_runner_;
+
+    // Expires when the object is destroyed.
+    std::shared_ptr<int> alive_token_;
+
+    DISALLOW_COPY_AND_ASSIGN(AsyncDatabase);
+};
+
+} // namespace router
+
+#endif // ROUTER__ASYNC_DATABASE_H
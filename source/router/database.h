@@ -29,6 +29,12 @@ class Database
 public:
     virtual ~Database() = default;
 
+    struct Host
+    {
+        base::HostId host_id = base::kInvalidHostId;
+        base::ByteArray key_hash;
+    };
+
     virtual std::vector<base::User> userList() const = 0;
     virtual bool addUser(const base::User& user) = 0;
     virtual bool modifyUser(const base::User& user) = 0;
@@ -36,6 +42,13 @@ public:
     virtual base::User findUser(std::u16string_view username) = 0;
     virtual base::HostId hostId(const base::ByteArray& keyHash) const = 0;
     virtual bool addHost(const base::ByteArray& keyHash) = 0;
+
+    // Reads all hosts.
+    virtual bool hostList(std::vector<Host>* hosts) const = 0;
+
+    // Adds hosts with the specified IDs in a single transaction. Hosts that are already in the
+    // database are skipped, so a failed call can be repeated.
+    virtual bool addHosts(const std::vector<Host>& hosts) = 0;
 };
 
 } // namespace router
@@ -0,0 +1,277 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "base/command_line.h"
+#include "base/crypto/generic_hash.h"
+#include "base/crypto/random.h"
+#include "base/files/file_util.h"
+#include "base/strings/string_number_conversions.h"
+#include "router/database_factory_sqlite.h"
+#include "router/database_sqlite.h"
+#include "router/host_key_index.h"
+#include "router/host_key_store.h"
+
+#include <chrono>
+#include <iostream>
+#include <random>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using Seconds = std::chrono::duration<double>;
+
+// Same as in the database shipped with the router.
+const char kSchema[] =
+    "CREATE TABLE IF NOT EXISTS \"users\" ("
+    "\"id\" INTEGER PRIMARY KEY AUTOINCREMENT UNIQUE,"
+    "\"name\" TEXT NOT NULL UNIQUE,"
+    "\"group\" TEXT NOT NULL,"
+    "\"salt\" BLOB NOT NULL,"
+    "\"verifier\" BLOB NOT NULL,"
+    "\"sessions\" INTEGER DEFAULT 0,"
+    "\"flags\" INTEGER DEFAULT 0);"
+    "CREATE TABLE IF NOT EXISTS \"hosts\" ("
+    "\"id\" INTEGER PRIMARY KEY AUTOINCREMENT UNIQUE,"
+    "\"key\" BLOB NOT NULL UNIQUE);";
+
+struct Options
+{
+    std::filesystem::path file_path;
+    int host_count = 10000;
+    int request_count = 100000;
+};
+
+base::ByteArray keyHash(const std::string& key)
+{
+    return base::GenericHash::hash(base::GenericHash::Type::BLAKE2b512, key);
+}
+
+bool createDatabase(const std::filesystem::path& file_path)
+{
+    sqlite3* db = nullptr;
+
+    int error_code = sqlite3_open(base::utf8FromFilePath(file_path).c_str(), &db);
+    if (error_code == SQLITE_OK)
+        error_code = sqlite3_exec(db, kSchema, nullptr, nullptr, nullptr);
+
+    sqlite3_close(db);
+
+    if (error_code != SQLITE_OK)
+    {
+        std::cout << "Unable to create database: " << sqlite3_errstr(error_code) << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+void printResult(const char* name, int count, const Clock::time_point& start_time)
+{
+    Seconds duration = Clock::now() - start_time;
+
+    std::cout << name << ": " << count << " requests in " << duration.count() << " s ("
+              << static_cast<int>(count / duration.count()) << " requests/s)" << std::endl;
+}
+
+//
+// Emulates host ID requests (SessionHost::readHostIdRequest) for existing hosts. Each request
+// opens the database, resolves the ID of the host and closes the database.
+// The connections are opened directly (as before the pool was added) and through the pool of
+// DatabaseFactorySqlite. Then the same requests are resolved by HostKeyIndex loaded from the
+// database, and new hosts are written in batches as HostKeyStore does.
+//
+bool runBenchmark(const Options& options)
+{
+    if (std::filesystem::exists(options.file_path))
+    {
+        std::cout << "File " << options.file_path << " already exists" << std::endl;
+        return false;
+    }
+
+    if (!createDatabase(options.file_path))
+        return false;
+
+    router::DatabaseFactorySqlite factory(options.file_path);
+    std::vector<base::ByteArray> hashes;
+    hashes.reserve(options.host_count);
+
+    Clock::time_point start_time = Clock::now();
+
+    for (int i = 0; i < options.host_count; ++i)
+    {
+        base::ByteArray hash = keyHash(base::Random::string(512));
+
+        std::unique_ptr<router::Database> database = factory.openDatabase();
+        if (!database || !database->addHost(hash))
+        {
+            std::cout << "Unable to add host" << std::endl;
+            return false;
+        }
+
+        hashes.emplace_back(std::move(hash));
+    }
+
+    printResult("New hosts (pooled)", options.host_count, start_time);
+
+    std::mt19937 random(options.host_count);
+    std::uniform_int_distribution<size_t> distribution(0, hashes.size() - 1);
+
+    int failed = 0;
+    start_time = Clock::now();
+
+    for (int i = 0; i < options.request_count; ++i)
+    {
+        std::unique_ptr<router::Database> database = router::DatabaseSqlite::open(options.file_path);
+        if (!database || database->hostId(hashes[distribution(random)]) == base::kInvalidHostId)
+            ++failed;
+    }
+
+    printResult("Existing hosts (not pooled)", options.request_count, start_time);
+
+    start_time = Clock::now();
+
+    for (int i = 0; i < options.request_count; ++i)
+    {
+        std::unique_ptr<router::Database> database = factory.openDatabase();
+        if (!database || database->hostId(hashes[distribution(random)]) == base::kInvalidHostId)
+            ++failed;
+    }
+
+    printResult("Existing hosts (pooled)", options.request_count, start_time);
+
+    start_time = Clock::now();
+
+    std::vector<router::Database::Host> hosts;
+    std::unique_ptr<router::Database> database = factory.openDatabase();
+    if (!database || !database->hostList(&hosts))
+    {
+        std::cout << "Unable to read the list of hosts" << std::endl;
+        return false;
+    }
+
+    router::HostKeyIndex index;
+    index.reserve(hosts.size());
+
+    base::HostId next_host_id = 1;
+    for (const auto& host : hosts)
+    {
+        index.insert(host.key_hash, host.host_id);
+        next_host_id = std::max(next_host_id, host.host_id + 1);
+    }
+
+    Seconds duration = Clock::now() - start_time;
+    std::cout << "Index loading: " << index.size() << " hosts in " << duration.count() << " s"
+              << std::endl;
+
+    start_time = Clock::now();
+
+    for (int i = 0; i < options.request_count; ++i)
+    {
+        if (index.find(hashes[distribution(random)]) == base::kInvalidHostId)
+            ++failed;
+    }
+
+    printResult("Existing hosts (index)", options.request_count, start_time);
+
+    std::vector<router::Database::Host> batch;
+    start_time = Clock::now();
+
+    for (int i = 0; i < options.host_count; ++i)
+    {
+        router::Database::Host host;
+        host.host_id = next_host_id++;
+        host.key_hash = keyHash(base::Random::string(512));
+
+        index.insert(host.key_hash, host.host_id);
+        batch.emplace_back(std::move(host));
+
+        if (batch.size() == router::HostKeyStore::kMaxBatchSize || i == options.host_count - 1)
+        {
+            if (!database->addHosts(batch))
+            {
+                std::cout << "Unable to add hosts" << std::endl;
+                return false;
+            }
+
+            batch.clear();
+        }
+    }
+
+    printResult("New hosts (index, batched)", options.host_count, start_time);
+
+    if (failed)
+    {
+        std::cout << failed << " requests failed" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool parseOptions(const base::CommandLine& command_line, Options* options)
+{
+    if (!command_line.hasSwitch(u"file"))
+        return false;
+
+    options->file_path = std::filesystem::path(command_line.switchValue(u"file"));
+
+    if (command_line.hasSwitch(u"hosts"))
+    {
+        if (!base::stringToInt(command_line.switchValue(u"hosts"), &options->host_count) ||
+            options->host_count <= 0)
+        {
+            return false;
+        }
+    }
+
+    if (command_line.hasSwitch(u"requests"))
+    {
+        if (!base::stringToInt(command_line.switchValue(u"requests"), &options->request_count) ||
+            options->request_count <= 0)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void showHelp()
+{
+    std::cout << "aspia_router_database_benchmark --file=<path> [--hosts=<count>] "
+                 "[--requests=<count>]" << std::endl
+              << "  --file      Path to a new database file" << std::endl
+              << "  --hosts     Number of hosts in the database (default: 10000)" << std::endl
+              << "  --requests  Number of host ID requests (default: 100000)" << std::endl;
+}
+
+} // namespace
+
+int main(int argc, const char* const* argv)
+{
+    base::CommandLine command_line(argc, argv);
+
+    Options options;
+    if (command_line.hasSwitch(u"help") || !parseOptions(command_line, &options))
+    {
+        showHelp();
+        return 1;
+    }
+
+    return runBenchmark(options) ? 0 : 1;
+}
@@ -18,17 +18,151 @@
 
 #include "router/database_factory_sqlite.h"
 
+#include "base/logging.h"
 #include "router/database_sqlite.h"
 
+#include <mutex>
+#include <vector>
+
 namespace router {
 
-DatabaseFactorySqlite::DatabaseFactorySqlite() = default;
+class DatabaseFactorySqlite::Pool
+{
+public:
+    explicit Pool(const std::filesystem::path& file_path)
+        : file_path_(file_path)
+    {
+        // Nothing
+    }
+
+    std::unique_ptr<DatabaseSqlite> take()
+    {
+        {
+            std::scoped_lock lock(lock_);
+
+            if (!idle_.empty())
+            {
+                std::unique_ptr<DatabaseSqlite> database = std::move(idle_.back());
+                idle_.pop_back();
+                return database;
+            }
+        }
+
+        // The file is opened outside the lock.
+        if (file_path_.empty())
+            return DatabaseSqlite::open();
+
+        return DatabaseSqlite::open(file_path_);
+    }
+
+    void release(std::unique_ptr<DatabaseSqlite> database)
+    {
+        std::scoped_lock lock(lock_);
+
+        if (idle_.size() < kMaxIdleConnections)
+            idle_.emplace_back(std::move(database));
+    }
+
+private:
+    const std::filesystem::path file_path_;
+
+    std::mutex lock_;
+    std::vector<std::unique_ptr<DatabaseSqlite>> idle_;
+
+    DISALLOW_COPY_AND_ASSIGN(Pool);
+};
+
+// Returns the connection to the pool when destroyed.
+class DatabaseFactorySqlite::PooledDatabase : public Database
+{
+public:
+    PooledDatabase(std::shared_ptr<Pool> pool, std::unique_ptr<DatabaseSqlite> database)
+        : pool_(std::move(pool)),
+          database_(std::move(database))
+    {
+        DCHECK(pool_);
+        DCHECK(database_);
+    }
+
+    ~PooledDatabase() override
+    {
+        pool_->release(std::move(database_));
+    }
+
+    // Database implementation.
+    std::vector<base::User> userList() const override
+    {
+        return database_->userList();
+    }
+
+    bool addUser(const base::User& user) override
+    {
+        return database_->addUser(user);
+    }
+
+    bool modifyUser(const base::User& user) override
+    {
+        return database_->modifyUser(user);
+    }
+
+    bool removeUser(int64_t entry_id) override
+    {
+        return database_->removeUser(entry_id);
+    }
+
+    base::User findUser(std::u16string_view username) override
+    {
+        return database_->findUser(username);
+    }
+
+    base::HostId hostId(const base::ByteArray& keyHash) const override
+    {
+        return database_->hostId(keyHash);
+    }
+
+    bool addHost(const base::ByteArray& keyHash) override
+    {
+        return database_->addHost(keyHash);
+    }
+
+    bool hostList(std::vector<Host>* hosts) const override
+    {
+        return database_->hostList(hosts);
+    }
+
+    bool addHosts(const std::vector<Host>& hosts) override
+    {
+        return database_->addHosts(hosts);
+    }
+
+private:
+    std::shared_ptr<Pool> pool_;
+    std::unique_ptr<DatabaseSqlite> database_;
+
+    DISALLOW_COPY_AND_ASSIGN(PooledDatabase);
+};
+
+DatabaseFactorySqlite::DatabaseFactorySqlite()
+    : pool_(std::make_shared<Pool>(std::filesystem::path()))
+{
+    // Nothing
+}
+
+DatabaseFactorySqlite::DatabaseFactorySqlite(const std::filesystem::path& file_path)
+    : pool_(std::make_shared<Pool>(file_path))
+{
+    // Nothing
+}
 
 DatabaseFactorySqlite::~DatabaseFactorySqlite() = default;
 
 std::unique_ptr<Database> DatabaseFactorySqlite::openDatabase() const
 {
-    return DatabaseSqlite::open();
+    std::unique_ptr<DatabaseSqlite> database = pool_->take();
+    if (!database)
+        return nullptr;
+
+    return std::make_unique<PooledDatabase>(pool_, std::move(database));
 }
 
 } // namespace router
@@ -22,17 +22,35 @@
 #include "base/macros_magic.h"
 #include "router/database_factory.h"
 
+#include <filesystem>
+
 namespace router {
 
+//
+// Opens connections to the SQLite database of the router.
+// Connections are kept in a pool. A connection returned by openDatabase() goes back to the pool
+// when it is destroyed, so the database file is not reopened and the prepared statements of the
+// connection are reused. The pool can be used from any thread.
+//
 class DatabaseFactorySqlite : public DatabaseFactory
 {
 public:
+    // Uses the default database file (see DatabaseSqlite::filePath).
     DatabaseFactorySqlite();
+    explicit DatabaseFactorySqlite(const std::filesystem::path& file_path);
     ~DatabaseFactorySqlite();
 
     std::unique_ptr<Database> openDatabase() const override;
 
+    // Maximum number of unused connections that are kept open.
+    static const size_t kMaxIdleConnections = 8;
+
 private:
+    class Pool;
+    class PooledDatabase;
+
+    std::shared_ptr<Pool> pool_;
+
     DISALLOW_COPY_AND_ASSIGN(DatabaseFactorySqlite);
 };
 
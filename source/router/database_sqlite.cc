@@ -20,6 +20,7 @@
 
 #include "base/logging.h"
 #include "base/files/base_paths.h"
+#include "base/files/file_util.h"
 #include "base/strings/unicode.h"
 #include "build/build_config.h"
 
@@ -29,6 +30,72 @@ namespace router {
 
 namespace {
 
+// The order corresponds to DatabaseSqlite::Query.
+const char* kQueries[] =
+{
+    // USER_LIST
+    "SELECT * FROM users",
+
+    // ADD_USER
+    "INSERT INTO users ('id', 'name', 'group', 'salt', 'verifier', 'sessions', 'flags') "
+    "VALUES (NULL, ?, ?, ?, ?, ?, ?)",
+
+    // MODIFY_USER
+    "UPDATE users SET ('name', 'group', 'salt', 'verifier', 'sessions', 'flags') = "
+    "(?, ?, ?, ?, ?, ?) WHERE id=?",
+
+    // REMOVE_USER
+    "DELETE FROM users WHERE id=?",
+
+    // FIND_USER
+    "SELECT * FROM users WHERE name=?",
+
+    // HOST_ID
+    "SELECT * FROM hosts WHERE key=?",
+
+    // ADD_HOST
+    "INSERT INTO hosts ('id', 'key') VALUES (NULL, ?)",
+
+    // HOST_LIST
+    "SELECT id, key FROM hosts",
+
+    // ADD_HOST_WITH_ID
+    "INSERT OR IGNORE INTO hosts ('id', 'key') VALUES (?, ?)"
+};
+
+// Executed for each new connection. In WAL mode readers do not block the writer and a transaction
+// commit does not require a sync of the database file. With synchronous=NORMAL the database stays
+// consistent after a power loss, but the last transactions may be rolled back.
+const char kConnectionSetup[] =
+    "PRAGMA journal_mode=WAL;"
+    "PRAGMA synchronous=NORMAL;"
+    "PRAGMA temp_store=MEMORY;";
+
+// Time during which a connection waits for a lock held by another connection.
+const int kBusyTimeoutMs = 5000;
+
+// Resets a cached statement and its parameters when it goes out of scope.
+class ScopedStatementReset
+{
+public:
+    explicit ScopedStatementReset(sqlite3_stmt* statement)
+        : statement_(statement)
+    {
+        // Nothing
+    }
+
+    ~ScopedStatementReset()
+    {
+        sqlite3_reset(statement_);
+        sqlite3_clear_bindings(statement_);
+    }
+
+private:
+    sqlite3_stmt* statement_;
+
+    DISALLOW_COPY_AND_ASSIGN(ScopedStatementReset);
+};
+
 bool writeText(sqlite3_stmt* statement, const std::string& text, int column)
 {
     int error_code = sqlite3_bind_text(
@@ -226,10 +293,14 @@ DatabaseSqlite::DatabaseSqlite(sqlite3* db)
     : db_(db)
 {
     DCHECK(db_);
+    statements_.fill(nullptr);
 }
 
 DatabaseSqlite::~DatabaseSqlite()
 {
+    for (auto statement : statements_)
+        sqlite3_finalize(statement);
+
     sqlite3_close(db_);
 }
 
@@ -243,15 +314,34 @@ std::unique_ptr<DatabaseSqlite> DatabaseSqlite::open()
         return nullptr;
     }
 
+    return open(file_path);
+}
+
+// static
+std::unique_ptr<DatabaseSqlite> DatabaseSqlite::open(const std::filesystem::path& file_path)
+{
     sqlite3* db = nullptr;
 
-    int error_code = sqlite3_open(file_path.u8string().c_str(), &db);
+    // Each connection is used by one thread at a time, so the connection mutex is not needed.
+    int error_code = sqlite3_open_v2(base::utf8FromFilePath(file_path).c_str(), &db,
+                                     SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE |
+                                     SQLITE_OPEN_NOMUTEX, nullptr);
     if (error_code != SQLITE_OK)
     {
-        LOG(LS_WARNING) << "sqlite3_open failed: " << sqlite3_errstr(error_code);
+        LOG(LS_WARNING) << "sqlite3_open_v2 failed: " << sqlite3_errstr(error_code);
+        sqlite3_close(db);
         return nullptr;
     }
 
+    sqlite3_busy_timeout(db, kBusyTimeoutMs);
+
+    error_code = sqlite3_exec(db, kConnectionSetup, nullptr, nullptr, nullptr);
+    if (error_code != SQLITE_OK)
+    {
+        // The database is still usable with the default settings.
+        LOG(LS_WARNING) << "Unable to configure connection: " << sqlite3_errstr(error_code);
+    }
+
     return std::unique_ptr<DatabaseSqlite>(new DatabaseSqlite(db));
 }
 
@@ -274,15 +364,11 @@ std::filesystem::path DatabaseSqlite::filePath()
 
 std::vector<base::User> DatabaseSqlite::userList() const
 {
-    const char kQuery[] = "SELECT * FROM users";
-
-    sqlite3_stmt* statement;
-    int error_code = sqlite3_prepare(db_, kQuery, std::size(kQuery), &statement, nullptr);
-    if (error_code != SQLITE_OK)
-    {
-        LOG(LS_ERROR) << "sqlite3_prepare failed: " << sqlite3_errstr(error_code);
+    sqlite3_stmt* statement = preparedStatement(Query::USER_LIST);
+    if (!statement)
         return std::vector<base::User>();
-    }
+
+    ScopedStatementReset statement_reset(statement);
 
     std::vector<base::User> users;
     for (;;)
@@ -295,7 +381,6 @@ std::vector<base::User> DatabaseSqlite::userList() const
             users.emplace_back(std::move(user.value()));
     }
 
-    sqlite3_finalize(statement);
     return users;
 }
 
@@ -307,17 +392,11 @@ bool DatabaseSqlite::addUser(const base::User& user)
         return false;
     }
 
-    static const char kQuery[] =
-        "INSERT INTO users ('id', 'name', 'group', 'salt', 'verifier', 'sessions', 'flags') "
-        "VALUES (NULL, ?, ?, ?, ?, ?, ?)";
-
-    sqlite3_stmt* statement = nullptr;
-    int error_code = sqlite3_prepare(db_, kQuery, std::size(kQuery), &statement, nullptr);
-    if (error_code != SQLITE_OK)
-    {
-        LOG(LS_ERROR) << "sqlite3_prepare failed: " << sqlite3_errstr(error_code);
+    sqlite3_stmt* statement = preparedStatement(Query::ADD_USER);
+    if (!statement)
         return false;
-    }
+
+    ScopedStatementReset statement_reset(statement);
 
     std::string username = base::utf8FromUtf16(user.name);
     bool result = false;
@@ -342,7 +421,7 @@ bool DatabaseSqlite::addUser(const base::User& user)
         if (!writeInt(statement, static_cast<int>(user.flags), 6))
             break;
 
-        error_code = sqlite3_step(statement);
+        int error_code = sqlite3_step(statement);
         if (error_code != SQLITE_DONE)
         {
             LOG(LS_ERROR) << "sqlite3_step failed: " << sqlite3_errstr(error_code);
@@ -353,7 +432,6 @@ bool DatabaseSqlite::addUser(const base::User& user)
     }
     while (false);
 
-    sqlite3_finalize(statement);
     return result;
 }
 
@@ -365,17 +443,11 @@ bool DatabaseSqlite::modifyUser(const base::User& user)
         return false;
     }
 
-    static const char kQuery[] =
-        "UPDATE users SET ('name', 'group', 'salt', 'verifier', 'sessions', 'flags') = "
-        "(?, ?, ?, ?, ?, ?) WHERE id=?";
-
-    sqlite3_stmt* statement = nullptr;
-    int error_code = sqlite3_prepare(db_, kQuery, std::size(kQuery), &statement, nullptr);
-    if (error_code != SQLITE_OK)
-    {
-        LOG(LS_ERROR) << "sqlite3_prepare failed: " << sqlite3_errstr(error_code);
+    sqlite3_stmt* statement = preparedStatement(Query::MODIFY_USER);
+    if (!statement)
         return false;
-    }
+
+    ScopedStatementReset statement_reset(statement);
 
     std::string username = base::utf8FromUtf16(user.name);
     bool result = false;
@@ -403,7 +475,7 @@ bool DatabaseSqlite::modifyUser(const base::User& user)
         if (!writeInt64(statement, user.entry_id, 7))
             break;
 
-        error_code = sqlite3_step(statement);
+        int error_code = sqlite3_step(statement);
         if (error_code != SQLITE_DONE)
         {
             LOG(LS_ERROR) << "sqlite3_step failed: " << sqlite3_errstr(error_code);
@@ -414,21 +486,16 @@ bool DatabaseSqlite::modifyUser(const base::User& user)
     }
     while (false);
 
-    sqlite3_finalize(statement);
     return result;
 }
 
 bool DatabaseSqlite::removeUser(int64_t entry_id)
 {
-    static const char kQuery[] = "DELETE FROM users WHERE id=?";
-
-    sqlite3_stmt* statement = nullptr;
-    int error_code = sqlite3_prepare(db_, kQuery, std::size(kQuery), &statement, nullptr);
-    if (error_code != SQLITE_OK)
-    {
-        LOG(LS_ERROR) << "sqlite3_prepare failed: " << sqlite3_errstr(error_code);
+    sqlite3_stmt* statement = preparedStatement(Query::REMOVE_USER);
+    if (!statement)
         return false;
-    }
+
+    ScopedStatementReset statement_reset(statement);
 
     bool result = false;
 
@@ -437,7 +504,7 @@ bool DatabaseSqlite::removeUser(int64_t entry_id)
         if (!writeInt64(statement, entry_id, 1))
             break;
 
-        error_code = sqlite3_step(statement);
+        int error_code = sqlite3_step(statement);
         if (error_code != SQLITE_DONE)
         {
             LOG(LS_ERROR) << "sqlite3_step failed: " << sqlite3_errstr(error_code);
@@ -448,21 +515,16 @@ bool DatabaseSqlite::removeUser(int64_t entry_id)
     }
     while (false);
 
-    sqlite3_finalize(statement);
     return result;
 }
 
 base::User DatabaseSqlite::findUser(std::u16string_view username)
 {
-    const char kQuery[] = "SELECT * FROM users WHERE name=?";
-
-    sqlite3_stmt* statement = nullptr;
-    int error_code = sqlite3_prepare(db_, kQuery, std::size(kQuery), &statement, nullptr);
-    if (error_code != SQLITE_OK)
-    {
-        LOG(LS_ERROR) << "sqlite3_prepare failed: " << sqlite3_errstr(error_code);
+    sqlite3_stmt* statement = preparedStatement(Query::FIND_USER);
+    if (!statement)
         return base::User::kInvalidUser;
-    }
+
+    ScopedStatementReset statement_reset(statement);
 
     std::string username_utf8 = base::utf8FromUtf16(username);
     std::optional<base::User> user;
@@ -479,7 +541,6 @@ base::User DatabaseSqlite::findUser(std::u16string_view username)
     }
     while (false);
 
-    sqlite3_finalize(statement);
     return user.value_or(base::User::kInvalidUser);
 }
 
@@ -491,15 +552,11 @@ base::HostId DatabaseSqlite::hostId(const base::ByteArray& keyHash) const
         return base::kInvalidHostId;
     }
 
-    const char kQuery[] = "SELECT * FROM hosts WHERE key=?";
-
-    sqlite3_stmt* statement;
-    int error_code = sqlite3_prepare(db_, kQuery, std::size(kQuery), &statement, nullptr);
-    if (error_code != SQLITE_OK)
-    {
-        LOG(LS_ERROR) << "sqlite3_prepare failed: " << sqlite3_errstr(error_code);
+    sqlite3_stmt* statement = preparedStatement(Query::HOST_ID);
+    if (!statement)
         return base::kInvalidHostId;
-    }
+
+    ScopedStatementReset statement_reset(statement);
 
     base::HostId result = base::kInvalidHostId;
 
@@ -508,7 +565,8 @@ base::HostId DatabaseSqlite::hostId(const base::ByteArray& keyHash) const
         if (!writeBlob(statement, keyHash, 1))
             break;
 
-        if (sqlite3_step(statement) != SQLITE_ROW)
+        int error_code = sqlite3_step(statement);
+        if (error_code != SQLITE_ROW)
         {
             LOG(LS_ERROR) << "sqlite3_step failed: " << sqlite3_errstr(error_code);
             break;
@@ -525,7 +583,6 @@ base::HostId DatabaseSqlite::hostId(const base::ByteArray& keyHash) const
     }
     while (false);
 
-    sqlite3_finalize(statement);
     return result;
 }
 
@@ -537,15 +594,11 @@ bool DatabaseSqlite::addHost(const base::ByteArray& keyHash)
         return false;
     }
 
-    const char kQuery[] = "INSERT INTO hosts ('id', 'key') VALUES (NULL, ?)";
-
-    sqlite3_stmt* statement = nullptr;
-    int error_code = sqlite3_prepare(db_, kQuery, std::size(kQuery), &statement, nullptr);
-    if (error_code != SQLITE_OK)
-    {
-        LOG(LS_ERROR) << "sqlite3_prepare failed: " << sqlite3_errstr(error_code);
+    sqlite3_stmt* statement = preparedStatement(Query::ADD_HOST);
+    if (!statement)
         return false;
-    }
+
+    ScopedStatementReset statement_reset(statement);
 
     bool result = false;
 
@@ -554,7 +607,7 @@ bool DatabaseSqlite::addHost(const base::ByteArray& keyHash)
         if (!writeBlob(statement, keyHash, 1))
             break;
 
-        error_code = sqlite3_step(statement);
+        int error_code = sqlite3_step(statement);
         if (error_code != SQLITE_DONE)
         {
             LOG(LS_ERROR) << "sqlite3_step failed: " << sqlite3_errstr(error_code)
@@ -566,8 +619,129 @@ bool DatabaseSqlite::addHost(const base::ByteArray& keyHash)
     }
     while (false);
 
-    sqlite3_finalize(statement);
     return result;
 }
 
+bool DatabaseSqlite::hostList(std::vector<Host>* hosts) const
+{
+    DCHECK(hosts);
+
+    sqlite3_stmt* statement = preparedStatement(Query::HOST_LIST);
+    if (!statement)
+        return false;
+
+    ScopedStatementReset statement_reset(statement);
+    hosts->clear();
+
+    for (;;)
+    {
+        int error_code = sqlite3_step(statement);
+        if (error_code == SQLITE_DONE)
+            break;
+
+        if (error_code != SQLITE_ROW)
+        {
+            LOG(LS_ERROR) << "sqlite3_step failed: " << sqlite3_errstr(error_code);
+            return false;
+        }
+
+        std::optional<int64_t> entry_id = readInteger<int64_t>(statement, 0);
+        if (!entry_id.has_value())
+        {
+            LOG(LS_ERROR) << "Failed to get field 'id'";
+            continue;
+        }
+
+        std::optional<base::ByteArray> key_hash = readBlob(statement, 1);
+        if (!key_hash.has_value())
+        {
+            LOG(LS_ERROR) << "Failed to get field 'key'";
+            continue;
+        }
+
+        Host host;
+        host.host_id = static_cast<base::HostId>(entry_id.value());
+        host.key_hash = std::move(key_hash.value());
+
+        hosts->emplace_back(std::move(host));
+    }
+
+    return true;
+}
+
+bool DatabaseSqlite::addHosts(const std::vector<Host>& hosts)
+{
+    if (hosts.empty())
+        return true;
+
+    sqlite3_stmt* statement = preparedStatement(Query::ADD_HOST_WITH_ID);
+    if (!statement)
+        return false;
+
+    // A single transaction requires one sync of the journal for all hosts.
+    if (!execute("BEGIN TRANSACTION"))
+        return false;
+
+    for (const auto& host : hosts)
+    {
+        ScopedStatementReset statement_reset(statement);
+
+        if (!writeInt64(statement, static_cast<int64_t>(host.host_id), 1) ||
+            !writeBlob(statement, host.key_hash, 2))
+        {
+            execute("ROLLBACK");
+            return false;
+        }
+
+        int error_code = sqlite3_step(statement);
+        if (error_code != SQLITE_DONE)
+        {
+            LOG(LS_ERROR) << "sqlite3_step failed: " << sqlite3_errstr(error_code);
+            execute("ROLLBACK");
+            return false;
+        }
+    }
+
+    if (!execute("COMMIT"))
+    {
+        execute("ROLLBACK");
+        return false;
+    }
+
+    return true;
+}
+
+bool DatabaseSqlite::execute(const char* query)
+{
+    int error_code = sqlite3_exec(db_, query, nullptr, nullptr, nullptr);
+    if (error_code != SQLITE_OK)
+    {
+        LOG(LS_ERROR) << "sqlite3_exec failed: " << sqlite3_errstr(error_code)
+                      << " (" << query << ")";
+        return false;
+    }
+
+    return true;
+}
+
+sqlite3_stmt* DatabaseSqlite::preparedStatement(Query query) const
+{
+    static_assert(std::size(kQueries) == static_cast<size_t>(Query::COUNT));
+
+    sqlite3_stmt*& statement = statements_[static_cast<size_t>(query)];
+    if (statement)
+        return statement;
+
+    int error_code = sqlite3_prepare_v3(db_, kQueries[static_cast<size_t>(query)], -1,
+                                        SQLITE_PREPARE_PERSISTENT, &statement, nullptr);
+    if (error_code != SQLITE_OK)
+    {
+        LOG(LS_ERROR) << "sqlite3_prepare_v3 failed: " << sqlite3_errstr(error_code);
+        statement = nullptr;
+        return nullptr;
+    }
+
+    return statement;
+}
+
 } // namespace router
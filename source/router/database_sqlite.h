@@ -22,6 +22,7 @@
 #include "base/macros_magic.h"
 #include "router/database.h"
 
+#include <array>
 #include <filesystem>
 
 #include <sqlite3.h>
@@ -34,6 +35,7 @@ public:
     ~DatabaseSqlite();
 
     static std::unique_ptr<DatabaseSqlite> open();
+    static std::unique_ptr<DatabaseSqlite> open(const std::filesystem::path& file_path);
     static std::filesystem::path filePath();
 
     // Database implementation.
@@ -44,11 +46,34 @@ public:
     base::User findUser(std::u16string_view username) override;
     base::HostId hostId(const base::ByteArray& keyHash) const override;
     bool addHost(const base::ByteArray& keyHash) override;
+    bool hostList(std::vector<Host>* hosts) const override;
+    bool addHosts(const std::vector<Host>& hosts) override;
 
 private:
+    enum class Query
+    {
+        USER_LIST,
+        ADD_USER,
+        MODIFY_USER,
+        REMOVE_USER,
+        FIND_USER,
+        HOST_ID,
+        ADD_HOST,
+        HOST_LIST,
+        ADD_HOST_WITH_ID,
+        COUNT
+    };
+
     explicit DatabaseSqlite(sqlite3* db);
 
+    // Returns the prepared statement for |query|. Statements are prepared on first use and are
+    // kept until the connection is closed. Returns nullptr on error.
+    sqlite3_stmt* preparedStatement(Query query) const;
+
+    bool execute(const char* query);
+
     sqlite3* db_;
+    mutable std::array<sqlite3_stmt*, static_cast<size_t>(Query::COUNT)> statements_;
 
     DISALLOW_COPY_AND_ASSIGN(DatabaseSqlite);
 };
@@ -0,0 +1,144 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "router/host_key_index.h"
+
+#include "base/logging.h"
+
+#include <cstring>
+
+namespace router {
+
+namespace {
+
+const size_t kMinSlotCount = 1024;
+
+// The table is kept at most half full, so probe sequences stay short.
+const size_t kMaxLoadFactor = 2;
+
+size_t slotCountFor(size_t count)
+{
+    size_t slot_count = kMinSlotCount;
+    while (slot_count < count * kMaxLoadFactor)
+        slot_count *= 2;
+
+    return slot_count;
+}
+
+} // namespace
+
+HostKeyIndex::HostKeyIndex()
+{
+    slots_.resize(kMinSlotCount);
+}
+
+HostKeyIndex::~HostKeyIndex() = default;
+
+base::HostId HostKeyIndex::find(const base::ByteArray& key_hash) const
+{
+    if (key_hash.size() != kKeySize)
+        return base::kInvalidHostId;
+
+    const Slot& slot = slots_[findSlot(key_hash.data(), hashOf(key_hash.data()))];
+    if (!slot.position)
+        return base::kInvalidHostId;
+
+    return entries_[slot.position - 1].host_id;
+}
+
+bool HostKeyIndex::insert(const base::ByteArray& key_hash, base::HostId host_id)
+{
+    if (key_hash.size() != kKeySize || host_id == base::kInvalidHostId)
+    {
+        LOG(LS_ERROR) << "Invalid parameters";
+        return false;
+    }
+
+    if ((entries_.size() + 1) * kMaxLoadFactor > slots_.size())
+        rehash(slots_.size() * 2);
+
+    const uint64_t hash = hashOf(key_hash.data());
+    Slot& slot = slots_[findSlot(key_hash.data(), hash)];
+    if (slot.position)
+        return false;
+
+    Entry entry;
+    memcpy(entry.key.data(), key_hash.data(), kKeySize);
+    entry.host_id = host_id;
+
+    entries_.emplace_back(entry);
+
+    slot.tag = static_cast<uint32_t>(hash >> 32);
+    slot.position = static_cast<uint32_t>(entries_.size());
+    return true;
+}
+
+void HostKeyIndex::reserve(size_t count)
+{
+    entries_.reserve(count);
+
+    const size_t slot_count = slotCountFor(count);
+    if (slot_count > slots_.size())
+        rehash(slot_count);
+}
+
+// static
+uint64_t HostKeyIndex::hashOf(const uint8_t* key)
+{
+    uint64_t hash;
+    memcpy(&hash, key, sizeof(hash));
+    return hash;
+}
+
+size_t HostKeyIndex::findSlot(const uint8_t* key, uint64_t hash) const
+{
+    const size_t mask = slots_.size() - 1;
+    const uint32_t tag = static_cast<uint32_t>(hash >> 32);
+
+    size_t index = static_cast<size_t>(hash) & mask;
+
+    for (;;)
+    {
+        const Slot& slot = slots_[index];
+        if (!slot.position)
+            return index;
+
+        if (slot.tag == tag && memcmp(entries_[slot.position - 1].key.data(), key, kKeySize) == 0)
+            return index;
+
+        index = (index + 1) & mask;
+    }
+}
+
+void HostKeyIndex::rehash(size_t slot_count)
+{
+    DCHECK(!(slot_count & (slot_count - 1)));
+
+    slots_.assign(slot_count, Slot());
+
+    for (size_t i = 0; i < entries_.size(); ++i)
+    {
+        const uint64_t hash = hashOf(entries_[i].key.data());
+        Slot& slot = slots_[findSlot(entries_[i].key.data(), hash)];
+
+        slot.tag = static_cast<uint32_t>(hash >> 32);
+        slot.position = static_cast<uint32_t>(i + 1);
+    }
+}
+
+} // namespace router
@@ -0,0 +1,91 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef ROUTER__HOST_KEY_INDEX_H
+#define ROUTER__HOST_KEY_INDEX_H
+
+#include "base/macros_magic.h"
+#include "base/memory/byte_array.h"
+#include "base/peer/host_id.h"
+
+#include <array>
+#include <vector>
+
+namespace router {
+
+//
+// In-memory index of host key hashes (BLAKE2b512, 64 bytes) to host IDs.
+// Entries are stored in a dense array. The hash table uses open addressing with linear probing,
+// each slot holds the position of an entry and 32 bits of its hash, so a probe rarely touches the
+// entries themselves. Key hashes are uniformly distributed, so their first bytes are used as the
+// hash of the table.
+// The class is not thread-safe.
+//
+class HostKeyIndex
+{
+public:
+    static const size_t kKeySize = 64;
+
+    HostKeyIndex();
+    ~HostKeyIndex();
+
+    // Returns the ID of the host with the specified key hash or kInvalidHostId if there is no such
+    // host.
+    base::HostId find(const base::ByteArray& key_hash) const;
+
+    // Adds a host. Returns false if the key hash has an invalid size or is already in the index.
+    bool insert(const base::ByteArray& key_hash, base::HostId host_id);
+
+    // Prepares the index for |count| entries.
+    void reserve(size_t count);
+
+    size_t size() const { return entries_.size(); }
+    bool empty() const { return entries_.empty(); }
+
+private:
+    using Key = std::array<uint8_t, kKeySize>;
+
+    struct Entry
+    {
+        Key key;
+        base::HostId host_id;
+    };
+
+    struct Slot
+    {
+        uint32_t tag = 0;
+
+        // Position of the entry plus one. Zero means an empty slot.
+        uint32_t position = 0;
+    };
+
+    static uint64_t hashOf(const uint8_t* key);
+
+    // Returns the slot that contains |key| or the empty slot where it should be placed.
+    size_t findSlot(const uint8_t* key, uint64_t hash) const;
+    void rehash(size_t slot_count);
+
+    std::vector<Entry> entries_;
+    std::vector<Slot> slots_;
+
+    DISALLOW_COPY_AND_ASSIGN(HostKeyIndex);
+};
+
+} // namespace router
+
+#endif // ROUTER__HOST_KEY_INDEX_H
@@ -0,0 +1,188 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "router/host_key_store.h"
+
+#include "base/logging.h"
+#include "router/database_factory.h"
+
+namespace router {
+
+// static
+const std::chrono::milliseconds HostKeyStore::kFlushDelay{ 100 };
+
+HostKeyStore::HostKeyStore(std::shared_ptr<DatabaseFactory> database_factory,
+                           std::shared_ptr<base::TaskRunner> database_task_runner,
+                           std::shared_ptr<base::TaskRunner> task_runner)
+    : database_factory_(database_factory),
+      task_runner_(task_runner),
+      database_(std::move(database_factory), std::move(database_task_runner),
+                std::move(task_runner))
+{
+    DCHECK(task_runner_);
+}
+
+HostKeyStore::~HostKeyStore()
+{
+    if (flush_task_id_)
+        task_runner_->cancelDelayedTask(flush_task_id_);
+
+    // The batch in progress is written again, because it may not be completed yet. Hosts that are
+    // already in the database are skipped.
+    std::vector<Database::Host> hosts = std::move(flushing_);
+    hosts.insert(hosts.end(),
+                 std::make_move_iterator(journal_.begin()), std::make_move_iterator(journal_.end()));
+
+    if (hosts.empty())
+        return;
+
+    std::unique_ptr<Database> database = database_factory_->openDatabase();
+    if (!database || !database->addHosts(hosts))
+        LOG(LS_ERROR) << "Unable to write " << hosts.size() << " hosts to the database";
+}
+
+bool HostKeyStore::load()
+{
+    std::unique_ptr<Database> database = database_factory_->openDatabase();
+    if (!database)
+    {
+        LOG(LS_ERROR) << "Failed to connect to database";
+        return false;
+    }
+
+    std::vector<Database::Host> hosts;
+    if (!database->hostList(&hosts))
+    {
+        LOG(LS_ERROR) << "Unable to read the list of hosts";
+        return false;
+    }
+
+    index_.reserve(hosts.size());
+
+    for (const auto& host : hosts)
+    {
+        if (!index_.insert(host.key_hash, host.host_id))
+        {
+            LOG(LS_WARNING) << "Invalid host entry: " << host.host_id;
+            continue;
+        }
+
+        next_host_id_ = std::max(next_host_id_, host.host_id + 1);
+    }
+
+    LOG(LS_INFO) << "Loaded " << index_.size() << " hosts (next ID: " << next_host_id_ << ")";
+    return true;
+}
+
+base::HostId HostKeyStore::hostId(const base::ByteArray& key_hash) const
+{
+    return index_.find(key_hash);
+}
+
+base::HostId HostKeyStore::addHost(const base::ByteArray& key_hash)
+{
+    base::HostId host_id = index_.find(key_hash);
+    if (host_id != base::kInvalidHostId)
+        return host_id;
+
+    host_id = next_host_id_;
+    if (!index_.insert(key_hash, host_id))
+        return base::kInvalidHostId;
+
+    ++next_host_id_;
+
+    Database::Host host;
+    host.host_id = host_id;
+    host.key_hash = key_hash;
+    journal_.emplace_back(std::move(host));
+
+    if (journal_.size() >= kMaxBatchSize)
+        flush();
+    else
+        scheduleFlush();
+
+    return host_id;
+}
+
+void HostKeyStore::scheduleFlush()
+{
+    if (flush_task_id_)
+        return;
+
+    flush_task_id_ = task_runner_->postCancelableDelayedTask([this]()
+    {
+        flush_task_id_ = 0;
+        flush();
+    },
+    kFlushDelay);
+}
+
+void HostKeyStore::flush()
+{
+    // The next batch is written after completion of the current one.
+    if (flush_in_progress_ || journal_.empty())
+        return;
+
+    if (flush_task_id_)
+    {
+        task_runner_->cancelDelayedTask(flush_task_id_);
+        flush_task_id_ = 0;
+    }
+
+    flushing_ = std::move(journal_);
+    journal_.clear();
+    flush_in_progress_ = true;
+
+    database_.execute([hosts = flushing_](Database& database)
+    {
+        return database.addHosts(hosts);
+    },
+    [this](bool result)
+    {
+        onFlushed(result);
+    });
+}
+
+void HostKeyStore::onFlushed(bool result)
+{
+    flush_in_progress_ = false;
+
+    if (!result)
+    {
+        LOG(LS_ERROR) << "Unable to write " << flushing_.size() << " hosts to the database";
+
+        // The batch is repeated together with the hosts that were added after it.
+        journal_.insert(journal_.begin(),
+                        std::make_move_iterator(flushing_.begin()),
+                        std::make_move_iterator(flushing_.end()));
+        flushing_.clear();
+
+        // The database may be busy, so the next attempt is made after a delay.
+        scheduleFlush();
+        return;
+    }
+
+    flushing_.clear();
+
+    if (journal_.size() >= kMaxBatchSize)
+        flush();
+    else if (!journal_.empty())
+        scheduleFlush();
+}
+
+} // namespace router
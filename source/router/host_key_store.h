@@ -0,0 +1,89 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef ROUTER__HOST_KEY_STORE_H
+#define ROUTER__HOST_KEY_STORE_H
+
+#include "router/async_database.h"
+#include "router/database.h"
+#include "router/host_key_index.h"
+
+namespace router {
+
+//
+// Resolves host IDs by key hashes without access to the database.
+// All hosts are loaded into HostKeyIndex at startup. A new host gets its ID immediately and is
+// written to the database later, together with other new hosts, in a single transaction on the
+// database thread (write-behind). A batch is written when it reaches kMaxBatchSize hosts or
+// kFlushDelay after the first host was added to it. A failed batch is repeated. Hosts that are not
+// yet written when the store is destroyed are written synchronously.
+// If the router process is terminated abnormally, the hosts added during the last kFlushDelay are
+// lost and have to request a new ID.
+// Host IDs are assigned by the store, so the hosts must not be added to the database by other
+// means while the store exists.
+//
+class HostKeyStore
+{
+public:
+    HostKeyStore(std::shared_ptr<DatabaseFactory> database_factory,
+                 std::shared_ptr<base::TaskRunner> database_task_runner,
+                 std::shared_ptr<base::TaskRunner> task_runner);
+    ~HostKeyStore();
+
+    // Loads the hosts from the database. Must be called before the other methods.
+    bool load();
+
+    // Returns the ID of the host or kInvalidHostId if there is no such host.
+    base::HostId hostId(const base::ByteArray& key_hash) const;
+
+    // Assigns an ID to a new host. If the host already exists, its ID is returned. Returns
+    // kInvalidHostId on error.
+    base::HostId addHost(const base::ByteArray& key_hash);
+
+    size_t count() const { return index_.size(); }
+
+    static const size_t kMaxBatchSize = 512;
+    static const std::chrono::milliseconds kFlushDelay;
+
+private:
+    void scheduleFlush();
+    void flush();
+    void onFlushed(bool result);
+
+    std::shared_ptr<DatabaseFactory> database_factory_;
+    std::shared_ptr<base::TaskRunner> task_runner_;
+    AsyncDatabase database_;
+
+    HostKeyIndex index_;
+    base::HostId next_host_id_ = 1;
+
+    // New hosts that are not yet written to the database.
+    std::vector<Database::Host> journal_;
+
+    // Hosts that are being written now.
+    std::vector<Database::Host> flushing_;
+    bool flush_in_progress_ = false;
+
+    base::TaskRunner::DelayedTaskId flush_task_id_ = 0;
+
+    DISALLOW_COPY_AND_ASSIGN(HostKeyStore);
+};
+
+} // namespace router
+
+#endif // ROUTER__HOST_KEY_STORE_H
@@ -0,0 +1,1039 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "base/command_line.h"
+#include "base/logging.h"
+#include "base/task_runner.h"
+#include "base/crypto/random.h"
+#include "base/message_loop/message_loop.h"
+#include "base/net/network_channel.h"
+#include "base/peer/client_authenticator.h"
+#include "base/peer/host_id.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/unicode.h"
+#include "build/build_config.h"
+#include "proto/router_client.pb.h"
+#include "proto/router_common.pb.h"
+#include "proto/router_host.pb.h"
+#include "proto/router_relay.pb.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+#if defined(OS_WIN)
+#include <Windows.h>
+#include <psapi.h>
+#endif // defined(OS_WIN)
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using TimePoint = Clock::time_point;
+using Milliseconds = std::chrono::duration<double, std::milli>;
+
+struct Options
+{
+    std::u16string address;
+    uint16_t port = 8060;
+    std::u16string user_name;
+    std::u16string password;
+    base::ByteArray public_key;
+    int host_count = 1000;
+    int client_count = 16;
+    int relay_count = 4;
+    int relay_key_count = 1000;
+    int concurrency = 50;
+    std::chrono::seconds stage_duration{ 5 };
+    int flood_count = 0;
+    uint32_t router_pid = 0;
+};
+
+// Returns the resident memory of the process in bytes or zero if it is unknown.
+int64_t processMemory(uint32_t pid)
+{
+    if (!pid)
+        return 0;
+
+#if defined(OS_WIN)
+    HANDLE process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+    if (!process)
+        return 0;
+
+    PROCESS_MEMORY_COUNTERS counters;
+    memset(&counters, 0, sizeof(counters));
+
+    int64_t result = 0;
+    if (GetProcessMemoryInfo(process, &counters, sizeof(counters)))
+        result = static_cast<int64_t>(counters.WorkingSetSize);
+
+    CloseHandle(process);
+    return result;
+#elif defined(OS_LINUX)
+    std::ifstream status("/proc/" + std::to_string(pid) + "/status");
+    std::string line;
+
+    while (std::getline(status, line))
+    {
+        if (line.rfind("VmRSS:", 0) != 0)
+            continue;
+
+        std::istringstream stream(line.substr(6));
+        int64_t kilobytes = 0;
+        if (!(stream >> kilobytes))
+            return 0;
+
+        return kilobytes * 1024;
+    }
+
+    return 0;
+#else
+    return 0;
+#endif
+}
+
+class Latencies
+{
+public:
+    void add(const Clock::duration& latency)
+    {
+        values_.emplace_back(std::chrono::duration_cast<Milliseconds>(latency).count());
+    }
+
+    size_t count() const { return values_.size(); }
+    void clear() { values_.clear(); }
+
+    void print(const char* name)
+    {
+        if (values_.empty())
+        {
+            std::cout << name << ": no samples" << std::endl;
+            return;
+        }
+
+        std::sort(values_.begin(), values_.end());
+
+        auto percentile = [this](double value)
+        {
+            size_t index = static_cast<size_t>(value * (values_.size() - 1));
+            return values_[index];
+        };
+
+        std::cout << name << " (ms): p50 " << percentile(0.5)
+                  << ", p90 " << percentile(0.9)
+                  << ", p99 " << percentile(0.99)
+                  << ", max " << values_.back() << std::endl;
+    }
+
+    double percentile99()
+    {
+        if (values_.empty())
+            return 0;
+
+        std::sort(values_.begin(), values_.end());
+        return values_[static_cast<size_t>(0.99 * (values_.size() - 1))];
+    }
+
+private:
+    std::vector<double> values_;
+};
+
+class LoadTest;
+
+//
+// Connection to the router with a session of the specified type. After authentication the
+// connection stays open and the messages of the router are passed to the subclass.
+//
+class Peer : public base::NetworkChannel::Listener
+{
+public:
+    Peer(LoadTest* load_test, proto::RouterSession session_type);
+    virtual ~Peer() = default;
+
+    void start();
+
+protected:
+    virtual void onReady() = 0;
+    virtual void onMessage(const base::ByteArray& buffer) = 0;
+    virtual void onFailed() = 0;
+
+    virtual std::u16string userName() const;
+
+    void send(const google::protobuf::MessageLite& message);
+
+    // Closes the connection and connects again.
+    void restart();
+
+    // base::NetworkChannel::Listener implementation.
+    void onConnected() override;
+    void onDisconnected(base::NetworkChannel::ErrorCode error_code) override;
+    void onMessageReceived(const base::ByteArray& buffer) override;
+    void onMessageWritten(size_t pending) override;
+
+    LoadTest* const load_test_;
+    TimePoint start_time_;
+    base::ClientAuthenticator::ErrorCode error_code_ = base::ClientAuthenticator::ErrorCode::SUCCESS;
+
+private:
+    const proto::RouterSession session_type_;
+    std::unique_ptr<base::NetworkChannel> channel_;
+    std::unique_ptr<base::ClientAuthenticator> authenticator_;
+    bool failed_ = false;
+
+    DISALLOW_COPY_AND_ASSIGN(Peer);
+};
+
+class RelayPeer : public Peer
+{
+public:
+    RelayPeer(LoadTest* load_test, int index);
+
+protected:
+    void onReady() override;
+    void onMessage(const base::ByteArray& buffer) override;
+    void onFailed() override;
+
+private:
+    void sendKeys(int count);
+
+    const std::string host_;
+    uint32_t next_key_id_ = 0;
+
+    DISALLOW_COPY_AND_ASSIGN(RelayPeer);
+};
+
+class HostPeer : public Peer
+{
+public:
+    explicit HostPeer(LoadTest* load_test);
+
+protected:
+    void onReady() override;
+    void onMessage(const base::ByteArray& buffer) override;
+    void onFailed() override;
+
+private:
+    TimePoint request_time_;
+    bool registered_ = false;
+
+    DISALLOW_COPY_AND_ASSIGN(HostPeer);
+};
+
+class ClientPeer : public Peer
+{
+public:
+    explicit ClientPeer(LoadTest* load_test);
+
+    // Starts sending connection requests one after another. Returns false if the client is not
+    // logged in.
+    bool activate();
+
+protected:
+    void onReady() override;
+    void onMessage(const base::ByteArray& buffer) override;
+    void onFailed() override;
+
+private:
+    void sendRequest();
+
+    TimePoint request_time_;
+    int stage_ = 0;
+    bool ready_ = false;
+    bool active_ = false;
+
+    DISALLOW_COPY_AND_ASSIGN(ClientPeer);
+};
+
+//
+// Connection that logs in with an unknown user name and connects again as soon as the login is
+// denied, like a reconnect storm or a password scanner. The names are taken from a small set, so
+// most logins repeat a name that the router has already seen.
+//
+class FloodPeer : public Peer
+{
+public:
+    explicit FloodPeer(LoadTest* load_test);
+
+protected:
+    void onReady() override;
+    void onMessage(const base::ByteArray& buffer) override;
+    void onFailed() override;
+    std::u16string userName() const override;
+
+private:
+    DISALLOW_COPY_AND_ASSIGN(FloodPeer);
+};
+
+//
+// Load test of the router. The test runs in the following phases:
+// 1. |relay_count| relays connect and supply |relay_key_count| keys each. Used keys are replaced.
+// 2. |host_count| hosts connect and request new IDs (|concurrency| logins at a time).
+// 3. |client_count| clients log in with the specified user.
+// 4. The clients send connection requests to random hosts, each client waits for the offer before
+//    sending the next request. The number of active clients is doubled every |stage_duration|
+//    until all clients are active. The stage after which the throughput grows by less than 10% is
+//    reported as the saturation point.
+//    If |flood_count| is specified, the flood connections (see FloodPeer) are started with the
+//    first stage, so the throughput of authenticated sessions can be compared with a run without
+//    the flood.
+// If the process ID of the router is specified, the memory of the router is measured before and
+// after the connection of all sessions.
+//
+class LoadTest
+{
+public:
+    LoadTest(std::shared_ptr<base::TaskRunner> task_runner, const Options& options)
+        : task_runner_(std::move(task_runner)),
+          options_(options),
+          random_(std::random_device()())
+    {
+        // Nothing
+    }
+
+    void start()
+    {
+        initial_memory_ = processMemory(options_.router_pid);
+
+        std::cout << "Connecting " << options_.relay_count << " relays..." << std::endl;
+        phase_start_time_ = Clock::now();
+
+        for (int i = 0; i < options_.relay_count; ++i)
+            startPeer(std::make_unique<RelayPeer>(this, i));
+    }
+
+    const Options& options() const { return options_; }
+    std::shared_ptr<base::TaskRunner> taskRunner() const { return task_runner_; }
+    int stage() const { return stage_; }
+
+    void onAuthenticated(const Clock::duration& latency)
+    {
+        auth_latencies_.add(latency);
+    }
+
+    void onRelayReady()
+    {
+        ++ready_relays_;
+        checkRelays();
+    }
+
+    void onRelayFailed()
+    {
+        ++failed_relays_;
+        checkRelays();
+    }
+
+    void onHostRegistered(base::HostId host_id, const Clock::duration& latency)
+    {
+        host_ids_.emplace_back(host_id);
+        registration_latencies_.add(latency);
+        onHostFinished();
+    }
+
+    void onHostFailed()
+    {
+        ++failed_hosts_;
+        onHostFinished();
+    }
+
+    void onHostOffer()
+    {
+        ++host_offers_;
+    }
+
+    void onClientReady()
+    {
+        ++ready_clients_;
+        onClientFinished();
+    }
+
+    void onClientFailed()
+    {
+        ++failed_clients_;
+        onClientFinished();
+    }
+
+    void onOfferReceived(int stage, bool success, const Clock::duration& latency)
+    {
+        if (stage != stage_)
+            return;
+
+        if (success)
+            offer_latencies_.add(latency);
+        else
+            ++failed_offers_;
+    }
+
+    void onFloodLogin(bool rejected)
+    {
+        if (rejected)
+            ++flood_rejected_;
+        else
+            ++flood_denied_;
+    }
+
+    base::HostId randomHostId()
+    {
+        std::uniform_int_distribution<size_t> distribution(0, host_ids_.size() - 1);
+        return host_ids_[distribution(random_)];
+    }
+
+private:
+    struct StageResult
+    {
+        int clients = 0;
+        double throughput = 0;
+        double p99 = 0;
+    };
+
+    void startPeer(std::unique_ptr<Peer> peer)
+    {
+        Peer* peer_ptr = peer.get();
+        peers_.emplace_back(std::move(peer));
+        peer_ptr->start();
+    }
+
+    void checkRelays()
+    {
+        if (ready_relays_ + failed_relays_ < options_.relay_count)
+            return;
+
+        std::cout << "Relays: " << ready_relays_ << " ready, " << failed_relays_ << " failed"
+                  << std::endl;
+
+        std::cout << "Connecting " << options_.host_count << " hosts..." << std::endl;
+        phase_start_time_ = Clock::now();
+        auth_latencies_.clear();
+
+        int initial = std::min(options_.concurrency, options_.host_count);
+        for (int i = 0; i < initial; ++i)
+            startHost();
+    }
+
+    void startHost()
+    {
+        ++started_hosts_;
+        startPeer(std::make_unique<HostPeer>(this));
+    }
+
+    void onHostFinished()
+    {
+        if (started_hosts_ < options_.host_count)
+        {
+            startHost();
+            return;
+        }
+
+        if (static_cast<int>(host_ids_.size()) + failed_hosts_ < options_.host_count)
+            return;
+
+        Milliseconds duration = Clock::now() - phase_start_time_;
+
+        std::cout << "Hosts: " << host_ids_.size() << " registered, " << failed_hosts_
+                  << " failed in " << duration.count() << " ms" << std::endl
+                  << "Authentication rate: " << (auth_latencies_.count() * 1000.0 / duration.count())
+                  << " logins/s" << std::endl;
+        auth_latencies_.print("Host authentication latency");
+        registration_latencies_.print("Host registration latency (connect to ID)");
+
+        if (host_ids_.empty())
+        {
+            finish();
+            return;
+        }
+
+        std::cout << "Connecting " << options_.client_count << " clients..." << std::endl;
+        phase_start_time_ = Clock::now();
+        auth_latencies_.clear();
+
+        int initial = std::min(options_.concurrency, options_.client_count);
+        for (int i = 0; i < initial; ++i)
+            startClient();
+    }
+
+    void startClient()
+    {
+        ++started_clients_;
+
+        std::unique_ptr<ClientPeer> client = std::make_unique<ClientPeer>(this);
+        clients_.emplace_back(client.get());
+        startPeer(std::move(client));
+    }
+
+    void onClientFinished()
+    {
+        if (started_clients_ < options_.client_count)
+        {
+            startClient();
+            return;
+        }
+
+        if (ready_clients_ + failed_clients_ < options_.client_count)
+            return;
+
+        std::cout << "Clients: " << ready_clients_ << " ready, " << failed_clients_ << " failed"
+                  << std::endl;
+        auth_latencies_.print("Client authentication latency");
+
+        const int64_t memory = processMemory(options_.router_pid);
+        const int sessions = ready_relays_ + static_cast<int>(host_ids_.size()) + ready_clients_;
+
+        if (memory && initial_memory_ && sessions)
+        {
+            std::cout << "Router memory: " << memory / 1024 << " KB (" << sessions
+                      << " sessions, " << (memory - initial_memory_) / sessions
+                      << " bytes per session)" << std::endl;
+        }
+
+        if (!ready_clients_)
+        {
+            finish();
+            return;
+        }
+
+        startStage(1);
+    }
+
+    void startStage(int active_clients)
+    {
+        ++stage_;
+        active_clients_ = std::min(active_clients, ready_clients_);
+        offer_latencies_.clear();
+        failed_offers_ = 0;
+        flood_denied_ = 0;
+        flood_rejected_ = 0;
+        phase_start_time_ = Clock::now();
+
+        if (stage_ == 1)
+        {
+            for (int i = 0; i < options_.flood_count; ++i)
+                startPeer(std::make_unique<FloodPeer>(this));
+        }
+
+        int activated = 0;
+        for (ClientPeer* client : clients_)
+        {
+            if (activated == active_clients_)
+                break;
+
+            if (client->activate())
+                ++activated;
+        }
+
+        task_runner_->postDelayedTask(
+            std::bind(&LoadTest::finishStage, this), options_.stage_duration);
+    }
+
+    void finishStage()
+    {
+        Milliseconds duration = Clock::now() - phase_start_time_;
+
+        StageResult result;
+        result.clients = active_clients_;
+        result.throughput = offer_latencies_.count() * 1000.0 / duration.count();
+        result.p99 = offer_latencies_.percentile99();
+        stages_.emplace_back(result);
+
+        std::cout << "Stage " << stage_ << ": " << active_clients_ << " clients, "
+                  << result.throughput << " offers/s, " << failed_offers_ << " failed" << std::endl;
+        offer_latencies_.print("  Connection offer latency");
+
+        if (options_.flood_count)
+        {
+            std::cout << "  Flood: " << flood_denied_ * 1000.0 / duration.count()
+                      << " logins/s denied after authentication, "
+                      << flood_rejected_ * 1000.0 / duration.count()
+                      << " connections/s rejected" << std::endl;
+        }
+
+        if (active_clients_ < ready_clients_)
+        {
+            startStage(active_clients_ * 2);
+            return;
+        }
+
+        printSaturation();
+        finish();
+    }
+
+    void printSaturation()
+    {
+        for (size_t i = 1; i < stages_.size(); ++i)
+        {
+            if (stages_[i].throughput < stages_[i - 1].throughput * 1.1)
+            {
+                std::cout << "Saturation point: " << stages_[i - 1].clients << " clients, "
+                          << stages_[i - 1].throughput << " offers/s (p99 "
+                          << stages_[i - 1].p99 << " ms)" << std::endl;
+                return;
+            }
+        }
+
+        std::cout << "Saturation point not reached (increase the number of clients)"
+                  << std::endl;
+    }
+
+    void finish()
+    {
+        std::cout << "Offers received by hosts: " << host_offers_ << std::endl;
+        task_runner_->postQuit();
+    }
+
+    std::shared_ptr<base::TaskRunner> task_runner_;
+    const Options options_;
+    std::mt19937 random_;
+
+    // Peers are never deleted during the test: the connections of hosts and relays must be kept
+    // and a failed peer is a rare case.
+    std::vector<std::unique_ptr<Peer>> peers_;
+    std::vector<ClientPeer*> clients_;
+
+    int ready_relays_ = 0;
+    int failed_relays_ = 0;
+
+    int started_hosts_ = 0;
+    int failed_hosts_ = 0;
+    std::vector<base::HostId> host_ids_;
+    int64_t host_offers_ = 0;
+
+    int started_clients_ = 0;
+    int ready_clients_ = 0;
+    int failed_clients_ = 0;
+
+    int stage_ = 0;
+    int active_clients_ = 0;
+    int failed_offers_ = 0;
+    std::vector<StageResult> stages_;
+
+    int64_t flood_denied_ = 0;
+    int64_t flood_rejected_ = 0;
+
+    TimePoint phase_start_time_;
+    int64_t initial_memory_ = 0;
+
+    Latencies auth_latencies_;
+    Latencies registration_latencies_;
+    Latencies offer_latencies_;
+
+    DISALLOW_COPY_AND_ASSIGN(LoadTest);
+};
+
+Peer::Peer(LoadTest* load_test, proto::RouterSession session_type)
+    : load_test_(load_test),
+      session_type_(session_type)
+{
+    // Nothing
+}
+
+void Peer::start()
+{
+    start_time_ = Clock::now();
+    error_code_ = base::ClientAuthenticator::ErrorCode::SUCCESS;
+    failed_ = false;
+
+    channel_ = std::make_unique<base::NetworkChannel>();
+    channel_->setListener(this);
+    channel_->connect(load_test_->options().address, load_test_->options().port);
+}
+
+std::u16string Peer::userName() const
+{
+    return load_test_->options().user_name;
+}
+
+void Peer::restart()
+{
+    // The method is called from the callbacks of the channel or the authenticator.
+    if (channel_)
+        load_test_->taskRunner()->deleteSoon(std::move(channel_));
+
+    load_test_->taskRunner()->postTask(std::bind(&Peer::start, this));
+}
+
+void Peer::send(const google::protobuf::MessageLite& message)
+{
+    if (channel_)
+        channel_->send(base::serialize(message));
+}
+
+void Peer::onConnected()
+{
+    channel_->setNoDelay(true);
+
+    const Options& options = load_test_->options();
+
+    authenticator_ = std::make_unique<base::ClientAuthenticator>(load_test_->taskRunner());
+
+    if (!options.public_key.empty())
+        authenticator_->setPeerPublicKey(options.public_key);
+
+    if (session_type_ == proto::ROUTER_SESSION_CLIENT)
+    {
+        authenticator_->setIdentify(proto::IDENTIFY_SRP);
+        authenticator_->setUserName(userName());
+        authenticator_->setPassword(options.password);
+    }
+    else
+    {
+        authenticator_->setIdentify(proto::IDENTIFY_ANONYMOUS);
+    }
+
+    authenticator_->setSessionType(session_type_);
+
+    authenticator_->start(std::move(channel_),
+                          [this](base::ClientAuthenticator::ErrorCode error_code)
+    {
+        if (error_code == base::ClientAuthenticator::ErrorCode::SUCCESS)
+        {
+            load_test_->onAuthenticated(Clock::now() - start_time_);
+
+            channel_ = authenticator_->takeChannel();
+            channel_->setListener(this);
+            channel_->resume();
+
+            onReady();
+        }
+        else
+        {
+            LOG(LS_WARNING) << "Authentication failed: "
+                            << base::ClientAuthenticator::errorToString(error_code);
+
+            error_code_ = error_code;
+            failed_ = true;
+            onFailed();
+        }
+
+        // Authenticator is no longer needed.
+        load_test_->taskRunner()->deleteSoon(std::move(authenticator_));
+    });
+}
+
+void Peer::onDisconnected(base::NetworkChannel::ErrorCode error_code)
+{
+    LOG(LS_WARNING) << "Connection failed: " << base::NetworkChannel::errorToString(error_code);
+
+    if (failed_)
+        return;
+
+    error_code_ = base::ClientAuthenticator::ErrorCode::NETWORK_ERROR;
+    failed_ = true;
+    onFailed();
+}
+
+void Peer::onMessageReceived(const base::ByteArray& buffer)
+{
+    onMessage(buffer);
+}
+
+void Peer::onMessageWritten(size_t /* pending */)
+{
+    // Nothing
+}
+
+RelayPeer::RelayPeer(LoadTest* load_test, int index)
+    : Peer(load_test, proto::ROUTER_SESSION_RELAY),
+      host_("relay-" + std::to_string(index) + ".test")
+{
+    // Nothing
+}
+
+void RelayPeer::onReady()
+{
+    sendKeys(load_test_->options().relay_key_count);
+    load_test_->onRelayReady();
+}
+
+void RelayPeer::onMessage(const base::ByteArray& buffer)
+{
+    proto::RouterToRelay message;
+    if (!base::parse(buffer, &message))
+        return;
+
+    // The used key is replaced, so the pool never runs out.
+    if (message.has_key_used())
+        sendKeys(1);
+}
+
+void RelayPeer::onFailed()
+{
+    load_test_->onRelayFailed();
+}
+
+void RelayPeer::sendKeys(int count)
+{
+    proto::RelayToRouter message;
+    proto::RelayKeyPool* key_pool = message.mutable_key_pool();
+
+    key_pool->set_peer_host(host_);
+    key_pool->set_peer_port(8070);
+
+    // The router does not check the keys, so random data is used instead of real key pairs.
+    for (int i = 0; i < count; ++i)
+    {
+        proto::RelayKey* key = key_pool->add_key();
+
+        key->set_key_id(next_key_id_++);
+        key->set_type(proto::RelayKey::TYPE_X25519);
+        key->set_encryption(proto::RelayKey::ENCRYPTION_CHACHA20_POLY1305);
+        key->set_public_key(base::Random::string(32));
+        key->set_iv(base::Random::string(12));
+    }
+
+    send(message);
+}
+
+HostPeer::HostPeer(LoadTest* load_test)
+    : Peer(load_test, proto::ROUTER_SESSION_HOST)
+{
+    // Nothing
+}
+
+void HostPeer::onReady()
+{
+    proto::HostToRouter message;
+    message.mutable_host_id_request()->set_type(proto::HostIdRequest::NEW_ID);
+    send(message);
+}
+
+void HostPeer::onMessage(const base::ByteArray& buffer)
+{
+    proto::RouterToHost message;
+    if (!base::parse(buffer, &message))
+        return;
+
+    if (message.has_host_id_response())
+    {
+        if (registered_)
+            return;
+
+        registered_ = true;
+        load_test_->onHostRegistered(message.host_id_response().host_id(),
+                                     Clock::now() - start_time_);
+    }
+    else if (message.has_connection_offer())
+    {
+        load_test_->onHostOffer();
+    }
+}
+
+void HostPeer::onFailed()
+{
+    if (registered_)
+        return;
+
+    load_test_->onHostFailed();
+}
+
+ClientPeer::ClientPeer(LoadTest* load_test)
+    : Peer(load_test, proto::ROUTER_SESSION_CLIENT)
+{
+    // Nothing
+}
+
+bool ClientPeer::activate()
+{
+    if (!ready_)
+        return false;
+
+    if (!active_)
+    {
+        active_ = true;
+        sendRequest();
+    }
+
+    return true;
+}
+
+void ClientPeer::onReady()
+{
+    ready_ = true;
+    load_test_->onClientReady();
+}
+
+void ClientPeer::onMessage(const base::ByteArray& buffer)
+{
+    proto::RouterToClient message;
+    if (!base::parse(buffer, &message) || !message.has_connection_offer())
+        return;
+
+    load_test_->onOfferReceived(
+        stage_, message.connection_offer().error_code() == proto::ConnectionOffer::SUCCESS,
+        Clock::now() - request_time_);
+
+    sendRequest();
+}
+
+void ClientPeer::onFailed()
+{
+    active_ = false;
+
+    if (!ready_)
+        load_test_->onClientFailed();
+}
+
+void ClientPeer::sendRequest()
+{
+    if (!active_)
+        return;
+
+    stage_ = load_test_->stage();
+    request_time_ = Clock::now();
+
+    proto::ClientToRouter message;
+    message.mutable_connection_request()->set_host_id(load_test_->randomHostId());
+    send(message);
+}
+
+FloodPeer::FloodPeer(LoadTest* load_test)
+    : Peer(load_test, proto::ROUTER_SESSION_CLIENT)
+{
+    // Nothing
+}
+
+void FloodPeer::onReady()
+{
+    // The user is not expected to exist.
+    restart();
+}
+
+void FloodPeer::onMessage(const base::ByteArray& /* buffer */)
+{
+    // Nothing
+}
+
+void FloodPeer::onFailed()
+{
+    // A connection that is closed by the router before authentication is rejected by the
+    // admission control.
+    load_test_->onFloodLogin(error_code_ == base::ClientAuthenticator::ErrorCode::NETWORK_ERROR);
+    restart();
+}
+
+std::u16string FloodPeer::userName() const
+{
+    static const uint32_t kNameCount = 100;
+    return u"flood-" + base::utf16FromAscii(std::to_string(base::Random::number32() % kNameCount));
+}
+
+void showHelp()
+{
+    std::cout << "aspia_router_load_test [switches]" << std::endl
+        << "Available switches:" << std::endl
+        << '\t' << "--address" << '\t' << "Router address" << std::endl
+        << '\t' << "--port" << '\t' << "Router port (default 8060)" << std::endl
+        << '\t' << "--public-key" << '\t' << "Router public key in hex" << std::endl
+        << '\t' << "--user" << '\t' << "User name for client sessions" << std::endl
+        << '\t' << "--password" << '\t' << "User password" << std::endl
+        << '\t' << "--hosts" << '\t' << "Number of hosts (default 1000)" << std::endl
+        << '\t' << "--clients" << '\t' << "Maximum number of clients (default 16)" << std::endl
+        << '\t' << "--relays" << '\t' << "Number of relays (default 4)" << std::endl
+        << '\t' << "--relay-keys" << '\t' << "Keys supplied by each relay (default 1000)"
+        << std::endl
+        << '\t' << "--concurrency" << '\t' << "Number of logins in progress (default 50)"
+        << std::endl
+        << '\t' << "--stage-duration" << '\t' << "Duration of a load stage in seconds (default 5)"
+        << std::endl
+        << '\t' << "--flood" << '\t' << "Number of flood connections during the load stages"
+        << std::endl
+        << '\t' << "--router-pid" << '\t' << "Process ID of a local router for memory measurement"
+        << std::endl;
+}
+
+bool parsePositive(const base::CommandLine& command_line, std::u16string_view name, int* value)
+{
+    if (!command_line.hasSwitch(name))
+        return true;
+
+    return base::stringToInt(command_line.switchValue(name), value) && *value > 0;
+}
+
+bool parseOptions(const base::CommandLine& command_line, Options* options)
+{
+    options->address = command_line.switchValue(u"address");
+    if (options->address.empty())
+        return false;
+
+    if (command_line.hasSwitch(u"port"))
+    {
+        int port = 0;
+        if (!base::stringToInt(command_line.switchValue(u"port"), &port) ||
+            port <= 0 || port > 65535)
+        {
+            return false;
+        }
+
+        options->port = static_cast<uint16_t>(port);
+    }
+
+    // Anonymous sessions (hosts and relays) require encryption with the router key.
+    options->public_key =
+        base::fromHex(base::utf8FromUtf16(command_line.switchValue(u"public-key")));
+    if (options->public_key.empty())
+        return false;
+
+    options->user_name = command_line.switchValue(u"user");
+    options->password = command_line.switchValue(u"password");
+    if (options->user_name.empty())
+        return false;
+
+    int stage_duration = static_cast<int>(options->stage_duration.count());
+
+    if (!parsePositive(command_line, u"hosts", &options->host_count) ||
+        !parsePositive(command_line, u"clients", &options->client_count) ||
+        !parsePositive(command_line, u"relays", &options->relay_count) ||
+        !parsePositive(command_line, u"relay-keys", &options->relay_key_count) ||
+        !parsePositive(command_line, u"concurrency", &options->concurrency) ||
+        !parsePositive(command_line, u"stage-duration", &stage_duration) ||
+        !parsePositive(command_line, u"flood", &options->flood_count))
+    {
+        return false;
+    }
+
+    options->stage_duration = std::chrono::seconds(stage_duration);
+
+    if (command_line.hasSwitch(u"router-pid"))
+    {
+        if (!base::stringToUint(command_line.switchValue(u"router-pid"), &options->router_pid))
+            return false;
+    }
+
+    return true;
+}
+
+} // namespace
+
+int main(int argc, const char* const* argv)
+{
+    base::CommandLine command_line(argc, argv);
+
+    Options options;
+    if (command_line.hasSwitch(u"help") || !parseOptions(command_line, &options))
+    {
+        showHelp();
+        return 1;
+    }
+
+    base::MessageLoop message_loop(base::MessageLoop::Type::ASIO);
+
+    LoadTest load_test(message_loop.taskRunner(), options);
+    message_loop.taskRunner()->postTask(std::bind(&LoadTest::start, &load_test));
+    message_loop.run();
+
+    return 0;
+}
@@ -0,0 +1,339 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "base/command_line.h"
+#include "base/logging.h"
+#include "base/task_runner.h"
+#include "base/message_loop/message_loop.h"
+#include "base/net/network_channel.h"
+#include "base/peer/client_authenticator.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/unicode.h"
+#include "proto/router_common.pb.h"
+
+#include <algorithm>
+#include <iostream>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using TimePoint = Clock::time_point;
+using Milliseconds = std::chrono::duration<double, std::milli>;
+
+struct Options
+{
+    std::u16string address;
+    uint16_t port = 8060;
+    std::u16string user_name;
+    std::u16string password;
+    base::ByteArray public_key;
+    int count = 100;
+    int concurrency = 10;
+};
+
+//
+// Connects to the router |count| times, keeping |concurrency| logins in progress at the same time,
+// and reports the login throughput and latency.
+// If a user name is specified, SRP authentication is used (client session). Otherwise an anonymous
+// host login is made, which requires the public key of the router.
+//
+class LoginBenchmark
+{
+public:
+    LoginBenchmark(std::shared_ptr<base::TaskRunner> task_runner, const Options& options)
+        : task_runner_(std::move(task_runner)),
+          options_(options)
+    {
+        // Nothing
+    }
+
+    void start()
+    {
+        start_time_ = Clock::now();
+
+        int initial = std::min(options_.concurrency, options_.count);
+        for (int i = 0; i < initial; ++i)
+            startLogin();
+    }
+
+private:
+    class Login : public base::NetworkChannel::Listener
+    {
+    public:
+        explicit Login(LoginBenchmark* benchmark)
+            : benchmark_(benchmark),
+              channel_(std::make_unique<base::NetworkChannel>())
+        {
+            // Nothing
+        }
+
+        void start()
+        {
+            start_time_ = Clock::now();
+
+            channel_->setListener(this);
+            channel_->connect(benchmark_->options_.address, benchmark_->options_.port);
+        }
+
+    protected:
+        // base::NetworkChannel::Listener implementation.
+        void onConnected() override
+        {
+            channel_->setNoDelay(true);
+
+            const Options& options = benchmark_->options_;
+
+            authenticator_ =
+                std::make_unique<base::ClientAuthenticator>(benchmark_->task_runner_);
+
+            if (!options.public_key.empty())
+                authenticator_->setPeerPublicKey(options.public_key);
+
+            if (options.user_name.empty())
+            {
+                authenticator_->setIdentify(proto::IDENTIFY_ANONYMOUS);
+                authenticator_->setSessionType(proto::ROUTER_SESSION_HOST);
+            }
+            else
+            {
+                authenticator_->setIdentify(proto::IDENTIFY_SRP);
+                authenticator_->setUserName(options.user_name);
+                authenticator_->setPassword(options.password);
+                authenticator_->setSessionType(proto::ROUTER_SESSION_CLIENT);
+            }
+
+            authenticator_->start(std::move(channel_),
+                                  [this](base::ClientAuthenticator::ErrorCode error_code)
+            {
+                if (error_code != base::ClientAuthenticator::ErrorCode::SUCCESS)
+                {
+                    LOG(LS_WARNING) << "Authentication failed: "
+                                    << base::ClientAuthenticator::errorToString(error_code);
+                }
+
+                benchmark_->onLoginFinished(
+                    this, error_code == base::ClientAuthenticator::ErrorCode::SUCCESS,
+                    Clock::now() - start_time_);
+            });
+        }
+
+        void onDisconnected(base::NetworkChannel::ErrorCode error_code) override
+        {
+            LOG(LS_WARNING) << "Connection failed: "
+                            << base::NetworkChannel::errorToString(error_code);
+            benchmark_->onLoginFinished(this, false, Clock::now() - start_time_);
+        }
+
+        void onMessageReceived(const base::ByteArray& /* buffer */) override
+        {
+            // Nothing
+        }
+
+        void onMessageWritten(size_t /* pending */) override
+        {
+            // Nothing
+        }
+
+    private:
+        LoginBenchmark* benchmark_;
+        std::unique_ptr<base::NetworkChannel> channel_;
+        std::unique_ptr<base::ClientAuthenticator> authenticator_;
+        TimePoint start_time_;
+
+        DISALLOW_COPY_AND_ASSIGN(Login);
+    };
+
+    void startLogin()
+    {
+        ++started_;
+
+        std::unique_ptr<Login> login = std::make_unique<Login>(this);
+        Login* login_ptr = login.get();
+
+        logins_.emplace_back(std::move(login));
+        login_ptr->start();
+    }
+
+    void onLoginFinished(Login* login, bool success, Clock::duration latency)
+    {
+        if (success)
+            latencies_.emplace_back(std::chrono::duration_cast<Milliseconds>(latency).count());
+        else
+            ++failed_;
+
+        // The login is called from its own callback, so it is deleted later.
+        auto it = std::find_if(logins_.begin(), logins_.end(),
+                               [login](const std::unique_ptr<Login>& item)
+        {
+            return item.get() == login;
+        });
+
+        if (it != logins_.end())
+        {
+            task_runner_->deleteSoon(std::move(*it));
+            logins_.erase(it);
+        }
+
+        if (started_ < options_.count)
+        {
+            startLogin();
+            return;
+        }
+
+        if (logins_.empty())
+        {
+            printResults();
+            task_runner_->postQuit();
+        }
+    }
+
+    void printResults()
+    {
+        Milliseconds total = Clock::now() - start_time_;
+
+        std::cout << "Logins: " << options_.count << " (concurrency " << options_.concurrency
+                  << ")" << std::endl
+                  << "Failed: " << failed_ << std::endl
+                  << "Total time: " << total.count() << " ms" << std::endl
+                  << "Throughput: " << (latencies_.size() * 1000.0 / total.count())
+                  << " logins/s" << std::endl;
+
+        if (latencies_.empty())
+            return;
+
+        std::sort(latencies_.begin(), latencies_.end());
+
+        double sum = 0;
+        for (double latency : latencies_)
+            sum += latency;
+
+        auto percentile = [this](double value)
+        {
+            size_t index = static_cast<size_t>(value * (latencies_.size() - 1));
+            return latencies_[index];
+        };
+
+        std::cout << "Latency (ms): avg " << (sum / latencies_.size())
+                  << ", p50 " << percentile(0.5)
+                  << ", p90 " << percentile(0.9)
+                  << ", p99 " << percentile(0.99)
+                  << ", max " << latencies_.back() << std::endl;
+    }
+
+    std::shared_ptr<base::TaskRunner> task_runner_;
+    const Options options_;
+
+    std::vector<std::unique_ptr<Login>> logins_;
+    std::vector<double> latencies_;
+    int started_ = 0;
+    int failed_ = 0;
+    TimePoint start_time_;
+
+    DISALLOW_COPY_AND_ASSIGN(LoginBenchmark);
+};
+
+void showHelp()
+{
+    std::cout << "aspia_router_login_benchmark [switches]" << std::endl
+        << "Available switches:" << std::endl
+        << '\t' << "--address" << '\t' << "Router address" << std::endl
+        << '\t' << "--port" << '\t' << "Router port (default 8060)" << std::endl
+        << '\t' << "--user" << '\t' << "User name for SRP login" << std::endl
+        << '\t' << "--password" << '\t' << "User password" << std::endl
+        << '\t' << "--public-key" << '\t' << "Router public key in hex (required for anonymous login)"
+        << std::endl
+        << '\t' << "--count" << '\t' << "Total number of logins (default 100)" << std::endl
+        << '\t' << "--concurrency" << '\t' << "Number of logins in progress (default 10)"
+        << std::endl;
+}
+
+bool parseOptions(const base::CommandLine& command_line, Options* options)
+{
+    options->address = command_line.switchValue(u"address");
+    if (options->address.empty())
+        return false;
+
+    if (command_line.hasSwitch(u"port"))
+    {
+        int port = 0;
+        if (!base::stringToInt(command_line.switchValue(u"port"), &port) ||
+            port <= 0 || port > 65535)
+        {
+            return false;
+        }
+
+        options->port = static_cast<uint16_t>(port);
+    }
+
+    options->user_name = command_line.switchValue(u"user");
+    options->password = command_line.switchValue(u"password");
+
+    if (command_line.hasSwitch(u"public-key"))
+    {
+        options->public_key =
+            base::fromHex(base::utf8FromUtf16(command_line.switchValue(u"public-key")));
+        if (options->public_key.empty())
+            return false;
+    }
+
+    // Anonymous access requires encryption with the router key.
+    if (options->user_name.empty() && options->public_key.empty())
+        return false;
+
+    if (command_line.hasSwitch(u"count"))
+    {
+        if (!base::stringToInt(command_line.switchValue(u"count"), &options->count) ||
+            options->count <= 0)
+        {
+            return false;
+        }
+    }
+
+    if (command_line.hasSwitch(u"concurrency"))
+    {
+        if (!base::stringToInt(command_line.switchValue(u"concurrency"), &options->concurrency) ||
+            options->concurrency <= 0)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+} // namespace
+
+int main(int argc, const char* const* argv)
+{
+    base::CommandLine command_line(argc, argv);
+
+    Options options;
+    if (command_line.hasSwitch(u"help") || !parseOptions(command_line, &options))
+    {
+        showHelp();
+        return 1;
+    }
+
+    base::MessageLoop message_loop(base::MessageLoop::Type::ASIO);
+
+    LoginBenchmark benchmark(message_loop.taskRunner(), options);
+    message_loop.taskRunner()->postTask(std::bind(&LoginBenchmark::start, &benchmark));
+    message_loop.run();
+
+    return 0;
+}
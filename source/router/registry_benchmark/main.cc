@@ -0,0 +1,120 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "base/command_line.h"
+#include "base/strings/string_number_conversions.h"
+#include "router/session_host.h"
+#include "router/session_registry.h"
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using Nanoseconds = std::chrono::duration<double, std::nano>;
+
+const int kLookupCount = 1000000;
+
+//
+// Fills the registry with |host_count| host sessions and measures the average time of a lookup by
+// session ID and of a disconnect/reconnect of a host. The time should not depend on the number of
+// registered hosts.
+//
+void runBenchmark(int host_count)
+{
+    router::SessionRegistry registry;
+    std::vector<router::SessionHost*> hosts;
+    hosts.reserve(host_count);
+
+    for (int i = 0; i < host_count; ++i)
+    {
+        std::unique_ptr<router::SessionHost> session = std::make_unique<router::SessionHost>();
+        session->setId(static_cast<uint64_t>(i + 1));
+
+        hosts.emplace_back(static_cast<router::SessionHost*>(registry.add(std::move(session))));
+    }
+
+    std::mt19937 random(static_cast<std::mt19937::result_type>(host_count));
+    std::uniform_int_distribution<int> distribution(0, host_count - 1);
+
+    std::vector<uint64_t> ids(kLookupCount);
+    for (auto& id : ids)
+        id = static_cast<uint64_t>(distribution(random) + 1);
+
+    size_t found = 0;
+    Clock::time_point start_time = Clock::now();
+
+    for (uint64_t id : ids)
+    {
+        if (registry.session(id))
+            ++found;
+    }
+
+    Nanoseconds lookup_time = (Clock::now() - start_time) / kLookupCount;
+
+    // Each iteration removes a random host and registers it again with a new session ID, which is
+    // what happens when a host reconnects.
+    const int churn_count = kLookupCount / 10;
+    uint64_t next_id = static_cast<uint64_t>(host_count);
+    start_time = Clock::now();
+
+    for (int i = 0; i < churn_count; ++i)
+    {
+        const size_t index = static_cast<size_t>(distribution(random));
+
+        std::unique_ptr<router::Session> session = registry.take(hosts[index]);
+        session->setId(++next_id);
+
+        hosts[index] = static_cast<router::SessionHost*>(registry.add(std::move(session)));
+    }
+
+    Nanoseconds churn_time = (Clock::now() - start_time) / churn_count;
+
+    std::cout << "hosts: " << host_count
+              << "\tlookup: " << lookup_time.count() << " ns"
+              << "\treconnect: " << churn_time.count() << " ns"
+              << "\tfound: " << found << std::endl;
+}
+
+} // namespace
+
+int main(int argc, const char* const* argv)
+{
+    base::CommandLine command_line(argc, argv);
+
+    int max_hosts = 50000;
+    if (command_line.hasSwitch(u"max-hosts"))
+    {
+        if (!base::stringToInt(command_line.switchValue(u"max-hosts"), &max_hosts) ||
+            max_hosts <= 0)
+        {
+            std::cout << "Usage: aspia_router_registry_benchmark [--max-hosts=<count>]"
+                      << std::endl;
+            return 1;
+        }
+    }
+
+    for (int host_count = 100; host_count < max_hosts; host_count *= 10)
+        runBenchmark(host_count);
+
+    runBenchmark(max_hosts);
+    return 0;
+}
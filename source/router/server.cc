@@ -20,9 +20,12 @@
 
 #include "base/logging.h"
 #include "base/task_runner.h"
-#include "base/net/network_channel.h"
+#include "base/crypto/random.h"
+#include "base/peer/fake_verifier_cache.h"
 #include "router/database_factory_sqlite.h"
 #include "router/database_sqlite.h"
+#include "router/host_key_store.h"
+#include "router/server_shard.h"
 #include "router/session_admin.h"
 #include "router/session_client.h"
 #include "router/session_host.h"
@@ -30,6 +33,9 @@
 #include "router/settings.h"
 #include "router/user_list_db.h"
 
+#include <algorithm>
+#include <thread>
+
 namespace router {
 
 namespace {
@@ -39,37 +45,34 @@ const wchar_t kFirewallRuleName[] = L"Aspia Router Service";
 const wchar_t kFirewallRuleDecription[] = L"Allow incoming TCP connections";
 #endif // defined(OS_WIN)
 
-const char* sessionTypeToString(proto::RouterSession session_type)
-{
-    switch (session_type)
-    {
-        case proto::ROUTER_SESSION_CLIENT:
-            return "ROUTER_SESSION_CLIENT";
-
-        case proto::ROUTER_SESSION_HOST:
-            return "ROUTER_SESSION_HOST";
+// SQLite allows only one writer at a time, so a larger number of threads does not help.
+const size_t kDatabaseThreadCount = 2;
 
-        case proto::ROUTER_SESSION_ADMIN:
-            return "ROUTER_SESSION_ADMIN";
-
-        case proto::ROUTER_SESSION_RELAY:
-            return "ROUTER_SESSION_RELAY";
-
-        default:
-            return "ROUTER_SESSION_UNKNOWN";
-    }
-}
+// Interval for logging the counters of connections and authentications.
+const std::chrono::minutes kMetricsInterval{ 1 };
 
 } // namespace
 
 Server::Server(std::shared_ptr<base::TaskRunner> task_runner)
     : task_runner_(std::move(task_runner)),
-      database_factory_(std::make_shared<DatabaseFactorySqlite>())
+      database_factory_(std::make_shared<DatabaseFactorySqlite>()),
+      database_pool_(kDatabaseThreadCount),
+      alive_token_(std::make_shared<int>(0))
 {
     DCHECK(task_runner_);
 }
 
-Server::~Server() = default;
+Server::~Server()
+{
+    if (metrics_task_id_)
+        task_runner_->cancelDelayedTask(metrics_task_id_);
+
+    // No new connections are accepted after this.
+    server_.reset();
+
+    // The sessions are destroyed on the threads of their shards.
+    shards_.clear();
+}
 
 bool Server::start()
 {
@@ -99,219 +102,368 @@ bool Server::start()
         return false;
     }
 
-    std::unique_ptr<base::UserListBase> user_list = UserListDb::open(*database_factory_);
+    size_t thread_count = settings.threadCount();
+    if (!thread_count)
+        thread_count = std::max(std::thread::hardware_concurrency(), 1U);
+
+    std::vector<std::unique_ptr<base::UserListBase>> user_lists;
+
+    for (size_t i = 0; i < thread_count; ++i)
+    {
+        std::unique_ptr<base::UserListBase> user_list = UserListDb::open(database_factory_);
+        if (!user_list)
+        {
+            LOG(LS_ERROR) << "Failed to open the user list";
+            return false;
+        }
+
+        user_lists.emplace_back(std::move(user_list));
+    }
+
+    worker_pool_.start();
+    database_pool_.start();
 
-    authenticator_manager_ =
-        std::make_unique<base::ServerAuthenticatorManager>(task_runner_, this);
-    authenticator_manager_->setPrivateKey(private_key);
-    authenticator_manager_->setUserList(std::move(user_list));
-    authenticator_manager_->setAnonymousAccess(
-        base::ServerAuthenticator::AnonymousAccess::ENABLE,
-        proto::ROUTER_SESSION_HOST | proto::ROUTER_SESSION_RELAY);
+    host_key_store_ = std::make_unique<HostKeyStore>(
+        database_factory_, database_pool_.createSequencedTaskRunner(), task_runner_);
+    if (!host_key_store_->load())
+    {
+        LOG(LS_ERROR) << "Failed to load the list of hosts";
+        host_key_store_.reset();
+        return false;
+    }
 
     relay_key_pool_ = std::make_unique<SharedKeyPool>(this);
 
+    // Handshakes in progress are limited for each shard. A flood of connections is rejected
+    // before the expensive key exchange is started.
+    const size_t max_pending_handshakes = settings.maxPendingHandshakes() ?
+        std::max<size_t>((settings.maxPendingHandshakes() + thread_count - 1) / thread_count, 1) :
+        0;
+
+    // All shards use the same seed key, so the numbers of an unknown user are calculated once
+    // regardless of the shard that accepted the connection.
+    fake_verifier_cache_ = std::make_shared<base::FakeVerifierCache>();
+
+    std::vector<base::NetworkServer::Worker> workers;
+
+    for (size_t i = 0; i < thread_count; ++i)
+    {
+        std::unique_ptr<ServerShard> shard =
+            std::make_unique<ServerShard>(this, task_runner_, alive_token_);
+
+        ServerShard::Config config;
+        config.database_factory = database_factory_;
+        config.database_pool = &database_pool_;
+        config.worker_task_runner = worker_pool_.taskRunner();
+        config.private_key = private_key;
+        config.user_list = std::move(user_lists[i]);
+        config.fake_verifier_cache = fake_verifier_cache_;
+        config.max_pending_handshakes = max_pending_handshakes;
+
+        shard->start(std::move(config));
+
+        base::NetworkServer::Worker worker;
+        worker.message_loop = shard->messageLoop();
+        worker.delegate = shard.get();
+
+        workers.emplace_back(worker);
+        shards_.emplace_back(std::move(shard));
+    }
+
+    LOG(LS_INFO) << "Network threads: " << thread_count;
+
+    base::ConnectionLimiter::Limits limits;
+    limits.rate = settings.maxConnectionRate();
+    limits.address_rate = settings.maxAddressConnectionRate();
+
     server_ = std::make_unique<base::NetworkServer>();
-    server_->start(port, this);
+    server_->setConnectionLimits(limits);
+    server_->start(port, workers);
 
+    startMetricsTimer();
     return true;
 }
 
-std::unique_ptr<proto::RelayList> Server::relayList() const
+void Server::onHostIdRequest(ServerShard* shard, uint64_t session_id,
+                             const base::ByteArray& key_hash, const std::string& key)
 {
-    std::unique_ptr<proto::RelayList> result = std::make_unique<proto::RelayList>();
+    base::HostId host_id;
 
-    for (const auto& session : sessions_)
-    {
-        if (session->sessionType() != proto::ROUTER_SESSION_RELAY)
-            continue;
-
-        SessionRelay* session_relay = static_cast<SessionRelay*>(session.get());
-        proto::Relay* relay = result->add_relay();
-
-        relay->set_timepoint(session_relay->startTime());
-        relay->set_address(session_relay->address());
-        relay->set_pool_size(relay_key_pool_->countForRelay(session_relay->host()));
-        relay->mutable_version()->CopyFrom(session_relay->version().toProto());
-        relay->set_os_name(session_relay->osName());
-        relay->set_computer_name(session_relay->computerName());
-    }
+    // The key is present only for a new host.
+    if (!key.empty())
+        host_id = host_key_store_->addHost(key_hash);
+    else
+        host_id = host_key_store_->hostId(key_hash);
 
-    result->set_error_code(proto::RelayList::SUCCESS);
-    return result;
+    shard->postToSession<SessionHost>(session_id, [host_id, key](SessionHost* session)
+    {
+        session->onHostIdReceived(host_id, key);
+    });
 }
 
-std::unique_ptr<proto::HostList> Server::hostList() const
+void Server::onHostSessionWithId(ServerShard* shard, uint64_t session_id, base::HostId host_id)
 {
-    std::unique_ptr<proto::HostList> result = std::make_unique<proto::HostList>();
+    SessionLocation location;
+    location.shard = shard;
+    location.session_id = session_id;
 
-    for (const auto& session : sessions_)
-    {
-        if (session->sessionType() != proto::ROUTER_SESSION_HOST)
-            continue;
-
-        SessionHost* session_host = static_cast<SessionHost*>(session.get());
-        proto::Host* host = result->add_host();
-
-        host->set_timepoint(session_host->startTime());
-        host->set_host_id(session_host->hostId());
-        host->set_ip_address(session_host->address());
-        host->mutable_version()->CopyFrom(session_host->version().toProto());
-        host->set_os_name(session_host->osName());
-        host->set_computer_name(session_host->computerName());
-    }
+    auto result = hosts_.try_emplace(host_id, location);
+    if (result.second)
+        return;
+
+    SessionLocation& previous = result.first->second;
+    if (previous == location)
+        return;
 
-    result->set_error_code(proto::HostList::SUCCESS);
-    return result;
+    LOG(LS_INFO) << "Detected previous connection with ID " << host_id
+                 << ". It will be completed";
+
+    previous.shard->disconnectSession(previous.session_id);
+    previous = location;
+}
+
+void Server::onHostSessionRemoved(ServerShard* shard, uint64_t session_id, base::HostId host_id)
+{
+    auto it = hosts_.find(host_id);
+    if (it == hosts_.end())
+        return;
+
+    // The host may have already reconnected with another session.
+    if (it->second.shard == shard && it->second.session_id == session_id)
+        hosts_.erase(it);
 }
 
-bool Server::disconnectHost(base::HostId host_id)
+void Server::onConnectionRequest(ServerShard* shard, uint64_t session_id, base::HostId host_id)
 {
-    for (auto it = sessions_.begin(); it != sessions_.end(); ++it)
+    proto::ConnectionOffer offer;
+
+    auto host = hosts_.find(host_id);
+    if (host == hosts_.end())
+    {
+        LOG(LS_WARNING) << "Host with id " << host_id << " NOT found!";
+
+        offer.set_error_code(proto::ConnectionOffer::PEER_NOT_FOUND);
+    }
+    else
     {
-        Session* entry = it->get();
+        LOG(LS_INFO) << "Host with id " << host_id << " found";
 
-        if (entry->sessionType() != proto::ROUTER_SESSION_HOST)
-            continue;
+        std::optional<SharedKeyPool::Credentials> credentials = relay_key_pool_->takeCredentials();
+        if (!credentials.has_value())
+        {
+            LOG(LS_WARNING) << "Empty key pool";
 
-        if (static_cast<SessionHost*>(entry)->hostId() == host_id)
+            offer.set_error_code(proto::ConnectionOffer::KEY_POOL_EMPTY);
+        }
+        else
         {
-            sessions_.erase(it);
-            return true;
+            offer.set_error_code(proto::ConnectionOffer::SUCCESS);
+
+            proto::RelayCredentials* offer_credentials = offer.mutable_relay();
+
+            offer_credentials->set_host(credentials->host);
+            offer_credentials->set_port(credentials->port);
+            offer_credentials->mutable_key()->CopyFrom(credentials->key);
+            offer_credentials->set_secret(base::Random::string(16));
+
+            host->second.shard->postToSession<SessionHost>(
+                host->second.session_id, [offer](SessionHost* session)
+            {
+                LOG(LS_INFO) << "Sending connection offer to host";
+                session->sendConnectionOffer(offer);
+            });
         }
     }
 
-    return false;
+    shard->postToSession<SessionClient>(session_id, [offer](SessionClient* session)
+    {
+        LOG(LS_INFO) << "Sending connection offer to client";
+        session->sendConnectionOffer(offer);
+    });
 }
 
-void Server::onHostSessionWithId(SessionHost* session)
+void Server::onRelayKeyPool(ServerShard* shard, uint64_t session_id,
+                            const proto::RelayKeyPool& key_pool)
 {
-    base::HostId host_id = session->hostId();
+    const std::string& host = key_pool.peer_host();
 
-    for (auto it = sessions_.begin(); it != sessions_.end();)
-    {
-        Session* entry = it->get();
+    SessionLocation location;
+    location.shard = shard;
+    location.session_id = session_id;
 
-        if (entry != session &&
-            entry->sessionType() == proto::ROUTER_SESSION_HOST &&
-            static_cast<SessionHost*>(entry)->hostId() == host_id)
-        {
-            LOG(LS_INFO) << "Detected previous connection with ID " << host_id
-                         << ". It will be completed";
+    std::vector<SessionLocation>& locations = relays_[host];
+    if (std::find(locations.begin(), locations.end(), location) == locations.end())
+        locations.emplace_back(location);
 
-            it = sessions_.erase(it);
-            continue;
-        }
+    uint16_t port = static_cast<uint16_t>(key_pool.peer_port());
 
-        ++it;
-    }
+    for (int i = 0; i < key_pool.key_size(); ++i)
+        relay_key_pool_->addKey(host, port, key_pool.key(i));
 }
 
-SessionHost* Server::hostSessionById(base::HostId host_id)
+void Server::onRelayStat(const std::string& host, const proto::RelayStat& relay_stat)
 {
-    for (auto it = sessions_.begin(); it != sessions_.end(); ++it)
-    {
-        Session* entry = it->get();
+    relay_key_pool_->setRelayStat(host, relay_stat);
+}
 
-        if (entry->sessionType() == proto::ROUTER_SESSION_HOST &&
-            static_cast<SessionHost*>(entry)->hostId() == host_id)
-        {
-            return static_cast<SessionHost*>(entry);
-        }
-    }
+void Server::onRelaySessionRemoved(ServerShard* shard, uint64_t session_id,
+                                   const std::string& host)
+{
+    relay_key_pool_->removeKeysForRelay(host);
+
+    auto it = relays_.find(host);
+    if (it == relays_.end())
+        return;
 
-    return nullptr;
+    SessionLocation location;
+    location.shard = shard;
+    location.session_id = session_id;
+
+    std::vector<SessionLocation>& locations = it->second;
+    locations.erase(std::remove(locations.begin(), locations.end(), location), locations.end());
+
+    if (locations.empty())
+        relays_.erase(it);
 }
 
-void Server::onNewConnection(std::unique_ptr<base::NetworkChannel> channel)
+void Server::onRelayListRequest(ServerShard* shard, uint64_t session_id)
 {
-    LOG(LS_INFO) << "New connection: " << channel->peerAddress();
+    ServerShard::PoolSizes pool_sizes;
+    for (const auto& relay : relays_)
+        pool_sizes.emplace(relay.first, relay_key_pool_->countForRelay(relay.first));
+
+    // The lists of the shards are merged on the server thread.
+    std::shared_ptr<proto::RelayList> result = std::make_shared<proto::RelayList>();
+    std::shared_ptr<size_t> pending = std::make_shared<size_t>(shards_.size());
 
-    if (authenticator_manager_)
-        authenticator_manager_->addNewChannel(std::move(channel));
+    for (const auto& target : shards_)
+    {
+        target->collectRelays(pool_sizes,
+            [shard, session_id, result, pending](std::shared_ptr<proto::RelayList> relay_list)
+        {
+            result->mutable_relay()->MergeFrom(relay_list->relay());
+            if (--*pending)
+                return;
+
+            result->set_error_code(proto::RelayList::SUCCESS);
+
+            shard->postToSession<SessionAdmin>(session_id, [result](SessionAdmin* session)
+            {
+                session->onRelayListReceived(*result);
+            });
+        });
+    }
 }
 
-void Server::onPoolKeyUsed(const std::string& host, uint32_t key_id)
+void Server::onHostListRequest(ServerShard* shard, uint64_t session_id)
 {
-    for (const auto& session : sessions_)
+    // The lists of the shards are merged on the server thread.
+    std::shared_ptr<proto::HostList> result = std::make_shared<proto::HostList>();
+    std::shared_ptr<size_t> pending = std::make_shared<size_t>(shards_.size());
+
+    for (const auto& target : shards_)
     {
-        if (session->sessionType() == proto::ROUTER_SESSION_RELAY)
+        target->collectHosts(
+            [shard, session_id, result, pending](std::shared_ptr<proto::HostList> host_list)
         {
-            SessionRelay* relay_session = static_cast<SessionRelay*>(session.get());
-            if (relay_session->host() == host)
-                relay_session->sendKeyUsed(key_id);
-        }
+            result->mutable_host()->MergeFrom(host_list->host());
+            if (--*pending)
+                return;
+
+            result->set_error_code(proto::HostList::SUCCESS);
+
+            shard->postToSession<SessionAdmin>(session_id, [result](SessionAdmin* session)
+            {
+                session->onHostListReceived(*result);
+            });
+        });
     }
 }
 
-void Server::onNewSession(base::ServerAuthenticatorManager::SessionInfo&& session_info)
+void Server::onDisconnectHostRequest(ServerShard* shard, uint64_t session_id,
+                                     base::HostId host_id)
 {
-    proto::RouterSession session_type =
-        static_cast<proto::RouterSession>(session_info.session_type);
+    auto host = hosts_.find(host_id);
+    const bool found = host != hosts_.end();
 
-    LOG(LS_INFO) << "New session: " << sessionTypeToString(session_type)
-                 << " (" << session_info.channel->peerAddress() << ")";
+    if (found)
+    {
+        host->second.shard->disconnectSession(host->second.session_id);
+        hosts_.erase(host);
+    }
 
-    std::unique_ptr<Session> session;
+    shard->postToSession<SessionAdmin>(session_id, [host_id, found](SessionAdmin* session)
+    {
+        session->onHostDisconnected(host_id, found);
+    });
+}
 
-    switch (session_info.session_type)
+void Server::startMetricsTimer()
+{
+    metrics_task_id_ = task_runner_->postCancelableDelayedTask([this]()
     {
-        case proto::ROUTER_SESSION_CLIENT:
-            session = std::make_unique<SessionClient>();
-            break;
+        metrics_task_id_ = 0;
+        logMetrics();
+        startMetricsTimer();
+    },
+    kMetricsInterval);
+}
 
-        case proto::ROUTER_SESSION_HOST:
-            session = std::make_unique<SessionHost>();
-            break;
+void Server::logMetrics()
+{
+    base::ConnectionLimiter::Metrics connections = server_->connectionMetrics();
 
-        case proto::ROUTER_SESSION_ADMIN:
-            session = std::make_unique<SessionAdmin>();
-            break;
+    LOG(LS_INFO) << "Connections: " << connections.admitted << " admitted, "
+                 << connections.rejected_by_address << " rejected by address limit, "
+                 << connections.rejected_by_rate << " rejected by rate limit ("
+                 << connections.addresses << " addresses tracked)";
 
-        case proto::ROUTER_SESSION_RELAY:
-            session = std::make_unique<SessionRelay>();
-            break;
+    base::FakeVerifierCache::Metrics unknown_users = fake_verifier_cache_->metrics();
 
-        default:
-            break;
-    }
+    LOG(LS_INFO) << "Unknown users: " << unknown_users.hits << " cache hits, "
+                 << unknown_users.misses << " cache misses (" << unknown_users.size
+                 << " cached)";
+
+    // The counters of the shards are summed on the server thread.
+    std::shared_ptr<base::ServerAuthenticatorManager::Metrics> total =
+        std::make_shared<base::ServerAuthenticatorManager::Metrics>();
+    std::shared_ptr<size_t> pending = std::make_shared<size_t>(shards_.size());
 
-    if (!session)
+    for (const auto& shard : shards_)
     {
-        LOG(LS_ERROR) << "Unsupported session type: "
-                      << static_cast<int>(session_info.session_type);
-        return;
+        shard->collectHandshakeMetrics(
+            [total, pending](const base::ServerAuthenticatorManager::Metrics& metrics)
+        {
+            total->pending += metrics.pending;
+            total->started += metrics.started;
+            total->rejected += metrics.rejected;
+            total->succeeded += metrics.succeeded;
+            total->failed += metrics.failed;
+
+            if (--*pending)
+                return;
+
+            LOG(LS_INFO) << "Handshakes: " << total->started << " started, "
+                         << total->rejected << " rejected, " << total->succeeded
+                         << " succeeded, " << total->failed << " failed, "
+                         << total->pending << " in progress";
+        });
     }
-
-    session->setChannel(std::move(session_info.channel));
-    session->setDatabaseFactory(database_factory_);
-    session->setServer(this);
-    session->setRelayKeyPool(relay_key_pool_->share());
-    session->setVersion(session_info.version);
-    session->setOsName(session_info.os_name);
-    session->setComputerName(session_info.computer_name);
-
-    sessions_.emplace_back(std::move(session));
-    sessions_.back()->start(this);
 }
 
-void Server::onSessionFinished()
+void Server::onPoolKeyUsed(const std::string& host, uint32_t key_id)
 {
-    for (auto it = sessions_.begin(); it != sessions_.end();)
-    {
-        Session* session = it->get();
-        if (session->state() == Session::State::FINISHED)
-        {
-            // Session will be destroyed after completion of the current call.
-            task_runner_->deleteSoon(std::move(*it));
+    auto it = relays_.find(host);
+    if (it == relays_.end())
+        return;
 
-            // Delete a session from the list.
-            it = sessions_.erase(it);
-        }
-        else
+    for (const auto& location : it->second)
+    {
+        location.shard->postToSession<SessionRelay>(
+            location.session_id, [key_id](SessionRelay* session)
         {
-            ++it;
-        }
+            session->sendKeyUsed(key_id);
+        });
     }
 }
 
@@ -19,25 +19,36 @@
 #ifndef ROUTER__SERVER_H
 #define ROUTER__SERVER_H
 
+#include "base/task_runner.h"
+#include "base/memory/byte_array.h"
 #include "base/net/network_server.h"
 #include "base/peer/host_id.h"
-#include "base/peer/server_authenticator_manager.h"
+#include "base/threading/thread_pool.h"
 #include "build/build_config.h"
-#include "proto/router_admin.pb.h"
-#include "router/session.h"
+#include "proto/router_relay.pb.h"
 #include "router/shared_key_pool.h"
 
+#include <unordered_map>
+#include <vector>
+
+namespace base {
+class FakeVerifierCache;
+} // namespace base
+
 namespace router {
 
 class DatabaseFactory;
-class SessionHost;
-class SessionRelay;
-
-class Server
-    : public base::NetworkServer::Delegate,
-      public SharedKeyPool::Delegate,
-      public base::ServerAuthenticatorManager::Delegate,
-      public Session::Delegate
+class HostKeyStore;
+class ServerShard;
+
+//
+// The router accepts connections on the server thread and distributes them between the shards
+// (see ServerShard). Each shard runs on its own thread and owns the sessions of its connections.
+// The state shared by all sessions lives on the server thread: the host key store, the relay key
+// pool and the directory that maps host IDs and relays to their sessions. The shards call the
+// methods below on the server thread and receive the results as tasks posted to their threads.
+//
+class Server : public SharedKeyPool::Delegate
 {
 public:
     explicit Server(std::shared_ptr<base::TaskRunner> task_runner);
@@ -45,33 +56,66 @@ public:
 
     bool start();
 
-    std::unique_ptr<proto::RelayList> relayList() const;
-    std::unique_ptr<proto::HostList> hostList() const;
-    bool disconnectHost(base::HostId host_id);
-    void onHostSessionWithId(SessionHost* session);
+    void onHostIdRequest(ServerShard* shard, uint64_t session_id,
+                         const base::ByteArray& key_hash, const std::string& key);
+    void onHostSessionWithId(ServerShard* shard, uint64_t session_id, base::HostId host_id);
+    void onHostSessionRemoved(ServerShard* shard, uint64_t session_id, base::HostId host_id);
+    void onConnectionRequest(ServerShard* shard, uint64_t session_id, base::HostId host_id);
 
-    SessionHost* hostSessionById(base::HostId host_id);
+    void onRelayKeyPool(ServerShard* shard, uint64_t session_id,
+                        const proto::RelayKeyPool& key_pool);
+    void onRelayStat(const std::string& host, const proto::RelayStat& relay_stat);
+    void onRelaySessionRemoved(ServerShard* shard, uint64_t session_id, const std::string& host);
 
-protected:
-    // base::NetworkServer::Delegate implementation.
-    void onNewConnection(std::unique_ptr<base::NetworkChannel> channel) override;
+    void onRelayListRequest(ServerShard* shard, uint64_t session_id);
+    void onHostListRequest(ServerShard* shard, uint64_t session_id);
+    void onDisconnectHostRequest(ServerShard* shard, uint64_t session_id, base::HostId host_id);
 
+protected:
     // SharedKeyPool::Delegate implementation.
     void onPoolKeyUsed(const std::string& host, uint32_t key_id) override;
 
-    // base::ServerAuthenticatorManager::Delegate implementation.
-    void onNewSession(base::ServerAuthenticatorManager::SessionInfo&& session_info) override;
+private:
+    void startMetricsTimer();
+    void logMetrics();
 
-    // Session::Delegate implementation.
-    void onSessionFinished() override;
+    struct SessionLocation
+    {
+        bool operator==(const SessionLocation& other) const
+        {
+            return shard == other.shard && session_id == other.session_id;
+        }
+
+        ServerShard* shard = nullptr;
+        uint64_t session_id = 0;
+    };
 
-private:
     std::shared_ptr<base::TaskRunner> task_runner_;
     std::shared_ptr<DatabaseFactory> database_factory_;
+
+    // Threads for CPU-bound work (SRP and key exchange calculations during authentication).
+    base::ThreadPool worker_pool_;
+
+    // Threads on which the sessions make database requests, so a slow disk does not block network
+    // I/O. Each session has its own sequence of requests.
+    base::ThreadPool database_pool_;
+
+    // Host IDs are resolved in memory; new hosts are written to the database in batches.
+    std::unique_ptr<HostKeyStore> host_key_store_;
+
     std::unique_ptr<base::NetworkServer> server_;
-    std::unique_ptr<base::ServerAuthenticatorManager> authenticator_manager_;
+    std::vector<std::unique_ptr<ServerShard>> shards_;
     std::unique_ptr<SharedKeyPool> relay_key_pool_;
-    std::vector<std::unique_ptr<Session>> sessions_;
+    std::shared_ptr<base::FakeVerifierCache> fake_verifier_cache_;
+
+    // Sessions of hosts that have received an ID and of relays that have sent keys.
+    std::unordered_map<base::HostId, SessionLocation> hosts_;
+    std::unordered_map<std::string, std::vector<SessionLocation>> relays_;
+
+    base::TaskRunner::DelayedTaskId metrics_task_id_ = 0;
+
+    // Expires when the server is destroyed. Tasks posted by the shards are not run after that.
+    std::shared_ptr<int> alive_token_;
 
     DISALLOW_COPY_AND_ASSIGN(Server);
 };
@@ -0,0 +1,368 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "router/server_shard.h"
+
+#include "base/logging.h"
+#include "base/task_runner.h"
+#include "base/net/network_channel.h"
+#include "base/threading/thread_pool.h"
+#include "router/async_database.h"
+#include "router/server.h"
+#include "router/session_admin.h"
+#include "router/session_client.h"
+#include "router/session_host.h"
+#include "router/session_relay.h"
+
+namespace router {
+
+namespace {
+
+const char* sessionTypeToString(proto::RouterSession session_type)
+{
+    switch (session_type)
+    {
+        case proto::ROUTER_SESSION_CLIENT:
+            return "ROUTER_SESSION_CLIENT";
+
+        case proto::ROUTER_SESSION_HOST:
+            return "ROUTER_SESSION_HOST";
+
+        case proto::ROUTER_SESSION_ADMIN:
+            return "ROUTER_SESSION_ADMIN";
+
+        case proto::ROUTER_SESSION_RELAY:
+            return "ROUTER_SESSION_RELAY";
+
+        default:
+            return "ROUTER_SESSION_UNKNOWN";
+    }
+}
+
+} // namespace
+
+ServerShard::ServerShard(Server* server,
+                         std::shared_ptr<base::TaskRunner> server_task_runner,
+                         std::weak_ptr<int> server_alive_token)
+    : server_(server),
+      server_task_runner_(std::move(server_task_runner)),
+      server_alive_token_(std::move(server_alive_token))
+{
+    DCHECK(server_);
+    DCHECK(server_task_runner_);
+}
+
+ServerShard::~ServerShard()
+{
+    stop();
+}
+
+void ServerShard::start(Config&& config)
+{
+    DCHECK(config.database_factory);
+    DCHECK(config.database_pool);
+    DCHECK(config.user_list);
+
+    config_ = std::move(config);
+
+    thread_.start(base::MessageLoop::Type::ASIO, this);
+    task_runner_ = thread_.taskRunner();
+}
+
+void ServerShard::stop()
+{
+    thread_.stop();
+}
+
+void ServerShard::disconnectSession(uint64_t session_id)
+{
+    task_runner_->postTask([this, session_id]()
+    {
+        Session* session = sessions_.session(session_id);
+        if (session)
+            removeSession(session);
+    });
+}
+
+void ServerShard::collectHosts(HostListCallback callback)
+{
+    task_runner_->postTask([this, callback = std::move(callback)]() mutable
+    {
+        std::shared_ptr<proto::HostList> host_list = std::make_shared<proto::HostList>();
+
+        sessions_.forEach([&](Session* session)
+        {
+            if (session->sessionType() != proto::ROUTER_SESSION_HOST)
+                return;
+
+            SessionHost* session_host = static_cast<SessionHost*>(session);
+            proto::Host* host = host_list->add_host();
+
+            host->set_timepoint(session_host->startTime());
+            host->set_host_id(session_host->hostId());
+            host->set_ip_address(session_host->address());
+            host->mutable_version()->CopyFrom(session_host->version().toProto());
+            host->set_os_name(session_host->osName());
+            host->set_computer_name(session_host->computerName());
+        });
+
+        postToServer([callback = std::move(callback), host_list](Server* /* server */)
+        {
+            callback(host_list);
+        });
+    });
+}
+
+void ServerShard::collectRelays(PoolSizes pool_sizes, RelayListCallback callback)
+{
+    task_runner_->postTask(
+        [this, pool_sizes = std::move(pool_sizes), callback = std::move(callback)]() mutable
+    {
+        std::shared_ptr<proto::RelayList> relay_list = std::make_shared<proto::RelayList>();
+
+        sessions_.forEach([&](Session* session)
+        {
+            if (session->sessionType() != proto::ROUTER_SESSION_RELAY)
+                return;
+
+            SessionRelay* session_relay = static_cast<SessionRelay*>(session);
+            proto::Relay* relay = relay_list->add_relay();
+
+            auto pool_size = pool_sizes.find(session_relay->host());
+
+            relay->set_timepoint(session_relay->startTime());
+            relay->set_address(session_relay->address());
+            relay->set_pool_size(pool_size != pool_sizes.end() ? pool_size->second : 0);
+            relay->mutable_version()->CopyFrom(session_relay->version().toProto());
+            relay->set_os_name(session_relay->osName());
+            relay->set_computer_name(session_relay->computerName());
+        });
+
+        postToServer([callback = std::move(callback), relay_list](Server* /* server */)
+        {
+            callback(relay_list);
+        });
+    });
+}
+
+void ServerShard::collectHandshakeMetrics(HandshakeMetricsCallback callback)
+{
+    task_runner_->postTask([this, callback = std::move(callback)]() mutable
+    {
+        base::ServerAuthenticatorManager::Metrics metrics;
+        if (authenticator_manager_)
+            metrics = authenticator_manager_->metrics();
+
+        postToServer([callback = std::move(callback), metrics](Server* /* server */)
+        {
+            callback(metrics);
+        });
+    });
+}
+
+void ServerShard::requestHostId(SessionHost* session, base::ByteArray key_hash, std::string key)
+{
+    postToServer([shard = this, session_id = session->id(), key_hash = std::move(key_hash),
+                  key = std::move(key)](Server* server)
+    {
+        server->onHostIdRequest(shard, session_id, key_hash, key);
+    });
+}
+
+void ServerShard::onHostSessionWithId(SessionHost* session)
+{
+    postToServer([shard = this, session_id = session->id(), host_id = session->hostId()](
+        Server* server)
+    {
+        server->onHostSessionWithId(shard, session_id, host_id);
+    });
+}
+
+void ServerShard::requestConnection(SessionClient* session, base::HostId host_id)
+{
+    postToServer([shard = this, session_id = session->id(), host_id](Server* server)
+    {
+        server->onConnectionRequest(shard, session_id, host_id);
+    });
+}
+
+void ServerShard::addRelayKeys(SessionRelay* session, proto::RelayKeyPool key_pool)
+{
+    postToServer([shard = this, session_id = session->id(), key_pool = std::move(key_pool)](
+        Server* server)
+    {
+        server->onRelayKeyPool(shard, session_id, key_pool);
+    });
+}
+
+void ServerShard::setRelayStat(SessionRelay* session, proto::RelayStat relay_stat)
+{
+    postToServer([host = session->host(), relay_stat = std::move(relay_stat)](Server* server)
+    {
+        server->onRelayStat(host, relay_stat);
+    });
+}
+
+void ServerShard::requestRelayList(SessionAdmin* session)
+{
+    postToServer([shard = this, session_id = session->id()](Server* server)
+    {
+        server->onRelayListRequest(shard, session_id);
+    });
+}
+
+void ServerShard::requestHostList(SessionAdmin* session)
+{
+    postToServer([shard = this, session_id = session->id()](Server* server)
+    {
+        server->onHostListRequest(shard, session_id);
+    });
+}
+
+void ServerShard::disconnectHost(SessionAdmin* session, base::HostId host_id)
+{
+    postToServer([shard = this, session_id = session->id(), host_id](Server* server)
+    {
+        server->onDisconnectHostRequest(shard, session_id, host_id);
+    });
+}
+
+void ServerShard::onBeforeThreadRunning()
+{
+    authenticator_manager_ =
+        std::make_unique<base::ServerAuthenticatorManager>(thread_.taskRunner(), this);
+    authenticator_manager_->setWorkerTaskRunner(config_.worker_task_runner);
+    authenticator_manager_->setPrivateKey(config_.private_key);
+    authenticator_manager_->setUserList(std::move(config_.user_list));
+    authenticator_manager_->setFakeVerifierCache(config_.fake_verifier_cache);
+    authenticator_manager_->setAnonymousAccess(
+        base::ServerAuthenticator::AnonymousAccess::ENABLE,
+        proto::ROUTER_SESSION_HOST | proto::ROUTER_SESSION_RELAY);
+    authenticator_manager_->setMaxPendingCount(config_.max_pending_handshakes);
+}
+
+void ServerShard::onAfterThreadRunning()
+{
+    // The channels and sessions are bound to the message loop of the thread and are destroyed
+    // before it.
+    authenticator_manager_.reset();
+    sessions_.clear();
+}
+
+void ServerShard::onNewConnection(std::unique_ptr<base::NetworkChannel> channel)
+{
+    LOG(LS_INFO) << "New connection: " << channel->peerAddress();
+
+    if (authenticator_manager_)
+        authenticator_manager_->addNewChannel(std::move(channel));
+}
+
+void ServerShard::onNewSession(base::ServerAuthenticatorManager::SessionInfo&& session_info)
+{
+    proto::RouterSession session_type =
+        static_cast<proto::RouterSession>(session_info.session_type);
+
+    LOG(LS_INFO) << "New session: " << sessionTypeToString(session_type)
+                 << " (" << session_info.channel->peerAddress() << ")";
+
+    std::unique_ptr<Session> session;
+
+    switch (session_info.session_type)
+    {
+        case proto::ROUTER_SESSION_CLIENT:
+            session = std::make_unique<SessionClient>();
+            break;
+
+        case proto::ROUTER_SESSION_HOST:
+            session = std::make_unique<SessionHost>();
+            break;
+
+        case proto::ROUTER_SESSION_ADMIN:
+            session = std::make_unique<SessionAdmin>();
+            break;
+
+        case proto::ROUTER_SESSION_RELAY:
+            session = std::make_unique<SessionRelay>();
+            break;
+
+        default:
+            break;
+    }
+
+    if (!session)
+    {
+        LOG(LS_ERROR) << "Unsupported session type: "
+                      << static_cast<int>(session_info.session_type);
+        return;
+    }
+
+    session->setId(++next_session_id_);
+    session->setChannel(std::move(session_info.channel));
+    session->setDatabase(std::make_unique<AsyncDatabase>(
+        config_.database_factory, config_.database_pool->createSequencedTaskRunner(),
+        task_runner_));
+    session->setShard(this);
+    session->setVersion(session_info.version);
+    session->setOsName(session_info.os_name);
+    session->setComputerName(session_info.computer_name);
+
+    sessions_.add(std::move(session))->start(this);
+}
+
+void ServerShard::onSessionFinished(Session* session)
+{
+    DCHECK_EQ(session->state(), Session::State::FINISHED);
+    removeSession(session);
+}
+
+void ServerShard::removeSession(Session* session)
+{
+    std::unique_ptr<Session> removed = sessions_.take(session);
+    if (!removed)
+        return;
+
+    const uint64_t session_id = removed->id();
+
+    if (removed->sessionType() == proto::ROUTER_SESSION_HOST)
+    {
+        base::HostId host_id = static_cast<SessionHost*>(removed.get())->hostId();
+        if (host_id != base::kInvalidHostId)
+        {
+            postToServer([shard = this, session_id, host_id](Server* server)
+            {
+                server->onHostSessionRemoved(shard, session_id, host_id);
+            });
+        }
+    }
+    else if (removed->sessionType() == proto::ROUTER_SESSION_RELAY)
+    {
+        const std::string& host = static_cast<SessionRelay*>(removed.get())->host();
+        if (!host.empty())
+        {
+            postToServer([shard = this, session_id, host](Server* server)
+            {
+                server->onRelaySessionRemoved(shard, session_id, host);
+            });
+        }
+    }
+
+    // Session will be destroyed after completion of the current call.
+    task_runner_->deleteSoon(std::move(removed));
+}
+
+} // namespace router
@@ -0,0 +1,196 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef ROUTER__SERVER_SHARD_H
+#define ROUTER__SERVER_SHARD_H
+
+#include "base/net/network_server.h"
+#include "base/peer/host_id.h"
+#include "base/peer/server_authenticator_manager.h"
+#include "base/peer/user_list_base.h"
+#include "base/threading/thread.h"
+#include "proto/router_admin.pb.h"
+#include "proto/router_relay.pb.h"
+#include "router/session.h"
+#include "router/session_registry.h"
+
+#include <functional>
+#include <unordered_map>
+
+namespace base {
+class FakeVerifierCache;
+class ThreadPool;
+} // namespace base
+
+namespace router {
+
+class DatabaseFactory;
+class Server;
+class SessionAdmin;
+class SessionClient;
+class SessionHost;
+class SessionRelay;
+
+//
+// Part of the router that runs on its own thread. A shard authenticates the network channels
+// accepted on its thread and owns the sessions created for them.
+// The state shared by all shards (the directory of hosts and relays, the relay key pool and the
+// host keys) belongs to Server and is used only on the server thread. Shards and the server do
+// not share data: they post tasks to each other. A session is addressed by its shard and its ID.
+//
+class ServerShard
+    : public base::Thread::Delegate,
+      public base::NetworkServer::Delegate,
+      public base::ServerAuthenticatorManager::Delegate,
+      public Session::Delegate
+{
+public:
+    ServerShard(Server* server,
+                std::shared_ptr<base::TaskRunner> server_task_runner,
+                std::weak_ptr<int> server_alive_token);
+    ~ServerShard();
+
+    struct Config
+    {
+        std::shared_ptr<DatabaseFactory> database_factory;
+
+        // Pool on which the sessions make database requests.
+        base::ThreadPool* database_pool = nullptr;
+
+        // Task runner for CPU-bound work of the authenticators.
+        std::shared_ptr<base::TaskRunner> worker_task_runner;
+
+        base::ByteArray private_key;
+        std::unique_ptr<base::UserListBase> user_list;
+
+        // Cache of the SRP numbers for unknown users shared by all shards.
+        std::shared_ptr<base::FakeVerifierCache> fake_verifier_cache;
+
+        // Maximum number of connections of the shard that are being authenticated.
+        size_t max_pending_handshakes = 0;
+    };
+
+    // Starts the thread of the shard. Called on the server thread.
+    void start(Config&& config);
+
+    // Stops the thread. All sessions of the shard are destroyed.
+    void stop();
+
+    base::MessageLoop* messageLoop() const { return thread_.messageLoop(); }
+    std::shared_ptr<base::TaskRunner> taskRunner() const { return task_runner_; }
+
+    //
+    // The methods below are called on the server thread.
+    //
+
+    // Calls |callback| on the shard thread if the session with |session_id| still exists.
+    template <typename SessionType, typename Callback>
+    void postToSession(uint64_t session_id, Callback callback)
+    {
+        task_runner_->postTask([this, session_id, callback = std::move(callback)]() mutable
+        {
+            Session* session = sessions_.session(session_id);
+            if (session)
+                callback(static_cast<SessionType*>(session));
+        });
+    }
+
+    void disconnectSession(uint64_t session_id);
+
+    using HostListCallback = std::function<void(std::shared_ptr<proto::HostList> host_list)>;
+    using RelayListCallback = std::function<void(std::shared_ptr<proto::RelayList> relay_list)>;
+    using PoolSizes = std::unordered_map<std::string, size_t>;
+
+    // Collects the sessions of the shard on its thread and passes them to |callback| on the
+    // server thread. The pool size of relays is taken from |pool_sizes|.
+    void collectHosts(HostListCallback callback);
+    void collectRelays(PoolSizes pool_sizes, RelayListCallback callback);
+
+    using HandshakeMetricsCallback =
+        std::function<void(const base::ServerAuthenticatorManager::Metrics& metrics)>;
+
+    // Passes the authentication counters of the shard to |callback| on the server thread.
+    void collectHandshakeMetrics(HandshakeMetricsCallback callback);
+
+    //
+    // The methods below are called on the shard thread by the sessions. The results are passed
+    // back to the sessions if they still exist.
+    //
+
+    void requestHostId(SessionHost* session, base::ByteArray key_hash, std::string key);
+    void onHostSessionWithId(SessionHost* session);
+    void requestConnection(SessionClient* session, base::HostId host_id);
+    void addRelayKeys(SessionRelay* session, proto::RelayKeyPool key_pool);
+    void setRelayStat(SessionRelay* session, proto::RelayStat relay_stat);
+    void requestRelayList(SessionAdmin* session);
+    void requestHostList(SessionAdmin* session);
+    void disconnectHost(SessionAdmin* session, base::HostId host_id);
+
+protected:
+    // base::Thread::Delegate implementation.
+    void onBeforeThreadRunning() override;
+    void onAfterThreadRunning() override;
+
+    // base::NetworkServer::Delegate implementation.
+    void onNewConnection(std::unique_ptr<base::NetworkChannel> channel) override;
+
+    // base::ServerAuthenticatorManager::Delegate implementation.
+    void onNewSession(base::ServerAuthenticatorManager::SessionInfo&& session_info) override;
+
+    // Session::Delegate implementation.
+    void onSessionFinished(Session* session) override;
+
+private:
+    // Posts |callback| to the server thread. It is not called if the server no longer exists.
+    template <typename Callback>
+    void postToServer(Callback callback)
+    {
+        server_task_runner_->postTask(
+            [server = server_, alive_token = server_alive_token_, callback = std::move(callback)]()
+            mutable
+        {
+            if (alive_token.expired())
+                return;
+
+            callback(server);
+        });
+    }
+
+    // Removes the session from the shard and notifies the server. The session is destroyed
+    // after completion of the current task.
+    void removeSession(Session* session);
+
+    Server* server_;
+    std::shared_ptr<base::TaskRunner> server_task_runner_;
+    std::weak_ptr<int> server_alive_token_;
+
+    base::Thread thread_;
+    std::shared_ptr<base::TaskRunner> task_runner_;
+    Config config_;
+
+    // The members below are used only on the shard thread.
+    std::unique_ptr<base::ServerAuthenticatorManager> authenticator_manager_;
+    SessionRegistry sessions_;
+    uint64_t next_session_id_ = 0;
+
+    DISALLOW_COPY_AND_ASSIGN(ServerShard);
+};
+
+} // namespace router
+
+#endif // ROUTER__SERVER_SHARD_H
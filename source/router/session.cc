@@ -21,9 +21,7 @@
 #include "base/logging.h"
 #include "base/net/network_channel.h"
 #include "base/strings/unicode.h"
-#include "router/database.h"
-#include "router/database_factory.h"
-#include "router/shared_key_pool.h"
+#include "router/async_database.h"
 
 namespace router {
 
@@ -40,19 +38,19 @@ void Session::setChannel(std::unique_ptr<base::NetworkChannel> channel)
     channel_ = std::move(channel);
 }
 
-void Session::setRelayKeyPool(std::unique_ptr<SharedKeyPool> relay_key_pool)
+void Session::setDatabase(std::unique_ptr<AsyncDatabase> database)
 {
-    relay_key_pool_ = std::move(relay_key_pool);
+    database_ = std::move(database);
 }
 
-void Session::setDatabaseFactory(std::shared_ptr<DatabaseFactory> database_factory)
+void Session::setShard(ServerShard* shard)
 {
-    database_factory_ = std::move(database_factory);
+    shard_ = shard;
 }
 
-void Session::setServer(Server* server)
+void Session::setId(uint64_t id)
 {
-    server_ = server;
+    id_ = id;
 }
 
 void Session::start(Delegate* delegate)
@@ -63,21 +61,15 @@ void Session::start(Delegate* delegate)
         return;
     }
 
-    if (!relay_key_pool_)
+    if (!database_)
     {
-        LOG(LS_FATAL) << "Invalid relay key pool";
+        LOG(LS_FATAL) << "Invalid database";
         return;
     }
 
-    if (!database_factory_)
+    if (!shard_)
     {
-        LOG(LS_FATAL) << "Invalid database factory";
-        return;
-    }
-
-    if (!server_)
-    {
-        LOG(LS_FATAL) << "Invalid server";
+        LOG(LS_FATAL) << "Invalid shard";
         return;
     }
 
@@ -96,11 +88,6 @@ void Session::start(Delegate* delegate)
     onSessionReady();
 }
 
-std::unique_ptr<Database> Session::openDatabase() const
-{
-    return database_factory_->openDatabase();
-}
-
 void Session::setVersion(const base::Version& version)
 {
     version_ = version;
@@ -147,7 +134,7 @@ void Session::onDisconnected(base::NetworkChannel::ErrorCode error_code)
 
     state_ = State::FINISHED;
     if (delegate_)
-        delegate_->onSessionFinished();
+        delegate_->onSessionFinished(this);
 }
 
 } // namespace router
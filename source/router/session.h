@@ -25,10 +25,8 @@
 
 namespace router {
 
-class Database;
-class DatabaseFactory;
-class Server;
-class SharedKeyPool;
+class AsyncDatabase;
+class ServerShard;
 
 class Session : public base::NetworkChannel::Listener
 {
@@ -41,7 +39,7 @@ public:
     public:
         virtual ~Delegate() = default;
 
-        virtual void onSessionFinished() = 0;
+        virtual void onSessionFinished(Session* session) = 0;
     };
 
     enum class State
@@ -52,9 +50,12 @@ public:
     };
 
     void setChannel(std::unique_ptr<base::NetworkChannel> channel);
-    void setRelayKeyPool(std::unique_ptr<SharedKeyPool> relay_key_pool);
-    void setDatabaseFactory(std::shared_ptr<DatabaseFactory> database_factory);
-    void setServer(Server* server);
+    void setDatabase(std::unique_ptr<AsyncDatabase> database);
+    void setShard(ServerShard* shard);
+
+    // The ID is unique within the shard of the session and is never reused.
+    void setId(uint64_t id);
+    uint64_t id() const { return id_; }
 
     void start(Delegate* delegate);
 
@@ -76,7 +77,8 @@ public:
 
 protected:
     void sendMessage(const google::protobuf::MessageLite& message);
-    std::unique_ptr<Database> openDatabase() const;
+
+    AsyncDatabase& database() { return *database_; }
 
     virtual void onSessionReady() = 0;
 
@@ -84,21 +86,23 @@ protected:
     void onConnected() override;
     void onDisconnected(base::NetworkChannel::ErrorCode error_code) override;
 
-    SharedKeyPool& relayKeyPool() { return *relay_key_pool_; }
-    const SharedKeyPool& relayKeyPool() const { return *relay_key_pool_; }
-
-    Server& server() { return *server_; }
-    const Server& server() const { return *server_; }
+    // The shard that owns the session. Operations on sessions of other shards and on the state
+    // shared by all shards are requested through it.
+    ServerShard& shard() { return *shard_; }
+    const ServerShard& shard() const { return *shard_; }
 
 private:
+    friend class SessionRegistry;
+    static constexpr size_t kNotRegistered = static_cast<size_t>(-1);
+
     const proto::RouterSession session_type_;
+    uint64_t id_ = 0;
     State state_ = State::NOT_STARTED;
     time_t start_time_ = 0;
 
     std::unique_ptr<base::NetworkChannel> channel_;
-    std::shared_ptr<DatabaseFactory> database_factory_;
-    std::unique_ptr<SharedKeyPool> relay_key_pool_;
-    Server* server_ = nullptr;
+    std::unique_ptr<AsyncDatabase> database_;
+    ServerShard* shard_ = nullptr;
 
     std::string address_;
     std::string username_;
@@ -107,6 +111,9 @@ private:
     std::string computer_name_;
 
     Delegate* delegate_ = nullptr;
+
+    // Position of the session in SessionRegistry.
+    size_t registry_index_ = kNotRegistered;
 };
 
 } // namespace router
@@ -22,8 +22,9 @@
 #include "base/strings/unicode.h"
 #include "base/net/network_channel.h"
 #include "base/peer/user.h"
+#include "router/async_database.h"
 #include "router/database.h"
-#include "router/server.h"
+#include "router/server_shard.h"
 
 namespace router {
 
@@ -83,69 +84,101 @@ void SessionAdmin::onMessageWritten(size_t pending)
 
 void SessionAdmin::doUserListRequest()
 {
-    std::unique_ptr<Database> database = openDatabase();
-    if (!database)
+    database().execute([](Database& database)
     {
-        LOG(LS_ERROR) << "Failed to connect to database";
-        return;
-    }
-
-    proto::RouterToAdmin message;
-    proto::UserList* list = message.mutable_user_list();
+        return database.userList();
+    },
+    [this](std::vector<base::User> users)
+    {
+        proto::RouterToAdmin message;
+        proto::UserList* list = message.mutable_user_list();
 
-    std::vector<base::User> users = database->userList();
-    for (const auto& user : users)
-        list->add_user()->CopyFrom(user.serialize());
+        for (const auto& user : users)
+            list->add_user()->CopyFrom(user.serialize());
 
-    sendMessage(message);
+        sendMessage(message);
+    });
 }
 
 void SessionAdmin::doUserRequest(const proto::UserRequest& request)
 {
-    proto::RouterToAdmin message;
-    proto::UserResult* result = message.mutable_user_result();
-    result->set_type(request.type());
-
     switch (request.type())
     {
         case proto::USER_REQUEST_ADD:
-            result->set_error_code(addUser(request.user()));
+            addUser(request.user());
             break;
 
         case proto::USER_REQUEST_MODIFY:
-            result->set_error_code(modifyUser(request.user()));
+            modifyUser(request.user());
             break;
 
         case proto::USER_REQUEST_DELETE:
-            result->set_error_code(deleteUser(request.user()));
+            deleteUser(request.user());
+            break;
+
+        default:
+            sendUserResult(request.type(), proto::UserResult::INVALID_DATA);
             break;
     }
+}
+
+void SessionAdmin::sendUserResult(
+    proto::UserRequestType type, proto::UserResult::ErrorCode error_code)
+{
+    proto::RouterToAdmin message;
+    proto::UserResult* result = message.mutable_user_result();
+    result->set_type(type);
+    result->set_error_code(error_code);
 
     sendMessage(message);
 }
 
-void SessionAdmin::doRelayListRequest()
+void SessionAdmin::onRelayListReceived(const proto::RelayList& relay_list)
 {
     proto::RouterToAdmin message;
+    message.mutable_relay_list()->CopyFrom(relay_list);
+    sendMessage(message);
+}
 
-    message.set_allocated_relay_list(server().relayList().release());
-    if (!message.has_relay_list())
-        message.mutable_relay_list()->set_error_code(proto::RelayList::UNKNOWN_ERROR);
-
+void SessionAdmin::onHostListReceived(const proto::HostList& host_list)
+{
+    proto::RouterToAdmin message;
+    message.mutable_host_list()->CopyFrom(host_list);
     sendMessage(message);
 }
 
-void SessionAdmin::doHostListRequest()
+void SessionAdmin::onHostDisconnected(base::HostId host_id, bool disconnected)
 {
     proto::RouterToAdmin message;
+    proto::HostResult* host_result = message.mutable_host_result();
+    host_result->set_type(proto::HOST_REQUEST_DISCONNECT);
 
-    message.set_allocated_host_list(server().hostList().release());
-    if (!message.has_host_list())
-        message.mutable_host_list()->set_error_code(proto::HostList::UNKNOWN_ERROR);
+    if (!disconnected)
+    {
+        LOG(LS_WARNING) << "Host not found: " << host_id;
+        host_result->set_error_code(proto::HostResult::HOST_MISSED);
+    }
+    else
+    {
+        LOG(LS_INFO) << "Host '" << host_id << "' disconnected by " << userName();
+        host_result->set_error_code(proto::HostResult::SUCCESS);
+    }
 
     sendMessage(message);
 }
 
+void SessionAdmin::doRelayListRequest()
+{
+    // The relays may belong to any shard. The list is collected by the server.
+    shard().requestRelayList(this);
+}
+
+void SessionAdmin::doHostListRequest()
+{
+    // The hosts may belong to any shard. The list is collected by the server.
+    shard().requestHostList(this);
+}
+
 void SessionAdmin::doHostRequest(const proto::HostRequest& request)
 {
     proto::RouterToAdmin message;
@@ -156,24 +189,15 @@ void SessionAdmin::doHostRequest(const proto::HostRequest& request)
     {
         base::HostId host_id = request.host().host_id();
 
-        if (host_id == base::kInvalidHostId)
-        {
-            LOG(LS_INFO) << "Invalid host ID";
-            host_result->set_error_code(proto::HostResult::INVALID_HOST_ID);
-        }
-        else
+        if (host_id != base::kInvalidHostId)
         {
-            if (!server().disconnectHost(host_id))
-            {
-                LOG(LS_WARNING) << "Host not found: " << host_id;
-                host_result->set_error_code(proto::HostResult::HOST_MISSED);
-            }
-            else
-            {
-                LOG(LS_INFO) << "Host '" << host_id << "' disconnected by " << userName();
-                host_result->set_error_code(proto::HostResult::SUCCESS);
-            }
+            // The result is sent from onHostDisconnected().
+            shard().disconnectHost(this, host_id);
+            return;
         }
+
+        LOG(LS_INFO) << "Invalid host ID";
+        host_result->set_error_code(proto::HostResult::INVALID_HOST_ID);
     }
     else
     {
@@ -184,7 +208,7 @@ void SessionAdmin::doHostRequest(const proto::HostRequest& request)
     sendMessage(message);
 }
 
-proto::UserResult::ErrorCode SessionAdmin::addUser(const proto::User& user)
+void SessionAdmin::addUser(const proto::User& user)
 {
     LOG(LS_INFO) << "User add request: " << user.name();
 
@@ -192,69 +216,66 @@ proto::UserResult::ErrorCode SessionAdmin::addUser(const proto::User& user)
     if (!new_user.isValid())
     {
         LOG(LS_ERROR) << "Failed to create user";
-        return proto::UserResult::INTERNAL_ERROR;
+        sendUserResult(proto::USER_REQUEST_ADD, proto::UserResult::INTERNAL_ERROR);
+        return;
     }
 
-    std::unique_ptr<Database> database = openDatabase();
-    if (!database)
+    database().execute([new_user = std::move(new_user)](Database& database)
     {
-        LOG(LS_ERROR) << "Failed to connect to database";
-        return proto::UserResult::INTERNAL_ERROR;
-    }
-
-    if (!database->addUser(new_user))
-        return proto::UserResult::INTERNAL_ERROR;
-
-    return proto::UserResult::SUCCESS;
+        return database.addUser(new_user);
+    },
+    [this](bool result)
+    {
+        sendUserResult(proto::USER_REQUEST_ADD,
+                       result ? proto::UserResult::SUCCESS : proto::UserResult::INTERNAL_ERROR);
+    });
 }
 
-proto::UserResult::ErrorCode SessionAdmin::modifyUser(const proto::User& user)
+void SessionAdmin::modifyUser(const proto::User& user)
 {
     LOG(LS_INFO) << "User modify request: " << user.name();
 
     if (user.entry_id() <= 0)
     {
         LOG(LS_ERROR) << "Invalid user ID: " << user.entry_id();
-        return proto::UserResult::INVALID_DATA;
+        sendUserResult(proto::USER_REQUEST_MODIFY, proto::UserResult::INVALID_DATA);
+        return;
     }
 
     base::User new_user = base::User::parseFrom(user);
     if (!new_user.isValid())
     {
         LOG(LS_ERROR) << "Failed to create user";
-        return proto::UserResult::INTERNAL_ERROR;
+        sendUserResult(proto::USER_REQUEST_MODIFY, proto::UserResult::INTERNAL_ERROR);
+        return;
     }
 
-    std::unique_ptr<Database> database = openDatabase();
-    if (!database)
+    database().execute([new_user = std::move(new_user)](Database& database)
     {
-        LOG(LS_ERROR) << "Failed to connect to database";
-        return proto::UserResult::INTERNAL_ERROR;
-    }
-
-    if (!database->modifyUser(new_user))
-        return proto::UserResult::INTERNAL_ERROR;
-
-    return proto::UserResult::SUCCESS;
+        return database.modifyUser(new_user);
+    },
+    [this](bool result)
+    {
+        sendUserResult(proto::USER_REQUEST_MODIFY,
+                       result ? proto::UserResult::SUCCESS : proto::UserResult::INTERNAL_ERROR);
+    });
 }
 
-proto::UserResult::ErrorCode SessionAdmin::deleteUser(const proto::User& user)
+void SessionAdmin::deleteUser(const proto::User& user)
 {
-    std::unique_ptr<Database> database = openDatabase();
-    if (!database)
-    {
-        LOG(LS_ERROR) << "Failed to connect to database";
-        return proto::UserResult::INTERNAL_ERROR;
-    }
-
     uint64_t entry_id = user.entry_id();
 
     LOG(LS_INFO) << "User remove request: " << entry_id;
 
-    if (!database->removeUser(entry_id))
-        return proto::UserResult::INTERNAL_ERROR;
-
-    return proto::UserResult::SUCCESS;
+    database().execute([entry_id](Database& database)
+    {
+        return database.removeUser(entry_id);
+    },
+    [this](bool result)
+    {
+        sendUserResult(proto::USER_REQUEST_DELETE,
+                       result ? proto::UserResult::SUCCESS : proto::UserResult::INTERNAL_ERROR);
+    });
 }
 
 } // namespace router
@@ -19,6 +19,7 @@
 #ifndef ROUTER__SESSION_ADMIN_H
 #define ROUTER__SESSION_ADMIN_H
 
+#include "base/peer/host_id.h"
 #include "proto/router_admin.pb.h"
 #include "router/session.h"
 
@@ -32,6 +33,10 @@ public:
     SessionAdmin();
     ~SessionAdmin();
 
+    void onRelayListReceived(const proto::RelayList& relay_list);
+    void onHostListReceived(const proto::HostList& host_list);
+    void onHostDisconnected(base::HostId host_id, bool disconnected);
+
 protected:
     // Session implementation.
     void onSessionReady() override;
@@ -47,9 +52,11 @@ private:
     void doHostListRequest();
     void doHostRequest(const proto::HostRequest& request);
 
-    proto::UserResult::ErrorCode addUser(const proto::User& user);
-    proto::UserResult::ErrorCode modifyUser(const proto::User& user);
-    proto::UserResult::ErrorCode deleteUser(const proto::User& user);
+    void sendUserResult(proto::UserRequestType type, proto::UserResult::ErrorCode error_code);
+
+    void addUser(const proto::User& user);
+    void modifyUser(const proto::User& user);
+    void deleteUser(const proto::User& user);
 
     DISALLOW_COPY_AND_ASSIGN(SessionAdmin);
 };
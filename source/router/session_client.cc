@@ -19,10 +19,7 @@
 #include "router/session_client.h"
 
 #include "base/logging.h"
-#include "base/crypto/random.h"
-#include "base/strings/unicode.h"
-#include "router/server.h"
-#include "router/session_host.h"
+#include "router/server_shard.h"
 
 namespace router {
 
@@ -34,6 +31,13 @@ SessionClient::SessionClient()
 
 SessionClient::~SessionClient() = default;
 
+void SessionClient::sendConnectionOffer(const proto::ConnectionOffer& offer)
+{
+    proto::RouterToClient message;
+    message.mutable_connection_offer()->CopyFrom(offer);
+    sendMessage(message);
+}
+
 void SessionClient::onSessionReady()
 {
     // Nothing
@@ -67,45 +71,9 @@ void SessionClient::readConnectionRequest(const proto::ConnectionRequest& reques
 {
     LOG(LS_INFO) << "New connection request (host_id: " << request.host_id() << ")";
 
-    proto::RouterToClient message;
-    proto::ConnectionOffer* offer = message.mutable_connection_offer();
-
-    SessionHost* host = server().hostSessionById(request.host_id());
-    if (!host)
-    {
-        LOG(LS_WARNING) << "Host with id " << request.host_id() << " NOT found!";
-
-        offer->set_error_code(proto::ConnectionOffer::PEER_NOT_FOUND);
-    }
-    else
-    {
-        LOG(LS_INFO) << "Host with id " << request.host_id() << " found";
-
-        std::optional<SharedKeyPool::Credentials> credentials = relayKeyPool().takeCredentials();
-        if (!credentials.has_value())
-        {
-            LOG(LS_WARNING) << "Empty key pool";
-
-            offer->set_error_code(proto::ConnectionOffer::KEY_POOL_EMPTY);
-        }
-        else
-        {
-            offer->set_error_code(proto::ConnectionOffer::SUCCESS);
-
-            proto::RelayCredentials* offer_credentials = offer->mutable_relay();
-
-            offer_credentials->set_host(credentials->host);
-            offer_credentials->set_port(credentials->port);
-            offer_credentials->mutable_key()->CopyFrom(credentials->key);
-            offer_credentials->set_secret(base::Random::string(16));
-
-            LOG(LS_INFO) << "Sending connection offer to host";
-            host->sendConnectionOffer(*offer);
-        }
-    }
-
-    LOG(LS_INFO) << "Sending connection offer to client";
-    sendMessage(message);
+    // The host may belong to another shard. The offer is sent to the host and to the client by the
+    // server.
+    shard().requestConnection(this, request.host_id());
 }
 
 } // namespace router
@@ -22,8 +22,7 @@
 #include "base/crypto/generic_hash.h"
 #include "base/crypto/random.h"
 #include "base/net/network_channel.h"
-#include "router/database.h"
-#include "router/server.h"
+#include "router/server_shard.h"
 
 namespace router {
 
@@ -91,37 +90,27 @@ void SessionHost::readHostIdRequest(const proto::HostIdRequest& host_id_request)
         return;
     }
 
-    std::unique_ptr<Database> database = openDatabase();
-    if (!database)
+    if (host_id_request_pending_)
     {
-        LOG(LS_ERROR) << "Failed to connect to database";
+        LOG(LS_ERROR) << "Host ID request is already in progress";
         return;
     }
 
-    proto::RouterToHost message;
-    proto::HostIdResponse* host_id_response = message.mutable_host_id_response();
-    base::ByteArray keyHash;
+    std::string key;
+    base::ByteArray key_hash;
 
     if (host_id_request.type() == proto::HostIdRequest::NEW_ID)
     {
         // Generate new key.
-        std::string key = base::Random::string(kPeerKeySize);
+        key = base::Random::string(kPeerKeySize);
 
         // Calculate hash for key.
-        keyHash = base::GenericHash::hash(base::GenericHash::Type::BLAKE2b512, key);
-
-        if (!database->addHost(keyHash))
-        {
-            LOG(LS_ERROR) << "Unable to add host";
-            return;
-        }
-
-        host_id_response->set_key(std::move(key));
+        key_hash = base::GenericHash::hash(base::GenericHash::Type::BLAKE2b512, key);
     }
     else if (host_id_request.type() == proto::HostIdRequest::EXISTING_ID)
     {
         // Using existing key.
-        keyHash = base::GenericHash::hash(
+        key_hash = base::GenericHash::hash(
             base::GenericHash::Type::BLAKE2b512, host_id_request.key());
     }
     else
@@ -130,15 +119,32 @@ void SessionHost::readHostIdRequest(const proto::HostIdRequest& host_id_request)
         return;
     }
 
-    host_id_ = database->hostId(keyHash);
-    if (host_id_ == base::kInvalidHostId)
+    // The host keys are shared by all shards and are resolved on the server thread.
+    host_id_request_pending_ = true;
+    shard().requestHostId(this, std::move(key_hash), std::move(key));
+}
+
+void SessionHost::onHostIdReceived(base::HostId host_id, const std::string& key)
+{
+    host_id_request_pending_ = false;
+
+    if (host_id == base::kInvalidHostId)
     {
         LOG(LS_ERROR) << "Failed to get host ID";
         return;
     }
 
+    host_id_ = host_id;
+
     // Notify the server that the ID has been assigned.
-    server().onHostSessionWithId(this);
+    shard().onHostSessionWithId(this);
+
+    proto::RouterToHost message;
+    proto::HostIdResponse* host_id_response = message.mutable_host_id_response();
+
+    // The key is sent only for a new host.
+    if (!key.empty())
+        host_id_response->set_key(key);
 
     host_id_response->set_host_id(host_id_);
     sendMessage(message);
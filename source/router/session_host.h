@@ -36,6 +36,7 @@ public:
     base::HostId hostId() const { return host_id_; }
 
     void sendConnectionOffer(const proto::ConnectionOffer& offer);
+    void onHostIdReceived(base::HostId host_id, const std::string& key);
 
 protected:
     // Session implementation.
@@ -49,6 +50,7 @@ private:
     void readHostIdRequest(const proto::HostIdRequest& host_id_request);
 
     base::HostId host_id_ = base::kInvalidHostId;
+    bool host_id_request_pending_ = false;
 
     DISALLOW_COPY_AND_ASSIGN(SessionHost);
 };
@@ -0,0 +1,90 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "router/session_registry.h"
+
+#include "base/logging.h"
+#include "router/session.h"
+
+namespace router {
+
+SessionRegistry::SessionRegistry() = default;
+
+SessionRegistry::~SessionRegistry() = default;
+
+Session* SessionRegistry::add(std::unique_ptr<Session> session)
+{
+    DCHECK(session);
+    DCHECK_EQ(session->registry_index_, Session::kNotRegistered);
+    DCHECK(!ids_.count(session->id()));
+
+    session->registry_index_ = sessions_.size();
+    ids_.emplace(session->id(), session.get());
+    sessions_.emplace_back(std::move(session));
+
+    return sessions_.back().get();
+}
+
+std::unique_ptr<Session> SessionRegistry::take(Session* session)
+{
+    if (!contains(session))
+        return nullptr;
+
+    ids_.erase(session->id());
+
+    const size_t index = session->registry_index_;
+    std::unique_ptr<Session> result = std::move(sessions_[index]);
+
+    // The last session takes the place of the removed one.
+    if (index != sessions_.size() - 1)
+    {
+        sessions_[index] = std::move(sessions_.back());
+        sessions_[index]->registry_index_ = index;
+    }
+
+    sessions_.pop_back();
+    result->registry_index_ = Session::kNotRegistered;
+
+    return result;
+}
+
+void SessionRegistry::clear()
+{
+    ids_.clear();
+    sessions_.clear();
+}
+
+Session* SessionRegistry::session(uint64_t session_id) const
+{
+    auto it = ids_.find(session_id);
+    if (it == ids_.end())
+        return nullptr;
+
+    return it->second;
+}
+
+bool SessionRegistry::contains(Session* session) const
+{
+    if (!session)
+        return false;
+
+    const size_t index = session->registry_index_;
+    return index < sessions_.size() && sessions_[index].get() == session;
+}
+
+} // namespace router
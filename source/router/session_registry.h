@@ -0,0 +1,79 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef ROUTER__SESSION_REGISTRY_H
+#define ROUTER__SESSION_REGISTRY_H
+
+#include "base/macros_magic.h"
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace router {
+
+class Session;
+
+//
+// Owns the sessions of a server shard and indexes them by session ID for fast lookup.
+// Each session stores its position in the registry, so a session is removed in constant time.
+// The ID of a session must be set before it is added and must not change while it is registered.
+// The class is not thread-safe.
+//
+class SessionRegistry
+{
+public:
+    SessionRegistry();
+    ~SessionRegistry();
+
+    // Adds a session to the registry. The registry takes ownership.
+    Session* add(std::unique_ptr<Session> session);
+
+    // Removes the session from the registry and returns it to the caller. Returns nullptr if the
+    // session is not in the registry.
+    std::unique_ptr<Session> take(Session* session);
+
+    // Destroys all sessions.
+    void clear();
+
+    // Returns the session with the specified ID or nullptr if there is no such session.
+    Session* session(uint64_t session_id) const;
+
+    template <typename Callback>
+    void forEach(Callback callback) const
+    {
+        for (const auto& session : sessions_)
+            callback(session.get());
+    }
+
+    size_t size() const { return sessions_.size(); }
+    bool empty() const { return sessions_.empty(); }
+
+private:
+    bool contains(Session* session) const;
+
+    std::vector<std::unique_ptr<Session>> sessions_;
+    std::unordered_map<uint64_t, Session*> ids_;
+
+    DISALLOW_COPY_AND_ASSIGN(SessionRegistry);
+};
+
+} // namespace router
+
+#endif // ROUTER__SESSION_REGISTRY_H
@@ -19,7 +19,7 @@
 #include "router/session_relay.h"
 
 #include "base/logging.h"
-#include "router/shared_key_pool.h"
+#include "router/server_shard.h"
 
 namespace router {
 
@@ -29,10 +29,7 @@ SessionRelay::SessionRelay()
     // Nothing
 }
 
-SessionRelay::~SessionRelay()
-{
-    relayKeyPool().removeKeysForRelay(host_);
-}
+SessionRelay::~SessionRelay() = default;
 
 void SessionRelay::sendKeyUsed(uint32_t key_id)
 {
@@ -60,6 +57,10 @@ void SessionRelay::onMessageReceived(const base::ByteArray& buffer)
     {
         readKeyPool(message.key_pool());
     }
+    else if (message.has_relay_stat())
+    {
+        readRelayStat(message.relay_stat());
+    }
     else
     {
         LOG(LS_WARNING) << "Unhandled message from relay server";
@@ -73,17 +74,29 @@ void SessionRelay::onMessageWritten(size_t /* pending */)
 
 void SessionRelay::readKeyPool(const proto::RelayKeyPool& key_pool)
 {
-    SharedKeyPool& pool = relayKeyPool();
-
     LOG(LS_INFO) << "Received key pool: " << key_pool.key_size() << " (" << address() << ")";
 
+    if (!host_.empty() && host_ != key_pool.peer_host())
+    {
+        LOG(LS_ERROR) << "Relay host cannot be changed (" << address() << ")";
+        return;
+    }
+
     host_ = key_pool.peer_host();
-    uint16_t port = key_pool.peer_port();
 
-    for (int i = 0; i < key_pool.key_size(); ++i)
+    // The key pool is shared by all shards and is owned by the server thread.
+    shard().addRelayKeys(this, key_pool);
+}
+
+void SessionRelay::readRelayStat(const proto::RelayStat& relay_stat)
+{
+    if (host_.empty())
     {
-        pool.addKey(host_, port, key_pool.key(i));
+        LOG(LS_WARNING) << "Relay stat received before key pool (" << address() << ")";
+        return;
     }
+
+    shard().setRelayStat(this, relay_stat);
 }
 
 } // namespace router
@@ -21,7 +21,6 @@
 
 #include "proto/router_relay.pb.h"
 #include "router/session.h"
-#include "router/shared_key_pool.h"
 
 namespace router {
 
@@ -44,6 +43,7 @@ protected:
 
 private:
     void readKeyPool(const proto::RelayKeyPool& key_pool);
+    void readRelayStat(const proto::RelayStat& relay_stat);
 
     std::string host_;
 
@@ -51,6 +51,46 @@ base::ByteArray Settings::privateKey() const
     return base::fromHex(impl_.get<std::string>("PrivateKey"));
 }
 
+void Settings::setThreadCount(uint32_t count)
+{
+    impl_.set<uint32_t>("ThreadCount", count);
+}
+
+uint32_t Settings::threadCount() const
+{
+    return impl_.get<uint32_t>("ThreadCount", 0);
+}
+
+void Settings::setMaxConnectionRate(uint32_t rate)
+{
+    impl_.set<uint32_t>("MaxConnectionRate", rate);
+}
+
+uint32_t Settings::maxConnectionRate() const
+{
+    return impl_.get<uint32_t>("MaxConnectionRate", 1000);
+}
+
+void Settings::setMaxAddressConnectionRate(uint32_t rate)
+{
+    impl_.set<uint32_t>("MaxAddressConnectionRate", rate);
+}
+
+uint32_t Settings::maxAddressConnectionRate() const
+{
+    return impl_.get<uint32_t>("MaxAddressConnectionRate", 20);
+}
+
+void Settings::setMaxPendingHandshakes(uint32_t count)
+{
+    impl_.set<uint32_t>("MaxPendingHandshakes", count);
+}
+
+uint32_t Settings::maxPendingHandshakes() const
+{
+    return impl_.get<uint32_t>("MaxPendingHandshakes", 1000);
+}
+
 void Settings::setLogPath(const std::filesystem::path& path)
 {
     impl_.set<std::filesystem::path>("LogPath", path);
@@ -35,6 +35,21 @@ public:
     void setPrivateKey(const base::ByteArray& private_key);
     base::ByteArray privateKey() const;
 
+    // Number of threads that serve network connections. Zero means the number of processors.
+    void setThreadCount(uint32_t count);
+    uint32_t threadCount() const;
+
+    // Maximum number of accepted connections per second from all addresses and from one address.
+    // Zero means no limit.
+    void setMaxConnectionRate(uint32_t rate);
+    uint32_t maxConnectionRate() const;
+    void setMaxAddressConnectionRate(uint32_t rate);
+    uint32_t maxAddressConnectionRate() const;
+
+    // Maximum number of connections that are being authenticated. Zero means no limit.
+    void setMaxPendingHandshakes(uint32_t count);
+    uint32_t maxPendingHandshakes() const;
+
     void setLogPath(const std::filesystem::path& path);
     std::filesystem::path logPath() const;
 
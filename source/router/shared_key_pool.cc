@@ -20,7 +20,9 @@
 
 #include "base/logging.h"
 
+#include <algorithm>
 #include <map>
+#include <set>
 
 namespace router {
 
@@ -33,6 +35,7 @@ public:
     void dettach();
 
     void addKey(const std::string& host, uint16_t port, const proto::RelayKey& key);
+    void setRelayStat(const std::string& host, const proto::RelayStat& stat);
     std::optional<Credentials> takeCredentials();
     void removeKeysForRelay(const std::string& host);
     void clear();
@@ -51,9 +54,29 @@ private:
 
         uint16_t port = 0;
         std::vector<proto::RelayKey> keys;
+
+        // Used instead of RelayStat::max_sessions until the relay sends its stat.
+        size_t peak_key_count = 0;
+
+        std::optional<proto::RelayStat> stat;
+
+        // Spare capacity with which the relay is stored in |candidates_|.
+        uint32_t spare_capacity = 0;
     };
 
+    using Relay = std::map<std::string, RelayInfo>::iterator;
+
+    // Spare capacity and host name of a relay.
+    using Candidate = std::pair<uint32_t, std::string>;
+
+    static uint32_t spareCapacity(const RelayInfo& relay);
+    void updateCandidate(Relay relay);
+
     std::map<std::string, RelayInfo> pool_;
+
+    // Relays that have keys, from the most to the least spare capacity.
+    std::set<Candidate, std::greater<Candidate>> candidates_;
+
     Delegate* delegate_;
 
     DISALLOW_COPY_AND_ASSIGN(Impl);
@@ -87,42 +110,39 @@ void SharedKeyPool::Impl::addKey(const std::string& host, uint16_t port, const p
 
     LOG(LS_INFO) << "Added key with id " << key.key_id() << " for host '" << host << "'";
     relay->second.keys.emplace_back(std::move(key));
+    relay->second.peak_key_count =
+        std::max(relay->second.peak_key_count, relay->second.keys.size());
+
+    updateCandidate(relay);
 }
 
-std::optional<SharedKeyPool::Credentials> SharedKeyPool::Impl::takeCredentials()
+void SharedKeyPool::Impl::setRelayStat(const std::string& host, const proto::RelayStat& stat)
 {
-    if (pool_.empty())
+    auto relay = pool_.find(host);
+    if (relay == pool_.end())
     {
-        LOG(LS_WARNING) << "Empty key pool";
-        return std::nullopt;
+        LOG(LS_WARNING) << "Stat for unknown relay '" << host << "'";
+        return;
     }
 
-    auto preffered_relay = pool_.end();
-    size_t max_count = 0;
-
-    for (auto it = pool_.begin(); it != pool_.end(); ++it)
-    {
-        size_t count = it->second.keys.size();
-        if (count > max_count)
-        {
-            preffered_relay = it;
-            max_count = count;
-        }
-    }
+    relay->second.stat = stat;
+    updateCandidate(relay);
+}
 
-    if (preffered_relay == pool_.end())
+std::optional<SharedKeyPool::Credentials> SharedKeyPool::Impl::takeCredentials()
+{
+    if (candidates_.empty())
     {
         LOG(LS_WARNING) << "Empty key pool";
         return std::nullopt;
     }
 
-    LOG(LS_INFO) << "Preffered relay: " << preffered_relay->first;
+    auto preffered_relay = pool_.find(candidates_.begin()->second);
+    DCHECK(preffered_relay != pool_.end());
+    DCHECK(!preffered_relay->second.keys.empty());
 
-    if (preffered_relay->second.keys.empty())
-    {
-        LOG(LS_ERROR) << "Empty key pool for relay";
-        return std::nullopt;
-    }
+    LOG(LS_INFO) << "Preffered relay: " << preffered_relay->first
+                 << " (spare capacity: " << preffered_relay->second.spare_capacity << ")";
 
     Credentials credentials;
     credentials.host = preffered_relay->first;
@@ -132,11 +152,8 @@ std::optional<SharedKeyPool::Credentials> SharedKeyPool::Impl::takeCredentials()
     // Removing the key from the pool.
     preffered_relay->second.keys.pop_back();
 
-    if (preffered_relay->second.keys.empty())
-    {
-        LOG(LS_INFO) << "Last key in the pool for relay. The relay will be removed from the pool";
-        pool_.erase(preffered_relay->first);
-    }
+    // The relay stays in the pool without keys, so its stat is kept until new keys are received.
+    updateCandidate(preffered_relay);
 
     if (delegate_)
         delegate_->onPoolKeyUsed(credentials.host, credentials.key.key_id());
@@ -146,13 +163,19 @@ std::optional<SharedKeyPool::Credentials> SharedKeyPool::Impl::takeCredentials()
 
 void SharedKeyPool::Impl::removeKeysForRelay(const std::string& host)
 {
+    auto relay = pool_.find(host);
+    if (relay == pool_.end())
+        return;
+
     LOG(LS_INFO) << "All keys for relay '" << host << "' removed";
-    pool_.erase(host);
+    candidates_.erase(Candidate(relay->second.spare_capacity, host));
+    pool_.erase(relay);
 }
 
 void SharedKeyPool::Impl::clear()
 {
     LOG(LS_INFO) << "Key pool cleared";
+    candidates_.clear();
     pool_.clear();
 }
 
@@ -177,7 +200,51 @@ size_t SharedKeyPool::Impl::count() const
 
 bool SharedKeyPool::Impl::isEmpty() const
 {
-    return pool_.empty();
+    return candidates_.empty();
+}
+
+// static
+uint32_t SharedKeyPool::Impl::spareCapacity(const RelayInfo& relay)
+{
+    // The capacity is measured in thousandths.
+    static const uint64_t kFull = 1000;
+
+    uint64_t max_sessions = relay.peak_key_count;
+    if (relay.stat.has_value() && relay.stat->max_sessions())
+        max_sessions = relay.stat->max_sessions();
+
+    // Each unused key corresponds to a free session of the relay.
+    uint64_t spare = 0;
+    if (max_sessions)
+        spare = std::min(kFull, relay.keys.size() * kFull / max_sessions);
+
+    if (relay.stat.has_value())
+    {
+        const proto::RelayStat& stat = *relay.stat;
+
+        spare = std::min(spare, kFull - std::min<uint64_t>(stat.cpu_usage(), 100) * kFull / 100);
+
+        if (stat.max_bandwidth())
+        {
+            const uint64_t used = std::min(stat.bandwidth(), stat.max_bandwidth());
+            spare = std::min(spare, kFull - used * kFull / stat.max_bandwidth());
+        }
+    }
+
+    return static_cast<uint32_t>(spare);
+}
+
+void SharedKeyPool::Impl::updateCandidate(Relay relay)
+{
+    RelayInfo& info = relay->second;
+
+    candidates_.erase(Candidate(info.spare_capacity, relay->first));
+
+    if (info.keys.empty())
+        return;
+
+    info.spare_capacity = spareCapacity(info);
+    candidates_.emplace(info.spare_capacity, relay->first);
 }
 
 SharedKeyPool::SharedKeyPool(Delegate* delegate)
@@ -210,6 +277,11 @@ void SharedKeyPool::addKey(const std::string& host, uint16_t port, const proto::
     impl_->addKey(host, port, key);
 }
 
+void SharedKeyPool::setRelayStat(const std::string& host, const proto::RelayStat& stat)
+{
+    impl_->setRelayStat(host, stat);
+}
+
 std::optional<SharedKeyPool::Credentials> SharedKeyPool::takeCredentials()
 {
     return impl_->takeCredentials();
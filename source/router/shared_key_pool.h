@@ -21,6 +21,7 @@
 
 #include "base/macros_magic.h"
 #include "proto/router_common.pb.h"
+#include "proto/router_relay.pb.h"
 
 #include <cstdint>
 #include <optional>
@@ -52,6 +53,10 @@ public:
     };
 
     void addKey(const std::string& host, uint16_t port, const proto::RelayKey& key);
+    void setRelayStat(const std::string& host, const proto::RelayStat& stat);
+
+    // Takes a key of the relay with the most spare capacity. The capacity is determined by the
+    // most loaded resource of the relay: free sessions (unused keys), processor or bandwidth.
     std::optional<Credentials> takeCredentials();
     void removeKeysForRelay(const std::string& host);
     void clear();
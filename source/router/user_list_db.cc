@@ -23,8 +23,8 @@
 
 namespace router {
 
-UserListDb::UserListDb(std::unique_ptr<Database> db)
-    : db_(std::move(db))
+UserListDb::UserListDb(std::shared_ptr<DatabaseFactory> factory)
+    : factory_(std::move(factory))
 {
     // Nothing
 }
@@ -32,23 +32,29 @@ UserListDb::UserListDb(std::unique_ptr<Database> db)
 UserListDb::~UserListDb() = default;
 
 // static
-std::unique_ptr<UserListDb> UserListDb::open(const DatabaseFactory& factory)
+std::unique_ptr<UserListDb> UserListDb::open(std::shared_ptr<DatabaseFactory> factory)
 {
-    std::unique_ptr<Database> db = factory.openDatabase();
-    if (!db)
+    // Checks that the database is available.
+    if (!factory->openDatabase())
         return nullptr;
 
-    return std::unique_ptr<UserListDb>(new UserListDb(std::move(db)));
+    return std::unique_ptr<UserListDb>(new UserListDb(std::move(factory)));
 }
 
 void UserListDb::add(const base::User& user)
 {
-    db_->addUser(user);
+    std::unique_ptr<Database> db = factory_->openDatabase();
+    if (db)
+        db->addUser(user);
 }
 
 base::User UserListDb::find(std::u16string_view username) const
 {
-    return db_->findUser(username);
+    std::unique_ptr<Database> db = factory_->openDatabase();
+    if (!db)
+        return base::User::kInvalidUser;
+
+    return db->findUser(username);
 }
 
 const base::ByteArray& UserListDb::seedKey() const
@@ -63,7 +69,11 @@ void UserListDb::setSeedKey(const base::ByteArray& seed_key)
 
 std::vector<base::User> UserListDb::list() const
 {
-    return db_->userList();
+    std::unique_ptr<Database> db = factory_->openDatabase();
+    if (!db)
+        return std::vector<base::User>();
+
+    return db->userList();
 }
 
 } // namespace router
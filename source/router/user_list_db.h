@@ -24,15 +24,20 @@
 
 namespace router {
 
-class Database;
 class DatabaseFactory;
 
+//
+// User list stored in the router database.
+// Each call takes a connection from the pool of the database factory, so find() may be called
+// from several threads at the same time (for example, from the authentication workers). The seed
+// key must be set before the list is shared.
+//
 class UserListDb : public base::UserListBase
 {
 public:
     ~UserListDb();
 
-    static std::unique_ptr<UserListDb> open(const DatabaseFactory& factory);
+    static std::unique_ptr<UserListDb> open(std::shared_ptr<DatabaseFactory> factory);
 
     // base::UserListBase implementation.
     void add(const base::User& user) override;
@@ -42,9 +47,9 @@ public:
     std::vector<base::User> list() const override;
 
 private:
-    explicit UserListDb(std::unique_ptr<Database> db);
+    explicit UserListDb(std::shared_ptr<DatabaseFactory> factory);
 
-    std::unique_ptr<Database> db_;
+    std::shared_ptr<DatabaseFactory> factory_;
     base::ByteArray seed_key_;
 
     DISALLOW_COPY_AND_ASSIGN(UserListDb);
@@ -19,7 +19,7 @@ void build(Solution &s)
 
     auto setup_target = [&aspia](auto &t, const String &name, bool add_tests = false) -> decltype(auto)
     {
-        t += cpp17;
+        t += cpp20;
         t.Public += "."_idir;
         t.setRootDirectory(name);
         t += IncludeDirectory("."s);
@@ -49,7 +49,7 @@ void build(Solution &s)
         if (add_tests)
         {
             auto &bt = t.addExecutable("test");
-            bt += cpp17;
+            bt += cpp20;
             bt += FileRegex(name, ".*_unittest.*", true);
             bt += t;
             bt += "org.sw.demo.google.googletest.gmock"_dep;
@@ -104,17 +104,26 @@ void build(Solution &s)
     automoc("org.sw.demo.qtproject.qt.base.tools.moc"_dep, base);
 
     auto &relay = aspia.addExecutable("relay");
-    relay += cpp17;
+    relay += cpp20;
     relay += "relay/.*"_rr;
     relay += base;
 
+    // The router sources are built as a library to be shared with the router benchmarks. The
+    // tools in the subdirectories are separate executables.
+    auto &router_core = aspia.addStaticLibrary("router_core");
+    router_core += cpp20;
+    router_core.setRootDirectory("router");
+    router_core += ".*"_r;
+    router_core -= "main.cc";
+    router_core.Public += base;
+    router_core.Public += "org.sw.demo.sqlite3"_dep;
+
     auto &router = aspia.addExecutable("router");
-    router += cpp17;
-    router += "router/.*"_rr;
-    router -= "router/keygen.*"_rr;
-    router -= "router/manager.*"_rr;
-    router += base;
-    router += "org.sw.demo.sqlite3"_dep;
+    router += cpp20;
+    router.setRootDirectory("router");
+    router += "main.cc";
+    router += "win/.*"_rr;
+    router += router_core;
 
     auto qt_progs = [](auto &t, const String &name_override = {}, const path &path_override = {})
     {
@@ -185,7 +194,7 @@ void build(Solution &s)
 
     auto &keygen = router.addExecutable("keygen");
     setup_exe(keygen);
-    keygen += cpp17;
+    keygen += cpp20;
     keygen.setRootDirectory("router/keygen");
     keygen += ".*"_rr;
     keygen += qt_base;
@@ -193,10 +202,34 @@ void build(Solution &s)
     keygen.Public += "org.sw.demo.qtproject.qt.base.plugins.styles.windowsvista"_dep;
     qt_progs(keygen);
 
+    auto &login_benchmark = router.addExecutable("login_benchmark");
+    login_benchmark += cpp20;
+    login_benchmark.setRootDirectory("router/login_benchmark");
+    login_benchmark += ".*"_rr;
+    login_benchmark += base;
+
+    auto &load_test = router.addExecutable("load_test");
+    load_test += cpp20;
+    load_test.setRootDirectory("router/load_test");
+    load_test += ".*"_rr;
+    load_test += base;
+
+    auto &database_benchmark = router.addExecutable("database_benchmark");
+    database_benchmark += cpp20;
+    database_benchmark.setRootDirectory("router/database_benchmark");
+    database_benchmark += ".*"_rr;
+    database_benchmark += router_core;
+
+    auto &registry_benchmark = router.addExecutable("registry_benchmark");
+    registry_benchmark += cpp20;
+    registry_benchmark.setRootDirectory("router/registry_benchmark");
+    registry_benchmark += ".*"_rr;
+    registry_benchmark += router_core;
+
     //
     auto &manager = router.addExecutable("manager");
     setup_exe(manager);
-    manager += cpp17;
+    manager += cpp20;
     manager.setRootDirectory("router/manager");
     manager += ".*"_rr;
     manager += qt_base;
@@ -206,11 +239,18 @@ void build(Solution &s)
 
     //
     auto &client = add_lib("client");
+    client -= "file_transfer_benchmark/.*"_rr;
     client.Public += common;
     if (client.getBuildSettings().TargetOS.Type == OSType::Windows)
         client.Public += "org.sw.demo.qtproject.qt.base.plugins.printsupport.windows"_dep;
     qt_progs_and_tr(client);
 
+    auto &file_transfer_benchmark = client.addExecutable("file_transfer_benchmark");
+    file_transfer_benchmark += cpp20;
+    file_transfer_benchmark.setRootDirectory("client/file_transfer_benchmark");
+    file_transfer_benchmark += ".*"_rr;
+    file_transfer_benchmark += client;
+
     auto add_exe = [&setup_exe](auto &base, const String &name) -> decltype(auto)
     {
         return setup_exe(base.addExecutable(name));